@@ -33,14 +33,16 @@ cbuffer SceneData : register(b0)
 };
 
 
-cbuffer MeshData : register(b1)
+StructuredBuffer<_OBJ_ATTRIBUTES_> materials : register(t0); // the level's material table
+
+cbuffer DrawData : register(b1) // one per table entry, written at load
 {
-    matrix worldMatrix;
-    _OBJ_ATTRIBUTES_ material;
+    uint materialIndex;
 };
 
 float4 main(PS_IN input) : SV_TARGET
 {
+    _OBJ_ATTRIBUTES_ material = materials[materialIndex];
     //Cashed Results, Large use of Swizzlers
     float3 lightDir = normalize(-_lightDirection.xyz);
     float lightRatio = saturate(dot(lightDir, normalize(input.normW))); 
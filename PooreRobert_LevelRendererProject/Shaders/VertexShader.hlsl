@@ -5,6 +5,9 @@ struct VS_IN
     float3 inputPos : POSITION;
     float3 inputUVW : UVW;
     float3 inputNormal : NORMAL;
+    matrix instanceWorld : WORLD; // per instance, WORLD0-3 are its rows
+    float4 decodeOffset : DECODE0; // per instance, 0 for uncompressed vertices
+    float4 decodeScale : DECODE1; // per instance, 1 for uncompressed vertices
 };
 
 struct VS_OUT
@@ -35,23 +38,16 @@ cbuffer SceneData : register(b0)
 };
 
 
-cbuffer MeshData : register(b1)
-{
-    matrix worldMatrix;
-    _OBJ_ATTRIBUTES_ material;
-};
-
-
 VS_OUT main(VS_IN input) 
 {
     VS_OUT output;
 	
-    output.posH = mul(float4(input.inputPos, 1), worldMatrix);
+    output.posH = mul(float4(input.decodeOffset.xyz + input.inputPos * input.decodeScale.xyz, 1), input.instanceWorld);
     output.posW = output.posH;
     output.posH = mul(output.posH, viewMatrix);
     output.posH = mul(output.posH, projectionMatrix);
 
-    output.normW = mul(float4(input.inputNormal, 0), worldMatrix).xyz; 
+    output.normW = mul(float4(input.inputNormal, 0), input.instanceWorld).xyz; 
 	
     return output;
 	
@@ -0,0 +1,49 @@
+//VertexShaderCompact
+// VertexShader for CompactVertex (see vertexCompression.h), the input assembler already turns
+// the UNORM16 position into 0..1 and the SNORM16 normal into -1..1
+#pragma pack_matrix(row_major)
+struct VS_IN
+{
+    float3 inputPos : POSITION; // inside the asset's box
+    float2 inputNormal : NORMAL; // octahedral
+    matrix instanceWorld : WORLD; // per instance, WORLD0-3 are its rows
+    float4 decodeOffset : DECODE0; // per instance, the asset's box
+    float4 decodeScale : DECODE1;
+};
+
+struct VS_OUT
+{
+    float4 posH : SV_POSITION;
+    float3 posW : WORLD;
+    float3 normW : NORMAL;
+};
+
+cbuffer SceneData : register(b0)
+{
+    vector _lightDirection, _lightColor, _sunAmbient, _cameraPos;
+    matrix viewMatrix, projectionMatrix;
+};
+
+// Unfolds the lower half of the octahedron, same as DecodeOctahedral on the CPU
+float3 DecodeOctahedral(float2 encoded)
+{
+    float3 n = float3(encoded, 1 - abs(encoded.x) - abs(encoded.y));
+    if (n.z < 0)
+        n.xy = (1 - abs(n.yx)) * (n.xy >= 0 ? 1 : -1);
+    return normalize(n);
+}
+
+VS_OUT main(VS_IN input)
+{
+    VS_OUT output;
+
+    float3 pos = input.decodeOffset.xyz + input.inputPos * input.decodeScale.xyz;
+    output.posH = mul(float4(pos, 1), input.instanceWorld);
+    output.posW = output.posH;
+    output.posH = mul(output.posH, viewMatrix);
+    output.posH = mul(output.posH, projectionMatrix);
+
+    output.normW = mul(float4(DecodeOctahedral(input.inputNormal), 0), input.instanceWorld).xyz;
+
+    return output;
+};
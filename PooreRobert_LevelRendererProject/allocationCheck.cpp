@@ -0,0 +1,133 @@
+//allocationCheck.cpp
+// Counts the heap allocations RenderLevel makes, on the render thread and in the jobs it hands to
+// the workers, headless on the in memory RecordingBackend. First the counter itself: plain and
+// over-aligned allocations in jobs count for the Scope that queued them, a thread outside it does
+// not. Then every GameLevel*.txt in a folder is drawn from a turning camera, on one thread and on
+// a JobSystem, with BVH and linear culling. The first frame may size things, every frame after it
+// must not allocate at all.
+//   AllocationCheck <h2b folder> <levels folder> [frames, default 8]
+#define GATEWARE_ENABLE_CORE // All libraries need this
+#define GATEWARE_ENABLE_SYSTEM // GFile & GLog used by the level loader
+#define GATEWARE_ENABLE_MATH
+#define LEVELRENDERER_COUNT_ALLOCATIONS // this is the one translation unit that counts them
+
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include "../gateware-main/gateware-main/Gateware.h"
+#include "load_object_oriented.h"
+#include "recordingBackend.h"
+
+static unsigned failures = 0;
+
+static void Check(bool passed, const std::string& what)
+{
+	if (!passed)
+	{
+		std::cout << "MISMATCH: " << what << std::endl;
+		++failures;
+	}
+}
+
+struct alignas(64) CacheLine
+{
+	float data[16];
+};
+
+// Every job of a ParallelFor allocates once plain and once over-aligned, wherever it runs, while
+// another thread allocates outside the scope
+static void CheckScope(JobSystem& jobs)
+{
+	const unsigned count = 64;
+	std::atomic<bool> stop{ false };
+	std::thread outside([&stop]() {
+		while (!stop.load())
+			delete new int(0);
+	});
+	unsigned long long counted;
+	std::atomic<unsigned> misaligned{ 0 };
+	{
+		AllocationCounter::Scope scope;
+		jobs.ParallelFor(count, 1, [&misaligned](unsigned begin, unsigned end) {
+			for (unsigned i = begin; i < end; ++i)
+			{
+				delete new int(static_cast<int>(i));
+				CacheLine* line = new CacheLine();
+				misaligned += reinterpret_cast<uintptr_t>(line) % alignof(CacheLine) != 0;
+				delete line;
+			}
+		});
+		counted = scope.Allocations();
+	}
+	stop.store(true);
+	outside.join();
+	Check(misaligned == 0, std::to_string(misaligned.load()) + " over-aligned allocations are not aligned");
+	Check(counted == 2 * count, std::to_string(counted) + " allocations counted for " + std::to_string(2 * count) +
+		" made by jobs on " + std::to_string(jobs.GetThreadCount()) + " threads");
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 3 && argc != 4)
+	{
+		std::cout << "usage: AllocationCheck <h2b folder> <levels folder> [frames]" << std::endl;
+		return 1;
+	}
+	const unsigned frames = argc == 4 ? std::max(2u, static_cast<unsigned>(std::stoul(argv[3]))) : 8;
+	std::vector<std::string> levels;
+	for (const auto& entry : std::filesystem::directory_iterator(argv[2]))
+	{
+		const std::string name = entry.path().filename().string();
+		if (name.rfind("GameLevel", 0) == 0 && entry.path().extension() == ".txt")
+			levels.push_back(entry.path().string());
+	}
+	std::sort(levels.begin(), levels.end());
+
+	// same projection as RenderManager at 16:9
+	GW::MATH::GMatrix proxy;
+	proxy.Create();
+	GW::MATH::GMATRIXF projection;
+	proxy.ProjectionDirectXLHF(G_DEGREE_TO_RADIAN_F(65), 16.0f / 9.0f, 0.1f, 100.0f, projection);
+	JobSystem jobs(3);
+	GW::SYSTEM::GLog log; // not created, the messages go nowhere
+	CheckScope(jobs);
+
+	std::cout << std::left << std::setw(20) << "level" << std::setw(10) << "jobs" << std::setw(10) << "culling" <<
+		std::right << std::setw(13) << "first frame" << std::setw(14) << "later frames" << std::endl;
+	bool allZero = !levels.empty();
+	for (const std::string& path : levels)
+	{
+		for (int config = 0; config < 4; ++config)
+		{
+			const bool threaded = config >= 2, hierarchy = config % 2 == 0;
+			Level_Objects level;
+			level.SetJobSystem(threaded ? &jobs : nullptr);
+			level.SetHierarchyCulling(hierarchy);
+			if (!level.LoadLevel(path.c_str(), argv[1], log))
+				return 1;
+			RecordingBackend backend;
+			backend.SetRecording(false); // counts only, the command stream would grow every frame
+			Camera camera;
+			camera.LookAt({ 0, 8, -18, 0 }, { 0, 0, 0, 0 }, { 0, 1, 0, 0 });
+			camera.SetProjection(projection);
+			level.UploadLevelToGPU(backend, camera.Update().view, projection);
+			unsigned long long first = 0, later = 0;
+			for (unsigned f = 0; f < frames; ++f)
+			{
+				camera.YawLocal(0.4f); // a different visible set every frame
+				level.RenderLevel(camera.Update());
+				(f == 0 ? first : later) += level.GetLastRenderAllocations();
+			}
+			allZero &= later == 0;
+			std::cout << std::left << std::setw(20) << std::filesystem::path(path).filename().string() << std::setw(10) <<
+				(threaded ? std::to_string(jobs.GetThreadCount()) : std::string("off")) << std::setw(10) <<
+				(hierarchy ? "bvh" : "linear") << std::right << std::setw(13) << first << std::setw(14) << later << std::endl;
+			level.UnloadLevel();
+		}
+	}
+	Check(allZero, "RenderLevel allocated after the first frame");
+	return failures == 0 ? 0 : 1;
+}
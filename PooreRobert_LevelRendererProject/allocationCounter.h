@@ -0,0 +1,124 @@
+//allocationCounter
+// Test hook that counts heap allocations made through the global operator new.
+// Define LEVELRENDERER_COUNT_ALLOCATIONS in exactly one translation unit before including
+// this header to install the counting operators, otherwise the count simply stays at zero.
+#ifndef _ALLOCATIONCOUNTER_H_
+#define _ALLOCATIONCOUNTER_H_
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace AllocationCounter {
+	// total number of operator new calls since program start
+	inline std::atomic<unsigned long long>& Total()
+	{
+		static std::atomic<unsigned long long> total(0);
+		return total;
+	}
+	// Where the calling thread's operator new calls are counted: the innermost Scope on it or, while
+	// a JobSystem thread runs a job, the Scope of the thread that queued the job. nullptr counts
+	// nowhere, so a background load does not show up in a render thread Scope even when it shares
+	// the job threads.
+	inline std::atomic<unsigned long long>*& ThisThread()
+	{
+		thread_local std::atomic<unsigned long long>* sink = nullptr;
+		return sink;
+	}
+
+	// Counts the allocations made between its construction and Allocations() by the current thread
+	// and by every job queued under it, on whichever thread the job runs. It must outlive those
+	// jobs, which it does when its thread waits on their counters before it goes. Nested scopes add
+	// their count to the outer one when they end.
+	class Scope
+	{
+		std::atomic<unsigned long long> count{ 0 };
+		std::atomic<unsigned long long>* outer;
+	public:
+		Scope() : outer(ThisThread()) { ThisThread() = &count; }
+		~Scope()
+		{
+			ThisThread() = outer;
+			if (outer != nullptr)
+				*outer += count.load();
+		}
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+		unsigned long long Allocations() const { return count.load(); }
+	};
+}
+
+#ifdef LEVELRENDERER_COUNT_ALLOCATIONS
+namespace AllocationCounter {
+	// What the replaced operators below allocate & free with, malloc or the aligned variant
+	void* Allocate(std::size_t size, std::size_t alignment)
+	{
+		++Total();
+		if (std::atomic<unsigned long long>* sink = ThisThread())
+			++*sink;
+		size = size ? size : 1;
+		if (alignment == 0)
+			return std::malloc(size);
+#ifdef _WIN32
+		return _aligned_malloc(size, alignment);
+#else
+		return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment); // a multiple of it
+#endif
+	}
+	void Release(void* p, bool aligned) noexcept
+	{
+#ifdef _WIN32
+		if (aligned)
+		{
+			_aligned_free(p);
+			return;
+		}
+#else
+		(void)aligned;
+#endif
+		// GCC inlines this into operator delete and, seeing memory that came from new reach free,
+		// warns of a mismatch. The operator new above is malloc underneath, so they do match.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+		std::free(p);
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+	}
+}
+
+void* operator new(std::size_t size)
+{
+	if (void* p = AllocationCounter::Allocate(size, 0))
+		return p;
+	throw std::bad_alloc();
+}
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	if (void* p = AllocationCounter::Allocate(size, static_cast<std::size_t>(alignment)))
+		return p;
+	throw std::bad_alloc();
+}
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+void operator delete(void* p) noexcept { AllocationCounter::Release(p, false); }
+void operator delete[](void* p) noexcept { AllocationCounter::Release(p, false); }
+void operator delete(void* p, std::size_t) noexcept { AllocationCounter::Release(p, false); }
+void operator delete[](void* p, std::size_t) noexcept { AllocationCounter::Release(p, false); }
+void operator delete(void* p, std::align_val_t) noexcept { AllocationCounter::Release(p, true); }
+void operator delete[](void* p, std::align_val_t) noexcept { AllocationCounter::Release(p, true); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { AllocationCounter::Release(p, true); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { AllocationCounter::Release(p, true); }
+#endif
+
+#endif
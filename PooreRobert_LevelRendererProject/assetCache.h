@@ -0,0 +1,431 @@
+//assetCache
+// Shares model data between every placed instance of the same .h2b.
+// A level like GameLevelOne.txt places Coin.h2b 14 times, but only the first
+// "Coin" parses the file and uploads its geometry, the rest just take a reference.
+// Preload parses a whole level's .h2b files at once on a JobSystem, the Acquire calls that
+// follow take the results instead of reading the disk.
+// Zero-copy tradeoff: a MAPPED load only points into the file, but mesh optimization and LOD
+// generation (both on by default) rewrite the geometry, so they copy it out and unmap the file
+// first. A .h2b read at run time therefore costs one copy plus the optimizer & simplifier, in
+// exchange for vertex cache friendly meshes & LODs without a build step. The zero-copy path is
+// the .lvlpack one: LevelPacker does that work offline and AcquireFromMemory uses the mapped
+// pack as is. Turning both settings off makes mapped .h2b loads zero-copy too, without LODs.
+#ifndef _ASSETCACHE_H_
+#define _ASSETCACHE_H_
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include "h2bParser.h"
+#include "h2bMappedParser.h"
+#include "renderBackend.h"
+#include "levelGeometry.h"
+#include "meshOptimizer.h"
+#include "meshSimplifier.h"
+#include "frustumCulling.h"
+#include "jobSystem.h"
+
+typedef unsigned AssetHandle;
+const AssetHandle INVALID_ASSET = ~0u;
+
+// How the cache reads .h2b files
+enum class H2BLoader
+{
+	MAPPED, // H2B::MappedParser over a memory mapped file, zero-copy unless optimized/LODs (default)
+	STREAM // H2B::Parser, std::ifstream into owned vectors
+};
+
+const unsigned INVALID_MATERIAL_LIST = ~0u;
+
+// The part of an H2B::MESH that drawing needs
+struct AssetMesh
+{
+	H2B::BATCH drawInfo;
+	unsigned materialIndex;
+};
+
+// Everything about a model that is the same for all of its instances
+struct ModelAsset
+{
+	std::string name; // stripped model name ("Coin" for "Coin.003")
+	H2B::Parser cpuModel; // filled by the STREAM loader
+	H2B::MappedParser mappedModel; // filled by the MAPPED loader
+	unsigned refCount = 0;
+
+	// geometry waiting for upload, points into cpuModel, mappedModel or the owned copies
+	// (optimized, LOD indices appended) until ReleaseCPUData
+	H2B::Span<H2B::VERTEX> vertices;
+	H2B::Span<unsigned> indices;
+	std::vector<H2B::VERTEX> ownedVertices;
+	std::vector<unsigned> ownedIndices;
+	// small per mesh/material data kept for drawing after the big arrays are gone
+	std::vector<AssetMesh> meshes;
+	std::vector<H2B::ATTRIBUTES> materials;
+	// coarser versions of meshes, lods[0] is LOD 1. They share the vertices, their index ranges
+	// follow the full model's in indices.
+	std::vector<MeshLod> lods;
+	// local space bounds of all vertices, computed on load
+	BoundingBox bounds = {};
+	BoundingSphere sphere = {};
+
+	// its vertices & indices in the level's shared buffers
+	GeometryHandle geometry = INVALID_GEOMETRY;
+	// where its meshes' entries start in the owning level's MaterialTable, set by the level
+	unsigned materialList = INVALID_MATERIAL_LIST;
+	LevelGeometry* uploadedTo = nullptr; // owner of the range above
+
+	bool IsUploaded() const
+	{
+		return uploadedTo != nullptr;
+	}
+
+	// 1 for the full model plus one per generated LOD
+	unsigned GetLodCount() const
+	{
+		return 1 + static_cast<unsigned>(lods.size());
+	}
+	// Object space error of a level, 0 for the full model
+	float GetLodError(unsigned lod) const
+	{
+		return lod == 0 ? 0.0f : lods[lod - 1].error;
+	}
+	// Index range of one mesh in one level, relative to the asset's indices
+	const H2B::BATCH& GetMeshDraw(unsigned lod, unsigned mesh) const
+	{
+		return lod == 0 ? meshes[mesh].drawInfo : lods[lod - 1].meshes[mesh];
+	}
+
+	// Copies the vertices & indices into the level's buffers, only the first instance to upload pays for this.
+	// False if the level's buffers cannot take it (too many vertices for 16 bit indices).
+	bool UploadToGPU(LevelGeometry& levelGeometry)
+	{
+		if (IsUploaded())
+			return true;
+
+		geometry = levelGeometry.Add(vertices.data, static_cast<unsigned>(vertices.size()),
+			indices.data, static_cast<unsigned>(indices.size()));
+		if (geometry == INVALID_GEOMETRY)
+			return false;
+		uploadedTo = &levelGeometry;
+		// the backend has its own copy now
+		ReleaseCPUData();
+		return true;
+	}
+
+	// Copies the geometry out of the parsed file so it can be changed, the file is released
+	void TakeOwnership()
+	{
+		if (vertices.data == ownedVertices.data() && indices.data == ownedIndices.data())
+			return;
+		ownedVertices.assign(vertices.begin(), vertices.end());
+		ownedIndices.assign(indices.begin(), indices.end());
+		cpuModel.Clear();
+		mappedModel.Clear();
+		PointAtOwned();
+	}
+	void PointAtOwned()
+	{
+		vertices.data = ownedVertices.data();
+		vertices.count = static_cast<unsigned>(ownedVertices.size());
+		indices.data = ownedIndices.data();
+		indices.count = static_cast<unsigned>(ownedIndices.size());
+	}
+	std::vector<H2B::BATCH> MeshRanges() const
+	{
+		std::vector<H2B::BATCH> ranges;
+		for (const AssetMesh& mesh : meshes)
+			ranges.push_back(mesh.drawInfo);
+		return ranges;
+	}
+
+	// Welds & reorders the geometry for the vertex cache (see meshOptimizer.h)
+	void Optimize()
+	{
+		TakeOwnership();
+		const std::vector<H2B::BATCH> ranges = MeshRanges();
+		OptimizeMesh(ownedVertices, ownedIndices, ranges.data(), static_cast<unsigned>(ranges.size()));
+		PointAtOwned();
+	}
+
+	// Appends the LOD chain to the indices (see meshSimplifier.h), small models get none
+	void GenerateLods()
+	{
+		TakeOwnership();
+		const std::vector<H2B::BATCH> ranges = MeshRanges();
+		lods = ::GenerateLods(ownedVertices, ownedIndices, ranges.data(), static_cast<unsigned>(ranges.size()));
+		PointAtOwned();
+	}
+
+	bool Load(const char* h2bPath, H2BLoader loader, bool optimize, bool generateLods)
+	{
+		if (loader == H2BLoader::MAPPED)
+		{
+			if (!mappedModel.Parse(h2bPath))
+				return false;
+			vertices = mappedModel.vertices;
+			indices = mappedModel.indices;
+			for (const H2B::MeshView& mesh : mappedModel.meshes)
+				meshes.push_back({ mesh.drawInfo, mesh.materialIndex });
+			for (const H2B::MaterialView& material : mappedModel.materials)
+				materials.push_back(material.attrib);
+		}
+		else
+		{
+			if (!cpuModel.Parse(h2bPath))
+				return false;
+			vertices.data = cpuModel.vertices.data();
+			vertices.count = static_cast<unsigned>(cpuModel.vertices.size());
+			indices.data = cpuModel.indices.data();
+			indices.count = static_cast<unsigned>(cpuModel.indices.size());
+			for (const H2B::MESH& mesh : cpuModel.meshes)
+				meshes.push_back({ mesh.drawInfo, mesh.materialIndex });
+			for (const H2B::MATERIAL& material : cpuModel.materials)
+				materials.push_back(material.attrib);
+		}
+		// welding, the LODs & the GPU all index with these, a file naming vertices it does not have
+		// fails like one that does not parse
+		if (!IndicesInRange(indices.data, indices.count, vertices.count))
+			return false;
+		if (optimize)
+			Optimize();
+		if (generateLods)
+			GenerateLods();
+		ComputeBounds(vertices.data, vertices.count, bounds, sphere);
+		return true;
+	}
+
+	// Uses geometry that already sits in memory (a mapped LevelPack), it has to stay valid until upload
+	void LoadFromMemory(H2B::Span<H2B::VERTEX> _vertices, H2B::Span<unsigned> _indices,
+		const AssetMesh* _meshes, unsigned meshCount, const H2B::ATTRIBUTES* _materials, unsigned materialCount,
+		const MeshLod* _lods, unsigned lodCount)
+	{
+		vertices = _vertices;
+		indices = _indices;
+		meshes.assign(_meshes, _meshes + meshCount);
+		materials.assign(_materials, _materials + materialCount);
+		lods.assign(_lods, _lods + lodCount);
+		ComputeBounds(vertices.data, vertices.count, bounds, sphere);
+	}
+
+	// Drops the vertex/index arrays (or unmaps the file), meshes, materials & LODs are kept
+	void ReleaseCPUData()
+	{
+		cpuModel.Clear();
+		mappedModel.Clear();
+		ownedVertices = std::vector<H2B::VERTEX>();
+		ownedIndices = std::vector<unsigned>();
+		vertices = H2B::Span<H2B::VERTEX>();
+		indices = H2B::Span<unsigned>();
+	}
+
+	void Free()
+	{
+		name.clear();
+		ReleaseCPUData();
+		meshes.clear();
+		materials.clear();
+		lods.clear();
+		bounds = {};
+		sphere = {};
+		refCount = 0;
+		if (uploadedTo != nullptr)
+			uploadedTo->Remove(geometry);
+		materialList = INVALID_MATERIAL_LIST;
+		geometry = INVALID_GEOMETRY;
+		uploadedTo = nullptr;
+	}
+};
+
+// One .h2b for AssetCache::Preload
+struct AssetRequest
+{
+	std::string name; // stripped model name, the key Acquire will use
+	std::string h2bPath;
+};
+
+// Reference counted storage of ModelAssets keyed by stripped model name
+class AssetCache
+{
+	// handles index into this and slots are recycled, a deque never relocates its elements
+	// which matters because H2B::Parser hands out pointers into its own strings (not copy safe)
+	// and H2B::MappedParser owns its file mapping (not copyable at all)
+	std::deque<ModelAsset> assets;
+	std::vector<AssetHandle> freeSlots;
+	std::unordered_map<std::string, AssetHandle> lookup;
+	// loaded by Preload and not acquired yet, INVALID_ASSET for files that failed to load
+	std::unordered_map<std::string, AssetHandle> preloaded;
+
+	H2BLoader loader = H2BLoader::MAPPED;
+	bool optimizeMeshes = true; // run meshOptimizer.h over every .h2b read from disk
+	bool generateLods = true; // and meshSimplifier.h
+
+	unsigned hits = 0; // Acquire calls satisfied without touching the disk
+	unsigned misses = 0; // Acquire calls that had to parse a .h2b
+
+	AssetHandle ClaimSlot()
+	{
+		if (freeSlots.empty())
+		{
+			assets.emplace_back();
+			return static_cast<AssetHandle>(assets.size() - 1);
+		}
+		const AssetHandle handle = freeSlots.back();
+		freeSlots.pop_back();
+		return handle;
+	}
+	void FreeSlot(AssetHandle handle)
+	{
+		assets[handle].Free();
+		freeSlots.push_back(handle);
+	}
+
+	// Looks the name up, or claims a slot and fills it with load(asset)
+	template<typename LoadFunction>
+	AssetHandle Insert(const std::string& assetName, LoadFunction load)
+	{
+		auto found = lookup.find(assetName);
+		if (found != lookup.end())
+		{
+			++hits;
+			++assets[found->second].refCount;
+			return found->second;
+		}
+
+		++misses;
+		AssetHandle handle;
+		auto ready = preloaded.find(assetName);
+		if (ready != preloaded.end())
+		{
+			// loaded already, still a miss. A failed file stays failed for every Acquire of it.
+			handle = ready->second;
+			if (handle == INVALID_ASSET)
+				return INVALID_ASSET;
+			preloaded.erase(ready);
+		}
+		else
+		{
+			handle = ClaimSlot();
+			if (!load(assets[handle]))
+			{
+				FreeSlot(handle);
+				return INVALID_ASSET;
+			}
+		}
+		ModelAsset& asset = assets[handle];
+		asset.name = assetName;
+		asset.refCount = 1;
+		lookup[assetName] = handle;
+		return handle;
+	}
+
+public:
+	void SetLoader(H2BLoader _loader) { loader = _loader; }
+	H2BLoader GetLoader() const { return loader; }
+	// On by default. Assets from memory (level packs) are never touched, LevelPacker already
+	// wrote them optimized.
+	void SetMeshOptimization(bool enabled) { optimizeMeshes = enabled; }
+	bool GetMeshOptimization() const { return optimizeMeshes; }
+	// On by default, same as above: packs bring the LODs LevelPacker generated
+	void SetLodGeneration(bool enabled) { generateLods = enabled; }
+	bool GetLodGeneration() const { return generateLods; }
+
+	// Strips the blender duplicate suffix, "Coin.003" -> "Coin"
+	static std::string StripModelName(const std::string& modelName)
+	{
+		return modelName.substr(0, modelName.find_last_of("."));
+	}
+
+	// Returns a shared handle to the asset, parsing h2bPath only the first time assetName is seen.
+	// Every successful Acquire must be paired with a Release.
+	AssetHandle Acquire(const std::string& assetName, const char* h2bPath)
+	{
+		return Insert(assetName, [&](ModelAsset& asset) { return asset.Load(h2bPath, loader, optimizeMeshes, generateLods); });
+	}
+
+	// Loads every requested asset that is neither cached nor preloaded yet, in parallel on jobs.
+	// Slots are claimed in request order and nothing is counted, the Acquire calls that follow
+	// take the results, so handles, hit & miss counts come out as if each Acquire had loaded its
+	// own file (except that failed files no longer hand their slot to the next asset).
+	// Call DiscardPreloads once done acquiring.
+	void Preload(const std::vector<AssetRequest>& requests, JobSystem& jobs)
+	{
+		std::vector<std::pair<AssetHandle, const AssetRequest*>> toLoad;
+		for (const AssetRequest& request : requests)
+		{
+			if (lookup.count(request.name) != 0 || preloaded.count(request.name) != 0)
+				continue;
+			const AssetHandle handle = ClaimSlot();
+			preloaded[request.name] = handle;
+			toLoad.push_back({ handle, &request });
+		}
+		// every job fills only its own slots, a deque's elements never move
+		std::vector<unsigned char> loaded(toLoad.size());
+		jobs.ParallelFor(static_cast<unsigned>(toLoad.size()), 1, [&](unsigned begin, unsigned end) {
+			for (unsigned i = begin; i < end; ++i)
+				loaded[i] = assets[toLoad[i].first].Load(toLoad[i].second->h2bPath.c_str(), loader, optimizeMeshes, generateLods);
+		});
+		for (size_t i = 0; i < toLoad.size(); ++i)
+			if (!loaded[i])
+			{
+				FreeSlot(toLoad[i].first);
+				preloaded[toLoad[i].second->name] = INVALID_ASSET;
+			}
+	}
+	// Frees whatever Preload loaded that was never acquired
+	void DiscardPreloads()
+	{
+		for (const auto& entry : preloaded)
+			if (entry.second != INVALID_ASSET)
+				FreeSlot(entry.second);
+		preloaded.clear();
+	}
+
+	// Acquire for data that is already in memory, see ModelAsset::LoadFromMemory
+	AssetHandle AcquireFromMemory(const std::string& assetName, H2B::Span<H2B::VERTEX> vertices, H2B::Span<unsigned> indices,
+		const AssetMesh* meshes, unsigned meshCount, const H2B::ATTRIBUTES* materials, unsigned materialCount,
+		const MeshLod* lods, unsigned lodCount)
+	{
+		return Insert(assetName, [&](ModelAsset& asset) {
+			asset.LoadFromMemory(vertices, indices, meshes, meshCount, materials, materialCount, lods, lodCount);
+			return true;
+		});
+	}
+
+	// Adds a reference to an asset the caller already holds, counts as a hit
+	AssetHandle Retain(AssetHandle handle)
+	{
+		if (handle >= assets.size() || assets[handle].refCount == 0)
+			return INVALID_ASSET;
+		++hits;
+		++assets[handle].refCount;
+		return handle;
+	}
+
+	// Drops a reference, the CPU & GPU data is freed with the last one
+	void Release(AssetHandle handle)
+	{
+		if (handle >= assets.size() || assets[handle].refCount == 0)
+			return;
+		ModelAsset& asset = assets[handle];
+		if (--asset.refCount == 0)
+		{
+			lookup.erase(asset.name);
+			asset.Free();
+			freeSlots.push_back(handle);
+		}
+	}
+
+	ModelAsset& Get(AssetHandle handle) { return assets[handle]; }
+	const ModelAsset& Get(AssetHandle handle) const { return assets[handle]; }
+
+	unsigned GetHitCount() const { return hits; }
+	unsigned GetMissCount() const { return misses; }
+	unsigned GetAssetCount() const { return static_cast<unsigned>(lookup.size()); }
+	void ResetCounters()
+	{
+		hits = 0;
+		misses = 0;
+	}
+};
+
+#endif
@@ -0,0 +1,158 @@
+//assetCacheCheck.cpp
+// Checks AssetCache's sharing on every GameLevel*.txt in a folder, loaded on one thread and on a
+// JobSystem. The expected counts come from reading the level file here, line by line: the first
+// MESH of each model name that has a .h2b is a miss and every later one a hit, records whose
+// .h2b is missing are a miss each and place nothing. Every asset's reference count must equal
+// its instances, removing all instances of an asset frees it, and after UnloadLevel the cache
+// and the in memory RecordingBackend are empty.
+//   AssetCacheCheck <h2b folder> <levels folder>
+#define GATEWARE_ENABLE_CORE // All libraries need this
+#define GATEWARE_ENABLE_SYSTEM // GFile & GLog used by the level loader
+#define GATEWARE_ENABLE_MATH
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <map>
+#include <set>
+#include "../gateware-main/gateware-main/Gateware.h"
+#include "load_object_oriented.h"
+#include "recordingBackend.h"
+
+static unsigned failures = 0;
+
+static void Check(bool passed, const std::string& what)
+{
+	if (!passed)
+	{
+		std::cout << "MISMATCH: " << what << std::endl;
+		++failures;
+	}
+}
+
+struct ExpectedCounts
+{
+	unsigned instances = 0, hits = 0, misses = 0, assets = 0;
+};
+
+static std::string Trim(const std::string& line)
+{
+	const size_t first = line.find_first_not_of(" \t\r");
+	return first == std::string::npos ? std::string() : line.substr(first, line.find_last_not_of(" \t\r") - first + 1);
+}
+
+static ExpectedCounts CountLevel(const std::string& levelPath, const std::string& h2bFolder)
+{
+	ExpectedCounts counts;
+	std::set<std::string> seen;
+	std::ifstream level(levelPath);
+	std::string line;
+	while (std::getline(level, line))
+	{
+		if (Trim(line) != "MESH" || !std::getline(level, line))
+			continue;
+		const std::string name = AssetCache::StripModelName(Trim(line));
+		if (!std::filesystem::exists(h2bFolder + "/" + name + ".h2b"))
+			++counts.misses;
+		else if (seen.insert(name).second)
+		{
+			++counts.misses;
+			++counts.instances;
+		}
+		else
+		{
+			++counts.hits;
+			++counts.instances;
+		}
+	}
+	counts.assets = static_cast<unsigned>(seen.size());
+	return counts;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		std::cout << "usage: AssetCacheCheck <h2b folder> <levels folder>" << std::endl;
+		return 1;
+	}
+	const std::string h2bFolder = argv[1];
+	std::vector<std::string> levels;
+	for (const auto& entry : std::filesystem::directory_iterator(argv[2]))
+	{
+		const std::string name = entry.path().filename().string();
+		if (name.rfind("GameLevel", 0) == 0 && entry.path().extension() == ".txt")
+			levels.push_back(entry.path().string());
+	}
+	std::sort(levels.begin(), levels.end());
+	Check(!levels.empty(), "no GameLevel*.txt found");
+	GW::SYSTEM::GLog log; // not created, the messages go nowhere
+	GW::MATH::GMatrix proxy;
+	proxy.Create();
+	GW::MATH::GMATRIXF projection;
+	proxy.ProjectionDirectXLHF(G_DEGREE_TO_RADIAN_F(65), 16.0f / 9.0f, 0.1f, 100.0f, projection);
+	JobSystem jobs(3);
+
+	std::cout << std::left << std::setw(20) << "level" << std::setw(6) << "jobs" << std::right << std::setw(11) <<
+		"instances" << std::setw(8) << "assets" << std::setw(7) << "hits" << std::setw(8) << "misses" << std::endl;
+	for (const bool threaded : { false, true })
+	{
+		// one level object for all of them, every load starts by unloading the last
+		Level_Objects level;
+		level.SetJobSystem(threaded ? &jobs : nullptr);
+		RecordingBackend backend;
+		for (const std::string& path : levels)
+		{
+			const std::string label = std::filesystem::path(path).filename().string() + (threaded ? " on jobs" : "");
+			const ExpectedCounts expected = CountLevel(path, h2bFolder);
+			if (!level.LoadLevel(path.c_str(), h2bFolder.c_str(), log))
+			{
+				Check(false, "could not load " + label);
+				continue;
+			}
+			const AssetCache& cache = level.GetAssetCache();
+			const InstanceStore& instances = level.GetInstances();
+			Check(instances.Size() == expected.instances && cache.GetAssetCount() == expected.assets &&
+				cache.GetHitCount() == expected.hits && cache.GetMissCount() == expected.misses,
+				label + ": " + std::to_string(instances.Size()) + " instances, " + std::to_string(cache.GetAssetCount()) +
+				" assets, " + std::to_string(cache.GetHitCount()) + " hits & " + std::to_string(cache.GetMissCount()) +
+				" misses, the file says " + std::to_string(expected.instances) + ", " + std::to_string(expected.assets) + ", " +
+				std::to_string(expected.hits) + " & " + std::to_string(expected.misses));
+
+			// each asset is held once per instance
+			std::map<AssetHandle, unsigned> uses;
+			for (unsigned i = 0; i < instances.Size(); ++i)
+				++uses[instances.GetAssets()[i]];
+			unsigned wrongRefs = 0;
+			for (const auto& use : uses)
+				wrongRefs += cache.Get(use.first).refCount != use.second;
+			Check(wrongRefs == 0 && uses.size() == cache.GetAssetCount(),
+				label + ": " + std::to_string(wrongRefs) + " assets are not referenced once per instance");
+			std::cout << std::left << std::setw(20) << std::filesystem::path(path).filename().string() << std::setw(6) <<
+				(threaded ? "on" : "off") << std::right << std::setw(11) << instances.Size() << std::setw(8) <<
+				cache.GetAssetCount() << std::setw(7) << cache.GetHitCount() << std::setw(8) << cache.GetMissCount() << std::endl;
+
+			// the asset goes away with its last instance
+			Camera camera;
+			camera.LookAt({ 0, 8, -18, 0 }, { 0, 0, 0, 0 }, { 0, 1, 0, 0 });
+			camera.SetProjection(projection);
+			level.UploadLevelToGPU(backend, camera.Update().view, projection);
+			const AssetHandle removed = instances.GetAssets()[0];
+			const unsigned assetsBefore = cache.GetAssetCount();
+			for (unsigned i = instances.Size(); i-- > 0;)
+				if (instances.GetAssets()[i] == removed)
+					level.RemoveInstance(instances.HandleOf(i));
+			level.RenderLevel(camera.Update());
+			Check(cache.GetAssetCount() == assetsBefore - 1 && cache.Get(removed).refCount == 0,
+				label + ": an asset was kept after its last instance was removed");
+		}
+		level.UnloadLevel();
+		Check(level.GetAssetCache().GetAssetCount() == 0, std::string("assets left after UnloadLevel") + (threaded ? " on jobs" : ""));
+		Check(backend.GetLiveBufferCount() == 0, std::string("GPU buffers left after UnloadLevel") + (threaded ? " on jobs" : ""));
+	}
+	if (failures == 0)
+		std::cout << "asset cache counts match the level files and every reference was released" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,350 @@
+//batchMath
+// Math over many instances at once, for the passes that touch every instance of a level:
+//   Concatenate:     world * viewProj for every world matrix (world * view * projection)
+//   TransformBounds: world boxes from local boxes, the batch version of TransformBounds
+//   CullSpheres:     bounding spheres against the six planes of a frustum
+// Each one has a scalar, an SSE and an AVX2 kernel. GetBatchMath() picks the widest one the CPU
+// and OS support on first use, GetBatchMath(level) asks for a specific one.
+// Every kernel does the same multiplies and adds in the same order as the scalar code (and
+// GW::MATH::GMatrix::MultiplyMatrixF) and never fuses them, so all of them give bit identical
+// results and can be swapped freely.
+// Matrices are row major with row vectors, 16 floats each like GW::MATH::GMATRIXF::data. Boxes
+// and spheres are structure-of-arrays, the lanes of one register are consecutive instances.
+#ifndef _BATCHMATH_H_
+#define _BATCHMATH_H_
+#include <vector>
+#include "frustumCulling.h"
+#if LEVELRENDERER_SSE && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#include <immintrin.h>
+#define LEVELRENDERER_AVX2 1
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define LEVELRENDERER_TARGET_AVX2 // MSVC compiles AVX intrinsics without a switch
+#else
+#define LEVELRENDERER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+enum class SimdLevel
+{
+	SCALAR,
+	SSE,
+	AVX2
+};
+
+// Six float arrays of count entries each. Kernels only read the ones they are given as input.
+struct BoxArrays
+{
+	float* center[3];
+	float* extents[3];
+};
+struct SphereArrays
+{
+	float* center[3];
+	float* radius;
+};
+
+// The kernels of one SimdLevel
+struct BatchMath
+{
+	SimdLevel level;
+	const char* name;
+	// out[i] = worlds[i] * viewProj, out may not alias worlds
+	void (*Concatenate)(const float* worlds, unsigned count, const float viewProj[16], float* out);
+	// out box i = local box i moved by worlds[i], out may alias local
+	void (*TransformBounds)(const BoxArrays& local, const float* worlds, unsigned count, const BoxArrays& out);
+	// Appends the index of every sphere that is at least partly inside, in ascending order
+	void (*CullSpheres)(const SphereArrays& spheres, unsigned count, const Frustum& frustum, std::vector<unsigned>& visible);
+};
+
+namespace BatchKernels {
+	inline void ConcatenateScalar(const float* worlds, unsigned count, const float viewProj[16], float* out)
+	{
+		for (unsigned i = 0; i < count; ++i)
+			MultiplyMatrix4(worlds + i * 16, viewProj, out + i * 16);
+	}
+	inline void TransformBoundsScalar(const BoxArrays& local, const float* worlds, unsigned count, const BoxArrays& out)
+	{
+		for (unsigned i = 0; i < count; ++i)
+		{
+			const BoundingBox box = { { local.center[0][i], local.center[1][i], local.center[2][i] },
+				{ local.extents[0][i], local.extents[1][i], local.extents[2][i] } };
+			const BoundingBox moved = ::TransformBounds(box, worlds + i * 16);
+			for (int a = 0; a < 3; ++a)
+			{
+				out.center[a][i] = moved.center[a];
+				out.extents[a][i] = moved.extents[a];
+			}
+		}
+	}
+	inline void CullSpheresScalar(const SphereArrays& spheres, unsigned first, unsigned count, const Frustum& frustum,
+		std::vector<unsigned>& visible)
+	{
+		for (unsigned i = first; i < count; ++i)
+		{
+			const BoundingSphere sphere = { { spheres.center[0][i], spheres.center[1][i], spheres.center[2][i] }, spheres.radius[i] };
+			if (IsSphereVisible(frustum, sphere))
+				visible.push_back(i);
+		}
+	}
+	inline void CullSpheresScalar(const SphereArrays& spheres, unsigned count, const Frustum& frustum, std::vector<unsigned>& visible)
+	{
+		CullSpheresScalar(spheres, 0, count, frustum, visible);
+	}
+
+#if LEVELRENDERER_SSE
+	// One row of the product: ((a0 * b0 + a1 * b1) + a2 * b2) + a3 * b3, a broadcast from the row
+	inline void ConcatenateSSE(const float* worlds, unsigned count, const float viewProj[16], float* out)
+	{
+		const __m128 b0 = _mm_loadu_ps(viewProj), b1 = _mm_loadu_ps(viewProj + 4);
+		const __m128 b2 = _mm_loadu_ps(viewProj + 8), b3 = _mm_loadu_ps(viewProj + 12);
+		for (unsigned i = 0; i < count; ++i)
+		{
+			const float* a = worlds + i * 16;
+			for (int r = 0; r < 4; ++r)
+			{
+				const __m128 row = _mm_loadu_ps(a + r * 4);
+				__m128 sum = _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(3, 3, 3, 3)), b3));
+				_mm_storeu_ps(out + i * 16 + r * 4, sum);
+			}
+		}
+	}
+
+	// Four instances per step, their matrix rows transposed so each register holds one element of
+	// four matrices
+	inline void TransformBoundsSSE(const BoxArrays& local, const float* worlds, unsigned count, const BoxArrays& out)
+	{
+		const __m128 signBit = _mm_set1_ps(-0.0f);
+		unsigned i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 m[4][4]; // [row][column], lane = instance
+			for (int r = 0; r < 4; ++r)
+			{
+				m[r][0] = _mm_loadu_ps(worlds + (i + 0) * 16 + r * 4);
+				m[r][1] = _mm_loadu_ps(worlds + (i + 1) * 16 + r * 4);
+				m[r][2] = _mm_loadu_ps(worlds + (i + 2) * 16 + r * 4);
+				m[r][3] = _mm_loadu_ps(worlds + (i + 3) * 16 + r * 4);
+				_MM_TRANSPOSE4_PS(m[r][0], m[r][1], m[r][2], m[r][3]);
+			}
+			const __m128 cx = _mm_loadu_ps(local.center[0] + i), cy = _mm_loadu_ps(local.center[1] + i);
+			const __m128 cz = _mm_loadu_ps(local.center[2] + i);
+			const __m128 ex = _mm_loadu_ps(local.extents[0] + i), ey = _mm_loadu_ps(local.extents[1] + i);
+			const __m128 ez = _mm_loadu_ps(local.extents[2] + i);
+			for (int a = 0; a < 3; ++a)
+			{
+				const __m128 center = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, m[0][a]), _mm_mul_ps(cy, m[1][a])),
+					_mm_mul_ps(cz, m[2][a])), m[3][a]);
+				const __m128 extents = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, _mm_andnot_ps(signBit, m[0][a])),
+					_mm_mul_ps(ey, _mm_andnot_ps(signBit, m[1][a]))), _mm_mul_ps(ez, _mm_andnot_ps(signBit, m[2][a])));
+				_mm_storeu_ps(out.center[a] + i, center);
+				_mm_storeu_ps(out.extents[a] + i, extents);
+			}
+		}
+		const BoxArrays localTail = { { local.center[0] + i, local.center[1] + i, local.center[2] + i },
+			{ local.extents[0] + i, local.extents[1] + i, local.extents[2] + i } };
+		const BoxArrays outTail = { { out.center[0] + i, out.center[1] + i, out.center[2] + i },
+			{ out.extents[0] + i, out.extents[1] + i, out.extents[2] + i } };
+		TransformBoundsScalar(localTail, worlds + i * 16, count - i, outTail);
+	}
+
+	// Same test as IsSphereVisible, four spheres per step
+	inline void CullSpheresSSE(const SphereArrays& spheres, unsigned count, const Frustum& frustum, std::vector<unsigned>& visible)
+	{
+		__m128 nx[6], ny[6], nz[6], nw[6];
+		for (int p = 0; p < 6; ++p)
+		{
+			nx[p] = _mm_set1_ps(frustum.planes[p][0]);
+			ny[p] = _mm_set1_ps(frustum.planes[p][1]);
+			nz[p] = _mm_set1_ps(frustum.planes[p][2]);
+			nw[p] = _mm_set1_ps(frustum.planes[p][3]);
+		}
+		const __m128 signBit = _mm_set1_ps(-0.0f);
+		unsigned i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 x = _mm_loadu_ps(spheres.center[0] + i), y = _mm_loadu_ps(spheres.center[1] + i);
+			const __m128 z = _mm_loadu_ps(spheres.center[2] + i);
+			const __m128 negativeRadius = _mm_xor_ps(_mm_loadu_ps(spheres.radius + i), signBit);
+			__m128 outside = _mm_setzero_ps();
+			for (int p = 0; p < 6; ++p)
+			{
+				const __m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], x), _mm_mul_ps(ny[p], y)),
+					_mm_mul_ps(nz[p], z)), nw[p]);
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(d, negativeRadius));
+			}
+			int mask = ~_mm_movemask_ps(outside) & 0xF;
+			for (unsigned lane = 0; mask != 0; ++lane, mask >>= 1)
+				if (mask & 1)
+					visible.push_back(i + lane);
+		}
+		CullSpheresScalar(spheres, i, count, frustum, visible);
+	}
+#endif
+
+#if LEVELRENDERER_AVX2
+	// Two rows per register, the in-lane permute broadcasts a row element within each half
+	LEVELRENDERER_TARGET_AVX2 inline void ConcatenateAVX2(const float* worlds, unsigned count, const float viewProj[16], float* out)
+	{
+		const __m256 b0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(viewProj));
+		const __m256 b1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(viewProj + 4));
+		const __m256 b2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(viewProj + 8));
+		const __m256 b3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(viewProj + 12));
+		for (unsigned i = 0; i < count; ++i)
+		{
+			const float* a = worlds + i * 16;
+			for (int r = 0; r < 4; r += 2)
+			{
+				const __m256 rows = _mm256_loadu_ps(a + r * 4);
+				__m256 sum = _mm256_mul_ps(_mm256_permute_ps(rows, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_permute_ps(rows, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_permute_ps(rows, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_permute_ps(rows, _MM_SHUFFLE(3, 3, 3, 3)), b3));
+				_mm256_storeu_ps(out + i * 16 + r * 4, sum);
+			}
+		}
+	}
+
+	// Eight instances per step: instances i..i+3 in the low halves, i+4..i+7 in the high halves,
+	// transposed in lane like _MM_TRANSPOSE4_PS
+	LEVELRENDERER_TARGET_AVX2 inline void TransformBoundsAVX2(const BoxArrays& local, const float* worlds, unsigned count,
+		const BoxArrays& out)
+	{
+		const __m256 signBit = _mm256_set1_ps(-0.0f);
+		unsigned i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 m[4][4]; // [row][column], lane = instance
+			for (int r = 0; r < 4; ++r)
+			{
+				__m256 rows[4];
+				for (int j = 0; j < 4; ++j)
+					rows[j] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(worlds + (i + j) * 16 + r * 4)),
+						_mm_loadu_ps(worlds + (i + j + 4) * 16 + r * 4), 1);
+				const __m256d t0 = _mm256_castps_pd(_mm256_unpacklo_ps(rows[0], rows[1]));
+				const __m256d t1 = _mm256_castps_pd(_mm256_unpacklo_ps(rows[2], rows[3]));
+				const __m256d t2 = _mm256_castps_pd(_mm256_unpackhi_ps(rows[0], rows[1]));
+				const __m256d t3 = _mm256_castps_pd(_mm256_unpackhi_ps(rows[2], rows[3]));
+				m[r][0] = _mm256_castpd_ps(_mm256_unpacklo_pd(t0, t1));
+				m[r][1] = _mm256_castpd_ps(_mm256_unpackhi_pd(t0, t1));
+				m[r][2] = _mm256_castpd_ps(_mm256_unpacklo_pd(t2, t3));
+				m[r][3] = _mm256_castpd_ps(_mm256_unpackhi_pd(t2, t3));
+			}
+			const __m256 cx = _mm256_loadu_ps(local.center[0] + i), cy = _mm256_loadu_ps(local.center[1] + i);
+			const __m256 cz = _mm256_loadu_ps(local.center[2] + i);
+			const __m256 ex = _mm256_loadu_ps(local.extents[0] + i), ey = _mm256_loadu_ps(local.extents[1] + i);
+			const __m256 ez = _mm256_loadu_ps(local.extents[2] + i);
+			for (int a = 0; a < 3; ++a)
+			{
+				const __m256 center = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, m[0][a]),
+					_mm256_mul_ps(cy, m[1][a])), _mm256_mul_ps(cz, m[2][a])), m[3][a]);
+				const __m256 extents = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, _mm256_andnot_ps(signBit, m[0][a])),
+					_mm256_mul_ps(ey, _mm256_andnot_ps(signBit, m[1][a]))), _mm256_mul_ps(ez, _mm256_andnot_ps(signBit, m[2][a])));
+				_mm256_storeu_ps(out.center[a] + i, center);
+				_mm256_storeu_ps(out.extents[a] + i, extents);
+			}
+		}
+		const BoxArrays localTail = { { local.center[0] + i, local.center[1] + i, local.center[2] + i },
+			{ local.extents[0] + i, local.extents[1] + i, local.extents[2] + i } };
+		const BoxArrays outTail = { { out.center[0] + i, out.center[1] + i, out.center[2] + i },
+			{ out.extents[0] + i, out.extents[1] + i, out.extents[2] + i } };
+		TransformBoundsSSE(localTail, worlds + i * 16, count - i, outTail);
+	}
+
+	LEVELRENDERER_TARGET_AVX2 inline void CullSpheresAVX2(const SphereArrays& spheres, unsigned count, const Frustum& frustum,
+		std::vector<unsigned>& visible)
+	{
+		__m256 nx[6], ny[6], nz[6], nw[6];
+		for (int p = 0; p < 6; ++p)
+		{
+			nx[p] = _mm256_set1_ps(frustum.planes[p][0]);
+			ny[p] = _mm256_set1_ps(frustum.planes[p][1]);
+			nz[p] = _mm256_set1_ps(frustum.planes[p][2]);
+			nw[p] = _mm256_set1_ps(frustum.planes[p][3]);
+		}
+		const __m256 signBit = _mm256_set1_ps(-0.0f);
+		unsigned i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256 x = _mm256_loadu_ps(spheres.center[0] + i), y = _mm256_loadu_ps(spheres.center[1] + i);
+			const __m256 z = _mm256_loadu_ps(spheres.center[2] + i);
+			const __m256 negativeRadius = _mm256_xor_ps(_mm256_loadu_ps(spheres.radius + i), signBit);
+			__m256 outside = _mm256_setzero_ps();
+			for (int p = 0; p < 6; ++p)
+			{
+				const __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx[p], x), _mm256_mul_ps(ny[p], y)),
+					_mm256_mul_ps(nz[p], z)), nw[p]);
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, negativeRadius, _CMP_LT_OQ));
+			}
+			int mask = ~_mm256_movemask_ps(outside) & 0xFF;
+			for (unsigned lane = 0; mask != 0; ++lane, mask >>= 1)
+				if (mask & 1)
+					visible.push_back(i + lane);
+		}
+		CullSpheresScalar(spheres, i, count, frustum, visible);
+	}
+#endif
+}
+
+// Widest kernels this CPU runs. AVX2 also needs the OS to save the 256 bit registers.
+inline SimdLevel DetectSimdLevel()
+{
+#if LEVELRENDERER_AVX2
+#if defined(_MSC_VER) && !defined(__clang__)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] >= 7)
+	{
+		__cpuid(info, 1);
+		const bool osSavesAvx = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6; // OSXSAVE, XMM & YMM state
+		__cpuidex(info, 7, 0);
+		if (osSavesAvx && (info[1] & (1 << 5)) != 0)
+			return SimdLevel::AVX2;
+	}
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) // checks the OS support as well
+		return SimdLevel::AVX2;
+#endif
+#endif
+#if LEVELRENDERER_SSE
+	return SimdLevel::SSE; // part of every x64 CPU
+#else
+	return SimdLevel::SCALAR;
+#endif
+}
+
+// Kernels of one level, a level this build or CPU cannot run falls back to the next narrower one
+inline const BatchMath& GetBatchMath(SimdLevel level)
+{
+	static const BatchMath scalar = { SimdLevel::SCALAR, "scalar", BatchKernels::ConcatenateScalar,
+		BatchKernels::TransformBoundsScalar, BatchKernels::CullSpheresScalar };
+#if LEVELRENDERER_SSE
+	static const BatchMath sse = { SimdLevel::SSE, "SSE", BatchKernels::ConcatenateSSE,
+		BatchKernels::TransformBoundsSSE, BatchKernels::CullSpheresSSE };
+#endif
+#if LEVELRENDERER_AVX2
+	static const BatchMath avx2 = { SimdLevel::AVX2, "AVX2", BatchKernels::ConcatenateAVX2,
+		BatchKernels::TransformBoundsAVX2, BatchKernels::CullSpheresAVX2 };
+	static const SimdLevel supported = DetectSimdLevel();
+	if (level == SimdLevel::AVX2 && supported == SimdLevel::AVX2)
+		return avx2;
+#endif
+#if LEVELRENDERER_SSE
+	if (level != SimdLevel::SCALAR)
+		return sse;
+#endif
+	return scalar;
+}
+
+// The widest kernels, chosen once
+inline const BatchMath& GetBatchMath()
+{
+	static const BatchMath& best = GetBatchMath(DetectSimdLevel());
+	return best;
+}
+
+#endif
@@ -0,0 +1,196 @@
+//batchMathBench.cpp
+// Checks every batch math kernel this CPU runs (batchMath.h) against the one instance at a time
+// code, bit for bit: world * viewProj against GMatrix::MultiplyMatrixF, boxes against
+// TransformBounds, spheres against IsSphereVisible. Then times each kernel.
+//   BatchMathBench [instances, default 10000] [repeats, default 200]
+#define GATEWARE_ENABLE_CORE // All libraries need this
+#define GATEWARE_ENABLE_MATH
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include "../gateware-main/gateware-main/Gateware.h"
+#include "batchMath.h"
+
+struct BenchData
+{
+	unsigned count = 0;
+	std::vector<GW::MATH::GMATRIXF> worlds;
+	std::vector<float> boxes; // 6 arrays of count, centers then extents
+	std::vector<float> spheres; // 4 arrays of count, centers then radius
+	GW::MATH::GMATRIXF viewProj;
+	Frustum frustum;
+
+	BoxArrays Boxes(std::vector<float>& storage) const
+	{
+		BoxArrays arrays;
+		for (int a = 0; a < 3; ++a)
+		{
+			arrays.center[a] = storage.data() + count * a;
+			arrays.extents[a] = storage.data() + count * (a + 3);
+		}
+		return arrays;
+	}
+	SphereArrays Spheres()
+	{
+		SphereArrays arrays;
+		for (int a = 0; a < 3; ++a)
+			arrays.center[a] = spheres.data() + count * a;
+		arrays.radius = spheres.data() + count * 3;
+		return arrays;
+	}
+};
+
+// Instances scattered around the camera of RenderManager with random rotation & scale
+static BenchData MakeData(GW::MATH::GMatrix& proxy, unsigned count)
+{
+	BenchData data;
+	data.count = count;
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-60.0f, 60.0f), angle(-3.14159265f, 3.14159265f),
+		scale(0.25f, 4.0f), size(0.05f, 3.0f);
+	data.worlds.resize(count);
+	for (GW::MATH::GMATRIXF& world : data.worlds)
+	{
+		proxy.RotationYawPitchRollF(angle(random), angle(random), angle(random), world);
+		const float s = scale(random);
+		for (int e = 0; e < 12; ++e)
+			world.data[e] *= s;
+		world.data[12] = position(random);
+		world.data[13] = position(random) * 0.25f;
+		world.data[14] = position(random);
+	}
+	data.boxes.resize(count * 6);
+	for (unsigned i = 0; i < count * 3; ++i)
+	{
+		data.boxes[i] = position(random) * 0.05f;
+		data.boxes[count * 3 + i] = size(random);
+	}
+	data.spheres.resize(count * 4);
+	for (unsigned i = 0; i < count * 3; ++i)
+		data.spheres[i] = position(random);
+	for (unsigned i = 0; i < count; ++i)
+		data.spheres[count * 3 + i] = size(random);
+
+	GW::MATH::GMATRIXF view, projection;
+	GW::MATH::GVECTORF eye = { 0, 8, -18, 0 }, at = { 0, 0, 0, 0 }, up = { 0, 1, 0, 0 };
+	proxy.LookAtLHF(eye, at, up, view);
+	proxy.ProjectionDirectXLHF(G_DEGREE_TO_RADIAN_F(65), 16.0f / 9.0f, 0.1f, 100.0f, projection);
+	proxy.MultiplyMatrixF(view, projection, data.viewProj);
+	data.frustum = ExtractFrustum(data.viewProj.data);
+	return data;
+}
+
+// Mismatching results of one kernel set, 0 when it is bit identical to the reference
+static unsigned Verify(const BatchMath& math, GW::MATH::GMatrix& proxy, BenchData& data)
+{
+	unsigned errors = 0;
+	std::vector<float> wvp(data.count * 16);
+	math.Concatenate(data.worlds[0].data, data.count, data.viewProj.data, wvp.data());
+	for (unsigned i = 0; i < data.count; ++i)
+	{
+		GW::MATH::GMATRIXF expected;
+		proxy.MultiplyMatrixF(data.worlds[i], data.viewProj, expected);
+		errors += std::memcmp(expected.data, wvp.data() + i * 16, sizeof(expected.data)) != 0;
+	}
+
+	std::vector<float> moved(data.count * 6);
+	const BoxArrays local = data.Boxes(data.boxes), out = data.Boxes(moved);
+	math.TransformBounds(local, data.worlds[0].data, data.count, out);
+	for (unsigned i = 0; i < data.count; ++i)
+	{
+		const BoundingBox box = { { local.center[0][i], local.center[1][i], local.center[2][i] },
+			{ local.extents[0][i], local.extents[1][i], local.extents[2][i] } };
+		const BoundingBox expected = TransformBounds(box, data.worlds[i].data);
+		for (int a = 0; a < 3; ++a)
+			errors += std::memcmp(&expected.center[a], &out.center[a][i], sizeof(float)) != 0 ||
+				std::memcmp(&expected.extents[a], &out.extents[a][i], sizeof(float)) != 0;
+	}
+
+	std::vector<unsigned> visible, expected;
+	const SphereArrays spheres = data.Spheres();
+	math.CullSpheres(spheres, data.count, data.frustum, visible);
+	for (unsigned i = 0; i < data.count; ++i)
+	{
+		const BoundingSphere sphere = { { spheres.center[0][i], spheres.center[1][i], spheres.center[2][i] }, spheres.radius[i] };
+		if (IsSphereVisible(data.frustum, sphere))
+			expected.push_back(i);
+	}
+	errors += visible != expected;
+	return errors;
+}
+
+// Nanoseconds per instance, best of repeats
+template <typename Kernel>
+static double Time(unsigned count, unsigned repeats, Kernel kernel)
+{
+	double best = HUGE_VAL;
+	for (unsigned r = 0; r < repeats; ++r)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		kernel();
+		const std::chrono::duration<double, std::nano> took = std::chrono::steady_clock::now() - start;
+		best = std::min(best, took.count() / count);
+	}
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 3)
+	{
+		std::cout << "usage: BatchMathBench [instances] [repeats]" << std::endl;
+		return 1;
+	}
+	const unsigned count = argc >= 2 ? static_cast<unsigned>(std::stoul(argv[1])) : 10000;
+	const unsigned repeats = argc >= 3 ? static_cast<unsigned>(std::stoul(argv[2])) : 200;
+	if (count == 0)
+		return 1;
+	GW::MATH::GMatrix proxy;
+	proxy.Create();
+	BenchData data = MakeData(proxy, count);
+
+	const SimdLevel best = DetectSimdLevel();
+	std::cout << count << " instances, best of " << repeats << " runs, this CPU runs up to " <<
+		GetBatchMath(best).name << std::endl;
+	std::cout << std::left << std::setw(10) << "kernels" << std::right << std::setw(12) << "mismatches" <<
+		std::setw(14) << "wvp ns" << std::setw(14) << "bounds ns" << std::setw(14) << "spheres ns" << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+
+	std::vector<float> wvp(count * 16), moved(count * 6);
+	std::vector<unsigned> visible;
+	visible.reserve(count);
+	double scalar[3] = {};
+	int failed = 0;
+	for (SimdLevel level : { SimdLevel::SCALAR, SimdLevel::SSE, SimdLevel::AVX2 })
+	{
+		const BatchMath& math = GetBatchMath(level);
+		if (math.level != level)
+			continue; // not available here
+		const unsigned errors = Verify(math, proxy, data);
+		failed |= errors != 0;
+		const BoxArrays local = data.Boxes(data.boxes), out = data.Boxes(moved);
+		const SphereArrays spheres = data.Spheres();
+		const double times[3] = {
+			Time(count, repeats, [&] { math.Concatenate(data.worlds[0].data, count, data.viewProj.data, wvp.data()); }),
+			Time(count, repeats, [&] { math.TransformBounds(local, data.worlds[0].data, count, out); }),
+			Time(count, repeats, [&] { visible.clear(); math.CullSpheres(spheres, count, data.frustum, visible); }),
+		};
+		if (level == SimdLevel::SCALAR)
+			std::memcpy(scalar, times, sizeof(scalar));
+		std::cout << std::left << std::setw(10) << math.name << std::right << std::setw(12) << errors;
+		for (int k = 0; k < 3; ++k)
+		{
+			const std::string speedup = level == SimdLevel::SCALAR ? "" :
+				" x" + std::to_string(scalar[k] / times[k]).substr(0, 4);
+			std::cout << std::setw(14 - static_cast<int>(speedup.size())) << times[k] << speedup;
+		}
+		std::cout << std::endl;
+	}
+	if (failed)
+		std::cout << "MISMATCH: a kernel differs from the reference math" << std::endl;
+	return failed;
+}
@@ -0,0 +1,424 @@
+//bvh
+// Bounding volume hierarchy over world space instance boxes. Built once with a binned
+// surface area heuristic, then flattened depth first into one array: an interior node's left
+// child is the next node and it stores the index of its right child, a leaf stores a range of
+// items. Queries return item indices (whatever the boxes were indexed by when built).
+#ifndef _BVH_H_
+#define _BVH_H_
+#include <vector>
+#include <cfloat>
+#include <cmath>
+#include "frustumCulling.h"
+
+struct BVHNode
+{
+	float min[3];
+	unsigned leftOrFirst; // interior: right child index, leaf: first entry in items
+	float max[3];
+	unsigned count; // 0 for interior nodes
+};
+
+class BVH
+{
+	// one box being sorted into the tree, partitioned in place so the build reads memory in order
+	struct BuildItem
+	{
+		float min[3], max[3], centroid[3];
+		unsigned index;
+	};
+
+	std::vector<BVHNode> nodes;
+	std::vector<unsigned> items; // item indices in leaf order
+	std::vector<float> itemMin, itemMax; // their boxes, 3 floats per entry, also in leaf order
+	std::vector<BuildItem> building; // only used during Build
+	std::vector<unsigned> stack; // traversal stack, kept so queries do not allocate
+	unsigned maxLeafSize = 4;
+
+	enum { BIN_COUNT = 16 };
+
+	struct Bin
+	{
+		float min[3], max[3];
+		unsigned count;
+		void Reset()
+		{
+			min[0] = min[1] = min[2] = FLT_MAX;
+			max[0] = max[1] = max[2] = -FLT_MAX;
+			count = 0;
+		}
+		void Grow(const float* lo, const float* hi)
+		{
+			for (int a = 0; a < 3; ++a)
+			{
+				min[a] = lo[a] < min[a] ? lo[a] : min[a];
+				max[a] = hi[a] > max[a] ? hi[a] : max[a];
+			}
+		}
+		float Area() const
+		{
+			if (count == 0)
+				return 0;
+			float x = max[0] - min[0], y = max[1] - min[1], z = max[2] - min[2];
+			return 2 * (x * y + y * z + z * x);
+		}
+	};
+
+	unsigned BuildNode(unsigned first, unsigned count)
+	{
+		const unsigned index = static_cast<unsigned>(nodes.size());
+		nodes.push_back(BVHNode());
+		Bin bounds, centers;
+		bounds.Reset();
+		centers.Reset();
+		for (unsigned i = first; i < first + count; ++i)
+		{
+			bounds.Grow(building[i].min, building[i].max);
+			centers.Grow(building[i].centroid, building[i].centroid);
+		}
+		bounds.count = count;
+		for (int a = 0; a < 3; ++a)
+		{
+			nodes[index].min[a] = bounds.min[a];
+			nodes[index].max[a] = bounds.max[a];
+		}
+
+		// best binned SAH split over all three axes, the cost of a leaf is its item count
+		int bestAxis = -1;
+		unsigned bestBin = 0;
+		float bestCost = static_cast<float>(count);
+		const float parentArea = bounds.Area();
+		if (count > maxLeafSize && parentArea > 0)
+		{
+			// one pass bins the range along all three axes
+			Bin bins[3][BIN_COUNT];
+			float scale[3];
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				for (Bin& b : bins[axis])
+					b.Reset();
+				const float extent = centers.max[axis] - centers.min[axis];
+				scale[axis] = extent > 0 ? BIN_COUNT / extent : 0;
+			}
+			for (unsigned i = first; i < first + count; ++i)
+			{
+				const BuildItem& item = building[i];
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					unsigned b = static_cast<unsigned>((item.centroid[axis] - centers.min[axis]) * scale[axis]);
+					b = b < BIN_COUNT ? b : BIN_COUNT - 1;
+					bins[axis][b].Grow(item.min, item.max);
+					++bins[axis][b].count;
+				}
+			}
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				if (scale[axis] == 0)
+					continue; // every centroid on one plane, nothing to split
+				// sweep from the left and from the right, areas of everything below/above each plane
+				float leftArea[BIN_COUNT - 1], rightArea[BIN_COUNT - 1];
+				unsigned leftCount[BIN_COUNT - 1], rightCount[BIN_COUNT - 1];
+				Bin left, right;
+				left.Reset();
+				right.Reset();
+				for (unsigned b = 0; b < BIN_COUNT - 1; ++b)
+				{
+					const Bin& lb = bins[axis][b];
+					left.count += lb.count;
+					if (lb.count)
+						left.Grow(lb.min, lb.max);
+					leftCount[b] = left.count;
+					leftArea[b] = left.Area();
+					const unsigned r = BIN_COUNT - 1 - b;
+					const Bin& rb = bins[axis][r];
+					right.count += rb.count;
+					if (rb.count)
+						right.Grow(rb.min, rb.max);
+					rightCount[r - 1] = right.count;
+					rightArea[r - 1] = right.Area();
+				}
+				for (unsigned b = 0; b < BIN_COUNT - 1; ++b)
+				{
+					if (leftCount[b] == 0 || rightCount[b] == 0)
+						continue;
+					float cost = 1 + (leftArea[b] * leftCount[b] + rightArea[b] * rightCount[b]) / parentArea;
+					if (cost < bestCost)
+					{
+						bestCost = cost;
+						bestAxis = axis;
+						bestBin = b;
+					}
+				}
+			}
+		}
+		if (bestAxis < 0)
+		{
+			nodes[index].leftOrFirst = first;
+			nodes[index].count = count;
+			return index;
+		}
+
+		// partition the item range around the chosen plane
+		const float lo = centers.min[bestAxis];
+		const float scale = BIN_COUNT / (centers.max[bestAxis] - lo);
+		unsigned i = first, j = first + count;
+		while (i < j)
+		{
+			unsigned b = static_cast<unsigned>((building[i].centroid[bestAxis] - lo) * scale);
+			b = b < BIN_COUNT ? b : BIN_COUNT - 1;
+			if (b <= bestBin)
+				++i;
+			else
+				std::swap(building[i], building[--j]);
+		}
+		const unsigned leftCount = i - first;
+		BuildNode(first, leftCount);
+		const unsigned right = BuildNode(i, count - leftCount);
+		nodes[index].leftOrFirst = right;
+		nodes[index].count = 0;
+		return index;
+	}
+
+	// 0 outside, 1 crossing, 2 fully inside
+	static int Classify(const Frustum& frustum, const BVHNode& node)
+	{
+		int result = 2;
+		const float c[3] = { (node.min[0] + node.max[0]) * 0.5f, (node.min[1] + node.max[1]) * 0.5f, (node.min[2] + node.max[2]) * 0.5f };
+		const float e[3] = { (node.max[0] - node.min[0]) * 0.5f, (node.max[1] - node.min[1]) * 0.5f, (node.max[2] - node.min[2]) * 0.5f };
+		for (const float* p : frustum.planes)
+		{
+			float d = p[0] * c[0] + p[1] * c[1] + p[2] * c[2] + p[3];
+			float r = std::fabs(p[0]) * e[0] + std::fabs(p[1]) * e[1] + std::fabs(p[2]) * e[2];
+			if (d + r < 0)
+				return 0;
+			if (d - r < 0)
+				result = 1;
+		}
+		return result;
+	}
+
+	static bool Overlaps(const BVHNode& node, const float* lo, const float* hi)
+	{
+		return node.min[0] <= hi[0] && node.max[0] >= lo[0] && node.min[1] <= hi[1] && node.max[1] >= lo[1] &&
+			node.min[2] <= hi[2] && node.max[2] >= lo[2];
+	}
+
+	// slab test, entry distance in tNear if the ray hits before tMax
+	static bool RayHits(const float* lo, const float* hi, const float origin[3], const float invDir[3], float tMax, float& tNear)
+	{
+		float t0 = 0, t1 = tMax;
+		for (int a = 0; a < 3; ++a)
+		{
+			float ta = (lo[a] - origin[a]) * invDir[a];
+			float tb = (hi[a] - origin[a]) * invDir[a];
+			if (ta > tb)
+				std::swap(ta, tb);
+			t0 = ta > t0 ? ta : t0;
+			t1 = tb < t1 ? tb : t1;
+			if (t0 > t1)
+				return false;
+		}
+		tNear = t0;
+		return true;
+	}
+
+	// everything below a node that is fully inside the frustum is visible without more tests
+	void AppendSubtree(unsigned node, std::vector<unsigned>& out)
+	{
+		const unsigned end = static_cast<unsigned>(stack.size());
+		stack.push_back(node);
+		while (stack.size() > end)
+		{
+			const BVHNode& n = nodes[stack.back()];
+			const unsigned current = stack.back();
+			stack.pop_back();
+			if (n.count > 0)
+				out.insert(out.end(), items.begin() + n.leftOrFirst, items.begin() + n.leftOrFirst + n.count);
+			else
+			{
+				stack.push_back(n.leftOrFirst);
+				stack.push_back(current + 1);
+			}
+		}
+	}
+
+public:
+	// Builds over count boxes, item i of every query result refers to boxes[i]
+	void Build(const BoundingBox* boxes, unsigned count, unsigned leafSize = 4)
+	{
+		maxLeafSize = leafSize > 0 ? leafSize : 1;
+		nodes.clear();
+		building.resize(count);
+		for (unsigned i = 0; i < count; ++i)
+		{
+			building[i].index = i;
+			for (int a = 0; a < 3; ++a)
+			{
+				building[i].min[a] = boxes[i].center[a] - boxes[i].extents[a];
+				building[i].max[a] = boxes[i].center[a] + boxes[i].extents[a];
+				building[i].centroid[a] = boxes[i].center[a];
+			}
+		}
+		if (count > 0)
+		{
+			nodes.reserve(2 * count / maxLeafSize + 1);
+			BuildNode(0, count);
+		}
+		items.resize(count);
+		itemMin.resize(count * 3);
+		itemMax.resize(count * 3);
+		for (unsigned i = 0; i < count; ++i)
+		{
+			items[i] = building[i].index;
+			for (int a = 0; a < 3; ++a)
+			{
+				itemMin[i * 3 + a] = building[i].min[a];
+				itemMax[i * 3 + a] = building[i].max[a];
+			}
+		}
+		building.clear();
+		building.shrink_to_fit();
+		stack.reserve(64);
+	}
+
+	void Clear()
+	{
+		nodes.clear();
+		items.clear();
+		itemMin.clear();
+		itemMax.clear();
+	}
+
+	// Appends every item whose box is at least partly inside, in no particular order
+	void QueryFrustum(const Frustum& frustum, std::vector<unsigned>& out)
+	{
+		if (nodes.empty())
+			return;
+		stack.clear();
+		stack.push_back(0);
+		while (!stack.empty())
+		{
+			const unsigned current = stack.back();
+			stack.pop_back();
+			const BVHNode& n = nodes[current];
+			const int inside = Classify(frustum, n);
+			if (inside == 0)
+				continue;
+			if (inside == 2)
+			{
+				AppendSubtree(current, out);
+				continue;
+			}
+			if (n.count > 0)
+			{
+				for (unsigned i = n.leftOrFirst; i < n.leftOrFirst + n.count; ++i)
+				{
+					const float* lo = &itemMin[i * 3];
+					const float* hi = &itemMax[i * 3];
+					const BoundingBox box = { { (lo[0] + hi[0]) * 0.5f, (lo[1] + hi[1]) * 0.5f, (lo[2] + hi[2]) * 0.5f },
+						{ (hi[0] - lo[0]) * 0.5f, (hi[1] - lo[1]) * 0.5f, (hi[2] - lo[2]) * 0.5f } };
+					if (IsBoxVisible(frustum, box))
+						out.push_back(items[i]);
+				}
+			}
+			else
+			{
+				stack.push_back(n.leftOrFirst);
+				stack.push_back(current + 1);
+			}
+		}
+	}
+
+	// Appends every item whose box overlaps the given box
+	void QueryAABB(const BoundingBox& box, std::vector<unsigned>& out)
+	{
+		if (nodes.empty())
+			return;
+		const float lo[3] = { box.center[0] - box.extents[0], box.center[1] - box.extents[1], box.center[2] - box.extents[2] };
+		const float hi[3] = { box.center[0] + box.extents[0], box.center[1] + box.extents[1], box.center[2] + box.extents[2] };
+		stack.clear();
+		stack.push_back(0);
+		while (!stack.empty())
+		{
+			const unsigned current = stack.back();
+			stack.pop_back();
+			const BVHNode& n = nodes[current];
+			if (!Overlaps(n, lo, hi))
+				continue;
+			if (n.count > 0)
+			{
+				for (unsigned i = n.leftOrFirst; i < n.leftOrFirst + n.count; ++i)
+				{
+					if (itemMin[i * 3] <= hi[0] && itemMax[i * 3] >= lo[0] && itemMin[i * 3 + 1] <= hi[1] &&
+						itemMax[i * 3 + 1] >= lo[1] && itemMin[i * 3 + 2] <= hi[2] && itemMax[i * 3 + 2] >= lo[2])
+						out.push_back(items[i]);
+				}
+			}
+			else
+			{
+				stack.push_back(n.leftOrFirst);
+				stack.push_back(current + 1);
+			}
+		}
+	}
+
+	// Nearest item box hit by origin + t * direction for 0 <= t <= maxDistance (picking)
+	bool Raycast(const float origin[3], const float direction[3], float maxDistance, unsigned& hitItem, float& hitDistance)
+	{
+		if (nodes.empty())
+			return false;
+		float invDir[3];
+		for (int a = 0; a < 3; ++a)
+			invDir[a] = direction[a] != 0 ? 1.0f / direction[a] : (std::signbit(direction[a]) ? -FLT_MAX : FLT_MAX);
+		bool hit = false;
+		float closest = maxDistance, t;
+		stack.clear();
+		stack.push_back(0);
+		while (!stack.empty())
+		{
+			const unsigned current = stack.back();
+			stack.pop_back();
+			const BVHNode& n = nodes[current];
+			if (!RayHits(n.min, n.max, origin, invDir, closest, t))
+				continue;
+			if (n.count > 0)
+			{
+				for (unsigned i = n.leftOrFirst; i < n.leftOrFirst + n.count; ++i)
+				{
+					if (RayHits(&itemMin[i * 3], &itemMax[i * 3], origin, invDir, closest, t))
+					{
+						hit = true;
+						closest = t;
+						hitItem = items[i];
+					}
+				}
+			}
+			else
+			{
+				// visit the nearer child first so closest shrinks sooner
+				float tLeft, tRight;
+				const bool left = RayHits(nodes[current + 1].min, nodes[current + 1].max, origin, invDir, closest, tLeft);
+				const bool right = RayHits(nodes[n.leftOrFirst].min, nodes[n.leftOrFirst].max, origin, invDir, closest, tRight);
+				if (left && right && tLeft < tRight)
+				{
+					stack.push_back(n.leftOrFirst);
+					stack.push_back(current + 1);
+				}
+				else
+				{
+					if (left)
+						stack.push_back(current + 1);
+					if (right)
+						stack.push_back(n.leftOrFirst);
+				}
+			}
+		}
+		if (hit)
+			hitDistance = closest;
+		return hit;
+	}
+
+	size_t GetNodeCount() const { return nodes.size(); }
+	const std::vector<BVHNode>& GetNodes() const { return nodes; }
+};
+
+#endif
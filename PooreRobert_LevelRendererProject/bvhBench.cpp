@@ -0,0 +1,275 @@
+//bvhBench.cpp
+// Checks BVH Raycast, QueryAABB and QueryFrustum against brute force on random box fields of
+// 1k, 10k and 100k boxes and times the build and each query both ways. Then a shipped level's
+// instance is moved, queried without drawing a frame in between, and removed: Raycast and
+// QueryBox must see the edit, not the hierarchy of the last frame.
+//   BVHBench <h2b folder> <levels folder>
+#define GATEWARE_ENABLE_CORE // All libraries need this
+#define GATEWARE_ENABLE_SYSTEM // GFile & GLog used by the level loader
+#define GATEWARE_ENABLE_MATH
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "../gateware-main/gateware-main/Gateware.h"
+#include "load_object_oriented.h"
+#include "recordingBackend.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double Milliseconds(Clock::time_point from, Clock::time_point to)
+{
+	return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+static unsigned failures = 0;
+
+static void Check(bool passed, const std::string& what)
+{
+	if (!passed)
+	{
+		std::cout << "MISMATCH: " << what << std::endl;
+		++failures;
+	}
+}
+
+struct Ray
+{
+	float origin[3], direction[3];
+};
+
+// Same slab test as the BVH's leaves, on a box given by center & extents
+static bool BruteRayHits(const BoundingBox& box, const Ray& ray, float maxDistance, float& tNear)
+{
+	float t0 = 0, t1 = maxDistance;
+	for (int a = 0; a < 3; ++a)
+	{
+		const float invDir = ray.direction[a] != 0 ? 1.0f / ray.direction[a] : (std::signbit(ray.direction[a]) ? -FLT_MAX : FLT_MAX);
+		float ta = (box.center[a] - box.extents[a] - ray.origin[a]) * invDir;
+		float tb = (box.center[a] + box.extents[a] - ray.origin[a]) * invDir;
+		if (ta > tb)
+			std::swap(ta, tb);
+		t0 = std::max(t0, ta);
+		t1 = std::min(t1, tb);
+		if (t0 > t1)
+			return false;
+	}
+	tNear = t0;
+	return true;
+}
+
+static bool BruteOverlaps(const BoundingBox& a, const BoundingBox& b)
+{
+	for (int i = 0; i < 3; ++i)
+		if (a.center[i] - a.extents[i] > b.center[i] + b.extents[i] || a.center[i] + a.extents[i] < b.center[i] - b.extents[i])
+			return false;
+	return true;
+}
+
+// Camera at the origin turned by yaw around +y, 90 degree perspective with far at 300
+static Frustum MakeFrustum(float yaw)
+{
+	const float n = 0.1f, f = 300.0f, c = std::cos(yaw), s = std::sin(yaw);
+	const float view[16] = { c, 0, s, 0, 0, 1, 0, 0, -s, 0, c, 0, 0, 0, 0, 1 };
+	const float projection[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, f / (f - n), 1, 0, 0, -n * f / (f - n), 0 };
+	float viewProj[16];
+	MultiplyMatrix4(view, projection, viewProj);
+	return ExtractFrustum(viewProj);
+}
+
+static void CheckRandomScene(unsigned boxCount)
+{
+	const unsigned queryCount = 1000;
+	const float maxDistance = 500.0f;
+	std::mt19937 random(boxCount);
+	std::uniform_real_distribution<float> position(-200.0f, 200.0f), size(0.1f, 4.0f), unit(-1.0f, 1.0f), querySize(1.0f, 20.0f);
+	std::vector<BoundingBox> boxes(boxCount);
+	FrustumCuller culler;
+	culler.Reserve(boxCount);
+	for (BoundingBox& box : boxes)
+	{
+		box = { { position(random), position(random) * 0.1f, position(random) }, { size(random), size(random), size(random) } };
+		culler.Add(box);
+	}
+	// every fourth ray runs along an axis so the zero direction components are covered
+	std::vector<Ray> rays(queryCount);
+	for (unsigned r = 0; r < queryCount; ++r)
+	{
+		Ray& ray = rays[r];
+		for (int a = 0; a < 3; ++a)
+		{
+			ray.origin[a] = position(random);
+			ray.direction[a] = unit(random);
+		}
+		if (r % 4 == 0)
+			for (int a = 0; a < 3; ++a)
+				ray.direction[a] = a == static_cast<int>(r / 4 % 3) ? (r % 8 == 0 ? 1.0f : -1.0f) : 0.0f;
+	}
+	std::vector<BoundingBox> queries(queryCount);
+	for (BoundingBox& query : queries)
+		query = { { position(random), position(random) * 0.1f, position(random) }, { querySize(random), querySize(random), querySize(random) } };
+
+	Clock::time_point start = Clock::now();
+	BVH hierarchy;
+	hierarchy.Build(boxes.data(), boxCount);
+	const double buildMs = Milliseconds(start, Clock::now());
+
+	// rays, the hit may be any of several boxes entered at the same distance
+	double rayMs = 0, bruteRayMs = 0;
+	unsigned hits = 0, wrongRays = 0;
+	for (const Ray& ray : rays)
+	{
+		start = Clock::now();
+		unsigned hit = 0;
+		float distance = 0;
+		const bool found = hierarchy.Raycast(ray.origin, ray.direction, maxDistance, hit, distance);
+		rayMs += Milliseconds(start, Clock::now());
+
+		start = Clock::now();
+		bool bruteFound = false;
+		float closest = maxDistance, t;
+		for (const BoundingBox& box : boxes)
+			if (BruteRayHits(box, ray, closest, t))
+			{
+				bruteFound = true;
+				closest = t;
+			}
+		bruteRayMs += Milliseconds(start, Clock::now());
+
+		hits += found;
+		wrongRays += found != bruteFound || (found && (distance != closest ||
+			!BruteRayHits(boxes[hit], ray, maxDistance, t) || t != distance));
+	}
+	Check(wrongRays == 0, std::to_string(boxCount) + " boxes: " + std::to_string(wrongRays) + " of " +
+		std::to_string(queryCount) + " rays hit another box than brute force");
+
+	// boxes, results sorted since the BVH returns them in leaf order
+	double boxMs = 0, bruteBoxMs = 0;
+	size_t overlaps = 0;
+	unsigned wrongBoxes = 0;
+	std::vector<unsigned> found, brute;
+	found.reserve(boxCount);
+	brute.reserve(boxCount);
+	for (const BoundingBox& query : queries)
+	{
+		found.clear();
+		start = Clock::now();
+		hierarchy.QueryAABB(query, found);
+		boxMs += Milliseconds(start, Clock::now());
+
+		brute.clear();
+		start = Clock::now();
+		for (unsigned i = 0; i < boxCount; ++i)
+			if (BruteOverlaps(boxes[i], query))
+				brute.push_back(i);
+		bruteBoxMs += Milliseconds(start, Clock::now());
+
+		std::sort(found.begin(), found.end());
+		overlaps += brute.size();
+		wrongBoxes += found != brute;
+	}
+	Check(wrongBoxes == 0, std::to_string(boxCount) + " boxes: " + std::to_string(wrongBoxes) + " of " +
+		std::to_string(queryCount) + " box queries found other boxes than brute force");
+
+	// frustums, the BVH must keep exactly what the linear cull keeps
+	double frustumMs = 0, cullMs = 0;
+	unsigned wrongFrustums = 0;
+	for (int d = 0; d < 8; ++d)
+	{
+		const Frustum frustum = MakeFrustum(d * 3.14159265f / 4);
+		found.clear();
+		start = Clock::now();
+		hierarchy.QueryFrustum(frustum, found);
+		frustumMs += Milliseconds(start, Clock::now());
+
+		brute.clear();
+		start = Clock::now();
+		culler.Cull(frustum, brute);
+		cullMs += Milliseconds(start, Clock::now());
+
+		std::sort(found.begin(), found.end());
+		wrongFrustums += found != brute;
+	}
+	Check(wrongFrustums == 0, std::to_string(boxCount) + " boxes: " + std::to_string(wrongFrustums) +
+		" of 8 frustum queries kept other boxes than FrustumCuller::Cull");
+
+	std::cout << std::left << std::setw(9) << boxCount << std::right << std::setw(9) << hierarchy.GetNodeCount() <<
+		std::setw(10) << buildMs << std::setw(7) << hits << std::setw(10) << rayMs * 1000 / queryCount <<
+		std::setw(12) << bruteRayMs * 1000 / queryCount << std::setw(11) << overlaps / queryCount << std::setw(10) <<
+		boxMs * 1000 / queryCount << std::setw(12) << bruteBoxMs * 1000 / queryCount << std::setw(12) << frustumMs / 8 <<
+		std::setw(10) << cullMs / 8 << std::setw(7) << (wrongRays + wrongBoxes + wrongFrustums == 0 ? "yes" : "NO") << std::endl;
+}
+
+// Moves the first instance far away and queries right after, without a frame in between
+static void CheckEdits(const std::string& h2bFolder, const std::string& levelPath)
+{
+	GW::SYSTEM::GLog log; // not created, the messages go nowhere
+	Level_Objects level;
+	if (!level.LoadLevel(levelPath.c_str(), h2bFolder.c_str(), log))
+	{
+		Check(false, "could not load " + levelPath);
+		return;
+	}
+	RecordingBackend backend;
+	backend.SetRecording(false);
+	GW::MATH::GMatrix proxy;
+	proxy.Create();
+	GW::MATH::GMATRIXF projection;
+	proxy.ProjectionDirectXLHF(G_DEGREE_TO_RADIAN_F(65), 16.0f / 9.0f, 0.1f, 100.0f, projection);
+	Camera camera;
+	camera.LookAt({ 0, 8, -18, 0 }, { 0, 0, 0, 0 }, { 0, 1, 0, 0 });
+	camera.SetProjection(projection);
+	level.UploadLevelToGPU(backend, camera.Update().view, projection);
+	level.RenderLevel(camera.Update());
+
+	const InstanceHandle moved = level.GetInstances().HandleOf(0);
+	const BoundingBox before = level.GetInstances().GetBounds()[0];
+	GW::MATH::GMATRIXF world = level.GetInstances().GetWorlds()[0];
+	world.row4.x += 1000;
+	world.row4.z += 1000;
+	level.MoveInstance(moved, world);
+
+	const BoundingBox after = level.GetInstances().GetBounds()[0];
+	const GW::MATH::GVECTORF above = { after.center[0], after.center[1] + after.extents[1] + 10, after.center[2], 1 };
+	float distance;
+	Check(level.Raycast(above, { 0, -1, 0, 0 }, 100, distance) == moved, "Raycast missed an instance moved since the last frame");
+	std::vector<unsigned> found;
+	level.QueryBox(before, found);
+	Check(std::find(found.begin(), found.end(), level.GetInstances().IndexOf(moved)) == found.end(),
+		"QueryBox still found an instance where it was before it moved");
+	found.clear();
+	level.QueryBox(after, found);
+	Check(found.size() == 1 && found[0] == level.GetInstances().IndexOf(moved), "QueryBox did not find a moved instance alone at its new place");
+
+	level.RemoveInstance(moved);
+	Check(level.Raycast(above, { 0, -1, 0, 0 }, 100, distance) == INVALID_INSTANCE, "Raycast hit an instance removed since the last frame");
+	found.clear();
+	level.QueryBox(after, found);
+	Check(found.empty(), "QueryBox found an instance removed since the last frame");
+	level.UnloadLevel();
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		std::cout << "usage: BVHBench <h2b folder> <levels folder>" << std::endl;
+		return 1;
+	}
+	std::cout << "1000 rays & box queries, 8 frustums, times per query (us for rays & boxes, ms for frustums)" << std::endl;
+	std::cout << std::left << std::setw(9) << "boxes" << std::right << std::setw(9) << "nodes" << std::setw(10) <<
+		"build ms" << std::setw(7) << "hits" << std::setw(10) << "ray us" << std::setw(12) << "brute us" <<
+		std::setw(11) << "overlaps" << std::setw(10) << "box us" << std::setw(12) << "brute us" << std::setw(12) <<
+		"frustum ms" << std::setw(10) << "cull ms" << std::setw(7) << "same" << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+	for (unsigned boxCount : { 1000u, 10000u, 100000u })
+		CheckRandomScene(boxCount);
+	for (const char* name : { "/GameLevelOne.txt", "/GameLevelTwo.txt" })
+		CheckEdits(argv[1], argv[2] + std::string(name));
+	if (failures == 0)
+		std::cout << "BVH queries match brute force and see edits made since the last frame" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
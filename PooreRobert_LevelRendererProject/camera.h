@@ -0,0 +1,243 @@
+//camera
+// The fly camera. Position and an orientation quaternion are the only state, every frame builds
+// the camera's world matrix straight from them and the view matrix with the orthonormal inverse
+// (transposed rotation, rotated & negated position) instead of inverting a 4x4 twice.
+// Update also makes view * projection, its frustum and the camera position, everything the
+// level needs for culling and SceneData, in one go.
+// Turning works like RenderManager always has (pitch about the world X axis, which also swings
+// the position around the origin, then yaw about the camera's own Y axis). ApplyCameraInput maps
+// one frame of mouse & keys onto it.
+// Matrices are row major with row vectors, like GW::MATH::GMATRIXF::data.
+#ifndef _CAMERA_H_
+#define _CAMERA_H_
+#include <cmath>
+#include "../gateware-main/gateware-main/Gateware.h"
+#include "frustumCulling.h"
+
+// Everything one view of the level needs
+struct CameraFrame
+{
+	GW::MATH::GMATRIXF world; // camera to world, row4 is the position
+	GW::MATH::GMATRIXF view; // world to camera
+	GW::MATH::GMATRIXF viewProj;
+	Frustum frustum; // of viewProj
+	GW::MATH::GVECTORF position; // w = 1
+};
+
+// A frame for view & camera matrices made elsewhere (tools, scripted cameras), the camera world
+// matrix is trusted to be the inverse of view
+inline CameraFrame MakeCameraFrame(const GW::MATH::GMATRIXF& view, const GW::MATH::GMATRIXF& world,
+	const GW::MATH::GMATRIXF& projection)
+{
+	CameraFrame frame;
+	frame.world = world;
+	frame.view = view;
+	MultiplyMatrix4(view.data, projection.data, frame.viewProj.data);
+	frame.frustum = ExtractFrustum(frame.viewProj.data);
+	frame.position = world.row4;
+	frame.position.w = 1.0f;
+	return frame;
+}
+
+class Camera
+{
+	float position[3] = { 0, 0, 0 };
+	float orientation[4] = { 0, 0, 0, 1 }; // unit quaternion x, y, z, w, rotates camera space into world space
+	GW::MATH::GMATRIXF projection = GW::MATH::GIdentityMatrixF;
+	CameraFrame frame;
+
+	// a * b, rotating by the result is rotating by b then by a
+	static void Multiply(const float a[4], const float b[4], float out[4])
+	{
+		const float x = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+		const float y = a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0];
+		const float z = a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3];
+		const float w = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+		out[0] = x;
+		out[1] = y;
+		out[2] = z;
+		out[3] = w;
+	}
+	// Rows of the rotation matrix (row vectors) of a unit quaternion
+	static void ToRows(const float q[4], float rows[3][3])
+	{
+		const float x = q[0], y = q[1], z = q[2], w = q[3];
+		rows[0][0] = 1 - 2 * (y * y + z * z); rows[0][1] = 2 * (x * y + z * w); rows[0][2] = 2 * (x * z - y * w);
+		rows[1][0] = 2 * (x * y - z * w); rows[1][1] = 1 - 2 * (x * x + z * z); rows[1][2] = 2 * (y * z + x * w);
+		rows[2][0] = 2 * (x * z + y * w); rows[2][1] = 2 * (y * z - x * w); rows[2][2] = 1 - 2 * (x * x + y * y);
+	}
+	void Normalize()
+	{
+		const float length = std::sqrt(orientation[0] * orientation[0] + orientation[1] * orientation[1] +
+			orientation[2] * orientation[2] + orientation[3] * orientation[3]);
+		for (float& c : orientation)
+			c /= length;
+	}
+
+public:
+	// Places the camera at eye looking at at, the same camera GMatrix::LookAtLHF's view matrix is
+	void LookAt(const GW::MATH::GVECTORF& eye, const GW::MATH::GVECTORF& at, const GW::MATH::GVECTORF& up)
+	{
+		float z[3] = { at.x - eye.x, at.y - eye.y, at.z - eye.z };
+		float length = std::sqrt(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+		for (float& c : z)
+			c /= length;
+		float x[3] = { up.y * z[2] - up.z * z[1], up.z * z[0] - up.x * z[2], up.x * z[1] - up.y * z[0] };
+		length = std::sqrt(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]);
+		for (float& c : x)
+			c /= length;
+		const float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+
+		// rotation matrix to quaternion, through the largest of w, x, y, z for precision
+		const float trace = x[0] + y[1] + z[2];
+		float* q = orientation;
+		if (trace > 0)
+		{
+			const float s = 2 * std::sqrt(trace + 1);
+			q[3] = 0.25f * s;
+			q[0] = (y[2] - z[1]) / s;
+			q[1] = (z[0] - x[2]) / s;
+			q[2] = (x[1] - y[0]) / s;
+		}
+		else if (x[0] > y[1] && x[0] > z[2])
+		{
+			const float s = 2 * std::sqrt(1 + x[0] - y[1] - z[2]);
+			q[3] = (y[2] - z[1]) / s;
+			q[0] = 0.25f * s;
+			q[1] = (y[0] + x[1]) / s;
+			q[2] = (z[0] + x[2]) / s;
+		}
+		else if (y[1] > z[2])
+		{
+			const float s = 2 * std::sqrt(1 + y[1] - x[0] - z[2]);
+			q[3] = (z[0] - x[2]) / s;
+			q[0] = (y[0] + x[1]) / s;
+			q[1] = 0.25f * s;
+			q[2] = (z[1] + y[2]) / s;
+		}
+		else
+		{
+			const float s = 2 * std::sqrt(1 + z[2] - x[0] - y[1]);
+			q[3] = (x[1] - y[0]) / s;
+			q[0] = (z[0] + x[2]) / s;
+			q[1] = (z[1] + y[2]) / s;
+			q[2] = 0.25f * s;
+		}
+		Normalize();
+		position[0] = eye.x;
+		position[1] = eye.y;
+		position[2] = eye.z;
+	}
+	void SetProjection(const GW::MATH::GMATRIXF& _projection)
+	{
+		projection = _projection;
+	}
+	const GW::MATH::GMATRIXF& GetProjection() const
+	{
+		return projection;
+	}
+
+	// Turns about the world X axis through the origin, the position swings around with it
+	void PitchGlobal(float radians)
+	{
+		const float turn[4] = { std::sin(radians * 0.5f), 0, 0, std::cos(radians * 0.5f) };
+		Multiply(turn, orientation, orientation);
+		Normalize();
+		const float y = position[1], z = position[2];
+		const float c = std::cos(radians), s = std::sin(radians);
+		position[1] = y * c - z * s;
+		position[2] = y * s + z * c;
+	}
+	// Turns about the camera's own Y axis
+	void YawLocal(float radians)
+	{
+		const float turn[4] = { 0, std::sin(radians * 0.5f), 0, std::cos(radians * 0.5f) };
+		Multiply(orientation, turn, orientation);
+		Normalize();
+	}
+	// Moves along the world axes
+	void TranslateGlobal(float x, float y, float z)
+	{
+		position[0] += x;
+		position[1] += y;
+		position[2] += z;
+	}
+
+	// The camera alpha (0..1) of the way from one state to another, for drawing between two fixed
+	// updates. Orientation is normalized lerp, the turns of one update are far too small to need slerp.
+	void Interpolate(const Camera& from, const Camera& to, float alpha)
+	{
+		const float* a = from.orientation;
+		const float* b = to.orientation;
+		const float sign = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3] < 0 ? -1.0f : 1.0f; // shorter way round
+		for (int c = 0; c < 4; ++c)
+			orientation[c] = a[c] + (b[c] * sign - a[c]) * alpha;
+		Normalize();
+		for (int c = 0; c < 3; ++c)
+			position[c] = from.position[c] + (to.position[c] - from.position[c]) * alpha;
+		projection = to.projection;
+	}
+
+	// Builds this frame's matrices, frustum & position from the current state
+	const CameraFrame& Update()
+	{
+		float rows[3][3];
+		ToRows(orientation, rows);
+		GW::MATH::GMATRIXF& world = frame.world;
+		GW::MATH::GMATRIXF& view = frame.view;
+		for (int r = 0; r < 3; ++r)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				world.data[r * 4 + c] = rows[r][c];
+				view.data[c * 4 + r] = rows[r][c]; // the inverse of a rotation is its transpose
+			}
+			world.data[r * 4 + 3] = view.data[r * 4 + 3] = 0;
+			world.data[12 + r] = position[r];
+			view.data[12 + r] = -(position[0] * rows[r][0] + position[1] * rows[r][1] + position[2] * rows[r][2]);
+		}
+		world.data[15] = view.data[15] = 1;
+		MultiplyMatrix4(view.data, projection.data, frame.viewProj.data);
+		frame.frustum = ExtractFrustum(frame.viewProj.data);
+		frame.position = { position[0], position[1], position[2], 1 };
+		return frame;
+	}
+	// What the last Update made
+	const CameraFrame& GetFrame() const
+	{
+		return frame;
+	}
+};
+
+// One frame of input for the fly camera
+struct CameraInput
+{
+	float mouseX = 0, mouseY = 0; // mouse delta in pixels
+	float right = 0, up = 0, forward = 0; // -1 .. 1: D - A, Space - Shift, W - S
+	float deltaTime = 0; // seconds
+	unsigned width = 0, height = 0; // client area
+	float aspectRatio = 0;
+};
+
+// Mouse turns by 65 degrees (the field of view) per window height, keys move 3 units a second
+// along the world axes.
+// A turn only happens when the mouse moves on both axes, pitch needs a horizontal delta and yaw
+// a vertical one. That is how the camera has always handled the mouse, kept as is.
+inline void ApplyCameraInput(Camera& camera, const CameraInput& input)
+{
+	const float speed = 3.0f;
+	if (input.width != 0 && input.height != 0)
+	{
+		const float pitch = static_cast<float>(1.13446 * input.mouseY / input.height);
+		const float yaw = static_cast<float>(1.13446 * input.aspectRatio * input.mouseX / input.width);
+		if (input.mouseX != 0)
+			camera.PitchGlobal(pitch);
+		if (input.mouseY != 0)
+			camera.YawLocal(yaw);
+	}
+	const float perFrameSpeed = speed * input.deltaTime;
+	camera.TranslateGlobal(input.right * perFrameSpeed, 0, input.forward * perFrameSpeed);
+	camera.TranslateGlobal(0, input.up * speed * input.deltaTime, 0);
+}
+
+#endif
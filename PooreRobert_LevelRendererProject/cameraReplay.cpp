@@ -0,0 +1,189 @@
+//cameraReplay.cpp
+// Replays recorded camera input through the Camera (camera.h) and through the matrix code
+// RenderManager::UpdateCamera used before it (invert the view, multiply in pitch & yaw, translate,
+// invert again) and reports how far apart their matrices get, plus what each costs per frame.
+//   CameraReplay [recording] [frames, default 3600]
+// A recording has one frame per line: deltaTime mouseX mouseY right up forward. Without one a
+// scripted minute of looking around and flying is replayed.
+#define GATEWARE_ENABLE_CORE // All libraries need this
+#define GATEWARE_ENABLE_MATH
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include "../gateware-main/gateware-main/Gateware.h"
+#include "camera.h"
+
+static const unsigned WIDTH = 1920, HEIGHT = 1080;
+
+// RenderManager::UpdateCamera before the Camera, input reading aside
+static void LegacyUpdate(GW::MATH::GMatrix& proxyMat, GW::MATH::GMATRIXF& view, GW::MATH::GMATRIXF& currView,
+	const CameraInput& input)
+{
+	proxyMat.InverseF(view, view);
+	const float cSpeed = 3.0;
+	GW::MATH::GMATRIXF zero;
+	proxyMat.IdentityF(zero);
+	float totalPitch = 1.13446 * input.mouseY / input.height;
+	float totalYaw = 1.13446 * input.aspectRatio * input.mouseX / input.width;
+	float perFrameSpeed = cSpeed * input.deltaTime;
+
+	GW::MATH::GMATRIXF pitch;
+	proxyMat.RotationYawPitchRollF(0, totalPitch, 0, pitch);
+	proxyMat.MultiplyMatrixF(view, input.mouseX != 0 ? pitch : zero, view);
+	GW::MATH::GMATRIXF yaw;
+	proxyMat.RotationYawPitchRollF(totalYaw, 0, 0, yaw);
+	proxyMat.MultiplyMatrixF(input.mouseY != 0 ? yaw : zero, view, view);
+
+	GW::MATH::GVECTORF zxMove = { input.right * perFrameSpeed, 0, input.forward * perFrameSpeed, 0 };
+	proxyMat.TranslateGlobalF(view, zxMove, view);
+	GW::MATH::GVECTORF yMove = { 0, input.up * cSpeed * input.deltaTime, 0, 0 };
+	proxyMat.TranslateGlobalF(view, yMove, view);
+	currView = view;
+	proxyMat.InverseF(view, view);
+}
+
+// Small mouse moves mostly on both axes, a few on one, with the keys held in turns, at 60 Hz
+static std::vector<CameraInput> ScriptedInput(unsigned frames)
+{
+	std::vector<CameraInput> recording(frames);
+	unsigned seed = 12345;
+	auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return (seed >> 8) / 16777216.0f; };
+	for (unsigned f = 0; f < frames; ++f)
+	{
+		CameraInput& input = recording[f];
+		input.deltaTime = 1.0f / 60.0f + (next() - 0.5f) * 0.002f;
+		const float roll = next();
+		if (roll < 0.6f)
+		{
+			input.mouseX = std::floor((next() - 0.5f) * 20.0f);
+			input.mouseY = std::floor((next() - 0.5f) * 12.0f);
+		}
+		else if (roll < 0.75f)
+			input.mouseX = std::floor((next() - 0.5f) * 20.0f);
+		else if (roll < 0.85f)
+			input.mouseY = std::floor((next() - 0.5f) * 12.0f);
+		const unsigned phase = (f / 90) % 6;
+		input.forward = phase == 0 ? 1.0f : phase == 3 ? -1.0f : 0.0f;
+		input.right = phase == 1 ? 1.0f : phase == 4 ? -1.0f : 0.0f;
+		input.up = phase == 2 ? 1.0f : phase == 5 ? -1.0f : 0.0f;
+	}
+	return recording;
+}
+
+static std::vector<CameraInput> LoadRecording(const char* path, unsigned frames)
+{
+	std::vector<CameraInput> recording;
+	std::ifstream file(path);
+	CameraInput input;
+	while (recording.size() < frames && file >> input.deltaTime >> input.mouseX >> input.mouseY >> input.right >>
+		input.up >> input.forward)
+		recording.push_back(input);
+	return recording;
+}
+
+// Largest difference of two float arrays, relative to a's magnitude where it is above 1
+static float MaxDifference(const float* a, const float* b, unsigned count)
+{
+	float worst = 0;
+	for (unsigned i = 0; i < count; ++i)
+		worst = std::max(worst, std::fabs(a[i] - b[i]) / std::max(1.0f, std::fabs(a[i])));
+	return worst;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 3)
+	{
+		std::cout << "usage: CameraReplay [recording] [frames]" << std::endl;
+		return 1;
+	}
+	const unsigned frames = argc == 3 ? static_cast<unsigned>(std::stoul(argv[2])) : 3600;
+	std::vector<CameraInput> recording = argc >= 2 ? LoadRecording(argv[1], frames) : ScriptedInput(frames);
+	if (recording.empty())
+	{
+		std::cout << "no frames to replay" << std::endl;
+		return 1;
+	}
+	for (CameraInput& input : recording)
+	{
+		input.width = WIDTH;
+		input.height = HEIGHT;
+		input.aspectRatio = WIDTH / static_cast<float>(HEIGHT);
+	}
+
+	// RenderManager's starting camera
+	GW::MATH::GMatrix proxyMat;
+	proxyMat.Create();
+	GW::MATH::GMATRIXF view, currView, projection;
+	GW::MATH::GVECTORF eye = { 0, 8, -18, 0 }, at = { 0, 0, 0, 0 }, up = { 0, 1, 0, 0 };
+	proxyMat.LookAtLHF(eye, at, up, view);
+	proxyMat.InverseF(view, currView);
+	proxyMat.ProjectionDirectXLHF(G_DEGREE_TO_RADIAN_F(65), WIDTH / static_cast<float>(HEIGHT), 0.1f, 100.0f, projection);
+	Camera camera;
+	camera.LookAt(eye, at, up);
+	camera.SetProjection(projection);
+	camera.Update();
+
+	// both side by side, the legacy frame's viewProj & frustum made the way RenderLevel did
+	float worstView = MaxDifference(view.data, camera.GetFrame().view.data, 16);
+	float worstWorld = 0, worstViewProj = 0, worstPlane = 0;
+	for (const CameraInput& input : recording)
+	{
+		LegacyUpdate(proxyMat, view, currView, input);
+		ApplyCameraInput(camera, input);
+		const CameraFrame& frame = camera.Update();
+		const CameraFrame legacy = MakeCameraFrame(view, currView, projection);
+		worstView = std::max(worstView, MaxDifference(legacy.view.data, frame.view.data, 16));
+		worstWorld = std::max(worstWorld, MaxDifference(legacy.world.data, frame.world.data, 16));
+		worstViewProj = std::max(worstViewProj, MaxDifference(legacy.viewProj.data, frame.viewProj.data, 16));
+		// planes are not normalized, compare them relative to their length
+		for (int p = 0; p < 6; ++p)
+		{
+			const float* a = legacy.frustum.planes[p];
+			const float* b = frame.frustum.planes[p];
+			const float length = std::sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2] + a[3] * a[3]);
+			for (int k = 0; k < 4; ++k)
+				worstPlane = std::max(worstPlane, std::fabs(a[k] - b[k]) / length);
+		}
+	}
+	std::cout << "Replayed " << recording.size() << " frames" << (argc >= 2 ? " from " + std::string(argv[1]) : "") << std::endl;
+	std::cout << std::scientific << std::setprecision(2) << "largest relative difference  view " << worstView << "  camera " <<
+		worstWorld << "  viewProj " << worstViewProj << "  frustum " << worstPlane << std::endl;
+
+	// cost per frame, best of a few passes over the whole recording
+	double legacyNs = HUGE_VAL, cameraNs = HUGE_VAL;
+	volatile float sink = 0; // keeps the optimizer from dropping the work
+	for (int pass = 0; pass < 5; ++pass)
+	{
+		proxyMat.LookAtLHF(eye, at, up, view);
+		auto start = std::chrono::steady_clock::now();
+		for (const CameraInput& input : recording)
+		{
+			LegacyUpdate(proxyMat, view, currView, input);
+			const CameraFrame legacy = MakeCameraFrame(view, currView, projection);
+			sink += legacy.frustum.planes[5][3];
+		}
+		std::chrono::duration<double, std::nano> took = std::chrono::steady_clock::now() - start;
+		legacyNs = std::min(legacyNs, took.count() / recording.size());
+
+		camera.LookAt(eye, at, up);
+		start = std::chrono::steady_clock::now();
+		for (const CameraInput& input : recording)
+		{
+			ApplyCameraInput(camera, input);
+			sink += camera.Update().frustum.planes[5][3];
+		}
+		took = std::chrono::steady_clock::now() - start;
+		cameraNs = std::min(cameraNs, took.count() / recording.size());
+	}
+	std::cout << std::fixed << std::setprecision(1) << "ns per frame  legacy " << legacyNs << "  camera " << cameraNs << std::endl;
+	// the legacy matrices pick up float error from two inversions a frame, a minute of it stays well under 1e-3
+	const bool matches = worstView < 1e-3f && worstWorld < 1e-3f && worstViewProj < 1e-3f && worstPlane < 1e-3f;
+	if (!matches)
+		std::cout << "MISMATCH: the camera drifted away from the legacy matrices" << std::endl;
+	return matches ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+//commandListBench.cpp
+// Scaling of draw recording over command lists (RenderQueue::RecordLists on the job system) on
+// the in memory RecordingBackend: a sorted queue of 100k draws is recorded into one list per
+// thread, from one thread up to one per core, then executed. The executed stream must draw
+// exactly what a plain Submit draws, in the same order.
+//   CommandListBench [max threads, default one per core] [draws, default 100000]
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <random>
+#include <vector>
+#include "renderQueue.h"
+#include "recordingBackend.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double Milliseconds(Clock::time_point from, Clock::time_point to)
+{
+	return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+// The draws of a command stream in order, binds left out
+static std::vector<RecordedCommand> Draws(const std::vector<RecordedCommand>& commands)
+{
+	std::vector<RecordedCommand> draws;
+	for (const RecordedCommand& c : commands)
+		if (c.type == RecordedCommandType::DRAW_INDEXED_INSTANCED)
+			draws.push_back(c);
+	return draws;
+}
+
+static bool SameDraws(const std::vector<RecordedCommand>& a, const std::vector<RecordedCommand>& b)
+{
+	return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](const RecordedCommand& x, const RecordedCommand& y) {
+		return std::equal(std::begin(x.args), std::end(x.args), y.args) && x.baseVertex == y.baseVertex; });
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 3)
+	{
+		std::cout << "usage: CommandListBench [max threads] [draws]" << std::endl;
+		return 1;
+	}
+	const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+	const unsigned maxThreads = argc >= 2 ? std::max(1u, static_cast<unsigned>(std::stoul(argv[1]))) : cores;
+	const unsigned drawCount = argc >= 3 ? static_cast<unsigned>(std::stoul(argv[2])) : 100000;
+
+	// a level's worth of state: 8 pipelines, 64 meshes in 4 vertex buffers, 256 materials
+	RenderQueue queue;
+	queue.Reserve(drawCount);
+	queue.ReserveLists(maxThreads);
+	std::mt19937 random(7);
+	for (unsigned i = 0; i < drawCount; ++i)
+	{
+		DrawPacket packet = {};
+		packet.pipeline = 1 + random() % 8;
+		const unsigned mesh = random() % 64;
+		packet.vertexBuffer = 1 + mesh % 4;
+		packet.vertexStride = 36;
+		packet.indexBuffer = 5 + mesh % 4;
+		packet.indexFormat = IndexFormat::UINT16;
+		packet.material = 9 + random() % 256;
+		packet.indexCount = 3 * (1 + random() % 500);
+		packet.firstIndex = mesh * 1500;
+		packet.baseVertex = static_cast<int>(mesh * 1000);
+		packet.instanceCount = 1 + random() % 4;
+		packet.firstInstance = i;
+		const float depth = std::uniform_real_distribution<float>(0.1f, 100.0f)(random);
+		queue.Push(RenderQueue::MakeKey(RenderPass::OPAQUE, packet.pipeline, mesh, packet.material, depth), packet);
+	}
+	queue.Sort();
+	const BufferHandle scene = 300, objects = 301, materials = 302;
+
+	RecordingBackend backend;
+	queue.Submit(backend, scene, objects, materials);
+	const std::vector<RecordedCommand> expected = Draws(backend.GetCommands());
+	const unsigned serialBinds = static_cast<unsigned>(backend.GetCommands().size()) - queue.GetStats().draws;
+	double serialMs = HUGE_VAL;
+	for (int pass = 0; pass < 10; ++pass)
+	{
+		backend.ClearCommands();
+		const Clock::time_point start = Clock::now();
+		queue.Submit(backend, scene, objects, materials);
+		serialMs = std::min(serialMs, Milliseconds(start, Clock::now()));
+	}
+
+	std::cout << cores << " cores, " << drawCount << " draws, plain Submit " << std::fixed << std::setprecision(2) <<
+		serialMs << " ms with " << serialBinds << " binds" << std::endl;
+	std::cout << std::left << std::setw(10) << "threads" << std::right << std::setw(12) << "record ms" << std::setw(10) <<
+		"speedup" << std::setw(13) << "execute ms" << std::setw(10) << "binds" << std::setw(8) << "same" << std::endl;
+	// 1, 2, 3, 4, then doubling, always ending on maxThreads
+	std::vector<unsigned> threadCounts;
+	for (unsigned threads = 1; threads < maxThreads; threads = threads < 4 ? threads + 1 : threads * 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+	double recordBase = 0;
+	bool allSame = true;
+	for (unsigned threads : threadCounts)
+	{
+		JobSystem jobs(threads - 1);
+		std::vector<std::unique_ptr<CommandList>> lists;
+		for (unsigned l = 0; l < threads; ++l)
+			lists.push_back(backend.CreateCommandList());
+		double recordMs = HUGE_VAL, executeMs = HUGE_VAL;
+		for (int pass = 0; pass < 10; ++pass)
+		{
+			backend.ClearCommands();
+			const Clock::time_point start = Clock::now();
+			queue.RecordLists(jobs, lists.data(), threads, scene, objects, materials);
+			const Clock::time_point recorded = Clock::now();
+			queue.ExecuteLists(backend, lists.data(), threads);
+			recordMs = std::min(recordMs, Milliseconds(start, recorded));
+			executeMs = std::min(executeMs, Milliseconds(recorded, Clock::now()));
+		}
+		const std::vector<RecordedCommand>& commands = backend.GetCommands();
+		const unsigned binds = static_cast<unsigned>(commands.size()) - queue.GetStats().draws - threads; // less the list markers
+		const bool same = SameDraws(Draws(commands), expected);
+		allSame &= same;
+		if (threads == 1)
+			recordBase = recordMs;
+		std::cout << std::left << std::setw(10) << threads << std::right << std::setw(12) << recordMs << std::setw(9) <<
+			recordBase / recordMs << "x" << std::setw(13) << executeMs << std::setw(10) << binds << std::setw(8) <<
+			(same ? "yes" : "NO") << std::endl;
+	}
+	if (!allSame)
+		std::cout << "MISMATCH: the command lists drew something else than Submit" << std::endl;
+	return allSame ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+//cullBench.cpp
+// Times FrustumCuller::Cull (SSE, four boxes at a time) against IsBoxVisible one box at a time
+// and the 8 corner CullReference, on 10k, 100k and 1M random instance boxes seen from eight
+// camera directions. The SSE cull must find exactly the boxes CullReference finds.
+//   CullBench [passes per direction, default 5]
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "frustumCulling.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double Milliseconds(Clock::time_point from, Clock::time_point to)
+{
+	return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+// Camera at the origin turned by yaw around +y, 90 degree perspective with far at 300
+static Frustum MakeFrustum(float yaw)
+{
+	const float n = 0.1f, f = 300.0f, c = std::cos(yaw), s = std::sin(yaw);
+	// view of a camera turned by yaw is the inverse (transpose) of the rotation
+	const float view[16] = { c, 0, s, 0, 0, 1, 0, 0, -s, 0, c, 0, 0, 0, 0, 1 };
+	const float projection[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, f / (f - n), 1, 0, 0, -n * f / (f - n), 0 };
+	float viewProj[16];
+	MultiplyMatrix4(view, projection, viewProj);
+	return ExtractFrustum(viewProj);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 2)
+	{
+		std::cout << "usage: CullBench [passes]" << std::endl;
+		return 1;
+	}
+	const int passes = argc == 2 ? std::max(1, std::stoi(argv[1])) : 5;
+	Frustum frustums[8];
+	for (int d = 0; d < 8; ++d)
+		frustums[d] = MakeFrustum(d * 3.14159265f / 4);
+
+#if LEVELRENDERER_SSE
+	std::cout << "SSE culling, ";
+#else
+	std::cout << "no SSE, Cull is the scalar loop, ";
+#endif
+	std::cout << "best of " << passes << " passes per direction, summed over 8 directions" << std::endl;
+	std::cout << std::left << std::setw(10) << "boxes" << std::right << std::setw(12) << "visible" << std::setw(11) <<
+		"cull ms" << std::setw(12) << "scalar ms" << std::setw(9) << "speedup" << std::setw(15) << "reference ms" <<
+		std::setw(12) << "Mboxes/s" << std::setw(7) << "same" << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+	bool allSame = true;
+	for (unsigned boxCount : { 10000u, 100000u, 1000000u })
+	{
+		// about a third of the boxes in front of any direction, some straddling the planes
+		FrustumCuller culler;
+		culler.Reserve(boxCount);
+		std::mt19937 random(boxCount);
+		std::uniform_real_distribution<float> position(-200.0f, 200.0f), size(0.1f, 4.0f);
+		for (unsigned i = 0; i < boxCount; ++i)
+			culler.Add({ { position(random), position(random) * 0.1f, position(random) }, { size(random), size(random), size(random) } });
+
+		std::vector<unsigned> visible, scalar, reference;
+		visible.reserve(boxCount);
+		scalar.reserve(boxCount);
+		reference.reserve(boxCount);
+		double cullMs = 0, scalarMs = 0, referenceMs = 0;
+		size_t visibleCount = 0;
+		bool same = true;
+		for (const Frustum& frustum : frustums)
+		{
+			double cullBest = HUGE_VAL, scalarBest = HUGE_VAL, referenceBest = HUGE_VAL;
+			for (int pass = 0; pass < passes; ++pass)
+			{
+				Clock::time_point start = Clock::now();
+				visible.clear();
+				culler.Cull(frustum, visible);
+				cullBest = std::min(cullBest, Milliseconds(start, Clock::now()));
+
+				start = Clock::now();
+				scalar.clear();
+				for (unsigned i = 0; i < boxCount; ++i)
+					if (IsBoxVisible(frustum, culler.Get(i)))
+						scalar.push_back(i);
+				scalarBest = std::min(scalarBest, Milliseconds(start, Clock::now()));
+
+				start = Clock::now();
+				reference.clear();
+				culler.CullReference(frustum, reference);
+				referenceBest = std::min(referenceBest, Milliseconds(start, Clock::now()));
+			}
+			cullMs += cullBest;
+			scalarMs += scalarBest;
+			referenceMs += referenceBest;
+			visibleCount += visible.size();
+			same = same && visible == reference && scalar == reference;
+		}
+		allSame &= same;
+		std::cout << std::left << std::setw(10) << boxCount << std::right << std::setw(12) << visibleCount / 8 <<
+			std::setw(11) << cullMs << std::setw(12) << scalarMs << std::setw(8) << scalarMs / cullMs << "x" <<
+			std::setw(15) << referenceMs << std::setw(12) << 8.0 * boxCount / cullMs / 1000.0 << std::setw(7) <<
+			(same ? "yes" : "NO") << std::endl;
+	}
+	if (!allSame)
+		std::cout << "MISMATCH: Cull found other boxes than CullReference" << std::endl;
+	return allSame ? 0 : 1;
+}
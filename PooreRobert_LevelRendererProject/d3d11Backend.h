@@ -0,0 +1,447 @@
+//d3d11Backend
+// RenderBackend implemented with Direct3D 11 on top of Gateware's GDirectX11Surface.
+// This is the code that used to live inside Model (buffer creation, SetUpPipeline, Map/Unmap).
+// Command lists are deferred contexts, binds & draws go through the same code for both kinds
+// of context.
+#ifndef _D3D11BACKEND_H_
+#define _D3D11BACKEND_H_
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "renderBackend.h"
+#include "shaderLibrary.h"
+
+class D3D11Backend : public RenderBackend
+{
+	struct Buffer
+	{
+		Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> view; // STRUCTURED only
+		BufferDesc desc;
+	};
+	// An owned copy of the PipelineDesc a pipeline was made from, a lookup whose hash matches
+	// compares it in full so two descriptions that collide never share a pipeline
+	struct PipelineKey
+	{
+		std::string shaders[6]; // vertex path, entry point & profile, then the pixel shader's
+		std::vector<std::string> semantics;
+		std::vector<unsigned> fields; // semanticIndex, format, inputSlot & perInstance per element
+
+		PipelineKey() = default;
+		explicit PipelineKey(const PipelineDesc& desc) :
+			shaders{ desc.vertexShaderPath, desc.vertexEntryPoint, desc.vertexProfile,
+				desc.pixelShaderPath, desc.pixelEntryPoint, desc.pixelProfile }
+		{
+			for (unsigned i = 0; i < desc.elementCount; ++i)
+			{
+				const VertexElement& e = desc.elements[i];
+				semantics.push_back(e.semanticName);
+				fields.insert(fields.end(), { e.semanticIndex, static_cast<unsigned>(e.format), e.inputSlot, e.perInstance ? 1u : 0u });
+			}
+		}
+		bool operator==(const PipelineKey& other) const
+		{
+			return std::equal(std::begin(shaders), std::end(shaders), std::begin(other.shaders)) &&
+				semantics == other.semantics && fields == other.fields;
+		}
+	};
+	struct Pipeline
+	{
+		Microsoft::WRL::ComPtr<ID3D11VertexShader> vertexShader;
+		Microsoft::WRL::ComPtr<ID3D11PixelShader> pixelShader;
+		Microsoft::WRL::ComPtr<ID3D11InputLayout> vertexFormat;
+		PipelineKey key;
+	};
+
+	GW::GRAPHICS::GDirectX11Surface d3d;
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	ShaderLibrary shaders;
+
+	std::vector<Buffer> buffers; // handle - 1
+	std::vector<BufferHandle> freeBuffers;
+	std::vector<Pipeline> pipelines; // handle - 1
+	std::unordered_multimap<unsigned long long, PipelineHandle> pipelineLookup; // by PipelineHash
+	// this frame's target, BeginFrame sets it on the immediate context and every list begins with it
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> frameTarget;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> frameDepth;
+	D3D11_VIEWPORT frameViewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+	UINT frameViewportCount = 0;
+
+	// Records on a deferred context of the backend's device
+	class D3D11CommandList : public CommandList
+	{
+		D3D11Backend& backend;
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> deferred;
+		Microsoft::WRL::ComPtr<ID3D11CommandList> commands; // the finished recording
+		friend class D3D11Backend;
+
+	public:
+		D3D11CommandList(D3D11Backend& _backend) : backend(_backend)
+		{
+			backend.device->CreateDeferredContext(0, deferred.GetAddressOf());
+		}
+		void Begin() override
+		{
+			commands.Reset();
+			deferred->ClearState();
+			ID3D11RenderTargetView* const views[] = { backend.frameTarget.Get() };
+			deferred->OMSetRenderTargets(ARRAYSIZE(views), views, backend.frameDepth.Get());
+			deferred->RSSetViewports(backend.frameViewportCount, backend.frameViewports);
+		}
+		void End() override
+		{
+			deferred->FinishCommandList(FALSE, commands.GetAddressOf());
+		}
+		void BindPipeline(PipelineHandle pipeline) override { backend.SetPipeline(deferred.Get(), pipeline); }
+		void BindVertexBuffer(BufferHandle buffer, unsigned stride, unsigned offset) override
+		{
+			backend.SetVertexBuffers(deferred.Get(), 0, &buffer, &stride, &offset, 1);
+		}
+		void BindVertexBuffers(unsigned startSlot, const BufferHandle* handles, const unsigned* strides,
+			const unsigned* offsets, unsigned count) override
+		{
+			backend.SetVertexBuffers(deferred.Get(), startSlot, handles, strides, offsets, count);
+		}
+		void BindIndexBuffer(BufferHandle buffer, IndexFormat format, unsigned offset) override
+		{
+			backend.SetIndexBuffer(deferred.Get(), buffer, format, offset);
+		}
+		void BindConstantBuffers(unsigned startSlot, const BufferHandle* handles, unsigned count) override
+		{
+			backend.SetConstantBuffers(deferred.Get(), startSlot, handles, count);
+		}
+		void BindShaderResources(unsigned startSlot, const BufferHandle* handles, unsigned count) override
+		{
+			backend.SetShaderResources(deferred.Get(), startSlot, handles, count);
+		}
+		void DrawIndexed(unsigned indexCount, unsigned firstIndex, int baseVertex) override
+		{
+			deferred->DrawIndexed(indexCount, firstIndex, baseVertex);
+		}
+		void DrawIndexedInstanced(unsigned indexCount, unsigned instanceCount, unsigned firstIndex,
+			int baseVertex, unsigned firstInstance) override
+		{
+			deferred->DrawIndexedInstanced(indexCount, instanceCount, firstIndex, baseVertex, firstInstance);
+		}
+	};
+
+	static DXGI_FORMAT ToDXGI(VertexFormat format)
+	{
+		switch (format)
+		{
+		case VertexFormat::FLOAT2: return DXGI_FORMAT_R32G32_FLOAT;
+		case VertexFormat::FLOAT3: return DXGI_FORMAT_R32G32B32_FLOAT;
+		case VertexFormat::FLOAT4: return DXGI_FORMAT_R32G32B32A32_FLOAT;
+		case VertexFormat::UNORM16X4: return DXGI_FORMAT_R16G16B16A16_UNORM;
+		case VertexFormat::SNORM16X2: return DXGI_FORMAT_R16G16_SNORM;
+		case VertexFormat::HALF2: return DXGI_FORMAT_R16G16_FLOAT;
+		}
+		return DXGI_FORMAT_UNKNOWN;
+	}
+
+	static UINT ToBindFlags(BufferType type)
+	{
+		switch (type)
+		{
+		case BufferType::VERTEX: return D3D11_BIND_VERTEX_BUFFER;
+		case BufferType::INDEX: return D3D11_BIND_INDEX_BUFFER;
+		case BufferType::CONSTANT: return D3D11_BIND_CONSTANT_BUFFER;
+		case BufferType::STRUCTURED: return D3D11_BIND_SHADER_RESOURCE;
+		}
+		return 0;
+	}
+
+	static unsigned long long PipelineHash(const PipelineDesc& desc)
+	{
+		const char* strings[] = { desc.vertexShaderPath, desc.vertexEntryPoint, desc.vertexProfile,
+			desc.pixelShaderPath, desc.pixelEntryPoint, desc.pixelProfile };
+		unsigned long long hash = HashShaderBytes(nullptr, 0);
+		for (const char* s : strings)
+			hash = HashShaderBytes(s, std::strlen(s) + 1, hash);
+		for (unsigned i = 0; i < desc.elementCount; ++i)
+		{
+			const VertexElement& e = desc.elements[i];
+			hash = HashShaderBytes(e.semanticName, std::strlen(e.semanticName) + 1, hash);
+			const unsigned fields[] = { e.semanticIndex, static_cast<unsigned>(e.format), e.inputSlot, e.perInstance ? 1u : 0u };
+			hash = HashShaderBytes(fields, sizeof(fields), hash);
+		}
+		return hash;
+	}
+
+	ID3D11Buffer* Get(BufferHandle buffer) const
+	{
+		return buffer != INVALID_BUFFER ? buffers[buffer - 1].buffer.Get() : nullptr;
+	}
+
+	// Binds on any context, the immediate one or a list's. Only read the backend, so lists can
+	// record on several threads at once.
+	void SetPipeline(ID3D11DeviceContext* target, PipelineHandle pipeline) const
+	{
+		const Pipeline& bound = pipelines[pipeline - 1];
+		target->VSSetShader(bound.vertexShader.Get(), nullptr, 0);
+		target->PSSetShader(bound.pixelShader.Get(), nullptr, 0);
+		target->IASetInputLayout(bound.vertexFormat.Get());
+		target->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	}
+	void SetVertexBuffers(ID3D11DeviceContext* target, unsigned startSlot, const BufferHandle* handles,
+		const unsigned* strides, const unsigned* offsets, unsigned count) const
+	{
+		ID3D11Buffer* buffs[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+		for (unsigned i = 0; i < count; ++i)
+			buffs[i] = Get(handles[i]);
+		target->IASetVertexBuffers(startSlot, count, buffs, strides, offsets);
+	}
+	void SetIndexBuffer(ID3D11DeviceContext* target, BufferHandle buffer, IndexFormat format, unsigned offset) const
+	{
+		target->IASetIndexBuffer(Get(buffer),
+			format == IndexFormat::UINT16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT, offset);
+	}
+	void SetConstantBuffers(ID3D11DeviceContext* target, unsigned startSlot, const BufferHandle* handles, unsigned count) const
+	{
+		ID3D11Buffer* pBuffs[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+		for (unsigned i = 0; i < count; ++i)
+			pBuffs[i] = Get(handles[i]);
+		target->VSSetConstantBuffers(startSlot, count, pBuffs);
+		target->PSSetConstantBuffers(startSlot, count, pBuffs);
+	}
+	void SetShaderResources(ID3D11DeviceContext* target, unsigned startSlot, const BufferHandle* handles, unsigned count) const
+	{
+		ID3D11ShaderResourceView* views[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT];
+		for (unsigned i = 0; i < count; ++i)
+			views[i] = handles[i] != INVALID_BUFFER ? buffers[handles[i] - 1].view.Get() : nullptr;
+		target->VSSetShaderResources(startSlot, count, views);
+		target->PSSetShaderResources(startSlot, count, views);
+	}
+
+public:
+	D3D11Backend(GW::GRAPHICS::GDirectX11Surface _d3d) : d3d(_d3d)
+	{
+		d3d.GetDevice((void**)device.GetAddressOf());
+		d3d.GetImmediateContext((void**)context.GetAddressOf());
+	}
+
+	BufferHandle CreateBuffer(const BufferDesc& desc, const void* initialData) override
+	{
+		CD3D11_BUFFER_DESC bDesc(desc.sizeInBytes, ToBindFlags(desc.type));
+		if (desc.usage == BufferUsage::DYNAMIC)
+		{
+			bDesc.Usage = D3D11_USAGE_DYNAMIC;
+			bDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		}
+		if (desc.type == BufferType::STRUCTURED)
+		{
+			bDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+			bDesc.StructureByteStride = desc.structureStride;
+		}
+		D3D11_SUBRESOURCE_DATA bData = { initialData, 0, 0 };
+		Buffer created;
+		created.desc = desc;
+		device->CreateBuffer(&bDesc, initialData != nullptr ? &bData : nullptr, created.buffer.GetAddressOf());
+		if (desc.type == BufferType::STRUCTURED && created.buffer)
+			device->CreateShaderResourceView(created.buffer.Get(), nullptr, created.view.GetAddressOf()); // whole buffer
+
+		BufferHandle handle;
+		if (freeBuffers.empty())
+		{
+			buffers.push_back(created);
+			handle = static_cast<BufferHandle>(buffers.size());
+		}
+		else
+		{
+			handle = freeBuffers.back();
+			freeBuffers.pop_back();
+			buffers[handle - 1] = created;
+		}
+		return handle;
+	}
+
+	void UpdateBuffer(BufferHandle buffer, const void* data, unsigned sizeInBytes) override
+	{
+		Buffer& target = buffers[buffer - 1];
+		if (target.desc.usage == BufferUsage::DYNAMIC)
+		{
+			D3D11_MAPPED_SUBRESOURCE subRes{};
+			context->Map(target.buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &subRes);
+			memcpy(subRes.pData, data, sizeInBytes);
+			context->Unmap(target.buffer.Get(), 0);
+		}
+		else
+			context->UpdateSubresource(target.buffer.Get(), 0, nullptr, data, 0, 0);
+	}
+
+	void UpdateBufferRange(BufferHandle buffer, unsigned offsetInBytes, const void* data, unsigned sizeInBytes) override
+	{
+		const D3D11_BOX box = { offsetInBytes, 0, 0, offsetInBytes + sizeInBytes, 1, 1 };
+		context->UpdateSubresource(Get(buffer), 0, &box, data, 0, 0);
+	}
+
+	void CopyBufferRange(BufferHandle destination, unsigned destinationOffset,
+		BufferHandle source, unsigned sourceOffset, unsigned sizeInBytes) override
+	{
+		const D3D11_BOX box = { sourceOffset, 0, 0, sourceOffset + sizeInBytes, 1, 1 };
+		context->CopySubresourceRegion(Get(destination), 0, destinationOffset, 0, 0, Get(source), 0, &box);
+	}
+
+	void* MapBuffer(BufferHandle buffer, MapMode mode) override
+	{
+		D3D11_MAPPED_SUBRESOURCE subRes{};
+		if (FAILED(context->Map(Get(buffer), 0,
+			mode == MapMode::DISCARD ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &subRes)))
+			return nullptr;
+		return subRes.pData;
+	}
+
+	void UnmapBuffer(BufferHandle buffer) override
+	{
+		context->Unmap(Get(buffer), 0);
+	}
+
+	void DestroyBuffer(BufferHandle buffer) override
+	{
+		if (buffer == INVALID_BUFFER)
+			return;
+		buffers[buffer - 1].buffer.Reset();
+		buffers[buffer - 1].view.Reset();
+		freeBuffers.push_back(buffer);
+	}
+
+	PipelineHandle CreatePipeline(const PipelineDesc& desc) override
+	{
+		const unsigned long long hash = PipelineHash(desc);
+		PipelineKey key(desc);
+		const auto found = pipelineLookup.equal_range(hash);
+		for (auto candidate = found.first; candidate != found.second; ++candidate)
+			if (pipelines[candidate->second - 1].key == key)
+				return candidate->second;
+
+		UINT compilerFlags = D3DCOMPILE_ENABLE_STRICTNESS;
+#if _DEBUG
+		compilerFlags |= D3DCOMPILE_DEBUG;
+#endif
+		Pipeline created;
+		ShaderKey vsKey;
+		shaders.LoadVertexShader(device.Get(), desc.vertexShaderPath, desc.vertexEntryPoint, desc.vertexProfile,
+			compilerFlags, created.vertexShader, vsKey);
+		shaders.LoadPixelShader(device.Get(), desc.pixelShaderPath, desc.pixelEntryPoint, desc.pixelProfile,
+			compilerFlags, created.pixelShader);
+
+		std::vector<D3D11_INPUT_ELEMENT_DESC> attributes(desc.elementCount);
+		for (unsigned i = 0; i < desc.elementCount; ++i)
+		{
+			attributes[i].SemanticName = desc.elements[i].semanticName;
+			attributes[i].SemanticIndex = desc.elements[i].semanticIndex;
+			attributes[i].Format = ToDXGI(desc.elements[i].format);
+			attributes[i].InputSlot = desc.elements[i].inputSlot;
+			attributes[i].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
+			attributes[i].InputSlotClass = desc.elements[i].perInstance ?
+				D3D11_INPUT_PER_INSTANCE_DATA : D3D11_INPUT_PER_VERTEX_DATA;
+			attributes[i].InstanceDataStepRate = desc.elements[i].perInstance ? 1 : 0;
+		}
+		shaders.LoadInputLayout(device.Get(), vsKey, attributes.data(), desc.elementCount, created.vertexFormat);
+
+		created.key = std::move(key);
+		pipelines.push_back(std::move(created));
+		PipelineHandle handle = static_cast<PipelineHandle>(pipelines.size());
+		pipelineLookup.emplace(hash, handle);
+		return handle;
+	}
+
+	void BeginFrame(const float clearColor[4]) override
+	{
+		ID3D11RenderTargetView* view;
+		ID3D11DepthStencilView* depth;
+		if (+d3d.GetRenderTargetView((void**)&view) && +d3d.GetDepthStencilView((void**)&depth))
+		{
+			context->ClearRenderTargetView(view, clearColor);
+			context->ClearDepthStencilView(depth, D3D11_CLEAR_DEPTH, 1, 0);
+			ID3D11RenderTargetView* const views[] = { view };
+			context->OMSetRenderTargets(ARRAYSIZE(views), views, depth);
+			frameTarget = view;
+			frameDepth = depth;
+			frameViewportCount = ARRAYSIZE(frameViewports);
+			context->RSGetViewports(&frameViewportCount, frameViewports);
+			// release incremented COM reference counts
+			depth->Release();
+			view->Release();
+		}
+	}
+
+	void Present(unsigned syncInterval) override
+	{
+		IDXGISwapChain* swap;
+		if (+d3d.GetSwapchain((void**)&swap))
+		{
+			swap->Present(syncInterval, 0);
+			swap->Release();
+		}
+		// a resize needs every reference to the back buffer gone
+		frameTarget.Reset();
+		frameDepth.Reset();
+	}
+
+	std::unique_ptr<CommandList> CreateCommandList() override
+	{
+		return std::unique_ptr<CommandList>(new D3D11CommandList(*this));
+	}
+
+	void ExecuteCommandList(CommandList& list) override
+	{
+		D3D11CommandList& recorded = static_cast<D3D11CommandList&>(list);
+		if (recorded.commands)
+			context->ExecuteCommandList(recorded.commands.Get(), FALSE); // FALSE: leaves the state cleared, cheaper than restoring it
+		recorded.commands.Reset();
+		// the list's render target is cleared with everything else
+		ID3D11RenderTargetView* const views[] = { frameTarget.Get() };
+		context->OMSetRenderTargets(ARRAYSIZE(views), views, frameDepth.Get());
+		context->RSSetViewports(frameViewportCount, frameViewports);
+	}
+
+	void BindPipeline(PipelineHandle pipeline) override
+	{
+		SetPipeline(context.Get(), pipeline);
+	}
+
+	void BindVertexBuffer(BufferHandle buffer, unsigned stride, unsigned offset) override
+	{
+		SetVertexBuffers(context.Get(), 0, &buffer, &stride, &offset, 1);
+	}
+
+	void BindVertexBuffers(unsigned startSlot, const BufferHandle* handles, const unsigned* strides,
+		const unsigned* offsets, unsigned count) override
+	{
+		SetVertexBuffers(context.Get(), startSlot, handles, strides, offsets, count);
+	}
+
+	void BindIndexBuffer(BufferHandle buffer, IndexFormat format, unsigned offset) override
+	{
+		SetIndexBuffer(context.Get(), buffer, format, offset);
+	}
+
+	void BindConstantBuffers(unsigned startSlot, const BufferHandle* handles, unsigned count) override
+	{
+		SetConstantBuffers(context.Get(), startSlot, handles, count);
+	}
+
+	void BindShaderResources(unsigned startSlot, const BufferHandle* handles, unsigned count) override
+	{
+		SetShaderResources(context.Get(), startSlot, handles, count);
+	}
+
+	void DrawIndexed(unsigned indexCount, unsigned firstIndex, int baseVertex) override
+	{
+		context->DrawIndexed(indexCount, firstIndex, baseVertex);
+	}
+
+	void DrawIndexedInstanced(unsigned indexCount, unsigned instanceCount, unsigned firstIndex,
+		int baseVertex, unsigned firstInstance) override
+	{
+		context->DrawIndexedInstanced(indexCount, instanceCount, firstIndex, baseVertex, firstInstance);
+	}
+
+	const ShaderLibrary& GetShaderLibrary() const { return shaders; }
+};
+
+#endif
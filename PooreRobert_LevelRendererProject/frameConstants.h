@@ -0,0 +1,109 @@
+//frameConstants
+// Per frame GPU data for a level. SceneData (view, camera, lights) is one constant buffer
+// written once per frame. Per object data (instance world matrix plus its asset's vertex
+// decode) goes into a ring buffer with room for several frames: each frame maps it once with NO_OVERWRITE, writes its
+// objects after the previous frame's and draws them through an instance offset. Only when the
+// ring is full does it DISCARD and start over at the front.
+// Per material data does not change at all and lives in the level's MaterialTable.
+#ifndef _FRAMECONSTANTS_H_
+#define _FRAMECONSTANTS_H_
+#include "../gateware-main/gateware-main/Gateware.h"
+#include "renderBackend.h"
+#include "vertexCompression.h"
+
+// Matches cbuffer SceneData in the shaders
+struct SceneData
+{
+	GW::MATH::GVECTORF _lightDirection, _lightColor, _sunAmbient, _cameraPos;
+	GW::MATH::GMATRIXF viewMatrix, projectionMatrix;
+};
+
+// One instance in the object ring, matches the per instance inputs of the vertex shaders
+struct ObjectData
+{
+	GW::MATH::GMATRIXF world;
+	VertexDecode decode; // of the instance's asset, see LevelGeometry
+};
+
+class FrameConstants
+{
+	RenderBackend* backend = nullptr;
+	BufferHandle sceneBuffer = INVALID_BUFFER;
+	BufferHandle objectBuffer = INVALID_BUFFER; // ObjectData ring, bound as per instance vertex data
+	unsigned capacity = 0; // in objects
+	unsigned head = 0; // where the next frame's objects go
+	unsigned frameStart = 0; // first object of the frame being written
+	ObjectData* mapped = nullptr;
+
+public:
+	// The ring holds objectsPerFrame * framesInFlight objects
+	void Create(RenderBackend& _backend, unsigned objectsPerFrame, unsigned framesInFlight = 3)
+	{
+		Destroy();
+		backend = &_backend;
+		BufferDesc sDesc = { BufferType::CONSTANT, BufferUsage::DYNAMIC, sizeof(SceneData) };
+		sceneBuffer = backend->CreateBuffer(sDesc, nullptr);
+		capacity = objectsPerFrame * framesInFlight;
+		head = capacity; // the first frame always discards
+		if (capacity > 0)
+		{
+			BufferDesc oDesc = { BufferType::VERTEX, BufferUsage::DYNAMIC,
+				static_cast<unsigned>(capacity * sizeof(ObjectData)) };
+			objectBuffer = backend->CreateBuffer(oDesc, nullptr);
+		}
+	}
+
+	void Destroy()
+	{
+		if (backend != nullptr)
+		{
+			backend->DestroyBuffer(sceneBuffer);
+			backend->DestroyBuffer(objectBuffer);
+		}
+		backend = nullptr;
+		sceneBuffer = objectBuffer = INVALID_BUFFER;
+		capacity = head = frameStart = 0;
+		mapped = nullptr;
+	}
+
+	// The one SceneData upload of the frame
+	void SetScene(const SceneData& scene)
+	{
+		backend->UpdateBuffer(sceneBuffer, &scene, sizeof(SceneData));
+	}
+
+	// Maps room for count objects, write exactly count of them then call EndObjects.
+	// nullptr if count is zero or more than the ring was created for.
+	ObjectData* BeginObjects(unsigned count)
+	{
+		if (count == 0 || count > capacity)
+			return nullptr;
+		MapMode mode = MapMode::NO_OVERWRITE;
+		if (head + count > capacity)
+		{
+			mode = MapMode::DISCARD;
+			head = 0;
+		}
+		void* memory = backend->MapBuffer(objectBuffer, mode);
+		if (memory == nullptr)
+			return nullptr;
+		frameStart = head;
+		head += count;
+		mapped = static_cast<ObjectData*>(memory) + frameStart;
+		return mapped;
+	}
+
+	void EndObjects()
+	{
+		if (mapped != nullptr)
+			backend->UnmapBuffer(objectBuffer);
+		mapped = nullptr;
+	}
+
+	// Instance offset of this frame's first object, add it to the object's index when drawing
+	unsigned GetFirstObject() const { return frameStart; }
+	BufferHandle GetSceneBuffer() const { return sceneBuffer; }
+	BufferHandle GetObjectBuffer() const { return objectBuffer; }
+};
+
+#endif
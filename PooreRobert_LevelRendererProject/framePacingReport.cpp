@@ -0,0 +1,140 @@
+//framePacingReport.cpp
+// Runs the FrameScheduler (frameScheduler.h) headless on a VirtualFrameClock through a few
+// simulated machines: render costs, display refresh rates, present modes and frame caps. For each
+// it prints the frame pacing stats and how smoothly an object moving at a constant speed in the
+// fixed update moves from frame to frame, with and without interpolation. Every run is repeated
+// to check it plays out exactly the same.
+//   FramePacingReport [seconds per scenario, default 10]
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cmath>
+#include "frameScheduler.h"
+
+struct Scenario
+{
+	const char* name;
+	FrameSchedulerSettings settings;
+	double refreshRate; // of the simulated display, vsync waits for its next refresh
+	double renderMs; // CPU + GPU cost of a frame
+	double renderJitterMs; // cost varies by up to this much either way
+	unsigned stallEvery; // every this many frames one takes stallMs instead, 0 for never
+	double stallMs;
+};
+
+struct ScenarioResult
+{
+	FramePacingStats stats;
+	double simulatedSeconds; // fixed updates run * step
+	double motionError; // RMS of how far the speed between frames is off, as a fraction
+	double motionErrorRaw; // the same drawing the last update's state as is
+};
+
+static ScenarioResult Run(const Scenario& scenario, double seconds)
+{
+	VirtualFrameClock clock;
+	FrameScheduler scheduler(clock, scenario.settings);
+	const FrameTime refresh = SecondsToFrameTime(1.0 / scenario.refreshRate);
+	const FrameTime end = SecondsToFrameTime(seconds);
+	unsigned seed = 777;
+	auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return (seed >> 8) / 16777216.0; };
+
+	// an object moving at one unit a second in the fixed update
+	double previous = 0, current = 0;
+	unsigned long long frame = 0;
+	double lastShown = 0, lastShownRaw = 0, lastStart = 0;
+	bool measuring = false; // from the second frame after two updates, before that nothing moves yet
+	double errorSum = 0, errorSumRaw = 0;
+	unsigned samples = 0;
+	while (clock.Now() < end)
+	{
+		scheduler.Tick([&](double step) {
+			previous = current;
+			current += step;
+		}, [&](float alpha) {
+			// the state drawn is for the time the frame started
+			const double start = FrameTimeToSeconds(clock.Now());
+			const double shown = previous + (current - previous) * alpha;
+			if (measuring)
+			{
+				const double interval = start - lastStart;
+				const double error = (shown - lastShown) / interval - 1.0;
+				const double errorRaw = (current - lastShownRaw) / interval - 1.0;
+				errorSum += error * error;
+				errorSumRaw += errorRaw * errorRaw;
+				++samples;
+			}
+			lastShown = shown;
+			lastShownRaw = current;
+			lastStart = start;
+			measuring = previous > 0;
+			++frame;
+
+			double cost = scenario.renderMs + (next() * 2 - 1) * scenario.renderJitterMs;
+			if (scenario.stallEvery != 0 && frame % scenario.stallEvery == 0)
+				cost = scenario.stallMs;
+			clock.Advance(SecondsToFrameTime(cost * 1e-3));
+			if (scheduler.GetSyncInterval() != 0)
+				clock.SleepUntil((clock.Now() / refresh + 1) * refresh); // the next refresh
+		});
+	}
+	ScenarioResult result;
+	result.stats = scheduler.GetStats();
+	result.simulatedSeconds = current;
+	result.motionError = samples ? std::sqrt(errorSum / samples) : 0;
+	result.motionErrorRaw = samples ? std::sqrt(errorSumRaw / samples) : 0;
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 2)
+	{
+		std::cout << "usage: FramePacingReport [seconds]" << std::endl;
+		return 1;
+	}
+	const double seconds = argc == 2 ? std::stod(argv[1]) : 10.0;
+
+	FrameSchedulerSettings vsync;
+	FrameSchedulerSettings immediate;
+	immediate.presentMode = PresentMode::IMMEDIATE;
+	FrameSchedulerSettings capped = immediate;
+	capped.frameCap = 100;
+	const Scenario scenarios[] = {
+		{ "vsync 60Hz", vsync, 60, 5, 1, 0, 0 },
+		{ "vsync 144Hz", vsync, 144, 5, 1, 0, 0 },
+		{ "vsync 60Hz slow", vsync, 60, 18, 2, 0, 0 },
+		{ "immediate", immediate, 60, 6, 3, 0, 0 },
+		{ "immediate cap 100", capped, 60, 6, 3, 0, 0 },
+		{ "vsync stalls", vsync, 60, 5, 1, 300, 250 },
+	};
+
+	std::cout << "Fixed update at " << vsync.updateRate << " Hz, " << seconds << " simulated seconds each" << std::endl;
+	std::cout << "motion error: RMS of how far the speed between frames of a constant speed object is off, " <<
+		"interpolated -> last update as is" << std::endl;
+	std::cout << std::left << std::setw(20) << "scenario" << std::right << std::setw(8) << "frames" << std::setw(9) << "avg ms" <<
+		std::setw(9) << "99% ms" << std::setw(9) << "jitter" << std::setw(9) << "upd/frm" << std::setw(8) << "stalls" <<
+		std::setw(11) << "dropped ms" << std::setw(10) << "sim s" << std::setw(20) << "motion error" <<
+		std::setw(7) << "same" << std::endl;
+	std::cout << std::fixed;
+	bool deterministic = true;
+	for (const Scenario& scenario : scenarios)
+	{
+		const ScenarioResult result = Run(scenario, seconds);
+		const ScenarioResult again = Run(scenario, seconds);
+		const bool same = result.stats.totalFrames == again.stats.totalFrames &&
+			result.stats.totalUpdates == again.stats.totalUpdates && result.stats.averageMs == again.stats.averageMs &&
+			result.stats.jitterMs == again.stats.jitterMs && result.motionError == again.motionError;
+		deterministic &= same;
+		const FramePacingStats& stats = result.stats;
+		std::cout << std::left << std::setw(20) << scenario.name << std::right << std::setw(8) << stats.totalFrames <<
+			std::setprecision(2) << std::setw(9) << stats.averageMs << std::setw(9) << stats.percentile99Ms <<
+			std::setw(9) << stats.jitterMs << std::setw(9) << stats.updatesPerFrame << std::setw(8) << stats.stalls <<
+			std::setw(11) << stats.droppedMs << std::setw(10) << result.simulatedSeconds <<
+			std::setprecision(3) << std::setw(11) << result.motionError << " -> " << std::setw(5) << result.motionErrorRaw <<
+			std::setw(7) << (same ? "yes" : "NO") << std::endl;
+	}
+	if (!deterministic)
+		std::cout << "MISMATCH: a scenario played out differently the second time" << std::endl;
+	return deterministic ? 0 : 1;
+}
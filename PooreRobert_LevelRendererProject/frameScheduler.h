@@ -0,0 +1,257 @@
+//frameScheduler
+// Runs the simulation at a fixed rate no matter how fast frames are drawn. Every Tick adds the
+// real time since the last frame to an accumulator, runs as many fixed updates as fit in it, then
+// renders once with alpha (0..1), how far the leftover time is into the next update, so the
+// renderer can blend the last two updates' states instead of showing the same one twice.
+// Long stalls (a breakpoint, a level upload) run at most maxUpdatesPerFrame updates, the rest of
+// the time is dropped rather than spiralling into ever longer frames.
+// How frames are presented is the scheduler's too: vsync or not (the sync interval for
+// RenderBackend::Present) and an optional frame cap it sleeps to between frames.
+// All time goes through a FrameClock. SteadyFrameClock is the real one, VirtualFrameClock only
+// moves when told to, so a whole run is deterministic and can play out headless and instantly.
+// Times are integer nanoseconds so the accumulator never drifts.
+#ifndef _FRAMESCHEDULER_H_
+#define _FRAMESCHEDULER_H_
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <thread>
+
+typedef long long FrameTime; // nanoseconds
+
+inline FrameTime SecondsToFrameTime(double seconds)
+{
+	return static_cast<FrameTime>(std::llround(seconds * 1e9));
+}
+inline double FrameTimeToSeconds(FrameTime time)
+{
+	return time * 1e-9;
+}
+inline double FrameTimeToMs(FrameTime time)
+{
+	return time * 1e-6;
+}
+
+class FrameClock
+{
+public:
+	virtual ~FrameClock() {}
+	// Time since some fixed point, never goes backwards
+	virtual FrameTime Now() = 0;
+	// Returns at or after time
+	virtual void SleepUntil(FrameTime time) = 0;
+};
+
+class SteadyFrameClock : public FrameClock
+{
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+
+public:
+	FrameTime Now() override
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+	}
+	// Sleeps most of the way and spins the rest, sleep alone overshoots by up to a scheduler quantum
+	void SleepUntil(FrameTime time) override
+	{
+		const FrameTime spin = 2000000; // 2ms
+		FrameTime now = Now();
+		if (time - now > spin)
+			std::this_thread::sleep_for(std::chrono::nanoseconds(time - now - spin));
+		while (Now() < time)
+			std::this_thread::yield();
+	}
+};
+
+// Time only moves through Advance and SleepUntil, for tools and tests
+class VirtualFrameClock : public FrameClock
+{
+	FrameTime now = 0;
+
+public:
+	FrameTime Now() override
+	{
+		return now;
+	}
+	void SleepUntil(FrameTime time) override
+	{
+		now = std::max(now, time);
+	}
+	void Advance(FrameTime time)
+	{
+		now += time;
+	}
+};
+
+enum class PresentMode
+{
+	VSYNC, // Present waits for the display, frame rate is at most its refresh rate
+	IMMEDIATE // Present returns right away, may tear
+};
+
+struct FrameSchedulerSettings
+{
+	double updateRate = 60.0; // fixed updates per second
+	unsigned maxUpdatesPerFrame = 5;
+	PresentMode presentMode = PresentMode::VSYNC;
+	double frameCap = 0.0; // frames per second, 0 for none
+};
+
+// frames the pacing stats look back over
+const unsigned FRAME_PACING_WINDOW = 256;
+
+// Over the last FRAME_PACING_WINDOW frames, times in milliseconds
+struct FramePacingStats
+{
+	unsigned frames; // in the window
+	double averageMs;
+	double minMs;
+	double maxMs;
+	double percentile99Ms; // 99% of frames were this fast or faster
+	double jitterMs; // standard deviation
+	double updatesPerFrame;
+	// since the scheduler started
+	unsigned long long totalFrames;
+	unsigned long long totalUpdates;
+	unsigned long long stalls; // frames that hit maxUpdatesPerFrame and dropped time
+	double droppedMs;
+};
+
+class FrameScheduler
+{
+public:
+	typedef std::function<void(double)> UpdateFunction; // fixed step in seconds
+	typedef std::function<void(float)> RenderFunction; // alpha
+
+private:
+	FrameClock* clock;
+	FrameSchedulerSettings settings;
+	FrameTime step = 0;
+	FrameTime accumulator = 0;
+	FrameTime lastFrame = 0;
+	FrameTime nextFrame = 0; // earliest start of the next frame under the frame cap
+	bool started = false;
+	float alpha = 0;
+
+	// last frames' lengths & update counts, a ring
+	FrameTime frameTimes[FRAME_PACING_WINDOW] = {};
+	unsigned frameUpdates[FRAME_PACING_WINDOW] = {};
+	unsigned head = 0;
+	unsigned filled = 0;
+	unsigned long long totalFrames = 0;
+	unsigned long long totalUpdates = 0;
+	unsigned long long stalls = 0;
+	FrameTime dropped = 0;
+
+public:
+	FrameScheduler(FrameClock& _clock, const FrameSchedulerSettings& _settings = FrameSchedulerSettings()) : clock(&_clock)
+	{
+		SetSettings(_settings);
+	}
+
+	void SetSettings(const FrameSchedulerSettings& _settings)
+	{
+		settings = _settings;
+		settings.updateRate = settings.updateRate > 0 ? settings.updateRate : 60.0;
+		settings.maxUpdatesPerFrame = std::max(1u, settings.maxUpdatesPerFrame);
+		step = SecondsToFrameTime(1.0 / settings.updateRate);
+	}
+	const FrameSchedulerSettings& GetSettings() const { return settings; }
+	void SetPresentMode(PresentMode mode) { settings.presentMode = mode; }
+	void SetFrameCap(double framesPerSecond) { settings.frameCap = std::max(0.0, framesPerSecond); }
+	// For RenderBackend::Present
+	unsigned GetSyncInterval() const { return settings.presentMode == PresentMode::VSYNC ? 1 : 0; }
+	double GetUpdateStep() const { return FrameTimeToSeconds(step); }
+	// alpha of the last Tick's render
+	float GetAlpha() const { return alpha; }
+
+	// One frame: the fixed updates that are due, then render (which presents). Under a frame cap
+	// the next Tick sleeps until its start time first. The first Tick renders without updating.
+	void Tick(const UpdateFunction& update, const RenderFunction& render)
+	{
+		if (started && settings.frameCap > 0)
+			clock->SleepUntil(nextFrame);
+		const FrameTime now = clock->Now();
+		const FrameTime elapsed = started ? now - lastFrame : 0;
+		if (settings.frameCap > 0)
+		{
+			// scheduled from the previous target so rounding does not build up, late frames restart it
+			const FrameTime interval = SecondsToFrameTime(1.0 / settings.frameCap);
+			nextFrame = started && now - nextFrame < interval ? nextFrame + interval : now + interval;
+		}
+		lastFrame = now;
+
+		accumulator += elapsed;
+		unsigned updates = 0;
+		while (accumulator >= step && updates < settings.maxUpdatesPerFrame)
+		{
+			update(FrameTimeToSeconds(step));
+			accumulator -= step;
+			++updates;
+		}
+		if (accumulator >= step)
+		{
+			// behind by more than the frame can catch up, keep the partial step only
+			++stalls;
+			dropped += accumulator - accumulator % step;
+			accumulator %= step;
+		}
+		alpha = static_cast<float>(static_cast<double>(accumulator) / step);
+		render(alpha);
+
+		if (started)
+		{
+			frameTimes[head] = elapsed;
+			frameUpdates[head] = updates;
+			head = (head + 1) % FRAME_PACING_WINDOW;
+			filled = std::min(filled + 1, FRAME_PACING_WINDOW);
+			++totalFrames;
+		}
+		totalUpdates += updates;
+		started = true;
+	}
+
+	FramePacingStats GetStats() const
+	{
+		FramePacingStats stats = {};
+		stats.frames = filled;
+		stats.totalFrames = totalFrames;
+		stats.totalUpdates = totalUpdates;
+		stats.stalls = stalls;
+		stats.droppedMs = FrameTimeToMs(dropped);
+		if (filled == 0)
+			return stats;
+		FrameTime sorted[FRAME_PACING_WINDOW];
+		double sum = 0, updates = 0;
+		for (unsigned i = 0; i < filled; ++i)
+		{
+			sorted[i] = frameTimes[i];
+			sum += FrameTimeToMs(frameTimes[i]);
+			updates += frameUpdates[i];
+		}
+		std::sort(sorted, sorted + filled);
+		stats.averageMs = sum / filled;
+		stats.minMs = FrameTimeToMs(sorted[0]);
+		stats.maxMs = FrameTimeToMs(sorted[filled - 1]);
+		stats.percentile99Ms = FrameTimeToMs(sorted[std::min(filled - 1, (filled * 99 + 99) / 100 - 1)]);
+		double variance = 0;
+		for (unsigned i = 0; i < filled; ++i)
+		{
+			const double d = FrameTimeToMs(frameTimes[i]) - stats.averageMs;
+			variance += d * d;
+		}
+		stats.jitterMs = std::sqrt(variance / filled);
+		stats.updatesPerFrame = updates / filled;
+		return stats;
+	}
+	void ResetStats()
+	{
+		head = filled = 0;
+		totalFrames = totalUpdates = stalls = 0;
+		dropped = 0;
+	}
+};
+
+#endif
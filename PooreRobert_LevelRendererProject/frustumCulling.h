@@ -0,0 +1,254 @@
+//frustumCulling
+// Bounding volumes for assets and instances plus view frustum culling.
+// Assets get a local AABB (center/extents) and bounding sphere from their vertices at load,
+// instances transform that box by their world matrix (the box of the rotated box, Arvo's method)
+// and FrustumCuller tests all of them against the six planes of view * projection.
+// The boxes are kept structure-of-arrays so the SSE path tests four at a time.
+// Matrices are row major with row vectors, like GW::MATH::GMATRIXF::data.
+#ifndef _FRUSTUMCULLING_H_
+#define _FRUSTUMCULLING_H_
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include "h2bParser.h"
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define LEVELRENDERER_SSE 1
+#endif
+
+struct BoundingBox
+{
+	float center[3];
+	float extents[3]; // half size, never negative
+};
+
+struct BoundingSphere
+{
+	float center[3];
+	float radius;
+};
+
+// Planes are (nx, ny, nz, d) with normals pointing inwards, a point p is inside when n.p + d >= 0
+struct Frustum
+{
+	float planes[6][4]; // left, right, bottom, top, near, far
+};
+
+// Local box and sphere (around the box center) of a vertex array, empty input gives a zero box
+inline void ComputeBounds(const H2B::VERTEX* vertices, unsigned count, BoundingBox& box, BoundingSphere& sphere)
+{
+	float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (unsigned i = 0; i < count; ++i)
+	{
+		const float p[3] = { vertices[i].pos.x, vertices[i].pos.y, vertices[i].pos.z };
+		for (int a = 0; a < 3; ++a)
+		{
+			lo[a] = p[a] < lo[a] ? p[a] : lo[a];
+			hi[a] = p[a] > hi[a] ? p[a] : hi[a];
+		}
+	}
+	if (count == 0)
+		lo[0] = lo[1] = lo[2] = hi[0] = hi[1] = hi[2] = 0;
+	float radiusSq = 0;
+	for (int a = 0; a < 3; ++a)
+	{
+		box.center[a] = sphere.center[a] = (lo[a] + hi[a]) * 0.5f;
+		box.extents[a] = (hi[a] - lo[a]) * 0.5f;
+	}
+	for (unsigned i = 0; i < count; ++i)
+	{
+		float dx = vertices[i].pos.x - box.center[0];
+		float dy = vertices[i].pos.y - box.center[1];
+		float dz = vertices[i].pos.z - box.center[2];
+		float d = dx * dx + dy * dy + dz * dz;
+		radiusSq = d > radiusSq ? d : radiusSq;
+	}
+	sphere.radius = std::sqrt(radiusSq);
+}
+
+// World space AABB of a local box, tight for the transformed box (not for the mesh)
+inline BoundingBox TransformBounds(const BoundingBox& local, const float world[16])
+{
+	BoundingBox out;
+	for (int a = 0; a < 3; ++a)
+	{
+		out.center[a] = local.center[0] * world[a] + local.center[1] * world[4 + a] +
+			local.center[2] * world[8 + a] + world[12 + a];
+		out.extents[a] = local.extents[0] * std::fabs(world[a]) + local.extents[1] * std::fabs(world[4 + a]) +
+			local.extents[2] * std::fabs(world[8 + a]);
+	}
+	return out;
+}
+
+// out = a * b, out may not alias a or b
+inline void MultiplyMatrix4(const float a[16], const float b[16], float out[16])
+{
+	for (int r = 0; r < 4; ++r)
+		for (int c = 0; c < 4; ++c)
+			out[r * 4 + c] = a[r * 4 + 0] * b[0 + c] + a[r * 4 + 1] * b[4 + c] +
+				a[r * 4 + 2] * b[8 + c] + a[r * 4 + 3] * b[12 + c];
+}
+
+// Gribb/Hartmann plane extraction for a Direct3D style view * projection (clip z from 0 to w)
+inline Frustum ExtractFrustum(const float viewProj[16])
+{
+	// clip.x is the row vector dotted with column 0 and so on, row r gives every plane's component r
+	Frustum f;
+	for (int r = 0; r < 4; ++r)
+	{
+		const float x = viewProj[r * 4 + 0], y = viewProj[r * 4 + 1];
+		const float z = viewProj[r * 4 + 2], w = viewProj[r * 4 + 3];
+		f.planes[0][r] = w + x; // left
+		f.planes[1][r] = w - x; // right
+		f.planes[2][r] = w + y; // bottom
+		f.planes[3][r] = w - y; // top
+		f.planes[4][r] = z; // near
+		f.planes[5][r] = w - z; // far
+	}
+	for (float* p : f.planes)
+	{
+		float length = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+		if (length > 0)
+			for (int i = 0; i < 4; ++i)
+				p[i] /= length;
+	}
+	return f;
+}
+
+// Fully outside one plane means culled, boxes crossing a corner of the frustum are kept.
+// Each plane is tested with the box corner furthest along its normal, that corner and its
+// distance are computed exactly like CullReference does so the two agree to the last bit.
+inline bool IsBoxVisible(const Frustum& frustum, const BoundingBox& box)
+{
+	for (const float* p : frustum.planes)
+	{
+		const float x = box.center[0] + (p[0] < 0 ? -box.extents[0] : box.extents[0]);
+		const float y = box.center[1] + (p[1] < 0 ? -box.extents[1] : box.extents[1]);
+		const float z = box.center[2] + (p[2] < 0 ? -box.extents[2] : box.extents[2]);
+		if (p[0] * x + p[1] * y + p[2] * z + p[3] < 0)
+			return false;
+	}
+	return true;
+}
+
+inline bool IsSphereVisible(const Frustum& frustum, const BoundingSphere& sphere)
+{
+	for (const float* p : frustum.planes)
+		if (p[0] * sphere.center[0] + p[1] * sphere.center[1] + p[2] * sphere.center[2] + p[3] < -sphere.radius)
+			return false;
+	return true;
+}
+
+// World space boxes of every instance in SoA form, culled together. Capacity is kept across
+// Clear so a level culls every frame without allocating.
+class FrustumCuller
+{
+	std::vector<float> cx, cy, cz, ex, ey, ez;
+
+public:
+	void Reserve(size_t count)
+	{
+		for (std::vector<float>* v : { &cx, &cy, &cz, &ex, &ey, &ez })
+			v->reserve(count);
+	}
+	void Clear()
+	{
+		for (std::vector<float>* v : { &cx, &cy, &cz, &ex, &ey, &ez })
+			v->clear();
+	}
+	void Add(const BoundingBox& worldBox)
+	{
+		cx.push_back(worldBox.center[0]);
+		cy.push_back(worldBox.center[1]);
+		cz.push_back(worldBox.center[2]);
+		ex.push_back(worldBox.extents[0]);
+		ey.push_back(worldBox.extents[1]);
+		ez.push_back(worldBox.extents[2]);
+	}
+	size_t Size() const { return cx.size(); }
+	BoundingBox Get(size_t i) const
+	{
+		return { { cx[i], cy[i], cz[i] }, { ex[i], ey[i], ez[i] } };
+	}
+
+	// Appends the index of every box that is at least partly inside, in ascending order
+	void Cull(const Frustum& frustum, std::vector<unsigned>& visible) const
+	{
+		Cull(frustum, 0, static_cast<unsigned>(cx.size()), visible);
+	}
+	// The same for boxes [first, end) only, ranges can be culled on different threads
+	void Cull(const Frustum& frustum, unsigned first, unsigned end, std::vector<unsigned>& visible) const
+	{
+		const unsigned count = end < cx.size() ? end : static_cast<unsigned>(cx.size());
+		unsigned i = first;
+#if LEVELRENDERER_SSE
+		// sx/sy/sz flip the extents' sign where the normal is negative, which picks the furthest corner
+		__m128 nx[6], ny[6], nz[6], nw[6], sx[6], sy[6], sz[6];
+		for (int p = 0; p < 6; ++p)
+		{
+			nx[p] = _mm_set1_ps(frustum.planes[p][0]);
+			ny[p] = _mm_set1_ps(frustum.planes[p][1]);
+			nz[p] = _mm_set1_ps(frustum.planes[p][2]);
+			nw[p] = _mm_set1_ps(frustum.planes[p][3]);
+			sx[p] = _mm_set1_ps(frustum.planes[p][0] < 0 ? -0.0f : 0.0f);
+			sy[p] = _mm_set1_ps(frustum.planes[p][1] < 0 ? -0.0f : 0.0f);
+			sz[p] = _mm_set1_ps(frustum.planes[p][2] < 0 ? -0.0f : 0.0f);
+		}
+		const __m128 zero = _mm_setzero_ps();
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 x = _mm_loadu_ps(&cx[i]), y = _mm_loadu_ps(&cy[i]), z = _mm_loadu_ps(&cz[i]);
+			const __m128 hx = _mm_loadu_ps(&ex[i]), hy = _mm_loadu_ps(&ey[i]), hz = _mm_loadu_ps(&ez[i]);
+			__m128 outside = zero;
+			for (int p = 0; p < 6; ++p)
+			{
+				// same operation order as IsBoxVisible so the tail and the SIMD lanes agree
+				const __m128 px = _mm_add_ps(x, _mm_xor_ps(hx, sx[p]));
+				const __m128 py = _mm_add_ps(y, _mm_xor_ps(hy, sy[p]));
+				const __m128 pz = _mm_add_ps(z, _mm_xor_ps(hz, sz[p]));
+				const __m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], px), _mm_mul_ps(ny[p], py)),
+					_mm_mul_ps(nz[p], pz)), nw[p]);
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(d, zero));
+			}
+			int mask = ~_mm_movemask_ps(outside) & 0xF;
+			for (unsigned lane = 0; mask != 0; ++lane, mask >>= 1)
+				if (mask & 1)
+					visible.push_back(i + lane);
+		}
+#endif
+		for (; i < count; ++i)
+			if (IsBoxVisible(frustum, Get(i)))
+				visible.push_back(i);
+	}
+
+	// Brute force reference: a box is culled only if all 8 of its corners are outside one plane
+	void CullReference(const Frustum& frustum, std::vector<unsigned>& visible) const
+	{
+		for (unsigned i = 0; i < cx.size(); ++i)
+		{
+			const BoundingBox box = Get(i);
+			bool inside = true;
+			for (const float* p : frustum.planes)
+			{
+				bool anyCornerIn = false;
+				for (int corner = 0; corner < 8 && !anyCornerIn; ++corner)
+				{
+					float x = box.center[0] + (corner & 1 ? box.extents[0] : -box.extents[0]);
+					float y = box.center[1] + (corner & 2 ? box.extents[1] : -box.extents[1]);
+					float z = box.center[2] + (corner & 4 ? box.extents[2] : -box.extents[2]);
+					anyCornerIn = p[0] * x + p[1] * y + p[2] * z + p[3] >= 0;
+				}
+				if (!anyCornerIn)
+				{
+					inside = false;
+					break;
+				}
+			}
+			if (inside)
+				visible.push_back(i);
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,143 @@
+//geometryCheck.cpp
+// Headless check of the level geometry buffers on the in memory RecordingBackend: the
+// RangeAllocator's best fit & free list coalescing, then assets added to and removed from a
+// LevelGeometry, packed by Defragment and grown by an Add that no longer fits. Every GPU copy
+// the repack issues is compared with the ranges it must move, and the data must still be there.
+//   GeometryCheck
+#include <iostream>
+#include <vector>
+#include "levelGeometry.h"
+#include "recordingBackend.h"
+
+static unsigned failures = 0;
+
+static void Check(bool passed, const char* what)
+{
+	if (!passed)
+	{
+		std::cout << "MISMATCH: " << what << std::endl;
+		++failures;
+	}
+}
+
+// count vertices and 3 * count indices, filled so every asset's data is different
+static void MakeAsset(unsigned id, unsigned count, std::vector<H2B::VERTEX>& vertices, std::vector<unsigned>& indices)
+{
+	vertices.assign(count, H2B::VERTEX());
+	for (unsigned v = 0; v < count; ++v)
+		vertices[v].pos = { static_cast<float>(id), static_cast<float>(v), 1.0f };
+	indices.resize(count * 3);
+	for (unsigned i = 0; i < indices.size(); ++i)
+		indices[i] = (i + id) % count;
+}
+
+// The asset's vertices & indices are where its range says in the backend's current buffers
+static bool InPlace(const RecordingBackend& backend, const LevelGeometry& geometry, GeometryHandle handle,
+	const std::vector<H2B::VERTEX>& vertices, const std::vector<unsigned>& indices)
+{
+	const GeometryRange& range = geometry.Get(handle);
+	const std::vector<char>& vertexBytes = backend.GetBuffer(geometry.GetVertexBuffer()).contents;
+	const std::vector<char>& indexBytes = backend.GetBuffer(geometry.GetIndexBuffer()).contents;
+	return range.vertexCount == vertices.size() && range.indexCount == indices.size() &&
+		std::memcmp(vertexBytes.data() + range.baseVertex * sizeof(H2B::VERTEX), vertices.data(),
+			vertices.size() * sizeof(H2B::VERTEX)) == 0 &&
+		std::memcmp(indexBytes.data() + range.firstIndex * sizeof(unsigned), indices.data(),
+			indices.size() * sizeof(unsigned)) == 0;
+}
+
+static bool IsCopy(const RecordedCommand& command, BufferHandle destination, unsigned destinationOffset,
+	BufferHandle source, unsigned sourceOffset, unsigned sizeInBytes)
+{
+	return command.type == RecordedCommandType::COPY_BUFFER_RANGE && command.args[0] == destination &&
+		command.args[1] == destinationOffset && command.args[2] == source && command.args[3] == sourceOffset &&
+		command.args[4] == sizeInBytes;
+}
+
+static void CheckAllocator()
+{
+	RangeAllocator space;
+	space.Reset(100);
+	const unsigned a = space.Allocate(10), b = space.Allocate(20), c = space.Allocate(30);
+	Check(a == 0 && b == 10 && c == 30, "allocations are not packed from the front");
+	Check(space.GetUsed() == 60 && space.GetFreeRangeCount() == 1, "three allocations left more than the tail free");
+	space.Free(b, 20);
+	Check(space.GetFreeRangeCount() == 2 && space.GetLargestFree() == 40, "freeing the middle range");
+	Check(space.Allocate(15) == 10, "best fit did not take the 20 element hole over the 40 element tail");
+	space.Free(10, 15);
+	space.Free(a, 10); // joins the hole after it
+	Check(space.GetFreeRangeCount() == 2 && space.GetLargestFree() == 40, "freeing the first range did not merge with the hole");
+	space.Free(c, 30); // joins both sides
+	Check(space.GetFreeRangeCount() == 1 && space.GetLargestFree() == 100 && space.GetUsed() == 0,
+		"freeing everything did not leave one free range");
+	Check(space.Allocate(101) == RangeAllocator::INVALID_OFFSET, "allocated more than the capacity");
+}
+
+static void CheckDefragment()
+{
+	RecordingBackend backend;
+	LevelGeometry geometry;
+	geometry.Create(backend, 100, 300);
+	std::vector<H2B::VERTEX> vertices[4];
+	std::vector<unsigned> indices[4];
+	GeometryHandle handles[4];
+	const unsigned sizes[4] = { 10, 20, 30, 80 };
+	for (unsigned a = 0; a < 4; ++a)
+		MakeAsset(a, sizes[a], vertices[a], indices[a]);
+	for (unsigned a = 0; a < 3; ++a)
+		handles[a] = geometry.Add(vertices[a].data(), sizes[a], indices[a].data(), sizes[a] * 3);
+	Check(geometry.Get(handles[2]).baseVertex == 30 && geometry.Get(handles[2]).firstIndex == 90, "third asset offsets");
+
+	// a hole in the middle, packing moves the last asset down into it
+	geometry.Remove(handles[1]);
+	Check(geometry.GetVertexSpace().GetFreeRangeCount() == 2 && geometry.GetIndexSpace().GetFreeRangeCount() == 2,
+		"removing the middle asset did not leave a hole");
+	const BufferHandle oldVertices = geometry.GetVertexBuffer(), oldIndices = geometry.GetIndexBuffer();
+	const unsigned stride = sizeof(H2B::VERTEX), indexSize = sizeof(unsigned);
+	backend.ClearCommands();
+	geometry.Defragment();
+	const BufferHandle newVertices = geometry.GetVertexBuffer(), newIndices = geometry.GetIndexBuffer();
+	const std::vector<RecordedCommand>& commands = backend.GetCommands();
+	Check(commands.size() == 8, "defragment did not issue two creates, four copies & two destroys");
+	if (commands.size() == 8)
+	{
+		Check(commands[0].type == RecordedCommandType::CREATE_BUFFER && commands[0].args[2] == 100 * stride &&
+			commands[1].type == RecordedCommandType::CREATE_BUFFER && commands[1].args[2] == 300 * indexSize,
+			"the new buffers are not the old capacities");
+		Check(IsCopy(commands[2], newVertices, 0, oldVertices, 0, 10 * stride) &&
+			IsCopy(commands[3], newIndices, 0, oldIndices, 0, 30 * indexSize), "first asset copies");
+		Check(IsCopy(commands[4], newVertices, 10 * stride, oldVertices, 30 * stride, 30 * stride) &&
+			IsCopy(commands[5], newIndices, 30 * indexSize, oldIndices, 90 * indexSize, 90 * indexSize),
+			"third asset copies");
+		Check(commands[6].type == RecordedCommandType::DESTROY_BUFFER && commands[6].args[0] == oldVertices &&
+			commands[7].type == RecordedCommandType::DESTROY_BUFFER && commands[7].args[0] == oldIndices,
+			"the old buffers were not destroyed");
+	}
+	Check(geometry.Get(handles[0]).baseVertex == 0 && geometry.Get(handles[0]).firstIndex == 0 &&
+		geometry.Get(handles[2]).baseVertex == 10 && geometry.Get(handles[2]).firstIndex == 30, "packed offsets");
+	Check(geometry.GetVertexSpace().GetFreeRangeCount() == 1 && geometry.GetVertexSpace().GetLargestFree() == 60 &&
+		geometry.GetIndexSpace().GetLargestFree() == 180, "packing did not leave one free range at the end");
+	Check(InPlace(backend, geometry, handles[0], vertices[0], indices[0]) &&
+		InPlace(backend, geometry, handles[2], vertices[2], indices[2]), "the data did not move with its range");
+
+	// 80 vertices do not fit the 60 free, the buffers double and the live data is copied over
+	backend.ClearCommands();
+	handles[3] = geometry.Add(vertices[3].data(), sizes[3], indices[3].data(), sizes[3] * 3);
+	Check(handles[3] == handles[1], "the removed asset's handle was not reused");
+	Check(geometry.GetDefragmentCount() == 2 && geometry.GetVertexSpace().GetCapacity() == 200 &&
+		geometry.GetIndexSpace().GetCapacity() == 600, "the buffers did not grow");
+	Check(backend.GetCount(RecordedCommandType::COPY_BUFFER_RANGE) == 4, "growing did not copy both live assets");
+	Check(geometry.Get(handles[3]).baseVertex == 40 && geometry.Get(handles[3]).firstIndex == 120, "added asset offsets");
+	for (unsigned a : { 0u, 2u, 3u })
+		Check(InPlace(backend, geometry, handles[a], vertices[a], indices[a]), "an asset's data is missing after growing");
+	geometry.Destroy();
+	Check(backend.GetLiveBufferCount() == 0, "buffers left after Destroy");
+}
+
+int main()
+{
+	CheckAllocator();
+	CheckDefragment();
+	if (failures == 0)
+		std::cout << "RangeAllocator & LevelGeometry defragment checks passed" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
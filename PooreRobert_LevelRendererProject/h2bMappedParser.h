@@ -0,0 +1,240 @@
+#ifndef _H2BMAPPEDPARSER_H_
+#define _H2BMAPPEDPARSER_H_
+// Zero-copy alternative to H2B::Parser. The .h2b file is memory mapped and vertices,
+// indices and batches are exposed as spans pointing straight into the mapping, strings as
+// string_views into the file. Every count is validated against the file size first.
+// Materials and meshes interleave variable length strings with their data so they can not
+// be spans, they are small arrays of views instead (one entry per material/mesh).
+#include <string_view>
+#include <vector>
+#include <cstring>
+#include "h2bParser.h"
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace H2B {
+
+	template<typename T>
+	struct Span {
+		const T* data = nullptr;
+		unsigned count = 0;
+		const T* begin() const { return data; }
+		const T* end() const { return data + count; }
+		const T& operator[](unsigned i) const { return data[i]; }
+		unsigned size() const { return count; }
+		bool empty() const { return count == 0; }
+	};
+
+	// Read only view of a whole file, unmapped on Close or destruction
+	class MappedFile
+	{
+		const char* bytes = nullptr;
+		size_t length = 0;
+#if defined(_WIN32)
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+#endif
+	public:
+		MappedFile() {}
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile() { Close(); }
+
+		bool Open(const char* path)
+		{
+			Close();
+#if defined(_WIN32)
+			file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+				FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+				return false;
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+			{
+				Close();
+				return false;
+			}
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping == nullptr)
+			{
+				Close();
+				return false;
+			}
+			bytes = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			length = static_cast<size_t>(fileSize.QuadPart);
+#else
+			int fd = open(path, O_RDONLY);
+			if (fd < 0)
+				return false;
+			struct stat info;
+			if (fstat(fd, &info) != 0 || info.st_size == 0)
+			{
+				close(fd);
+				return false;
+			}
+			void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			close(fd); // the mapping keeps the file alive
+			if (view == MAP_FAILED)
+				return false;
+			bytes = static_cast<const char*>(view);
+			length = static_cast<size_t>(info.st_size);
+#endif
+			if (bytes == nullptr)
+			{
+				Close();
+				return false;
+			}
+			return true;
+		}
+
+		void Close()
+		{
+#if defined(_WIN32)
+			if (bytes != nullptr)
+				UnmapViewOfFile(bytes);
+			if (mapping != nullptr)
+				CloseHandle(mapping);
+			if (file != INVALID_HANDLE_VALUE)
+				CloseHandle(file);
+			mapping = nullptr;
+			file = INVALID_HANDLE_VALUE;
+#else
+			if (bytes != nullptr)
+				munmap(const_cast<char*>(bytes), length);
+#endif
+			bytes = nullptr;
+			length = 0;
+		}
+
+		const char* Data() const { return bytes; }
+		size_t Size() const { return length; }
+		bool IsOpen() const { return bytes != nullptr; }
+	};
+
+	struct MaterialView {
+		ATTRIBUTES attrib; // copied out, the mapping gives no alignment guarantee for it
+		// same order as MATERIAL: name, map_Kd, map_Ks, map_Ka, map_Ke, map_Ns, map_d, disp, decal, bump
+		std::string_view strings[10];
+		std::string_view name() const { return strings[0]; }
+	};
+	struct MeshView {
+		std::string_view name;
+		BATCH drawInfo;
+		unsigned materialIndex;
+	};
+
+	class MappedParser
+	{
+		MappedFile file;
+
+		// bounds checked cursor over the mapping
+		struct Reader {
+			const char* at;
+			const char* end;
+			bool Has(unsigned long long bytes) const { return bytes <= static_cast<unsigned long long>(end - at); }
+			bool Read(void* out, unsigned bytes) {
+				if (!Has(bytes))
+					return false;
+				std::memcpy(out, at, bytes);
+				at += bytes;
+				return true;
+			}
+			// null terminated, at most 260 characters like the .h2b exporter writes
+			bool ReadString(std::string_view& out) {
+				const char* terminator = static_cast<const char*>(std::memchr(at, '\0', end - at));
+				if (terminator == nullptr || terminator - at >= 260)
+					return false;
+				out = std::string_view(at, terminator - at);
+				at = terminator + 1;
+				return true;
+			}
+			template<typename T>
+			bool Take(Span<T>& out, unsigned count, unsigned elementSize) {
+				if (!Has(static_cast<unsigned long long>(count) * elementSize))
+					return false;
+				out.data = reinterpret_cast<const T*>(at);
+				out.count = count;
+				at += static_cast<size_t>(count) * elementSize;
+				return true;
+			}
+		};
+
+	public:
+		char version[4];
+		unsigned vertexCount;
+		unsigned indexCount;
+		unsigned materialCount;
+		unsigned meshCount;
+		Span<VERTEX> vertices;
+		Span<unsigned> indices;
+		Span<BATCH> batches;
+		std::vector<MaterialView> materials;
+		std::vector<MeshView> meshes;
+
+		MappedParser() { Clear(); }
+
+		// false if the file is missing, of an older version or its counts run past the end of the file
+		bool Parse(const char* h2bPath)
+		{
+			Clear();
+			if (!file.Open(h2bPath))
+				return false;
+			Reader r = { file.Data(), file.Data() + file.Size() };
+			if (!r.Read(version, 4) ||
+				version[1] < '1' || version[2] < '9' || version[3] < 'd' ||
+				!r.Read(&vertexCount, 4) || !r.Read(&indexCount, 4) ||
+				!r.Read(&materialCount, 4) || !r.Read(&meshCount, 4) ||
+				!r.Take(vertices, vertexCount, 36) || !r.Take(indices, indexCount, 4))
+				return Fail();
+			// every material needs at least 80 bytes + 10 terminators, check before reserving
+			if (!r.Has(static_cast<unsigned long long>(materialCount) * 90))
+				return Fail();
+			materials.resize(materialCount);
+			for (unsigned i = 0; i < materialCount; ++i) {
+				if (!r.Read(&materials[i].attrib, 80))
+					return Fail();
+				for (int j = 0; j < 10; ++j)
+					if (!r.ReadString(materials[i].strings[j]))
+						return Fail();
+			}
+			if (!r.Take(batches, materialCount, 8))
+				return Fail();
+			if (!r.Has(static_cast<unsigned long long>(meshCount) * 13))
+				return Fail();
+			meshes.resize(meshCount);
+			for (unsigned i = 0; i < meshCount; ++i) {
+				if (!r.ReadString(meshes[i].name) ||
+					!r.Read(&meshes[i].drawInfo, 8) || !r.Read(&meshes[i].materialIndex, 4))
+					return Fail();
+			}
+			return true;
+		}
+
+		// unmaps the file, every span and string_view is invalid afterwards
+		void Clear()
+		{
+			file.Close();
+			std::memset(version, 0, sizeof(version));
+			vertexCount = indexCount = materialCount = meshCount = 0;
+			vertices = Span<VERTEX>();
+			indices = Span<unsigned>();
+			batches = Span<BATCH>();
+			materials.clear();
+			meshes.clear();
+		}
+
+	private:
+		bool Fail()
+		{
+			Clear();
+			return false;
+		}
+	};
+}
+#endif
@@ -0,0 +1,194 @@
+//instanceStore
+// Every placed model of a level, structure-of-arrays. Each column (world matrix, world box,
+// asset, material list, flags, name) is one contiguous array indexed by the same dense index,
+// so a pass over the level only touches the columns it needs and walks them front to back.
+// Removing swaps the last instance into the hole, which keeps the arrays packed but moves that
+// instance. Code that holds on to an instance keeps an InstanceHandle instead: it goes through
+// a slot table to the current dense index and is stale once the instance is removed.
+#ifndef _INSTANCESTORE_H_
+#define _INSTANCESTORE_H_
+#include <vector>
+#include <string>
+#include <numeric>
+#include <algorithm>
+#include "../gateware-main/gateware-main/Gateware.h"
+#include "frustumCulling.h"
+#include "assetCache.h"
+
+// Low 24 bits pick the slot, high 8 bits are the slot's generation when the handle was made
+typedef unsigned InstanceHandle;
+const InstanceHandle INVALID_INSTANCE = ~0u;
+
+enum InstanceFlags : unsigned
+{
+	INSTANCE_NONE = 0,
+	INSTANCE_HIDDEN = 1 << 0, // kept in the level but never drawn
+};
+
+class InstanceStore
+{
+	static const unsigned SLOT_BITS = 24;
+	static const unsigned SLOT_MASK = (1u << SLOT_BITS) - 1;
+	static const unsigned NO_SLOT = ~0u;
+
+	// dense columns, all the same length
+	std::vector<GW::MATH::GMATRIXF> worlds;
+	std::vector<BoundingBox> bounds; // world space, kept up to date by the owner
+	std::vector<AssetHandle> assets;
+	std::vector<unsigned> materials; // start of its per mesh entries in the level's MaterialTable
+	std::vector<unsigned> flags;
+	std::vector<std::string> names; // only read by tools and logging
+	std::vector<unsigned> slotOf; // dense index -> slot
+	// slot table, a free slot's denseOf links to the next free one
+	std::vector<unsigned> denseOf;
+	std::vector<unsigned char> generations;
+	unsigned firstFree = NO_SLOT;
+
+	void Swap(unsigned a, unsigned b)
+	{
+		std::swap(worlds[a], worlds[b]);
+		std::swap(bounds[a], bounds[b]);
+		std::swap(assets[a], assets[b]);
+		std::swap(materials[a], materials[b]);
+		std::swap(flags[a], flags[b]);
+		std::swap(names[a], names[b]);
+		std::swap(slotOf[a], slotOf[b]);
+		denseOf[slotOf[a]] = a;
+		denseOf[slotOf[b]] = b;
+	}
+
+public:
+	void Reserve(size_t count)
+	{
+		worlds.reserve(count);
+		bounds.reserve(count);
+		assets.reserve(count);
+		materials.reserve(count);
+		flags.reserve(count);
+		names.reserve(count);
+		slotOf.reserve(count);
+		denseOf.reserve(count);
+		generations.reserve(count);
+	}
+
+	InstanceHandle Add(std::string name, AssetHandle asset, unsigned materialList,
+		const GW::MATH::GMATRIXF& world, const BoundingBox& worldBox)
+	{
+		unsigned slot = firstFree;
+		if (slot != NO_SLOT)
+			firstFree = denseOf[slot];
+		else
+		{
+			slot = static_cast<unsigned>(denseOf.size());
+			denseOf.push_back(0);
+			generations.push_back(0);
+		}
+		denseOf[slot] = static_cast<unsigned>(worlds.size());
+		worlds.push_back(world);
+		bounds.push_back(worldBox);
+		assets.push_back(asset);
+		materials.push_back(materialList);
+		flags.push_back(INSTANCE_NONE);
+		names.push_back(std::move(name));
+		slotOf.push_back(slot);
+		return slot | static_cast<unsigned>(generations[slot]) << SLOT_BITS;
+	}
+
+	// Moves the last instance into the removed one's place, false if the handle is stale
+	bool Remove(InstanceHandle handle)
+	{
+		if (!IsValid(handle))
+			return false;
+		const unsigned slot = handle & SLOT_MASK;
+		const unsigned last = static_cast<unsigned>(worlds.size()) - 1;
+		if (denseOf[slot] != last)
+			Swap(denseOf[slot], last);
+		worlds.pop_back();
+		bounds.pop_back();
+		assets.pop_back();
+		materials.pop_back();
+		flags.pop_back();
+		names.pop_back();
+		slotOf.pop_back();
+		++generations[slot];
+		denseOf[slot] = firstFree;
+		firstFree = slot;
+		return true;
+	}
+
+	void Clear()
+	{
+		worlds.clear();
+		bounds.clear();
+		assets.clear();
+		materials.clear();
+		flags.clear();
+		names.clear();
+		slotOf.clear();
+		denseOf.clear();
+		generations.clear();
+		firstFree = NO_SLOT;
+	}
+
+	bool IsValid(InstanceHandle handle) const
+	{
+		const unsigned slot = handle & SLOT_MASK;
+		return handle != INVALID_INSTANCE && slot < denseOf.size() &&
+			generations[slot] == handle >> SLOT_BITS && denseOf[slot] < slotOf.size() && slotOf[denseOf[slot]] == slot;
+	}
+	// Current dense index of a valid handle, it changes when instances are removed or sorted
+	unsigned IndexOf(InstanceHandle handle) const
+	{
+		return denseOf[handle & SLOT_MASK];
+	}
+	InstanceHandle HandleOf(unsigned index) const
+	{
+		const unsigned slot = slotOf[index];
+		return slot | static_cast<unsigned>(generations[slot]) << SLOT_BITS;
+	}
+
+	// Reorders the dense arrays so instances sharing an asset and material list are one run,
+	// stable so they keep the order they were added in. Handles stay valid.
+	void SortByAsset()
+	{
+		std::vector<unsigned> order(worlds.size());
+		std::iota(order.begin(), order.end(), 0u);
+		std::stable_sort(order.begin(), order.end(),
+			[this](unsigned a, unsigned b) {
+				return assets[a] != assets[b] ? assets[a] < assets[b] : materials[a] < materials[b]; });
+		// apply the permutation cycle by cycle, order[i] is the old index that belongs at i
+		for (unsigned i = 0; i < order.size(); ++i)
+		{
+			unsigned current = i;
+			while (order[current] != i)
+			{
+				const unsigned next = order[current];
+				Swap(current, next);
+				order[current] = current;
+				current = next;
+			}
+			order[current] = current;
+		}
+	}
+
+	size_t Size() const { return worlds.size(); }
+	bool Empty() const { return worlds.empty(); }
+
+	// Columns, index with 0 .. Size() - 1
+	const GW::MATH::GMATRIXF* GetWorlds() const { return worlds.data(); }
+	const BoundingBox* GetBounds() const { return bounds.data(); }
+	BoundingBox* GetBounds() { return bounds.data(); }
+	const AssetHandle* GetAssets() const { return assets.data(); }
+	const unsigned* GetMaterials() const { return materials.data(); }
+	const unsigned* GetFlags() const { return flags.data(); }
+	const std::string& GetName(unsigned index) const { return names[index]; }
+
+	void SetWorld(unsigned index, const GW::MATH::GMATRIXF& world, const BoundingBox& worldBox)
+	{
+		worlds[index] = world;
+		bounds[index] = worldBox;
+	}
+	void SetFlags(unsigned index, unsigned value) { flags[index] = value; }
+};
+
+#endif
@@ -0,0 +1,124 @@
+//instancingCheck.cpp
+// Checks on the in memory RecordingBackend that RenderLevel draws each mesh once for all of its
+// instances. With culling and LODs off every instance is drawn at full detail, so a shipped level
+// must take exactly one draw per distinct (asset, material list, mesh) that has indices, and the
+// draws' instance counts must add up to every instance's meshes. From a turning camera with
+// culling and LODs on no mesh of one LOD may be drawn twice in a frame.
+//   InstancingCheck <h2b folder> <levels folder>
+#define GATEWARE_ENABLE_CORE // All libraries need this
+#define GATEWARE_ENABLE_SYSTEM // GFile & GLog used by the level loader
+#define GATEWARE_ENABLE_MATH
+
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+#include <set>
+#include <tuple>
+#include "../gateware-main/gateware-main/Gateware.h"
+#include "load_object_oriented.h"
+#include "recordingBackend.h"
+
+static unsigned failures = 0;
+
+static void Check(bool passed, const std::string& what)
+{
+	if (!passed)
+	{
+		std::cout << "MISMATCH: " << what << std::endl;
+		++failures;
+	}
+}
+
+// firstIndex, baseVertex & indexCount, which mesh of which LOD a draw is
+typedef std::tuple<unsigned, int, unsigned> MeshKey;
+
+int main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		std::cout << "usage: InstancingCheck <h2b folder> <levels folder>" << std::endl;
+		return 1;
+	}
+	GW::SYSTEM::GLog log; // not created, the messages go nowhere
+	GW::MATH::GMatrix proxy;
+	proxy.Create();
+	GW::MATH::GMATRIXF projection;
+	proxy.ProjectionDirectXLHF(G_DEGREE_TO_RADIAN_F(65), 16.0f / 9.0f, 0.1f, 100.0f, projection);
+
+	std::cout << std::left << std::setw(20) << "level" << std::right << std::setw(11) << "instances" << std::setw(8) <<
+		"groups" << std::setw(8) << "draws" << std::setw(10) << "expected" << std::setw(16) << "instance meshes" << std::endl;
+	for (const char* name : { "GameLevelOne.txt", "GameLevelTwo.txt" })
+	{
+		const std::string path = std::string(argv[2]) + "/" + name;
+		Level_Objects level;
+		if (!level.LoadLevel(path.c_str(), argv[1], log))
+		{
+			std::cout << "could not load " << path << std::endl;
+			return 1;
+		}
+		RecordingBackend backend;
+		Camera camera;
+		camera.LookAt({ 0, 8, -18, 0 }, { 0, 0, 0, 0 }, { 0, 1, 0, 0 });
+		camera.SetProjection(projection);
+		level.UploadLevelToGPU(backend, camera.Update().view, projection);
+
+		// the groups every instance falls in, worked out from the store & assets alone
+		const InstanceStore& instances = level.GetInstances();
+		std::set<std::tuple<AssetHandle, unsigned, unsigned>> groups;
+		unsigned instanceMeshes = 0;
+		for (unsigned i = 0; i < instances.Size(); ++i)
+		{
+			const ModelAsset& asset = level.GetAssetCache().Get(instances.GetAssets()[i]);
+			for (unsigned m = 0; m < asset.meshes.size(); ++m)
+				if (asset.GetMeshDraw(0, m).indexCount > 0)
+				{
+					groups.insert(std::make_tuple(instances.GetAssets()[i], instances.GetMaterials()[i], m));
+					++instanceMeshes;
+				}
+		}
+
+		level.SetCulling(false);
+		level.SetLodEnabled(false);
+		backend.ClearCommands();
+		level.RenderLevel(camera.Update());
+		unsigned draws = 0, drawnInstanceMeshes = 0;
+		for (const RecordedCommand& c : backend.GetCommands())
+			if (c.type == RecordedCommandType::DRAW_INDEXED_INSTANCED)
+			{
+				++draws;
+				drawnInstanceMeshes += c.args[1];
+			}
+		Check(draws == groups.size(), std::string(name) + ": " + std::to_string(draws) + " draws for " +
+			std::to_string(groups.size()) + " distinct asset meshes");
+		Check(drawnInstanceMeshes == instanceMeshes, std::string(name) + ": the draws' instance counts add up to " +
+			std::to_string(drawnInstanceMeshes) + ", not " + std::to_string(instanceMeshes));
+		std::cout << std::left << std::setw(20) << name << std::right << std::setw(11) << instances.Size() << std::setw(8) <<
+			level.GetInstanceGroupCount() << std::setw(8) << draws << std::setw(10) << groups.size() << std::setw(16) <<
+			drawnInstanceMeshes << std::endl;
+
+		// culled & LOD selected frames, one draw per mesh of each LOD in use
+		level.SetCulling(true);
+		level.SetLodEnabled(true);
+		unsigned repeatedFrames = 0;
+		for (int frame = 0; frame < 16; ++frame)
+		{
+			camera.YawLocal(0.4f);
+			backend.ClearCommands();
+			level.RenderLevel(camera.Update());
+			std::set<MeshKey> drawn;
+			for (const RecordedCommand& c : backend.GetCommands())
+				if (c.type == RecordedCommandType::DRAW_INDEXED_INSTANCED &&
+					!drawn.insert(MeshKey(c.args[2], c.baseVertex, c.args[0])).second)
+				{
+					++repeatedFrames;
+					break;
+				}
+		}
+		Check(repeatedFrames == 0, std::string(name) + ": " + std::to_string(repeatedFrames) +
+			" culled frames drew a mesh more than once");
+		level.UnloadLevel();
+	}
+	if (failures == 0)
+		std::cout << "every mesh is one instanced draw" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+//jobBench.cpp
+// Scaling of the job system (jobSystem.h) from one thread up to one per core on two loads:
+// parsing every .h2b in a folder (one job per file) and culling a large field of instance boxes
+// (linear SIMD culling in chunks, like Level_Objects with a job system). Every thread count must
+// give the same results as one thread.
+//   JobBench <h2b folder> [max threads, default one per core] [boxes, default 200000]
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include "h2bParser.h"
+#include "frustumCulling.h"
+#include "jobSystem.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double Milliseconds(Clock::time_point from, Clock::time_point to)
+{
+	return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+// What a parse produced, compared across thread counts
+struct ParseSummary
+{
+	size_t vertices, indices, meshes, materials;
+	bool operator==(const ParseSummary& other) const
+	{
+		return vertices == other.vertices && indices == other.indices && meshes == other.meshes &&
+			materials == other.materials;
+	}
+};
+
+// Parses every file repeats times, one job each, best of three runs
+static double ParseAll(JobSystem& jobs, const std::vector<std::string>& files, unsigned repeats,
+	std::vector<ParseSummary>& summaries)
+{
+	const unsigned count = static_cast<unsigned>(files.size()) * repeats;
+	summaries.assign(count, ParseSummary());
+	double best = HUGE_VAL;
+	for (int run = 0; run < 3; ++run)
+	{
+		const Clock::time_point start = Clock::now();
+		jobs.ParallelFor(count, 1, [&](unsigned begin, unsigned end) {
+			for (unsigned i = begin; i < end; ++i)
+			{
+				H2B::Parser parser;
+				if (parser.Parse(files[i % files.size()].c_str()))
+					summaries[i] = { parser.vertices.size(), parser.indices.size(), parser.meshes.size(),
+						parser.materials.size() };
+			}
+		});
+		best = std::min(best, Milliseconds(start, Clock::now()));
+	}
+	return best;
+}
+
+// Culls in chunks of 2048 boxes with a result list each, joined in order, best of passes
+static double CullAll(JobSystem& jobs, const FrustumCuller& culler, const Frustum& frustum,
+	std::vector<std::vector<unsigned>>& chunks, std::vector<unsigned>& visible)
+{
+	const unsigned chunkSize = 2048;
+	const unsigned boxCount = static_cast<unsigned>(culler.Size());
+	chunks.resize((boxCount + chunkSize - 1) / chunkSize);
+	double best = HUGE_VAL;
+	for (int pass = 0; pass < 50; ++pass)
+	{
+		const Clock::time_point start = Clock::now();
+		jobs.ParallelFor(static_cast<unsigned>(chunks.size()), 1, [&](unsigned begin, unsigned end) {
+			for (unsigned c = begin; c < end; ++c)
+			{
+				chunks[c].clear();
+				culler.Cull(frustum, c * chunkSize, (c + 1) * chunkSize, chunks[c]);
+			}
+		});
+		visible.clear();
+		for (const std::vector<unsigned>& chunk : chunks)
+			visible.insert(visible.end(), chunk.begin(), chunk.end());
+		best = std::min(best, Milliseconds(start, Clock::now()));
+	}
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2 || argc > 4)
+	{
+		std::cout << "usage: JobBench <h2b folder> [max threads] [boxes]" << std::endl;
+		return 1;
+	}
+	const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+	const unsigned maxThreads = argc >= 3 ? std::max(1u, static_cast<unsigned>(std::stoul(argv[2]))) : cores;
+	const unsigned boxCount = argc >= 4 ? static_cast<unsigned>(std::stoul(argv[3])) : 200000;
+
+	std::vector<std::string> files;
+	for (const auto& entry : std::filesystem::directory_iterator(argv[1]))
+		if (entry.path().extension() == ".h2b")
+			files.push_back(entry.path().string());
+	std::sort(files.begin(), files.end());
+	if (files.empty())
+	{
+		std::cout << "no .h2b files in " << argv[1] << std::endl;
+		return 1;
+	}
+	const unsigned repeats = 32; // enough parses to keep every thread busy
+
+	// boxes scattered around a camera at the origin looking down +z, about a third visible
+	FrustumCuller culler;
+	culler.Reserve(boxCount);
+	std::mt19937 random(99);
+	std::uniform_real_distribution<float> position(-200.0f, 200.0f), size(0.1f, 4.0f);
+	for (unsigned i = 0; i < boxCount; ++i)
+		culler.Add({ { position(random), position(random) * 0.1f, position(random) }, { size(random), size(random), size(random) } });
+	// view = identity, a 90 degree perspective with far at 300
+	const float n = 0.1f, f = 300.0f;
+	const float viewProj[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, f / (f - n), 1, 0, 0, -n * f / (f - n), 0 };
+	const Frustum frustum = ExtractFrustum(viewProj);
+
+	std::cout << cores << " cores, " << files.size() * repeats << " .h2b parses, " << boxCount << " boxes" << std::endl;
+	std::cout << std::left << std::setw(10) << "threads" << std::right << std::setw(12) << "parse ms" << std::setw(10) <<
+		"speedup" << std::setw(12) << "cull ms" << std::setw(10) << "speedup" << std::setw(10) << "same" << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+	std::vector<ParseSummary> firstParse, parse;
+	std::vector<unsigned> firstVisible, visible;
+	std::vector<std::vector<unsigned>> chunks;
+	double parseBase = 0, cullBase = 0;
+	bool allSame = true;
+	// 1, 2, 3, 4, then doubling, always ending on maxThreads
+	std::vector<unsigned> threadCounts;
+	for (unsigned threads = 1; threads < maxThreads; threads = threads < 4 ? threads + 1 : threads * 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+	for (unsigned threads : threadCounts)
+	{
+		JobSystem jobs(threads - 1);
+		const double parseMs = ParseAll(jobs, files, repeats, threads == 1 ? firstParse : parse);
+		const double cullMs = CullAll(jobs, culler, frustum, chunks, threads == 1 ? firstVisible : visible);
+		const bool same = threads == 1 || (parse == firstParse && visible == firstVisible);
+		allSame &= same;
+		if (threads == 1)
+		{
+			parseBase = parseMs;
+			cullBase = cullMs;
+		}
+		std::cout << std::left << std::setw(10) << threads << std::right << std::setw(12) << parseMs <<
+			std::setw(9) << parseBase / parseMs << "x" << std::setw(12) << cullMs << std::setw(9) << cullBase / cullMs << "x" <<
+			std::setw(10) << (same ? "yes" : "NO") << std::endl;
+	}
+	std::cout << "visible boxes " << firstVisible.size() << std::endl;
+	if (!allSame)
+		std::cout << "MISMATCH: a thread count gave different results" << std::endl;
+	return allSame ? 0 : 1;
+}
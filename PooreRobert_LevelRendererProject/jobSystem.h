@@ -0,0 +1,391 @@
+//jobSystem
+// A pool of worker threads that run small jobs for the loader, culling & draw list building.
+// Every thread of the system (the workers plus the thread that created it, thread 0) owns a
+// Chase-Lev deque: it pushes & pops its own jobs at the bottom, idle threads steal from the top
+// of the others'. Jobs report to a JobCounter that Wait blocks on, and while it waits the
+// waiting thread runs jobs itself, so the main thread is one more worker instead of idling.
+// A job may also wait for a counter before it starts (Run's after), that is how dependent work
+// is chained without blocking a thread.
+// Threads outside the system (the level streaming thread) can Run and Wait too, their jobs go
+// through a shared queue instead of a deque. Only the workers and outside threads take from it:
+// thread 0 is the render thread, a long load job picked up while it waits on a frame's work
+// would stall the frame.
+// Jobs come from a fixed ring per thread and no path allocates once running. A slot is only
+// reused once its job finished: a thread whose next slot is still waiting or running runs the
+// new job itself, after waiting for its after counter if it has one.
+// A job's heap allocations count for the AllocationCounter::Scope it was queued under, so a
+// frame's count includes the work it handed to the workers.
+#ifndef _JOBSYSTEM_H_
+#define _JOBSYSTEM_H_
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "allocationCounter.h"
+
+const unsigned JOB_POOL_SIZE = 4096; // per thread, a power of two
+
+// Runs items [begin, end) of whatever data points at
+typedef void (*JobFunction)(void* data, unsigned begin, unsigned end);
+
+class JobCounter;
+
+struct Job
+{
+	JobFunction function;
+	void* data;
+	unsigned begin, end;
+	JobCounter* counter; // counted down when the job finishes, may be nullptr
+	std::atomic<unsigned long long>* allocations; // the AllocationCounter::Scope it was queued under
+	std::atomic<bool> inUse{ false }; // queued, waiting or running, the ring must not reuse it yet
+};
+
+// Jobs still to finish. Wait on it before reusing or destroying it.
+class JobCounter
+{
+	friend class JobSystem;
+	std::atomic<unsigned> pending{ 0 };
+	std::mutex mutex;
+	std::vector<Job*> waiting; // jobs started with this counter as their after
+
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+	bool IsDone() const { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+// Chase-Lev work stealing deque with the C11 orderings of Le et al., "Correct and Efficient
+// Work-Stealing for Weak Memory Models" (2013). Fixed capacity.
+class JobDeque
+{
+	std::atomic<long long> top{ 0 };
+	std::atomic<long long> bottom{ 0 };
+	std::unique_ptr<std::atomic<Job*>[]> buffer;
+
+public:
+	JobDeque() : buffer(new std::atomic<Job*>[JOB_POOL_SIZE]) {}
+
+	// Owner only, false when full
+	bool Push(Job* job)
+	{
+		const long long b = bottom.load(std::memory_order_relaxed);
+		const long long t = top.load(std::memory_order_acquire);
+		if (b - t >= static_cast<long long>(JOB_POOL_SIZE))
+			return false;
+		buffer[b & (JOB_POOL_SIZE - 1)].store(job, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return true;
+	}
+	// Owner only, the newest job
+	Job* Pop()
+	{
+		const long long b = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		long long t = top.load(std::memory_order_relaxed);
+		if (t > b)
+		{
+			bottom.store(b + 1, std::memory_order_relaxed); // was empty
+			return nullptr;
+		}
+		Job* job = buffer[b & (JOB_POOL_SIZE - 1)].load(std::memory_order_relaxed);
+		if (t == b)
+		{
+			// the last one, a thief may be taking it too
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				job = nullptr;
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+	// Any thread, the oldest job
+	Job* Steal()
+	{
+		long long t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const long long b = bottom.load(std::memory_order_acquire);
+		if (t >= b)
+			return nullptr;
+		Job* job = buffer[t & (JOB_POOL_SIZE - 1)].load(std::memory_order_relaxed);
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return nullptr; // lost the race, the caller tries elsewhere
+		return job;
+	}
+};
+
+class JobSystem
+{
+	struct ThreadState
+	{
+		JobDeque deque;
+		std::unique_ptr<Job[]> pool{ new Job[JOB_POOL_SIZE] };
+		unsigned nextJob = 0;
+		unsigned nextVictim = 0;
+	};
+
+	std::vector<std::unique_ptr<ThreadState>> threads; // 0 is the creating thread
+	std::vector<std::thread> workers;
+	// jobs from threads outside the system
+	std::mutex externalMutex;
+	std::vector<Job*> externalQueue;
+	std::unique_ptr<Job[]> externalPool{ new Job[JOB_POOL_SIZE] };
+	unsigned externalNext = 0;
+	// idle workers sleep until a job is queued
+	std::atomic<int> queued{ 0 };
+	std::atomic<int> sleepers{ 0 };
+	std::atomic<bool> quit{ false };
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+
+	// which system & thread the calling thread is, nullptr outside any
+	static JobSystem*& CurrentSystem()
+	{
+		static thread_local JobSystem* system = nullptr;
+		return system;
+	}
+	static unsigned& CurrentIndex()
+	{
+		static thread_local unsigned index = 0;
+		return index;
+	}
+	ThreadState* Member()
+	{
+		return CurrentSystem() == this ? threads[CurrentIndex()].get() : nullptr;
+	}
+
+	// The calling thread's next ring slot, nullptr if its job has not finished yet
+	Job* Allocate(JobFunction function, void* data, unsigned begin, unsigned end, JobCounter* counter)
+	{
+		Job* slot;
+		if (ThreadState* self = Member())
+		{
+			slot = &self->pool[self->nextJob & (JOB_POOL_SIZE - 1)];
+			if (slot->inUse.load(std::memory_order_acquire))
+				return nullptr;
+			++self->nextJob;
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock(externalMutex);
+			slot = &externalPool[externalNext & (JOB_POOL_SIZE - 1)];
+			if (slot->inUse.load(std::memory_order_acquire))
+				return nullptr;
+			++externalNext;
+		}
+		slot->inUse.store(true, std::memory_order_relaxed); // published by Queue or after's lock
+		slot->function = function;
+		slot->data = data;
+		slot->begin = begin;
+		slot->end = end;
+		slot->counter = counter;
+		slot->allocations = AllocationCounter::ThisThread();
+		return slot;
+	}
+	void Queue(Job* job)
+	{
+		queued.fetch_add(1); // before it can be found, so the count never goes below zero
+		if (ThreadState* self = Member())
+		{
+			if (!self->deque.Push(job))
+			{
+				queued.fetch_sub(1);
+				Execute(job); // deque full, run it right here
+				return;
+			}
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock(externalMutex);
+			externalQueue.push_back(job);
+		}
+		if (sleepers.load() > 0)
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			wake.notify_one();
+		}
+	}
+	Job* FindJob()
+	{
+		ThreadState* self = Member();
+		Job* job = self != nullptr ? self->deque.Pop() : nullptr;
+		if (job == nullptr && queued.load(std::memory_order_relaxed) > 0)
+		{
+			if (self != threads[0].get())
+			{
+				std::lock_guard<std::mutex> lock(externalMutex);
+				if (!externalQueue.empty())
+				{
+					job = externalQueue.back();
+					externalQueue.pop_back();
+				}
+			}
+			// steal, starting at the last thread that had something
+			const unsigned count = static_cast<unsigned>(threads.size());
+			const unsigned first = self != nullptr ? self->nextVictim : 0;
+			for (unsigned k = 0; k < count && job == nullptr; ++k)
+			{
+				const unsigned v = (first + k) % count;
+				if (threads[v].get() != self)
+				{
+					job = threads[v]->deque.Steal();
+					if (job != nullptr && self != nullptr)
+						self->nextVictim = v;
+				}
+			}
+		}
+		if (job != nullptr)
+			queued.fetch_sub(1);
+		return job;
+	}
+	void Execute(Job* job)
+	{
+		// its allocations count for whoever queued it, not for what this thread is doing
+		std::atomic<unsigned long long>*& allocations = AllocationCounter::ThisThread();
+		std::atomic<unsigned long long>* const own = allocations;
+		allocations = job->allocations;
+		job->function(job->data, job->begin, job->end);
+		allocations = own;
+		JobCounter* counter = job->counter;
+		job->inUse.store(false, std::memory_order_release); // its thread may refill the slot from here on
+		if (counter != nullptr)
+			Finish(*counter);
+	}
+	// Counts down under the counter's lock, Wait takes the lock once before returning so the
+	// counter is never destroyed while this still holds it
+	void Finish(JobCounter& counter)
+	{
+		std::vector<Job*> released;
+		{
+			std::lock_guard<std::mutex> lock(counter.mutex);
+			if (counter.pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				released.swap(counter.waiting); // the last one, start everything that waited for it
+		}
+		for (Job* job : released)
+			Queue(job);
+	}
+	void WorkerLoop(unsigned index)
+	{
+		CurrentSystem() = this;
+		CurrentIndex() = index;
+		while (!quit.load())
+		{
+			if (Job* job = FindJob())
+			{
+				Execute(job);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			sleepers.fetch_add(1);
+			wake.wait(lock, [this]() { return quit.load() || queued.load() > 0; });
+			sleepers.fetch_sub(1);
+		}
+		CurrentSystem() = nullptr;
+	}
+
+public:
+	// workerCount threads besides the calling one, which becomes thread 0 and runs jobs while it
+	// waits. Defaults to one thread per core.
+	explicit JobSystem(unsigned workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1)
+	{
+		for (unsigned i = 0; i <= workerCount; ++i)
+			threads.emplace_back(new ThreadState());
+		externalQueue.reserve(JOB_POOL_SIZE);
+		CurrentSystem() = this;
+		CurrentIndex() = 0;
+		for (unsigned i = 1; i <= workerCount; ++i)
+			workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+	~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			quit.store(true);
+		}
+		wake.notify_all();
+		for (std::thread& worker : workers)
+			worker.join();
+		if (CurrentSystem() == this)
+			CurrentSystem() = nullptr;
+	}
+
+	// Threads that run jobs, the workers and thread 0
+	unsigned GetThreadCount() const { return static_cast<unsigned>(threads.size()); }
+
+	// Queues function(data, begin, end), counter (if any) counts it until it finished. With after
+	// the job only starts once that counter reached zero. If the calling thread's ring has no
+	// free slot the job runs (after after) before Run returns.
+	void Run(JobFunction function, void* data, unsigned begin, unsigned end, JobCounter* counter,
+		JobCounter* after = nullptr)
+	{
+		if (counter != nullptr)
+			counter->pending.fetch_add(1, std::memory_order_relaxed);
+		Job* job = Allocate(function, data, begin, end, counter);
+		if (job == nullptr)
+		{
+			// the ring came round to a job that has not finished, never overwrite it
+			if (after != nullptr)
+				Wait(*after);
+			function(data, begin, end);
+			if (counter != nullptr)
+				Finish(*counter);
+			return;
+		}
+		if (after != nullptr)
+		{
+			std::lock_guard<std::mutex> lock(after->mutex);
+			if (!after->IsDone())
+			{
+				after->waiting.push_back(job);
+				return;
+			}
+		}
+		Queue(job);
+	}
+
+	// Runs jobs until counter reached zero, after that the counter may be reused or destroyed
+	void Wait(JobCounter& counter)
+	{
+		while (!counter.IsDone())
+		{
+			if (Job* job = FindJob())
+				Execute(job);
+			else
+				std::this_thread::yield();
+		}
+		std::lock_guard<std::mutex> lock(counter.mutex); // the last Finish has let go of it
+	}
+
+	// body(begin, end) over [0, count) in ranges of about grain items, returns when all are done.
+	// The calling thread takes part.
+	template <typename Body>
+	void ParallelFor(unsigned count, unsigned grain, const Body& body)
+	{
+		if (count == 0)
+			return;
+		grain = std::max(1u, grain);
+		if (count <= grain || threads.size() == 1)
+		{
+			body(0u, count);
+			return;
+		}
+		JobCounter counter;
+		const JobFunction run = [](void* data, unsigned begin, unsigned end) {
+			(*static_cast<const Body*>(data))(begin, end);
+		};
+		void* data = const_cast<Body*>(&body);
+		// all but the first range go to the workers, this thread starts on the first
+		for (unsigned begin = grain; begin < count; begin += grain)
+			Run(run, data, begin, std::min(count, begin + grain), &counter);
+		body(0u, std::min(count, grain));
+		Wait(counter);
+	}
+};
+
+#endif
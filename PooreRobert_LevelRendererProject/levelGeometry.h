@@ -0,0 +1,304 @@
+//levelGeometry
+// All vertices and indices of a level in one vertex buffer and one index buffer. Each asset
+// gets a range of both, draws reach it through baseVertex/firstIndex, so the whole level is
+// drawn with the input assembler bound once.
+// Ranges come from a RangeAllocator per buffer. When an asset no longer fits, the live ranges
+// are packed to the front of new buffers by GPU copies (bigger ones if the free space alone
+// would not be enough), which is what keeps a level that adds and removes assets from
+// fragmenting its buffers.
+// Vertices are stored in the level's VertexEncoding, the compact ones are encoded on Add.
+// Indices are 16 bit when the level asks for it, they are relative to the asset's first vertex
+// so that only limits a single asset to 65536 vertices.
+#ifndef _LEVELGEOMETRY_H_
+#define _LEVELGEOMETRY_H_
+#include <map>
+#include <iterator>
+#include <vector>
+#include "h2bParser.h"
+#include "renderBackend.h"
+#include "vertexCompression.h"
+
+// Free space of [0, capacity) as a sorted map of ranges, in elements. Best fit, neighbours
+// are merged on free. Does not remember allocation sizes, the caller passes them back to Free.
+class RangeAllocator
+{
+	std::map<unsigned, unsigned> freeRanges; // offset -> size
+	unsigned capacity = 0;
+	unsigned used = 0;
+
+public:
+	static const unsigned INVALID_OFFSET = ~0u;
+
+	void Reset(unsigned _capacity)
+	{
+		freeRanges.clear();
+		capacity = _capacity;
+		used = 0;
+		if (capacity > 0)
+			freeRanges[0] = capacity;
+	}
+
+	// Smallest free range that fits, the lowest one of equal size. INVALID_OFFSET if none does.
+	unsigned Allocate(unsigned size)
+	{
+		if (size == 0)
+			return 0;
+		auto best = freeRanges.end();
+		for (auto r = freeRanges.begin(); r != freeRanges.end(); ++r)
+			if (r->second >= size && (best == freeRanges.end() || r->second < best->second))
+				best = r;
+		if (best == freeRanges.end())
+			return INVALID_OFFSET;
+		const unsigned offset = best->first;
+		const unsigned left = best->second - size;
+		freeRanges.erase(best);
+		if (left > 0)
+			freeRanges[offset + size] = left;
+		used += size;
+		return offset;
+	}
+
+	void Free(unsigned offset, unsigned size)
+	{
+		if (size == 0)
+			return;
+		used -= size;
+		auto next = freeRanges.lower_bound(offset);
+		if (next != freeRanges.begin())
+		{
+			auto previous = std::prev(next);
+			if (previous->first + previous->second == offset)
+			{
+				offset = previous->first;
+				size += previous->second;
+				freeRanges.erase(previous);
+			}
+		}
+		if (next != freeRanges.end() && offset + size == next->first)
+		{
+			size += next->second;
+			freeRanges.erase(next);
+		}
+		freeRanges[offset] = size;
+	}
+
+	unsigned GetCapacity() const { return capacity; }
+	unsigned GetUsed() const { return used; }
+	unsigned GetFree() const { return capacity - used; }
+	unsigned GetLargestFree() const
+	{
+		unsigned largest = 0;
+		for (const auto& r : freeRanges)
+			largest = r.second > largest ? r.second : largest;
+		return largest;
+	}
+	size_t GetFreeRangeCount() const { return freeRanges.size(); }
+};
+
+typedef unsigned GeometryHandle;
+const GeometryHandle INVALID_GEOMETRY = ~0u;
+
+// Where one asset's data lives in the level buffers, in vertices & indices
+struct GeometryRange
+{
+	unsigned baseVertex;
+	unsigned vertexCount;
+	unsigned firstIndex;
+	unsigned indexCount;
+	VertexDecode decode; // turns its stored positions back into object space
+	bool alive;
+};
+
+class LevelGeometry
+{
+	RenderBackend* backend = nullptr;
+	BufferHandle vertexBuffer = INVALID_BUFFER;
+	BufferHandle indexBuffer = INVALID_BUFFER;
+	VertexEncoding encoding = VertexEncoding::FULL;
+	unsigned vertexStride = sizeof(H2B::VERTEX);
+	IndexFormat indexFormat = IndexFormat::UINT32;
+	unsigned indexSize = sizeof(unsigned);
+	std::vector<unsigned char> encoded; // Add's scratch for compact vertices
+	std::vector<unsigned short> narrowIndices; // and for 16 bit indices
+	RangeAllocator vertexSpace;
+	RangeAllocator indexSpace;
+	std::vector<GeometryRange> ranges; // handle -> range
+	std::vector<GeometryHandle> freeHandles;
+	unsigned defragmentCount = 0;
+
+	static BufferHandle CreateBuffer(RenderBackend& backend, BufferType type, unsigned sizeInBytes)
+	{
+		if (sizeInBytes == 0)
+			return INVALID_BUFFER;
+		BufferDesc desc = { type, BufferUsage::STATIC, sizeInBytes };
+		return backend.CreateBuffer(desc, nullptr);
+	}
+
+public:
+	// Buffers for exactly this many vertices & indices, more room is made when it runs out.
+	// COMPACT_NO_UV drops the UVs of every asset added later too, UINT16 refuses assets with
+	// more than 65536 vertices.
+	void Create(RenderBackend& _backend, unsigned vertexCapacity, unsigned indexCapacity,
+		VertexEncoding _encoding = VertexEncoding::FULL, IndexFormat _indexFormat = IndexFormat::UINT32)
+	{
+		Destroy();
+		backend = &_backend;
+		encoding = _encoding;
+		vertexStride = VertexStride(encoding);
+		indexFormat = _indexFormat;
+		indexSize = indexFormat == IndexFormat::UINT16 ? sizeof(unsigned short) : sizeof(unsigned);
+		vertexBuffer = CreateBuffer(*backend, BufferType::VERTEX, vertexCapacity * vertexStride);
+		indexBuffer = CreateBuffer(*backend, BufferType::INDEX, indexCapacity * indexSize);
+		vertexSpace.Reset(vertexCapacity);
+		indexSpace.Reset(indexCapacity);
+	}
+
+	void Destroy()
+	{
+		if (backend != nullptr)
+		{
+			backend->DestroyBuffer(vertexBuffer);
+			backend->DestroyBuffer(indexBuffer);
+		}
+		backend = nullptr;
+		vertexBuffer = indexBuffer = INVALID_BUFFER;
+		vertexSpace.Reset(0);
+		indexSpace.Reset(0);
+		ranges.clear();
+		freeHandles.clear();
+		encoded = std::vector<unsigned char>();
+		narrowIndices = std::vector<unsigned short>();
+		defragmentCount = 0;
+	}
+
+	// Copies one asset's vertices & indices in, the indices stay relative to its first vertex.
+	// INVALID_GEOMETRY if they do not fit the index format.
+	GeometryHandle Add(const H2B::VERTEX* vertices, unsigned vertexCount, const unsigned* indices, unsigned indexCount)
+	{
+		if (indexFormat == IndexFormat::UINT16 && vertexCount > 65536)
+			return INVALID_GEOMETRY;
+		unsigned baseVertex = vertexSpace.Allocate(vertexCount);
+		unsigned firstIndex = indexSpace.Allocate(indexCount);
+		if (baseVertex == RangeAllocator::INVALID_OFFSET || firstIndex == RangeAllocator::INVALID_OFFSET)
+		{
+			if (baseVertex != RangeAllocator::INVALID_OFFSET)
+				vertexSpace.Free(baseVertex, vertexCount);
+			if (firstIndex != RangeAllocator::INVALID_OFFSET)
+				indexSpace.Free(firstIndex, indexCount);
+			// packing the live ranges leaves all free space in one piece at the end, grow if that is too small
+			unsigned vertexCapacity = vertexSpace.GetCapacity();
+			unsigned indexCapacity = indexSpace.GetCapacity();
+			if (vertexSpace.GetFree() < vertexCount)
+				vertexCapacity = vertexSpace.GetUsed() + vertexCount > vertexCapacity * 2 ?
+					vertexSpace.GetUsed() + vertexCount : vertexCapacity * 2;
+			if (indexSpace.GetFree() < indexCount)
+				indexCapacity = indexSpace.GetUsed() + indexCount > indexCapacity * 2 ?
+					indexSpace.GetUsed() + indexCount : indexCapacity * 2;
+			Defragment(vertexCapacity, indexCapacity);
+			baseVertex = vertexSpace.Allocate(vertexCount);
+			firstIndex = indexSpace.Allocate(indexCount);
+		}
+		const VertexDecode decode = ComputeVertexDecode(vertices, vertexCount, encoding);
+		if (vertexCount > 0)
+		{
+			const void* data = vertices;
+			if (encoding != VertexEncoding::FULL)
+			{
+				encoded.resize(static_cast<size_t>(vertexCount) * vertexStride);
+				EncodeVertices(vertices, vertexCount, encoding, decode, encoded.data());
+				data = encoded.data();
+			}
+			backend->UpdateBufferRange(vertexBuffer, baseVertex * vertexStride, data, vertexCount * vertexStride);
+		}
+		if (indexCount > 0)
+		{
+			const void* data = indices;
+			if (indexFormat == IndexFormat::UINT16)
+			{
+				narrowIndices.assign(indices, indices + indexCount);
+				data = narrowIndices.data();
+			}
+			backend->UpdateBufferRange(indexBuffer, firstIndex * indexSize, data, indexCount * indexSize);
+		}
+
+		GeometryHandle handle;
+		if (freeHandles.empty())
+		{
+			handle = static_cast<GeometryHandle>(ranges.size());
+			ranges.push_back(GeometryRange());
+		}
+		else
+		{
+			handle = freeHandles.back();
+			freeHandles.pop_back();
+		}
+		ranges[handle] = { baseVertex, vertexCount, firstIndex, indexCount, decode, true };
+		return handle;
+	}
+
+	void Remove(GeometryHandle handle)
+	{
+		if (handle >= ranges.size() || !ranges[handle].alive)
+			return;
+		GeometryRange& range = ranges[handle];
+		vertexSpace.Free(range.baseVertex, range.vertexCount);
+		indexSpace.Free(range.firstIndex, range.indexCount);
+		range.alive = false;
+		freeHandles.push_back(handle);
+	}
+
+	// Packs every live range to the front of new buffers of the given capacities (at least the
+	// used space), in handle order. Ranges move, handles stay valid.
+	void Defragment(unsigned vertexCapacity, unsigned indexCapacity)
+	{
+		vertexCapacity = vertexCapacity > vertexSpace.GetUsed() ? vertexCapacity : vertexSpace.GetUsed();
+		indexCapacity = indexCapacity > indexSpace.GetUsed() ? indexCapacity : indexSpace.GetUsed();
+		BufferHandle newVertices = CreateBuffer(*backend, BufferType::VERTEX, vertexCapacity * vertexStride);
+		BufferHandle newIndices = CreateBuffer(*backend, BufferType::INDEX, indexCapacity * indexSize);
+		unsigned vertexHead = 0, indexHead = 0;
+		for (GeometryRange& range : ranges)
+		{
+			if (!range.alive)
+				continue;
+			if (range.vertexCount > 0)
+				backend->CopyBufferRange(newVertices, vertexHead * vertexStride, vertexBuffer,
+					range.baseVertex * vertexStride, range.vertexCount * vertexStride);
+			if (range.indexCount > 0)
+				backend->CopyBufferRange(newIndices, indexHead * indexSize, indexBuffer,
+					range.firstIndex * indexSize, range.indexCount * indexSize);
+			range.baseVertex = vertexHead;
+			range.firstIndex = indexHead;
+			vertexHead += range.vertexCount;
+			indexHead += range.indexCount;
+		}
+		backend->DestroyBuffer(vertexBuffer);
+		backend->DestroyBuffer(indexBuffer);
+		vertexBuffer = newVertices;
+		indexBuffer = newIndices;
+		vertexSpace.Reset(vertexCapacity);
+		indexSpace.Reset(indexCapacity);
+		if (vertexHead > 0)
+			vertexSpace.Allocate(vertexHead);
+		if (indexHead > 0)
+			indexSpace.Allocate(indexHead);
+		++defragmentCount;
+	}
+	// Same capacities, only packs
+	void Defragment()
+	{
+		Defragment(vertexSpace.GetCapacity(), indexSpace.GetCapacity());
+	}
+
+	const GeometryRange& Get(GeometryHandle handle) const { return ranges[handle]; }
+	BufferHandle GetVertexBuffer() const { return vertexBuffer; }
+	BufferHandle GetIndexBuffer() const { return indexBuffer; }
+	VertexEncoding GetEncoding() const { return encoding; }
+	unsigned GetVertexStride() const { return vertexStride; }
+	IndexFormat GetIndexFormat() const { return indexFormat; }
+	const RangeAllocator& GetVertexSpace() const { return vertexSpace; }
+	const RangeAllocator& GetIndexSpace() const { return indexSpace; }
+	// Times the buffers were repacked (or grown) since Create
+	unsigned GetDefragmentCount() const { return defragmentCount; }
+};
+
+#endif
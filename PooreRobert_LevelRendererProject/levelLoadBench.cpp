@@ -0,0 +1,169 @@
+//levelLoadBench.cpp
+// Times LoadLevel with the .h2b imports on one thread and in parallel on a JobSystem, for every
+// GameLevel*.txt in a folder plus a generated level of 500 distinct assets. Cold is the first
+// load after the files were dropped from the OS file cache (Linux only, elsewhere it is just
+// the first load of the run), warm is the best of five loads after it. Both ways must load
+// exactly the same instances, assets & cache counts.
+//   LevelLoadBench <h2b folder> <levels folder> [threads, default one per core]
+#define GATEWARE_ENABLE_CORE // All libraries need this
+#define GATEWARE_ENABLE_SYSTEM // GFile & GLog used by the level loader
+#define GATEWARE_ENABLE_MATH
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include "../gateware-main/gateware-main/Gateware.h"
+#include "load_object_oriented.h"
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+// Asks the OS to forget its cached pages of every file in the folder (clean pages only)
+static void DropFileCache(const std::string& folder)
+{
+#if defined(__linux__)
+	for (const auto& entry : std::filesystem::directory_iterator(folder))
+	{
+		const int fd = open(entry.path().c_str(), O_RDONLY);
+		if (fd < 0)
+			continue;
+		fdatasync(fd);
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(fd);
+	}
+#else
+	(void)folder;
+#endif
+}
+
+// Everything a load produced that must not depend on how it was loaded
+static std::string Fingerprint(const Level_Objects& level)
+{
+	const InstanceStore& instances = level.GetInstances();
+	const AssetCache& assets = level.GetAssetCache();
+	std::string print = std::to_string(assets.GetAssetCount()) + " " + std::to_string(assets.GetHitCount()) + " " +
+		std::to_string(assets.GetMissCount()) + "\n";
+	for (unsigned i = 0; i < instances.Size(); ++i)
+	{
+		const ModelAsset& asset = assets.Get(instances.GetAssets()[i]);
+		print += instances.GetName(i) + " " + std::to_string(instances.GetAssets()[i]) + " " + asset.name + " " +
+			std::to_string(asset.vertices.size()) + " " + std::to_string(asset.indices.size()) + " " +
+			std::to_string(asset.GetLodCount()) + " ";
+		print.append(reinterpret_cast<const char*>(instances.GetWorlds()[i].data), sizeof(GW::MATH::GMATRIXF));
+		print += "\n";
+	}
+	return print;
+}
+
+struct LoadTimes
+{
+	double coldMs, warmMs;
+	std::string fingerprint;
+	unsigned instances, assets;
+};
+
+static LoadTimes TimeLoads(const std::string& levelPath, const std::string& h2bFolder, JobSystem* jobs)
+{
+	LoadTimes times = {};
+	GW::SYSTEM::GLog log; // not created, the messages go nowhere
+	Level_Objects level;
+	level.SetJobSystem(jobs);
+	DropFileCache(h2bFolder);
+	Clock::time_point start = Clock::now();
+	level.LoadLevel(levelPath.c_str(), h2bFolder.c_str(), log);
+	times.coldMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	times.warmMs = HUGE_VAL;
+	for (int run = 0; run < 5; ++run)
+	{
+		start = Clock::now();
+		level.LoadLevel(levelPath.c_str(), h2bFolder.c_str(), log);
+		times.warmMs = std::min(times.warmMs, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+	}
+	times.fingerprint = Fingerprint(level);
+	times.instances = static_cast<unsigned>(level.GetInstances().Size());
+	times.assets = level.GetAssetCache().GetAssetCount();
+	level.UnloadLevel();
+	return times;
+}
+
+// 500 copies of the shipped models under their own names, each placed twice
+static std::string WriteSyntheticLevel(const std::string& h2bFolder, const std::string& folder)
+{
+	std::vector<std::filesystem::path> models;
+	for (const auto& entry : std::filesystem::directory_iterator(h2bFolder))
+		if (entry.path().extension() == ".h2b")
+			models.push_back(entry.path());
+	std::sort(models.begin(), models.end());
+	std::filesystem::create_directories(folder);
+	const std::string levelPath = folder + "/Synthetic500.txt";
+	std::ofstream level(levelPath);
+	level << "# Game Level Exporter v1.3\n";
+	level << std::fixed << std::setprecision(4);
+	for (unsigned a = 0; a < 500 && !models.empty(); ++a)
+	{
+		std::string name = "Asset" + std::to_string(1000 + a).substr(1);
+		std::filesystem::copy_file(models[a % models.size()], folder + "/" + name + ".h2b",
+			std::filesystem::copy_options::overwrite_existing);
+		for (int copy = 0; copy < 2; ++copy)
+		{
+			level << "MESH\n" << name << (copy ? ".001" : "") << "\n";
+			level << "<Matrix 4x4 (1.0000, 0.0000, 0.0000, 0.0000)\n";
+			level << "            (0.0000, 1.0000, 0.0000, 0.0000)\n";
+			level << "            (0.0000, 0.0000, 1.0000, 0.0000)\n";
+			level << "            (" << (a % 25) * 4.0f << ", " << copy * 4.0f << ", " << (a / 25) * 4.0f << ", 1.0000)>\n";
+		}
+	}
+	return levelPath;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 3 && argc != 4)
+	{
+		std::cout << "usage: LevelLoadBench <h2b folder> <levels folder> [threads]" << std::endl;
+		return 1;
+	}
+	const unsigned threads = argc == 4 ? std::max(1u, static_cast<unsigned>(std::stoul(argv[3]))) :
+		std::max(1u, std::thread::hardware_concurrency());
+
+	// level file, its h2b folder
+	std::vector<std::pair<std::string, std::string>> levels;
+	for (const auto& entry : std::filesystem::directory_iterator(argv[2]))
+	{
+		const std::string name = entry.path().filename().string();
+		if (name.rfind("GameLevel", 0) == 0 && entry.path().extension() == ".txt")
+			levels.push_back({ entry.path().string(), argv[1] });
+	}
+	std::sort(levels.begin(), levels.end());
+	const std::string syntheticFolder = (std::filesystem::temp_directory_path() / "LevelLoadBench").string();
+	levels.push_back({ WriteSyntheticLevel(argv[1], syntheticFolder), syntheticFolder });
+
+	JobSystem jobs(threads - 1);
+	std::cout << jobs.GetThreadCount() << " threads" << std::endl;
+	std::cout << std::left << std::setw(20) << "level" << std::right << std::setw(10) << "instances" << std::setw(8) <<
+		"assets" << std::setw(13) << "serial cold" << std::setw(13) << "serial warm" << std::setw(15) << "parallel cold" <<
+		std::setw(15) << "parallel warm" << std::setw(10) << "speedup" << std::setw(7) << "same" << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+	bool allSame = true;
+	for (const auto& level : levels)
+	{
+		const LoadTimes serial = TimeLoads(level.first, level.second, nullptr);
+		const LoadTimes parallel = TimeLoads(level.first, level.second, &jobs);
+		const bool same = serial.fingerprint == parallel.fingerprint;
+		allSame &= same;
+		std::cout << std::left << std::setw(20) << std::filesystem::path(level.first).filename().string() << std::right <<
+			std::setw(10) << serial.instances << std::setw(8) << serial.assets << std::setw(13) << serial.coldMs <<
+			std::setw(13) << serial.warmMs << std::setw(15) << parallel.coldMs << std::setw(15) << parallel.warmMs <<
+			std::setw(9) << serial.warmMs / parallel.warmMs << "x" << std::setw(7) << (same ? "yes" : "NO") << std::endl;
+	}
+	std::filesystem::remove_all(syntheticFolder);
+	if (!allSame)
+		std::cout << "MISMATCH: a level loaded differently in parallel" << std::endl;
+	return allSame ? 0 : 1;
+}
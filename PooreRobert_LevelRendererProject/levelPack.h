@@ -0,0 +1,352 @@
+//levelPack
+// Single file binary level format. A GameLevel*.txt plus all the .h2b files it places
+// become one .lvlpack: header, unique mesh table with 16 byte aligned vertex/index blobs,
+// a material table and an instance table of world matrices. Loading is one mmap and
+// resolving offsets into pointers, nothing is parsed or copied.
+//
+// Layout (all offsets are from the start of the file, every table is 16 byte aligned)
+//   PackHeader
+//   PackAsset[assetCount]      name, vertex/index blob offsets, mesh, material & LOD ranges
+//   PackMesh[meshCount]        draw ranges, materialIndex is local to the asset. An asset's
+//                              meshes are followed by the same meshes again for each LOD.
+//   PackLod[lodCount]          error & triangle count of each LOD, see meshSimplifier.h
+//   H2B::ATTRIBUTES[materialCount]
+//   PackInstance[instanceCount] world matrix + asset index
+//   string table               null terminated names
+//   vertex & index blobs
+#ifndef _LEVELPACK_H_
+#define _LEVELPACK_H_
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include "h2bParser.h"
+#include "h2bMappedParser.h"
+
+namespace LevelPackFormat {
+	const char MAGIC[4] = { 'L', 'V', 'P', 'K' };
+	const unsigned VERSION = 2; // 2: LODs
+	const unsigned ALIGNMENT = 16;
+
+	struct PackHeader {
+		char magic[4];
+		unsigned version;
+		unsigned assetCount;
+		unsigned meshCount;
+		unsigned materialCount;
+		unsigned instanceCount;
+		unsigned lodCount;
+		unsigned padding;
+		unsigned long long assetTableOffset;
+		unsigned long long meshTableOffset;
+		unsigned long long lodTableOffset;
+		unsigned long long materialTableOffset;
+		unsigned long long instanceTableOffset;
+		unsigned long long stringTableOffset;
+		unsigned long long stringTableSize;
+		unsigned long long fileSize;
+	};
+	struct PackAsset {
+		unsigned nameOffset; // into the string table
+		unsigned vertexCount;
+		unsigned indexCount;
+		unsigned firstMesh;
+		unsigned meshCount;
+		unsigned firstMaterial;
+		unsigned materialCount;
+		unsigned firstLod;
+		unsigned lodCount; // LOD meshes start at firstMesh + meshCount
+		unsigned padding;
+		unsigned long long vertexOffset;
+		unsigned long long indexOffset;
+	};
+	struct PackMesh {
+		unsigned indexCount;
+		unsigned indexOffset;
+		unsigned materialIndex;
+	};
+	struct PackLod {
+		float error;
+		unsigned triangleCount;
+	};
+	struct PackInstance {
+		float world[16];
+		unsigned assetIndex;
+		unsigned nameOffset;
+		unsigned padding[2];
+	};
+	static_assert(sizeof(PackHeader) % ALIGNMENT == 0, "pack tables must stay aligned");
+	static_assert(sizeof(PackAsset) % 8 == 0, "pack tables must stay aligned");
+	static_assert(sizeof(PackInstance) % ALIGNMENT == 0, "pack tables must stay aligned");
+	static_assert(sizeof(H2B::ATTRIBUTES) == 80, "material table entries are raw ATTRIBUTES");
+}
+
+// CPU side description of a level handed to LevelPackWriter
+struct LevelPackSource
+{
+	struct Asset {
+		std::string name;
+		H2B::Span<H2B::VERTEX> vertices;
+		H2B::Span<unsigned> indices;
+		std::vector<LevelPackFormat::PackMesh> meshes;
+		std::vector<H2B::ATTRIBUTES> materials;
+		struct Lod {
+			LevelPackFormat::PackLod info;
+			std::vector<LevelPackFormat::PackMesh> meshes; // same count as the asset's
+		};
+		std::vector<Lod> lods;
+	};
+	struct Instance {
+		std::string name;
+		float world[16];
+		unsigned assetIndex;
+	};
+	std::vector<Asset> assets;
+	std::vector<Instance> instances;
+};
+
+class LevelPackWriter
+{
+	static unsigned long long Align(unsigned long long offset)
+	{
+		return (offset + LevelPackFormat::ALIGNMENT - 1) & ~static_cast<unsigned long long>(LevelPackFormat::ALIGNMENT - 1);
+	}
+	static void Pad(std::ofstream& file, unsigned long long& written, unsigned long long target)
+	{
+		static const char zeros[LevelPackFormat::ALIGNMENT] = {};
+		file.write(zeros, static_cast<std::streamsize>(target - written));
+		written = target;
+	}
+	template<typename T>
+	static void Write(std::ofstream& file, unsigned long long& written, const T* data, size_t count)
+	{
+		file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(sizeof(T) * count));
+		written += sizeof(T) * count;
+	}
+
+public:
+	static bool Write(const char* packPath, const LevelPackSource& source)
+	{
+		using namespace LevelPackFormat;
+		PackHeader header = {};
+		std::memcpy(header.magic, MAGIC, 4);
+		header.version = VERSION;
+		header.assetCount = static_cast<unsigned>(source.assets.size());
+		header.instanceCount = static_cast<unsigned>(source.instances.size());
+
+		// build the tables first so every offset is known before writing
+		std::string strings;
+		auto addString = [&strings](const std::string& s) {
+			unsigned offset = static_cast<unsigned>(strings.size());
+			strings.append(s.c_str(), s.size() + 1);
+			return offset;
+		};
+		std::vector<PackAsset> assets(source.assets.size());
+		std::vector<PackMesh> meshes;
+		std::vector<H2B::ATTRIBUTES> materials;
+		std::vector<PackLod> lods;
+		for (size_t i = 0; i < source.assets.size(); ++i)
+		{
+			const LevelPackSource::Asset& a = source.assets[i];
+			assets[i] = {};
+			assets[i].nameOffset = addString(a.name);
+			assets[i].vertexCount = a.vertices.size();
+			assets[i].indexCount = a.indices.size();
+			assets[i].firstMesh = static_cast<unsigned>(meshes.size());
+			assets[i].meshCount = static_cast<unsigned>(a.meshes.size());
+			assets[i].firstMaterial = static_cast<unsigned>(materials.size());
+			assets[i].materialCount = static_cast<unsigned>(a.materials.size());
+			assets[i].firstLod = static_cast<unsigned>(lods.size());
+			assets[i].lodCount = static_cast<unsigned>(a.lods.size());
+			meshes.insert(meshes.end(), a.meshes.begin(), a.meshes.end());
+			materials.insert(materials.end(), a.materials.begin(), a.materials.end());
+			for (const LevelPackSource::Asset::Lod& lod : a.lods)
+			{
+				lods.push_back(lod.info);
+				meshes.insert(meshes.end(), lod.meshes.begin(), lod.meshes.end());
+			}
+		}
+		std::vector<PackInstance> instances(source.instances.size());
+		for (size_t i = 0; i < source.instances.size(); ++i)
+		{
+			instances[i] = {};
+			std::memcpy(instances[i].world, source.instances[i].world, sizeof(instances[i].world));
+			instances[i].assetIndex = source.instances[i].assetIndex;
+			instances[i].nameOffset = addString(source.instances[i].name);
+		}
+		header.meshCount = static_cast<unsigned>(meshes.size());
+		header.materialCount = static_cast<unsigned>(materials.size());
+		header.lodCount = static_cast<unsigned>(lods.size());
+
+		header.assetTableOffset = Align(sizeof(PackHeader));
+		header.meshTableOffset = Align(header.assetTableOffset + sizeof(PackAsset) * assets.size());
+		header.lodTableOffset = Align(header.meshTableOffset + sizeof(PackMesh) * meshes.size());
+		header.materialTableOffset = Align(header.lodTableOffset + sizeof(PackLod) * lods.size());
+		header.instanceTableOffset = Align(header.materialTableOffset + sizeof(H2B::ATTRIBUTES) * materials.size());
+		header.stringTableOffset = Align(header.instanceTableOffset + sizeof(PackInstance) * instances.size());
+		header.stringTableSize = strings.size();
+		unsigned long long blobOffset = Align(header.stringTableOffset + strings.size());
+		for (size_t i = 0; i < assets.size(); ++i)
+		{
+			assets[i].vertexOffset = blobOffset;
+			blobOffset = Align(blobOffset + sizeof(H2B::VERTEX) * assets[i].vertexCount);
+			assets[i].indexOffset = blobOffset;
+			blobOffset = Align(blobOffset + sizeof(unsigned) * assets[i].indexCount);
+		}
+		header.fileSize = blobOffset;
+
+		std::ofstream file(packPath, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+		if (!file.is_open())
+			return false;
+		unsigned long long written = 0;
+		Write(file, written, &header, 1);
+		Pad(file, written, header.assetTableOffset);
+		Write(file, written, assets.data(), assets.size());
+		Pad(file, written, header.meshTableOffset);
+		Write(file, written, meshes.data(), meshes.size());
+		Pad(file, written, header.lodTableOffset);
+		Write(file, written, lods.data(), lods.size());
+		Pad(file, written, header.materialTableOffset);
+		Write(file, written, materials.data(), materials.size());
+		Pad(file, written, header.instanceTableOffset);
+		Write(file, written, instances.data(), instances.size());
+		Pad(file, written, header.stringTableOffset);
+		Write(file, written, strings.data(), strings.size());
+		for (size_t i = 0; i < assets.size(); ++i)
+		{
+			const LevelPackSource::Asset& a = source.assets[i];
+			Pad(file, written, assets[i].vertexOffset);
+			Write(file, written, a.vertices.data, a.vertices.size());
+			Pad(file, written, assets[i].indexOffset);
+			Write(file, written, a.indices.data, a.indices.size());
+		}
+		Pad(file, written, header.fileSize);
+		return static_cast<bool>(file);
+	}
+};
+
+// Runtime reader, every view points into the mapping and stays valid until Close
+class LevelPack
+{
+public:
+	struct AssetView {
+		std::string_view name;
+		H2B::Span<H2B::VERTEX> vertices;
+		H2B::Span<unsigned> indices;
+		H2B::Span<LevelPackFormat::PackMesh> meshes;
+		H2B::Span<H2B::ATTRIBUTES> materials;
+		H2B::Span<LevelPackFormat::PackLod> lods;
+		H2B::Span<LevelPackFormat::PackMesh> lodMeshes; // meshes.size() per LOD
+	};
+	struct InstanceView {
+		std::string_view name;
+		const float* world; // 16 floats, row major like GW::MATH::GMATRIXF
+		unsigned assetIndex;
+	};
+
+private:
+	H2B::MappedFile file;
+	const LevelPackFormat::PackHeader* header = nullptr;
+	std::vector<AssetView> assets; // pointer fixups, one per asset
+	std::vector<InstanceView> instances;
+
+	bool InFile(unsigned long long offset, unsigned long long bytes) const
+	{
+		return offset <= file.Size() && bytes <= file.Size() - offset;
+	}
+	std::string_view String(unsigned offset) const
+	{
+		const char* table = file.Data() + header->stringTableOffset;
+		if (offset >= header->stringTableSize)
+			return std::string_view();
+		const char* end = static_cast<const char*>(std::memchr(table + offset, '\0', header->stringTableSize - offset));
+		return end != nullptr ? std::string_view(table + offset, end - (table + offset)) : std::string_view();
+	}
+	template<typename T>
+	static H2B::Span<T> MakeSpan(const char* at, unsigned count)
+	{
+		H2B::Span<T> span;
+		span.data = reinterpret_cast<const T*>(at);
+		span.count = count;
+		return span;
+	}
+	bool Fail()
+	{
+		Close();
+		return false;
+	}
+
+public:
+	// Maps the pack and resolves every table, false if the file is missing or malformed
+	bool Open(const char* packPath)
+	{
+		using namespace LevelPackFormat;
+		Close();
+		if (!file.Open(packPath) || file.Size() < sizeof(PackHeader))
+			return Fail();
+		header = reinterpret_cast<const PackHeader*>(file.Data());
+		if (std::memcmp(header->magic, MAGIC, 4) != 0 || header->version != VERSION ||
+			header->fileSize != file.Size() ||
+			!InFile(header->assetTableOffset, sizeof(PackAsset) * static_cast<unsigned long long>(header->assetCount)) ||
+			!InFile(header->meshTableOffset, sizeof(PackMesh) * static_cast<unsigned long long>(header->meshCount)) ||
+			!InFile(header->lodTableOffset, sizeof(PackLod) * static_cast<unsigned long long>(header->lodCount)) ||
+			!InFile(header->materialTableOffset, sizeof(H2B::ATTRIBUTES) * static_cast<unsigned long long>(header->materialCount)) ||
+			!InFile(header->instanceTableOffset, sizeof(PackInstance) * static_cast<unsigned long long>(header->instanceCount)) ||
+			!InFile(header->stringTableOffset, header->stringTableSize))
+			return Fail();
+
+		const PackAsset* packAssets = reinterpret_cast<const PackAsset*>(file.Data() + header->assetTableOffset);
+		assets.resize(header->assetCount);
+		for (unsigned i = 0; i < header->assetCount; ++i)
+		{
+			const PackAsset& a = packAssets[i];
+			if (!InFile(a.vertexOffset, sizeof(H2B::VERTEX) * static_cast<unsigned long long>(a.vertexCount)) ||
+				!InFile(a.indexOffset, sizeof(unsigned) * static_cast<unsigned long long>(a.indexCount)) ||
+				static_cast<unsigned long long>(a.firstMesh) + a.meshCount * (1ull + a.lodCount) > header->meshCount ||
+				static_cast<unsigned long long>(a.firstLod) + a.lodCount > header->lodCount ||
+				static_cast<unsigned long long>(a.firstMaterial) + a.materialCount > header->materialCount)
+				return Fail();
+			// every draw range, the full meshes' and each LOD's, must stay inside the asset's indices
+			const PackMesh* meshes = reinterpret_cast<const PackMesh*>(file.Data() + header->meshTableOffset) + a.firstMesh;
+			for (unsigned m = 0; m < a.meshCount * (1 + a.lodCount); ++m)
+				if (static_cast<unsigned long long>(meshes[m].indexOffset) + meshes[m].indexCount > a.indexCount)
+					return Fail();
+			assets[i].name = String(a.nameOffset);
+			assets[i].vertices = MakeSpan<H2B::VERTEX>(file.Data() + a.vertexOffset, a.vertexCount);
+			assets[i].indices = MakeSpan<unsigned>(file.Data() + a.indexOffset, a.indexCount);
+			assets[i].meshes = MakeSpan<PackMesh>(file.Data() + header->meshTableOffset + sizeof(PackMesh) * a.firstMesh, a.meshCount);
+			assets[i].materials = MakeSpan<H2B::ATTRIBUTES>(
+				file.Data() + header->materialTableOffset + sizeof(H2B::ATTRIBUTES) * a.firstMaterial, a.materialCount);
+			assets[i].lods = MakeSpan<PackLod>(file.Data() + header->lodTableOffset + sizeof(PackLod) * a.firstLod, a.lodCount);
+			assets[i].lodMeshes = MakeSpan<PackMesh>(file.Data() + header->meshTableOffset +
+				sizeof(PackMesh) * (a.firstMesh + a.meshCount), a.meshCount * a.lodCount);
+		}
+
+		const PackInstance* packInstances = reinterpret_cast<const PackInstance*>(file.Data() + header->instanceTableOffset);
+		instances.resize(header->instanceCount);
+		for (unsigned i = 0; i < header->instanceCount; ++i)
+		{
+			if (packInstances[i].assetIndex >= header->assetCount)
+				return Fail();
+			instances[i].name = String(packInstances[i].nameOffset);
+			instances[i].world = packInstances[i].world;
+			instances[i].assetIndex = packInstances[i].assetIndex;
+		}
+		return true;
+	}
+
+	void Close()
+	{
+		file.Close();
+		header = nullptr;
+		assets.clear();
+		instances.clear();
+	}
+
+	bool IsOpen() const { return header != nullptr; }
+	const std::vector<AssetView>& GetAssets() const { return assets; }
+	const std::vector<InstanceView>& GetInstances() const { return instances; }
+};
+
+#endif
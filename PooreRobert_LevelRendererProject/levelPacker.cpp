@@ -0,0 +1,62 @@
+//levelPacker.cpp
+// Build step that turns a GameLevel*.txt and the .h2b files it places into one .lvlpack,
+// then loads the pack back and checks it rebuilds exactly the same instance list.
+//   LevelPacker <GameLevel.txt> <h2b folder> <output.lvlpack>
+#define GATEWARE_ENABLE_CORE // All libraries need this
+#define GATEWARE_ENABLE_SYSTEM // GFile & GLog used by the level loader
+#define GATEWARE_ENABLE_MATH
+
+#include "../gateware-main/gateware-main/Gateware.h"
+#include "load_object_oriented.h"
+
+// Same models, same order, same assets, bit identical matrices
+static bool SameInstances(const Level_Objects& text, const Level_Objects& packed)
+{
+	const InstanceStore& a = text.GetInstances();
+	const InstanceStore& b = packed.GetInstances();
+	if (a.Size() != b.Size())
+		return false;
+	for (unsigned i = 0; i < a.Size(); ++i)
+	{
+		if (a.GetName(i) != b.GetName(i) ||
+			text.GetAssetCache().Get(a.GetAssets()[i]).name != packed.GetAssetCache().Get(b.GetAssets()[i]).name ||
+			std::memcmp(a.GetWorlds()[i].data, b.GetWorlds()[i].data, sizeof(a.GetWorlds()[i].data)) != 0)
+			return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 4)
+	{
+		std::cout << "usage: LevelPacker <GameLevel.txt> <h2b folder> <output.lvlpack>" << std::endl;
+		return 1;
+	}
+	GW::SYSTEM::GLog log;
+	log.Create("LevelPackerLog.txt");
+	log.EnableConsoleLogging(true);
+
+	JobSystem jobs; // imports the .h2b files in parallel
+	Level_Objects text;
+	text.SetJobSystem(&jobs);
+	LevelPackSource source;
+	if (!text.LoadLevel(argv[1], argv[2], log) || !text.BuildPackSource(source))
+		return 1;
+	if (!LevelPackWriter::Write(argv[3], source))
+	{
+		log.LogCategorized("ERROR", (std::string("Could not write level pack: ") + argv[3]).c_str());
+		return 1;
+	}
+
+	Level_Objects packed;
+	if (!packed.LoadLevelPack(argv[3], log) || !SameInstances(text, packed))
+	{
+		log.LogCategorized("ERROR", "Level pack round trip does not match the text level.");
+		return 1;
+	}
+	std::string info = std::string("Packed ") + std::to_string(source.instances.size()) + " instances of " +
+		std::to_string(source.assets.size()) + " assets into " + argv[3];
+	log.LogCategorized("INFO", info.c_str());
+	return 0;
+}
@@ -0,0 +1,245 @@
+//levelParser
+// Single pass, allocation free parser for the GameLevel*.txt format written by the
+// Blender "Game Level Exporter". Works over a whole file already in memory (a mapping),
+// names come back as string_views into that buffer. Whitespace is free form, so it does not
+// depend on the exporter's column layout the way sscanf(linebuffer + 13, ...) did.
+//
+//   # comment line
+//   MESH | LIGHT | CAMERA
+//   <name>
+//   <Matrix 4x4 (f, f, f, f)
+//               (f, f, f, f)
+//               (f, f, f, f)
+//               (f, f, f, f)>
+#ifndef _LEVELPARSER_H_
+#define _LEVELPARSER_H_
+#include <string_view>
+#include <cstdlib>
+#include <cstring>
+
+enum class LevelRecordType { MESH, LIGHT, CAMERA };
+
+struct LevelRecord
+{
+	LevelRecordType type;
+	std::string_view name;
+	float matrix[16]; // row major, same layout as GW::MATH::GMATRIXF::data
+};
+
+struct LevelParseError
+{
+	unsigned line; // 1 based, 0 means no error
+	unsigned column;
+	const char* message;
+};
+
+class LevelTextParser
+{
+	const char* at;
+	const char* end;
+	const char* lineStart;
+	unsigned line = 1;
+	LevelParseError error = { 0, 0, nullptr };
+
+	bool Fail(const char* message)
+	{
+		error.line = line;
+		error.column = static_cast<unsigned>(at - lineStart) + 1;
+		error.message = message;
+		return false;
+	}
+
+	void NewLine()
+	{
+		++line;
+		lineStart = at;
+	}
+
+	// spaces, tabs & carriage returns, newlines only when allowed
+	void SkipSpaces(bool newlines)
+	{
+		while (at < end)
+		{
+			if (*at == ' ' || *at == '\t' || *at == '\r')
+				++at;
+			else if (*at == '\n' && newlines)
+			{
+				++at;
+				NewLine();
+			}
+			else
+				break;
+		}
+	}
+
+	void SkipLine()
+	{
+		while (at < end && *at != '\n')
+			++at;
+		if (at < end)
+		{
+			++at;
+			NewLine();
+		}
+	}
+
+	// rest of the line without surrounding whitespace
+	std::string_view ReadLine()
+	{
+		SkipSpaces(false);
+		const char* start = at;
+		while (at < end && *at != '\n')
+			++at;
+		const char* last = at;
+		while (last > start && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r'))
+			--last;
+		if (at < end)
+		{
+			++at;
+			NewLine();
+		}
+		return std::string_view(start, last - start);
+	}
+
+	bool Expect(char c, const char* message)
+	{
+		SkipSpaces(true);
+		if (at >= end || *at != c)
+			return Fail(message);
+		++at;
+		return true;
+	}
+
+	bool ExpectWord(const char* word, const char* message)
+	{
+		SkipSpaces(true);
+		size_t length = std::strlen(word);
+		if (static_cast<size_t>(end - at) < length || std::memcmp(at, word, length) != 0)
+			return Fail(message);
+		at += length;
+		return true;
+	}
+
+	// [sign] digits [. digits] [e [sign] digits]
+	bool ReadFloat(float& out)
+	{
+		SkipSpaces(true);
+		const char* start = at;
+		bool negative = false;
+		if (at < end && (*at == '-' || *at == '+'))
+			negative = *at++ == '-';
+		unsigned long long mantissa = 0;
+		int digits = 0, exponent = 0;
+		bool any = false;
+		for (; at < end && *at >= '0' && *at <= '9'; ++at, any = true)
+			if (digits < 19) { mantissa = mantissa * 10 + (*at - '0'); if (mantissa) ++digits; }
+			else ++exponent;
+		if (at < end && *at == '.')
+			for (++at; at < end && *at >= '0' && *at <= '9'; ++at, any = true)
+				if (digits < 19) { mantissa = mantissa * 10 + (*at - '0'); --exponent; if (mantissa) ++digits; }
+		if (!any)
+			return Fail("Expected a number");
+		if (at < end && (*at == 'e' || *at == 'E'))
+		{
+			const char* e = at + 1;
+			bool negativeExponent = false;
+			if (e < end && (*e == '-' || *e == '+'))
+				negativeExponent = *e++ == '-';
+			int value = 0;
+			const char* digitsStart = e;
+			for (; e < end && *e >= '0' && *e <= '9'; ++e)
+				value = value < 10000 ? value * 10 + (*e - '0') : value;
+			if (e != digitsStart)
+			{
+				exponent += negativeExponent ? -value : value;
+				at = e;
+			}
+		}
+		// exact fast path: the mantissa and the power of ten are both exact floats, so one
+		// correctly rounded multiply/divide gives the same answer as strtof
+		static const float powers[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+		if (mantissa <= (1ull << 24) && exponent >= -10 && exponent <= 10)
+		{
+			float value = static_cast<float>(mantissa);
+			value = exponent < 0 ? value / powers[-exponent] : value * powers[exponent];
+			out = negative ? -value : value;
+			return true;
+		}
+		// rare long or huge numbers, fall back to the C library on a small stack copy
+		char text[64];
+		size_t length = static_cast<size_t>(at - start);
+		if (length >= sizeof(text))
+			return Fail("Number is too long");
+		std::memcpy(text, start, length);
+		text[length] = '\0';
+		out = std::strtof(text, nullptr);
+		return true;
+	}
+
+	bool ReadMatrix(float matrix[16])
+	{
+		if (!Expect('<', "Expected '<Matrix 4x4'") || !ExpectWord("Matrix", "Expected 'Matrix'") ||
+			!ExpectWord("4x4", "Expected '4x4'"))
+			return false;
+		for (int row = 0; row < 4; ++row)
+		{
+			if (!Expect('(', "Expected '(' to start a matrix row"))
+				return false;
+			for (int column = 0; column < 4; ++column)
+			{
+				if (column > 0 && !Expect(',', "Expected ',' between matrix values"))
+					return false;
+				if (!ReadFloat(matrix[row * 4 + column]))
+					return false;
+			}
+			if (!Expect(')', "Expected ')' to end a matrix row"))
+				return false;
+		}
+		return Expect('>', "Expected '>' to end the matrix");
+	}
+
+public:
+	LevelTextParser(const char* data, size_t size) : at(data), end(data + size), lineStart(data) {}
+
+	// Fills the next record, false at the end of the file or on an error (see GetError)
+	bool Next(LevelRecord& record)
+	{
+		if (error.message != nullptr)
+			return false;
+		for (;;)
+		{
+			SkipSpaces(true);
+			if (at >= end)
+				return false;
+			if (*at == '#')
+			{
+				SkipLine();
+				continue;
+			}
+			std::string_view keyword = ReadLine();
+			if (keyword == "MESH")
+				record.type = LevelRecordType::MESH;
+			else if (keyword == "LIGHT")
+				record.type = LevelRecordType::LIGHT;
+			else if (keyword == "CAMERA")
+				record.type = LevelRecordType::CAMERA;
+			else
+			{
+				--line; // report the keyword's line, not the one after it
+				at = keyword.data();
+				lineStart = keyword.data();
+				return Fail("Unknown record, expected MESH, LIGHT or CAMERA");
+			}
+			SkipSpaces(true);
+			record.name = ReadLine();
+			if (record.name.empty())
+				return Fail("Expected a name");
+			return ReadMatrix(record.matrix);
+		}
+	}
+
+	bool HasError() const { return error.message != nullptr; }
+	const LevelParseError& GetError() const { return error; }
+};
+
+#endif
@@ -0,0 +1,132 @@
+//levelStreamer
+// Loads the next level on a background thread while the current one keeps rendering.
+// The worker fills a fresh Level_Objects (file read, text/pack parse, .h2b import) which is
+// the staged upload data, the render thread then uploads it and swaps it in between frames.
+// Only one load is in flight at a time, further requests are refused until it is swapped.
+#ifndef _LEVELSTREAMER_H_
+#define _LEVELSTREAMER_H_
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include "load_object_oriented.h"
+
+// Where the time of the last level swap went, all in milliseconds
+struct LevelLoadTimings
+{
+	double loadMs; // worker thread: file read, parse & .h2b import
+	double waitMs; // load finished until the render thread picked it up
+	double uploadMs; // render thread: GPU buffers & pipelines
+	double unloadMs; // render thread: freeing the previous level
+	double totalMs; // request until the new level was swapped in
+	unsigned framesWhileLoading; // Update calls that found the load still running
+};
+
+enum class LevelStreamState { IDLE, LOADING, SWAPPED, FAILED };
+
+class LevelStreamer
+{
+public:
+	// Runs on the worker thread and fills an empty level, false if the level could not be loaded
+	typedef std::function<bool(Level_Objects&)> LoadFunction;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	std::unique_ptr<Level_Objects> current;
+	std::unique_ptr<Level_Objects> pending; // owned by the worker until finished is set
+	std::thread worker;
+	std::atomic<bool> finished{ false };
+	bool loading = false;
+	bool loadSucceeded = false; // written by the worker before finished
+	std::string pendingName;
+	Clock::time_point requestTime;
+	Clock::time_point finishTime; // written by the worker before finished
+	LevelLoadTimings inFlight = {};
+	LevelLoadTimings lastTimings = {};
+
+	static double Milliseconds(Clock::time_point from, Clock::time_point to)
+	{
+		return std::chrono::duration<double, std::milli>(to - from).count();
+	}
+
+public:
+	LevelStreamer() : current(new Level_Objects()) {}
+	LevelStreamer(const LevelStreamer&) = delete;
+	LevelStreamer& operator=(const LevelStreamer&) = delete;
+	~LevelStreamer()
+	{
+		if (worker.joinable())
+			worker.join();
+	}
+
+	// Starts loading in the background, false (and nothing happens) if a load is already in flight
+	bool Request(const char* levelName, LoadFunction load)
+	{
+		if (loading)
+			return false;
+		loading = true;
+		finished.store(false);
+		pendingName = levelName;
+		inFlight = LevelLoadTimings();
+		requestTime = Clock::now();
+		pending.reset(new Level_Objects());
+		Level_Objects* target = pending.get();
+		worker = std::thread([this, target, load]() {
+			Clock::time_point start = Clock::now();
+			loadSucceeded = load(*target);
+			finishTime = Clock::now();
+			inFlight.loadMs = Milliseconds(start, finishTime);
+			finished.store(true, std::memory_order_release);
+		});
+		return true;
+	}
+
+	// Call once per frame on the render thread, outside of drawing. Never waits for the worker,
+	// if the load is done the new level is uploaded, swapped in and the old one unloaded.
+	LevelStreamState Update(RenderBackend& backend, GW::MATH::GMATRIXF vMatrix, GW::MATH::GMATRIXF pMatrix)
+	{
+		if (!loading)
+			return LevelStreamState::IDLE;
+		if (!finished.load(std::memory_order_acquire))
+		{
+			++inFlight.framesWhileLoading;
+			return LevelStreamState::LOADING;
+		}
+		worker.join();
+		loading = false;
+		Clock::time_point start = Clock::now();
+		inFlight.waitMs = Milliseconds(finishTime, start);
+		if (!loadSucceeded)
+		{
+			pending->UnloadLevel();
+			pending.reset();
+			inFlight.totalMs = Milliseconds(requestTime, Clock::now());
+			lastTimings = inFlight;
+			return LevelStreamState::FAILED;
+		}
+		pending->UploadLevelToGPU(backend, vMatrix, pMatrix);
+		Clock::time_point uploaded = Clock::now();
+		inFlight.uploadMs = Milliseconds(start, uploaded);
+		current->UnloadLevel();
+		current.swap(pending);
+		pending.reset();
+		Clock::time_point swapped = Clock::now();
+		inFlight.unloadMs = Milliseconds(uploaded, swapped);
+		inFlight.totalMs = Milliseconds(requestTime, swapped);
+		lastTimings = inFlight;
+		return LevelStreamState::SWAPPED;
+	}
+
+	bool IsLoading() const { return loading; }
+	// name given to the last Request, the loaded level once Update returned SWAPPED
+	const std::string& GetRequestedName() const { return pendingName; }
+	const LevelLoadTimings& GetLastTimings() const { return lastTimings; }
+	// The level being drawn, only the render thread may touch it
+	Level_Objects& GetLevel() { return *current; }
+	const Level_Objects& GetLevel() const { return *current; }
+};
+
+#endif
@@ -3,24 +3,33 @@
 // Feel free to use this code as a base and tweak it for your needs.
 
 // This reads .h2b files which are optimized binary .obj+.mtl files
+#ifndef _LOAD_OBJECT_ORIENTED_H_
+#define _LOAD_OBJECT_ORIENTED_H_
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
 #include "h2bParser.h"
 #include "../gateware-main/gateware-main/Gateware.h"
-
-// class Model contains everyhting needed to draw a single 3D model
-struct SceneData 
-{
-	GW::MATH::GVECTORF _lightDirection, _lightColor, _sunAmbient, _cameraPos;
-	GW::MATH::GMATRIXF viewMatrix, projectionMatrix;
-};
-
-struct MeshData
-{
-	GW::MATH::GMATRIXF worldMatrix;
-	H2B::ATTRIBUTES material;
-
-};
-
-void PrintLabeledDebugString(const char* label, const char* toPrint)
+#include "renderBackend.h"
+#include "assetCache.h"
+#include "allocationCounter.h"
+#include "levelPack.h"
+#include "levelParser.h"
+#include "frameConstants.h"
+#include "bvh.h"
+#include "instanceStore.h"
+#include "renderQueue.h"
+#include "materialTable.h"
+#include "batchMath.h"
+#include "camera.h"
+#include "jobSystem.h"
+
+inline void PrintLabeledDebugString(const char* label, const char* toPrint)
 {
 	std::cout << label << toPrint << std::endl;
 #if defined WIN32 //OutputDebugStringA is a windows-only function 
@@ -29,430 +38,797 @@ void PrintLabeledDebugString(const char* label, const char* toPrint)
 #endif
 }
 
+// * NOTE: *
+// The level started out as a std::list of self contained Model objects, each one a heap node with
+// its own copy of everything it needed. It is now data oriented: the placed models are rows of an
+// InstanceStore, one contiguous array per attribute, and the shared .h2b data lives once in the
+// AssetCache. Loading, culling, per frame updates and drawing are each one linear pass over the
+// columns they need. Instances are still easy to add, move and remove at run time, but anything
+// that keeps one around holds an InstanceHandle, never an index or a pointer.
+
+// class Level_Objects owns every instance placed by the level and draws them
+class Level_Objects {
 
-class Model {
-public:
-	// Name of the Model in the GameLevel (useful for debugging)
-	std::string name;
-	// Loads and stores CPU model data from .h2b file
-	H2B::Parser cpuModel; // reads the .h2b format
-	// Shader variables needed by this model. 
-	GW::MATH::GMATRIXF world;// TODO: Add matrix/light/etc vars..
-	// TODO: API Rendering vars here (unique to this model)
-	// Vertex Buffer
-	// Index Buffer
-	// Pipeline/State Objects
-	// Uniform/ShaderVariable Buffer
-	// Vertex/Pixel Shaders
-	GW::GRAPHICS::GDirectX11Surface d3d;
-
-	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> meshBuffer;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> sceneBuffer;
-	
-	Microsoft::WRL::ComPtr<ID3D11VertexShader>	vertexShader;
-	Microsoft::WRL::ComPtr<ID3D11PixelShader>	pixelShader;
-
-	Microsoft::WRL::ComPtr<ID3D11InputLayout>	vertexFormat;
-
-	SceneData theScene;
-	MeshData theMesh;
-
-	void InitializeVertexBuffer(ID3D11Device* creator)
-	{
-		CreateVertexBuffer(creator, cpuModel.vertices.data(), sizeof(H2B::VERTEX) * cpuModel.vertices.size());
-	}
-
-	void InitializeIndexBuffer(ID3D11Device* creator)
-	{
-		CreateIndexBuffer(creator, cpuModel.indices.data(), sizeof(unsigned int) * cpuModel.indices.size());
-	}
-
-
-
-	void CreateConstBuffer(ID3D11Device* creator, const void* data, unsigned int sizeInBytes, Microsoft::WRL::ComPtr<ID3D11Buffer>& bufferType)
-	{
-		D3D11_SUBRESOURCE_DATA bData = { data, 0, 0 };
-		CD3D11_BUFFER_DESC bDesc(sizeInBytes, D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
-		creator->CreateBuffer(&bDesc, &bData, bufferType.GetAddressOf());
-	}
-
-	void CreateIndexBuffer(ID3D11Device* creator, const void* data, unsigned int sizeInBytes)
+	// every placed model, sorted by asset once uploaded so each asset is one run
+	InstanceStore instances;
+	// what gets drawn this frame, one packet per visible group & mesh sorted by state.
+	// Capacity is kept between frames so RenderLevel never allocates.
+	RenderQueue queue;
+	// runs of one asset in the instance store, each is drawn instanced. Built on upload.
+	struct InstanceGroup
 	{
-		D3D11_SUBRESOURCE_DATA iData = { data, 0, 0 };
-		CD3D11_BUFFER_DESC iDesc(sizeInBytes, D3D11_BIND_INDEX_BUFFER);
-		creator->CreateBuffer(&iDesc, &iData, indexBuffer.GetAddressOf());
-	}
+		unsigned first; // dense index into the instance store
+		unsigned count;
+	};
+	std::vector<InstanceGroup> instanceGroups;
+	// every instance is drawn with the same shaders & vertex layout
+	PipelineHandle pipeline = INVALID_PIPELINE;
+	// each distinct material of the level's assets once, on the GPU as one array
+	MaterialTable materialTable;
+	// vertices & indices of every asset in one buffer each
+	LevelGeometry geometry;
+	// upload the vertices as CompactVertex instead of H2B::VERTEX
+	bool compactVertices = false;
+	// SceneData once per frame, world matrices into a ring mapped once per frame
+	FrameConstants frame;
+	SceneData theScene = {};
+	// the instance boxes in SoA form, the hierarchy built over them and which instances
+	// (dense indices, ascending) survived this frame's frustum test
+	FrustumCuller culler;
+	BVH hierarchy;
+	std::vector<unsigned> visibleInstances;
+	std::vector<float> boundsScratch; // local boxes in SoA form for the batch transform, 6 arrays
+	// optional worker threads for loading, culling, LOD selection & draw recording, results are the
+	// same with or without. Linear culling splits the boxes into chunks of CULL_CHUNK, each with its
+	// own result list, queues of at least two DRAWS_PER_LIST are recorded into command lists.
+	JobSystem* jobs = nullptr;
+	static const unsigned CULL_CHUNK = 2048;
+	static const unsigned LOD_GRAIN = 256; // visible instances per LOD selection job
+	static const unsigned DRAWS_PER_LIST = 512;
+	std::vector<std::vector<unsigned>> cullChunks;
+	std::vector<std::unique_ptr<CommandList>> commandLists; // one per job thread
+	bool cullingEnabled = true;
+	bool useHierarchy = true;
+	// level of detail of each visible instance (parallel to visibleInstances), chosen from how big
+	// the LOD's error would look on screen
+	std::vector<unsigned char> visibleLods;
+	std::vector<float> visibleDepths; // view space depth of each visible instance's box center
+	bool lodEnabled = true;
+	float lodThreshold = 0.002f; // of the screen height, about two pixels at 1080p
+	unsigned lodInstanceCounts[MAX_LOD_COUNT] = {};
+	// set when instances were added/removed (re-sort & regroup, rebuild culling data) or moved
+	// (rebuild culling data), both are handled before the next frame is drawn or, for the culling
+	// data, the next Raycast/QueryBox
+	bool layoutDirty = false;
+	bool boundsDirty = false;
+	unsigned long long lastRenderAllocations = 0;
+	// one copy of each unique .h2b shared by all the instances above
+	AssetCache assets;
+	// where the level was uploaded, it draws there and frees its GPU data there on unload
+	RenderBackend* backend = nullptr;
+	// mapped .lvlpack the assets point into, kept open until they are uploaded
+	LevelPack pack;
+private:
+	GW::MATH::GVECTORF const lightColor = { 0.9f, 0.9f, 1.0f, 1.0f }; // Lights
+	GW::MATH::GVECTORF lightDirection = { 3.0f, -3.0, 2.0f, 1 };
+	GW::MATH::GVECTORF sunAmbient = { 255 * 0.25f, 255 * 0.25f, 255 * 0.35f, 1.0f }; 
 
-	void CreateVertexBuffer(ID3D11Device* creator, const void* data, unsigned int sizeInBytes)
-	{
-		D3D11_SUBRESOURCE_DATA bData = { data, 0, 0 };
-		CD3D11_BUFFER_DESC bDesc(sizeInBytes, D3D11_BIND_VERTEX_BUFFER);
-		creator->CreateBuffer(&bDesc, &bData, vertexBuffer.GetAddressOf());
-	}
+	// LIGHT and CAMERA records from the level file, kept as exported (Blender space)
+	GW::MATH::GMATRIXF levelLight = GW::MATH::GIdentityMatrixF;
+	GW::MATH::GMATRIXF levelCamera = GW::MATH::GIdentityMatrixF;
+	bool hasLevelLight = false;
+	bool hasLevelCamera = false;
 
-	void InitializePipeline(ID3D11Device* creator)
+	void InitializePipeline()
 	{
-		UINT compilerFlags = D3DCOMPILE_ENABLE_STRICTNESS;
-#if _DEBUG
-		compilerFlags |= D3DCOMPILE_DEBUG;
-#endif
-		Microsoft::WRL::ComPtr<ID3DBlob> vsBlob = CompileVertexShader(creator, compilerFlags);
-		Microsoft::WRL::ComPtr<ID3DBlob> psBlob = CompilePixelShader(creator, compilerFlags);
-
-		CreateVertexInputLayout(creator, vsBlob);
+		PipelineDesc desc;
+		desc.vertexShaderPath = geometry.GetEncoding() == VertexEncoding::FULL ?
+			"../Shaders/VertexShader.hlsl" : "../Shaders/VertexShaderCompact.hlsl";
+		desc.vertexEntryPoint = "main";
+		desc.vertexProfile = "vs_5_0";
+		desc.pixelShaderPath = "../Shaders/PixelShader.hlsl";
+		desc.pixelEntryPoint = "main";
+		desc.pixelProfile = "ps_5_0";
+		CreateVertexInputLayout(desc, geometry.GetEncoding());
+		pipeline = backend->CreatePipeline(desc);
 	}
 
-	Microsoft::WRL::ComPtr<ID3DBlob> CompileVertexShader(ID3D11Device* creator, UINT compilerFlags)
+	// Matches H2B::VERTEX or CompactVertex in slot 0, slot 1 is one ObjectData per instance
+	static void CreateVertexInputLayout(PipelineDesc& desc, VertexEncoding encoding)
 	{
-		std::string vertexShaderSource = ReadFileIntoString("../Shaders/VertexShader.hlsl");
-
-		Microsoft::WRL::ComPtr<ID3DBlob> vsBlob, errors;
-
-		HRESULT compilationResult =
-			D3DCompile(vertexShaderSource.c_str(), vertexShaderSource.length(),
-				nullptr, nullptr, nullptr, "main", "vs_4_0", compilerFlags, 0,
-				vsBlob.GetAddressOf(), errors.GetAddressOf());
-
-		if (SUCCEEDED(compilationResult))
+		static const VertexElement full[] = {
+			{ "POSITION", 0, VertexFormat::FLOAT3, 0, false },
+			{ "UVW", 0, VertexFormat::FLOAT3, 0, false },
+			{ "NORMAL", 0, VertexFormat::FLOAT3, 0, false },
+			{ "WORLD", 0, VertexFormat::FLOAT4, 1, true },
+			{ "WORLD", 1, VertexFormat::FLOAT4, 1, true },
+			{ "WORLD", 2, VertexFormat::FLOAT4, 1, true },
+			{ "WORLD", 3, VertexFormat::FLOAT4, 1, true },
+			{ "DECODE", 0, VertexFormat::FLOAT4, 1, true },
+			{ "DECODE", 1, VertexFormat::FLOAT4, 1, true },
+		};
+		static const VertexElement compact[] = {
+			{ "POSITION", 0, VertexFormat::UNORM16X4, 0, false },
+			{ "NORMAL", 0, VertexFormat::SNORM16X2, 0, false },
+			{ "UV", 0, VertexFormat::HALF2, 0, false },
+			{ "WORLD", 0, VertexFormat::FLOAT4, 1, true },
+			{ "WORLD", 1, VertexFormat::FLOAT4, 1, true },
+			{ "WORLD", 2, VertexFormat::FLOAT4, 1, true },
+			{ "WORLD", 3, VertexFormat::FLOAT4, 1, true },
+			{ "DECODE", 0, VertexFormat::FLOAT4, 1, true },
+			{ "DECODE", 1, VertexFormat::FLOAT4, 1, true },
+		};
+		static const VertexElement compactNoUV[] = {
+			{ "POSITION", 0, VertexFormat::UNORM16X4, 0, false },
+			{ "NORMAL", 0, VertexFormat::SNORM16X2, 0, false },
+			{ "WORLD", 0, VertexFormat::FLOAT4, 1, true },
+			{ "WORLD", 1, VertexFormat::FLOAT4, 1, true },
+			{ "WORLD", 2, VertexFormat::FLOAT4, 1, true },
+			{ "WORLD", 3, VertexFormat::FLOAT4, 1, true },
+			{ "DECODE", 0, VertexFormat::FLOAT4, 1, true },
+			{ "DECODE", 1, VertexFormat::FLOAT4, 1, true },
+		};
+		switch (encoding)
 		{
-			creator->CreateVertexShader(vsBlob->GetBufferPointer(),
-				vsBlob->GetBufferSize(), nullptr, vertexShader.GetAddressOf());
+		case VertexEncoding::COMPACT:
+			desc.elements = compact;
+			desc.elementCount = sizeof(compact) / sizeof(compact[0]);
+			break;
+		case VertexEncoding::COMPACT_NO_UV:
+			desc.elements = compactNoUV;
+			desc.elementCount = sizeof(compactNoUV) / sizeof(compactNoUV[0]);
+			break;
+		default:
+			desc.elements = full;
+			desc.elementCount = sizeof(full) / sizeof(full[0]);
+			break;
 		}
-		else
-		{
-			PrintLabeledDebugString("Vertex Shader Errors:\n", (char*)errors->GetBufferPointer());
-			abort();
-			return nullptr;
-		}
-
-		return vsBlob;
 	}
 
-	Microsoft::WRL::ComPtr<ID3DBlob> CompilePixelShader(ID3D11Device* creator, UINT compilerFlags)
+	// Coarsest LOD of the asset whose error, scaled by the instance and seen from the nearest point
+	// of its box, stays under lodThreshold: error * scale * lodFactor <= distance
+	unsigned SelectLod(const ModelAsset& shared, const GW::MATH::GMATRIXF& world, const BoundingBox& box,
+		float depth, float lodFactor) const
 	{
-		std::string pixelShaderSource = ReadFileIntoString("../Shaders/PixelShader.hlsl");
-
-		Microsoft::WRL::ComPtr<ID3DBlob> psBlob, errors;
-
-		HRESULT compilationResult =
-			D3DCompile(pixelShaderSource.c_str(), pixelShaderSource.length(),
-				nullptr, nullptr, nullptr, "main", "ps_4_0", compilerFlags, 0,
-				psBlob.GetAddressOf(), errors.GetAddressOf());
-
-		if (SUCCEEDED(compilationResult))
-		{
-			creator->CreatePixelShader(psBlob->GetBufferPointer(),
-				psBlob->GetBufferSize(), nullptr, pixelShader.GetAddressOf());
-		}
-		else
-		{
-			PrintLabeledDebugString("Pixel Shader Errors:\n", (char*)errors->GetBufferPointer());
-			abort();
-			return nullptr;
+		unsigned lod = shared.GetLodCount() - 1;
+		if (!lodEnabled || lod == 0)
+			return 0;
+		const float distance = depth - std::sqrt(box.extents[0] * box.extents[0] +
+			box.extents[1] * box.extents[1] + box.extents[2] * box.extents[2]);
+		if (distance <= 0)
+			return 0; // the camera is at or inside the instance
+		float scale = 0; // longest axis of the world matrix, squared
+		for (int r = 0; r < 3; ++r) {
+			const float* axis = world.data + r * 4;
+			const float length = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+			scale = length > scale ? length : scale;
 		}
-
-		return psBlob;
+		const float limit = distance / (std::sqrt(scale) * lodFactor);
+		while (lod > 0 && shared.GetLodError(lod) > limit)
+			--lod;
+		return lod;
 	}
 
-	void CreateVertexInputLayout(ID3D11Device* creator, Microsoft::WRL::ComPtr<ID3DBlob>& vsBlob)
+	// Places an instance of an acquired asset, the store takes over the asset reference
+	InstanceHandle AddInstance(std::string name, AssetHandle asset, const GW::MATH::GMATRIXF& world)
 	{
-		// TODO: Part 1E 
-		D3D11_INPUT_ELEMENT_DESC attributes[3];
-
-		attributes[0].SemanticName = "POSITION";
-		attributes[0].SemanticIndex = 0;
-		attributes[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-		attributes[0].InputSlot = 0;
-		attributes[0].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-		attributes[0].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-		attributes[0].InstanceDataStepRate = 0;
-
-		attributes[1].SemanticName = "UVW";
-		attributes[1].SemanticIndex = 0;
-		attributes[1].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-		attributes[1].InputSlot = 0;
-		attributes[1].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-		attributes[1].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-		attributes[1].InstanceDataStepRate = 0;
-
-		attributes[2].SemanticName = "NORMAL";
-		attributes[2].SemanticIndex = 0;
-		attributes[2].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-		attributes[2].InputSlot = 0;
-		attributes[2].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-		attributes[2].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-		attributes[2].InstanceDataStepRate = 0;
-
-		HRESULT h = creator->CreateInputLayout(attributes, ARRAYSIZE(attributes),
-			vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(),
-			vertexFormat.GetAddressOf());
-	}
-
-private:
-	struct PipelineHandles
-	{
-		ID3D11DeviceContext* context;
-		ID3D11RenderTargetView* targetView;
-		ID3D11DepthStencilView* depthStencil;
-	};
-
-	PipelineHandles GetCurrentPipelineHandles()
-	{
-		PipelineHandles retval;
-		d3d.GetImmediateContext((void**)&retval.context);
-		d3d.GetRenderTargetView((void**)&retval.targetView);
-		d3d.GetDepthStencilView((void**)&retval.depthStencil);
-		return retval;
-	}
-
-	void SetUpPipeline(PipelineHandles handles)
-	{
-		SetRenderTargets(handles);
-		SetVertexBuffers(handles);
-		SetShaders(handles);
-
-		handles.context->IASetInputLayout(vertexFormat.Get());
-		handles.context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	}
-
-	void SetRenderTargets(PipelineHandles handles)
-	{
-		ID3D11RenderTargetView* const views[] = { handles.targetView };
-		handles.context->OMSetRenderTargets(ARRAYSIZE(views), views, handles.depthStencil);
-	}
-
-	void SetVertexBuffers(PipelineHandles handles)
-	{
-		const UINT strides[] = { sizeof(H2B::VERTEX) }; 
-		const UINT offsets[] = { 0 };
-		ID3D11Buffer* const buffs[] = { vertexBuffer.Get() };
-		handles.context->IASetVertexBuffers(0, ARRAYSIZE(buffs), buffs, strides, offsets);
-	}
-
-	void SetShaders(PipelineHandles handles)
-	{
-		handles.context->VSSetShader(vertexShader.Get(), nullptr, 0);
-		handles.context->PSSetShader(pixelShader.Get(), nullptr, 0);
-	}
-
-	void ReleasePipelineHandles(PipelineHandles toRelease)
-	{
-		toRelease.depthStencil->Release();
-		toRelease.targetView->Release();
-		toRelease.context->Release();
-	}
-	//End Integrated Methods ///////////////////////////////////////
-
-public:
-	inline void SetName(std::string modelName) {
-		name = modelName;
-	}
-	inline void SetWorldMatrix(GW::MATH::GMATRIXF worldMatrix) {
-		world = worldMatrix;
-	}
-	bool LoadModelDataFromDisk(const char* h2bPath) {
-		// if this succeeds "cpuModel" should now contain all the model's info
-		return cpuModel.Parse(h2bPath);
-	}
-	bool UploadModelData2GPU(GW::GRAPHICS::GDirectX11Surface _d3d, GW::MATH::GMATRIXF worldM, GW::MATH::GMATRIXF vMatrix,
-		GW::MATH::GMATRIXF pMatrix, GW::MATH::GVECTORF lightDir, GW::MATH::GVECTORF lightColor) {
-		// TODO: Use chosen API to upload this model's graphics data to GPU
-
-		//Takes in many variables to initialize theScene and theMesh, as well as initialize the Vertex,
-		// Index, and Constant Buffers. Methods cascade into others to complete the initialization process and
-		//  uploads to the GPU.
-		d3d = _d3d;
-
-		ID3D11Device* creator;
-		_d3d.GetDevice((void**)&creator);
-
-		InitializeVertexBuffer(creator);
-		InitializeIndexBuffer(creator);
-		
-		theScene.projectionMatrix = pMatrix;
-		theScene.viewMatrix = vMatrix;
-		theScene._lightDirection = lightDir;
-		theScene._lightColor = lightColor;
-		theMesh.worldMatrix = worldM;
-		CreateConstBuffer(creator, &theScene, sizeof(SceneData), sceneBuffer);
-		CreateConstBuffer(creator, &theMesh, sizeof(MeshData), meshBuffer);
-		InitializePipeline(creator);
-
-		// free temporary handle
-		creator->Release();
-		return true;
-	}
-
-	bool DrawModel(GW::MATH::GMATRIXF view, Model e, GW::MATH::GMATRIXF currView) {
-		// TODO: Use chosen API to setup the pipeline for this model and draw it
-
-		PipelineHandles curHandles = GetCurrentPipelineHandles();
-		SetUpPipeline(curHandles);
-		
-
-		ID3D11Buffer* pBuffs[] = { sceneBuffer.Get(), meshBuffer.Get() };
-		curHandles.context->VSSetConstantBuffers(0, ARRAYSIZE(pBuffs), pBuffs);
-		curHandles.context->PSSetConstantBuffers(0, ARRAYSIZE(pBuffs), pBuffs);
-		curHandles.context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-		
-		D3D11_MAPPED_SUBRESOURCE subRes{};
-		curHandles.context->Map(meshBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &subRes);
-		theMesh.worldMatrix = e.world;
-		memcpy(subRes.pData, &theMesh, sizeof(theMesh));
-		curHandles.context->Unmap(meshBuffer.Get(), 0);
-
-		for (int i = 0; i < cpuModel.meshCount; i++)
-		{
-			curHandles.context->Map(meshBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &subRes);
-			theMesh.material = cpuModel.materials[i].attrib;
-			memcpy(subRes.pData, &theMesh, sizeof(theMesh));
-			curHandles.context->Unmap(meshBuffer.Get(), 0);
-
-			curHandles.context->Map(sceneBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &subRes);
-			theScene.viewMatrix = view;
-			theScene._cameraPos = currView.row4;
-			memcpy(subRes.pData, &theScene, sizeof(theScene));
-			curHandles.context->Unmap(sceneBuffer.Get(), 0);
-			curHandles.context->DrawIndexed(cpuModel.meshes[i].drawInfo.indexCount
-				,cpuModel.meshes[i].drawInfo.indexOffset, 0);
-
-		}
-		ReleasePipelineHandles(curHandles);
-		return true;
+		layoutDirty = boundsDirty = true;
+		ModelAsset& shared = assets.Get(asset);
+		if (shared.materialList == INVALID_MATERIAL_LIST) // first instance of this asset
+			shared.materialList = materialTable.AddMeshList(shared);
+		return instances.Add(std::move(name), asset, shared.materialList, world, TransformBounds(shared.bounds, world.data));
 	}
-	bool FreeResources(/*specific API device for unloading*/) { 
 
-		// TODO: Use chosen API to free all GPU resources used by this model
-	}
-};
-
-// * NOTE: *
-// Unlike the DOP version, this class was not designed to reuse data in anyway or process it efficiently.
-// You can find ways to make it more efficient by sharing pointers to resources and sorting the models.
-// However, this is tricky to implement and can be prone to errors. (OOP data isolation becomes an issue)
-// A huge positive is that everything you want to draw is totally self contained and easy to see/find.
-// This means updating matricies, adding new objects & removing old ones from the world is a breeze. 
-// You can even easily load brand new models from disk at run-time without much trouble.
-// The last major downside is trying to do things like dynamic lights, shadows and sorted transparency. 
-// Effects like these expect your model set to be processed/traversed in unique ways which can be awkward.   
-
-// class Level_Objects is simply a list of all the Models currently used by the level
-class Level_Objects {
-
-	// store all our models
-	std::list<Model> allObjectsInLevel;
-private:
-	GW::MATH::GVECTORF const lightColor = { 0.9f, 0.9f, 1.0f, 1.0f }; // Lights
-	GW::MATH::GVECTORF lightDirection = { 3.0f, -3.0, 2.0f, 1 };
-	GW::MATH::GVECTORF sunAmbient = { 255 * 0.25f, 255 * 0.25f, 255 * 0.35f, 1.0f }; 
-
-	// TODO: This could be a good spot for any global data like cameras or lights
 public:
 
-	// Imports the default level txt format and creates a Model from each .h2b
+	// Imports the default level txt format and places an instance of each .h2b
 	bool LoadLevel(const char* gameLevelPath,
 		const char* h2bFolderPath,
 		GW::SYSTEM::GLog log) {
 
 		// What this does:
 		// Parse GameLevel.txt 
+		// With a job system, import every unique .h2b it names at once
 		// For each model found in the file...
-			// Create a new Model class on the stack.
-				// Read matrix transform and add to this model.
-				// Load all CPU rendering data for this model from .h2b
-			// Move the newly found Model to our list of total models for the level 
+			// Read its name & matrix transform.
+			// Load all CPU rendering data for it from .h2b (once per unique .h2b, unless imported above)
+			// Add a row for it to the instance store
 
 		log.LogCategorized("EVENT", "LOADING GAME LEVEL [OBJECT ORIENTED]");
 		log.LogCategorized("MESSAGE", "Begin Reading Game Level Text File.");
 
 		UnloadLevel();// clear previous level data if there is any
-		GW::SYSTEM::GFile file;
-		file.Create();
-		if (-file.OpenTextRead(gameLevelPath)) {
+		assets.ResetCounters(); // hit/miss counts describe this level only
+		H2B::MappedFile file;
+		if (!file.Open(gameLevelPath)) {
 			log.LogCategorized(
 				"ERROR", (std::string("Game level not found: ") + gameLevelPath).c_str());
 			return false;
 		}
-		char linebuffer[1024];
-		while (+file.ReadLine(linebuffer, 1024, '\n'))
-		{
-			// having to have this is a bug, need to have Read/ReadLine return failure at EOF
-			if (linebuffer[0] == '\0')
-				break;
-			if (std::strcmp(linebuffer, "MESH") == 0)
-			{
-				Model newModel;
-				file.ReadLine(linebuffer, 1024, '\n');
-				log.LogCategorized("INFO", (std::string("Model Detected: ") + linebuffer).c_str());
-				// create the model file name from this (strip the .001)
-				newModel.SetName(linebuffer);
-				std::string modelFile = linebuffer;
-				modelFile = modelFile.substr(0, modelFile.find_last_of("."));
-				modelFile += ".h2b";
-
-				// now read the transform data as we will need that regardless
-				GW::MATH::GMATRIXF transform;
-				for (int i = 0; i < 4; ++i) {
-					file.ReadLine(linebuffer, 1024, '\n');
-					// read floats
-					std::sscanf(linebuffer + 13, "%f, %f, %f, %f",
-						&transform.data[0 + i * 4], &transform.data[1 + i * 4],
-						&transform.data[2 + i * 4], &transform.data[3 + i * 4]);
-				}
-				std::string loc = "Location: X ";
-				loc += std::to_string(transform.row4.x) + " Y " +
-					std::to_string(transform.row4.y) + " Z " + std::to_string(transform.row4.z);
-				log.LogCategorized("INFO", loc.c_str());
-
-				// Add new model to list of all Models
-				log.LogCategorized("MESSAGE", "Begin Importing .H2B File Data.");
-				modelFile = std::string(h2bFolderPath) + "/" + modelFile;
-				newModel.SetWorldMatrix(transform);
-				// If we find and load it add it to the level
-				if (newModel.LoadModelDataFromDisk(modelFile.c_str())) {
-					// add to our level objects, we use std::move since Model::cpuModel is not copy safe.
-					allObjectsInLevel.push_back(std::move(newModel));
-					log.LogCategorized("INFO", (std::string("H2B Imported: ") + modelFile).c_str());
-				}
-				else {
-					// notify user that a model file is missing but continue loading
-					log.LogCategorized("ERROR",
-						(std::string("H2B Not Found: ") + modelFile).c_str());
-					log.LogCategorized("WARNING", "Loading will continue but model(s) are missing.");
+		auto parseStart = std::chrono::steady_clock::now();
+		unsigned recordCount = 0;
+		LevelTextParser parser(file.Data(), file.Size());
+		LevelRecord record; // its name points into the mapped file
+		if (jobs != nullptr) {
+			// a first pass over the mapped text for the models, so they import at once. The parser
+			// does not allocate, so the records are read twice instead of kept in a vector.
+			LevelTextParser scan(file.Data(), file.Size());
+			std::vector<AssetRequest> requests;
+			while (scan.Next(record))
+				if (record.type == LevelRecordType::MESH) {
+					std::string assetName = AssetCache::StripModelName(std::string(record.name));
+					std::string h2bPath = std::string(h2bFolderPath) + "/" + assetName + ".h2b";
+					requests.push_back({ std::move(assetName), std::move(h2bPath) });
 				}
-				log.LogCategorized("MESSAGE", "Importing of .H2B File Data Complete.");
+			assets.Preload(requests, *jobs); // Acquire below takes these in level order, the log reads the same
+		}
+		std::string modelName;
+		while (parser.Next(record))
+		{
+			++recordCount;
+			if (record.type == LevelRecordType::LIGHT) {
+				std::memcpy(levelLight.data, record.matrix, sizeof(record.matrix));
+				hasLevelLight = true;
+				continue;
+			}
+			if (record.type == LevelRecordType::CAMERA) {
+				std::memcpy(levelCamera.data, record.matrix, sizeof(record.matrix));
+				hasLevelCamera = true;
+				continue;
 			}
+			modelName.assign(record.name.data(), record.name.size());
+			log.LogCategorized("INFO", (std::string("Model Detected: ") + modelName).c_str());
+			// create the model file name from this (strip the .001)
+			std::string modelFile = AssetCache::StripModelName(modelName);
+			modelFile += ".h2b";
+
+			// now read the transform data as we will need that regardless
+			GW::MATH::GMATRIXF transform;
+			std::memcpy(transform.data, record.matrix, sizeof(record.matrix));
+			std::string loc = "Location: X ";
+			loc += std::to_string(transform.row4.x) + " Y " +
+				std::to_string(transform.row4.y) + " Z " + std::to_string(transform.row4.z);
+			log.LogCategorized("INFO", loc.c_str());
+
+			// Add new model to the instance store
+			log.LogCategorized("MESSAGE", "Begin Importing .H2B File Data.");
+			modelFile = std::string(h2bFolderPath) + "/" + modelFile;
+			// parsed now or by an earlier instance of the same .h2b
+			AssetHandle asset = assets.Acquire(AssetCache::StripModelName(modelName), modelFile.c_str());
+			// If we find and load it add it to the level
+			if (asset != INVALID_ASSET) {
+				// add to our level objects, the .h2b data itself stays in the AssetCache.
+				AddInstance(modelName, asset, transform);
+				log.LogCategorized("INFO", (std::string("H2B Imported: ") + modelFile).c_str());
+			}
+			else {
+				// notify user that a model file is missing but continue loading
+				log.LogCategorized("ERROR",
+					(std::string("H2B Not Found: ") + modelFile).c_str());
+				log.LogCategorized("WARNING", "Loading will continue but model(s) are missing.");
+			}
+			log.LogCategorized("MESSAGE", "Importing of .H2B File Data Complete.");
+		}
+		assets.DiscardPreloads();
+		if (parser.HasError()) {
+			// whatever was read before the bad record stays loaded, same as a missing .h2b
+			const LevelParseError& error = parser.GetError();
+			log.LogCategorized("ERROR", (std::string(gameLevelPath) + "(" + std::to_string(error.line) + "," +
+				std::to_string(error.column) + "): " + error.message).c_str());
+			log.LogCategorized("WARNING", "Loading stopped at the malformed record, the rest of the level is missing.");
 		}
+		double parseMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - parseStart).count();
+		log.LogCategorized("INFO", ("Level Records: " + std::to_string(recordCount) +
+			" Load Time (ms): " + std::to_string(parseMs)).c_str());
 		log.LogCategorized("MESSAGE", "Game Level File Reading Complete.");
+		std::string cacheInfo = "Unique Assets: " + std::to_string(assets.GetAssetCount()) +
+			" Cache Hits: " + std::to_string(assets.GetHitCount()) + " Cache Misses: " + std::to_string(assets.GetMissCount());
+		log.LogCategorized("INFO", cacheInfo.c_str());
 		// level loaded into CPU ram
 		log.LogCategorized("EVENT", "GAME LEVEL WAS LOADED TO CPU [OBJECT ORIENTED]");
 		return true;
 	}
+	// Loads a .lvlpack made by LevelPacker, one file mapping instead of a text parse plus one open per .h2b
+	bool LoadLevelPack(const char* packPath, GW::SYSTEM::GLog log) {
+		log.LogCategorized("EVENT", "LOADING GAME LEVEL PACK [OBJECT ORIENTED]");
+
+		UnloadLevel();// clear previous level data if there is any
+		assets.ResetCounters();
+		if (!pack.Open(packPath)) {
+			log.LogCategorized("ERROR", (std::string("Game level pack not found or invalid: ") + packPath).c_str());
+			return false;
+		}
+		// every pack asset is unique, so each one is a single cache miss and the instances are hits
+		std::vector<AssetHandle> handles;
+		std::vector<AssetMesh> meshes;
+		std::vector<MeshLod> lods;
+		for (const LevelPack::AssetView& a : pack.GetAssets()) {
+			meshes.clear();
+			for (const LevelPackFormat::PackMesh& m : a.meshes)
+				meshes.push_back({ { m.indexCount, m.indexOffset }, m.materialIndex });
+			lods.resize(a.lods.size());
+			for (unsigned l = 0; l < a.lods.size(); ++l) {
+				lods[l].error = a.lods[l].error;
+				lods[l].triangleCount = a.lods[l].triangleCount;
+				lods[l].meshes.clear();
+				for (unsigned m = 0; m < a.meshes.size(); ++m) {
+					const LevelPackFormat::PackMesh& lodMesh = a.lodMeshes[l * a.meshes.size() + m];
+					lods[l].meshes.push_back({ lodMesh.indexCount, lodMesh.indexOffset });
+				}
+			}
+			handles.push_back(assets.AcquireFromMemory(std::string(a.name), a.vertices, a.indices,
+				meshes.data(), static_cast<unsigned>(meshes.size()), a.materials.data, a.materials.size(),
+				lods.data(), static_cast<unsigned>(lods.size())));
+		}
+		for (const LevelPack::InstanceView& i : pack.GetInstances()) {
+			GW::MATH::GMATRIXF transform;
+			std::memcpy(transform.data, i.world, sizeof(transform.data));
+			AddInstance(std::string(i.name), assets.Retain(handles[i.assetIndex]), transform);
+		}
+		// drop the load references, the instances hold their own now
+		for (AssetHandle h : handles)
+			assets.Release(h);
+
+		std::string info = "Pack Instances: " + std::to_string(instances.Size()) +
+			" Unique Assets: " + std::to_string(assets.GetAssetCount());
+		log.LogCategorized("INFO", info.c_str());
+		log.LogCategorized("EVENT", "GAME LEVEL PACK WAS LOADED TO CPU [OBJECT ORIENTED]");
+		return true;
+	}
+	// Describes the loaded (not yet uploaded) level for LevelPackWriter
+	bool BuildPackSource(LevelPackSource& source) const {
+		source.assets.clear();
+		source.instances.clear();
+		std::unordered_map<AssetHandle, unsigned> packIndex;
+		const AssetHandle* assetIds = instances.GetAssets();
+		const GW::MATH::GMATRIXF* worlds = instances.GetWorlds();
+		for (unsigned e = 0; e < instances.Size(); ++e) {
+			const ModelAsset& shared = assets.Get(assetIds[e]);
+			if (shared.IsUploaded())
+				return false; // the vertex & index data is gone once it is on the GPU
+			auto found = packIndex.find(assetIds[e]);
+			if (found == packIndex.end()) {
+				LevelPackSource::Asset a;
+				a.name = shared.name;
+				a.vertices = shared.vertices;
+				a.indices = shared.indices;
+				for (const AssetMesh& m : shared.meshes)
+					a.meshes.push_back({ m.drawInfo.indexCount, m.drawInfo.indexOffset, m.materialIndex });
+				a.materials = shared.materials;
+				for (const MeshLod& lod : shared.lods) {
+					LevelPackSource::Asset::Lod packLod;
+					packLod.info = { lod.error, lod.triangleCount };
+					for (unsigned m = 0; m < lod.meshes.size(); ++m)
+						packLod.meshes.push_back({ lod.meshes[m].indexCount, lod.meshes[m].indexOffset, shared.meshes[m].materialIndex });
+					a.lods.push_back(std::move(packLod));
+				}
+				found = packIndex.emplace(assetIds[e], static_cast<unsigned>(source.assets.size())).first;
+				source.assets.push_back(std::move(a));
+			}
+			LevelPackSource::Instance instance;
+			instance.name = instances.GetName(e);
+			std::memcpy(instance.world, worlds[e].data, sizeof(instance.world));
+			instance.assetIndex = found->second;
+			source.instances.push_back(std::move(instance));
+		}
+		return true;
+	}
+	// Every placed model, in level file order until the level is uploaded, then grouped by asset
+	const InstanceStore& GetInstances() const {
+		return instances;
+	}
 	// Upload the CPU level to GPU
-	void UploadLevelToGPU(GW::GRAPHICS::GDirectX11Surface _d3d, GW::MATH::GMATRIXF worldM, GW::MATH::GMATRIXF vMatrix,
-		GW::MATH::GMATRIXF pMatrix) {
-		// iterate over each model and tell it to draw itself
-		for (auto& e : allObjectsInLevel) {
-			e.UploadModelData2GPU(_d3d, worldM, vMatrix, pMatrix, lightDirection, lightColor);
+	void UploadLevelToGPU(RenderBackend& _backend, GW::MATH::GMATRIXF vMatrix, GW::MATH::GMATRIXF pMatrix) {
+		backend = &_backend;
+		// one vertex & index buffer sized for every asset placed at least once
+		std::vector<AssetHandle> used(instances.GetAssets(), instances.GetAssets() + instances.Size());
+		std::sort(used.begin(), used.end());
+		used.erase(std::unique(used.begin(), used.end()), used.end());
+		unsigned vertexCount = 0, indexCount = 0;
+		bool anyUVs = false, shortIndices = true;
+		for (AssetHandle a : used) {
+			const ModelAsset& shared = assets.Get(a);
+			vertexCount += static_cast<unsigned>(shared.vertices.size());
+			indexCount += static_cast<unsigned>(shared.indices.size());
+			anyUVs = anyUVs || (compactVertices && HasUVs(shared.vertices.data, shared.vertices.count));
+			shortIndices = shortIndices && shared.vertices.size() <= 65536; // indices are per asset
 		}
+		const VertexEncoding encoding = !compactVertices ? VertexEncoding::FULL :
+			anyUVs ? VertexEncoding::COMPACT : VertexEncoding::COMPACT_NO_UV;
+		geometry.Create(_backend, vertexCount, indexCount, encoding,
+			shortIndices ? IndexFormat::UINT16 : IndexFormat::UINT32);
+		for (AssetHandle a : used) {
+			assets.Get(a).UploadToGPU(geometry);
+		}
+		InitializePipeline();
+		materialTable.Upload(_backend);
+		theScene.projectionMatrix = pMatrix;
+		theScene.viewMatrix = vMatrix;
+		theScene._lightDirection = lightDirection;
+		theScene._lightColor = lightColor;
+		pack.Close(); // the backend has everything a pack asset pointed at
+		BuildInstanceGroups();
 	}
 	// Draws all objects in the level
-	void RenderLevel(GW::GRAPHICS::GDirectX11Surface _d3d, GW::MATH::GMATRIXF view, GW::MATH::GMATRIXF currView) {
-		// iterate over each model and tell it to draw itself
-		for (auto& e : allObjectsInLevel) {
-			e.DrawModel(view, e, currView);
+	void RenderLevel(const GW::MATH::GMATRIXF& view, const GW::MATH::GMATRIXF& currView) {
+		RenderLevel(MakeCameraFrame(view, currView, theScene.projectionMatrix));
+	}
+	// Same with the view, frustum & position a Camera already made, its viewProj should use the
+	// projection the level was uploaded with
+	void RenderLevel(const CameraFrame& camera) {
+		const GW::MATH::GMATRIXF& view = camera.view;
+		if (backend == nullptr)
+			return; // nothing uploaded yet
+		// edits since the last frame, these may allocate and are not counted below
+		if (layoutDirty)
+			BuildInstanceGroups();
+		else if (boundsDirty)
+			RebuildCulling();
+		AllocationCounter::Scope allocations;
+		// the only two writes of the frame: scene data, then every visible model's world matrix
+		theScene.viewMatrix = view;
+		theScene._cameraPos = camera.position;
+		frame.SetScene(theScene);
+		CullInstances(camera.frustum);
+		// each group's visible instances stay together, sorted by LOD. Every mesh of every LOD a
+		// group still uses is one instanced draw keyed by its state and the group's nearest instance.
+		queue.Clear();
+		const GW::MATH::GMATRIXF* instanceWorlds = instances.GetWorlds();
+		const float lodFactor = theScene.projectionMatrix.data[5] * 0.5f / lodThreshold;
+		for (unsigned& count : lodInstanceCounts)
+			count = 0;
+		visibleLods.resize(visibleInstances.size());
+		visibleDepths.resize(visibleInstances.size());
+		SelectVisibleLods(view, lodFactor);
+		if (ObjectData* objects = frame.BeginObjects(static_cast<unsigned>(visibleInstances.size()))) {
+			unsigned v = 0;
+			for (const InstanceGroup& group : instanceGroups) {
+				const unsigned start = v;
+				const AssetHandle asset = instances.GetAssets()[group.first];
+				const ModelAsset& shared = assets.Get(asset);
+				const GeometryRange& range = geometry.Get(shared.geometry);
+				float nearest = FLT_MAX;
+				unsigned lodCounts[MAX_LOD_COUNT] = {};
+				for (; v < visibleInstances.size() && visibleInstances[v] < group.first + group.count; ++v) {
+					nearest = visibleDepths[v] < nearest ? visibleDepths[v] : nearest;
+					++lodCounts[visibleLods[v]];
+				}
+				if (v == start)
+					continue; // whole group culled
+				// one run of world matrices per LOD
+				unsigned lodFirst[MAX_LOD_COUNT], next[MAX_LOD_COUNT];
+				unsigned first = start;
+				for (unsigned l = 0; l < MAX_LOD_COUNT; ++l) {
+					lodFirst[l] = next[l] = first;
+					first += lodCounts[l];
+					lodInstanceCounts[l] += lodCounts[l];
+				}
+				for (unsigned k = start; k < v; ++k) {
+					const unsigned slot = next[visibleLods[k]]++;
+					objects[slot].world = instanceWorlds[visibleInstances[k]];
+					objects[slot].decode = range.decode;
+				}
+				const unsigned materialList = instances.GetMaterials()[group.first];
+				for (unsigned l = 0; l < shared.GetLodCount(); ++l) {
+					if (lodCounts[l] == 0)
+						continue;
+					for (unsigned m = 0; m < shared.meshes.size(); ++m) {
+						const H2B::BATCH& draw = shared.GetMeshDraw(l, m);
+						if (draw.indexCount == 0)
+							continue; // simplified away
+						const unsigned material = materialTable.GetMeshMaterial(materialList, m);
+						DrawPacket packet;
+						packet.pipeline = pipeline;
+						packet.vertexBuffer = geometry.GetVertexBuffer();
+						packet.vertexStride = geometry.GetVertexStride();
+						packet.indexBuffer = geometry.GetIndexBuffer();
+						packet.indexFormat = geometry.GetIndexFormat();
+						packet.material = materialTable.GetIndexBuffer(material);
+						packet.indexCount = draw.indexCount;
+						packet.firstIndex = range.firstIndex + draw.indexOffset;
+						packet.baseVertex = static_cast<int>(range.baseVertex);
+						packet.instanceCount = lodCounts[l];
+						packet.firstInstance = frame.GetFirstObject() + lodFirst[l];
+						queue.Push(RenderQueue::MakeKey(RenderPass::OPAQUE, pipeline, asset, material, nearest), packet);
+					}
+				}
+			}
+			frame.EndObjects();
+		}
+		queue.Sort();
+		const unsigned listCount = std::min(static_cast<unsigned>(commandLists.size()),
+			static_cast<unsigned>(queue.Size() / DRAWS_PER_LIST));
+		if (jobs != nullptr && listCount > 1)
+			queue.SubmitParallel(*backend, *jobs, commandLists.data(), listCount, frame.GetSceneBuffer(),
+				frame.GetObjectBuffer(), materialTable.GetTableBuffer());
+		else
+			queue.Submit(*backend, frame.GetSceneBuffer(), frame.GetObjectBuffer(), materialTable.GetTableBuffer());
+		lastRenderAllocations = allocations.Allocations();
+	}
+	// Depth & LOD of every visible instance, on the job system when there are enough of them
+	void SelectVisibleLods(const GW::MATH::GMATRIXF& view, float lodFactor) {
+		const GW::MATH::GMATRIXF* worlds = instances.GetWorlds();
+		const BoundingBox* bounds = instances.GetBounds();
+		const AssetHandle* assetIds = instances.GetAssets();
+		auto select = [&](unsigned begin, unsigned end) {
+			for (unsigned v = begin; v < end; ++v) {
+				const unsigned i = visibleInstances[v];
+				visibleDepths[v] = bounds[i].center[0] * view.data[2] + bounds[i].center[1] * view.data[6] +
+					bounds[i].center[2] * view.data[10] + view.data[14];
+				visibleLods[v] = static_cast<unsigned char>(SelectLod(assets.Get(assetIds[i]), worlds[i], bounds[i],
+					visibleDepths[v], lodFactor));
+			}
+		};
+		const unsigned count = static_cast<unsigned>(visibleInstances.size());
+		if (jobs != nullptr)
+			jobs->ParallelFor(count, LOD_GRAIN, select);
+		else
+			select(0, count);
+	}
+	// Fills visibleInstances (dense indices into the instance store, ascending) for this frustum,
+	// hidden instances are never visible
+	void CullInstances(const Frustum& frustum) {
+		visibleInstances.clear();
+		const unsigned* flags = instances.GetFlags();
+		if (!cullingEnabled) {
+			for (unsigned i = 0; i < instances.Size(); ++i) {
+				if ((flags[i] & INSTANCE_HIDDEN) == 0)
+					visibleInstances.push_back(i);
+			}
+			return;
+		}
+		if (useHierarchy) {
+			hierarchy.QueryFrustum(frustum, visibleInstances);
+			std::sort(visibleInstances.begin(), visibleInstances.end()); // groups are walked in order
+		}
+		else if (jobs != nullptr && cullChunks.size() > 1) {
+			// every chunk culls into its own list, joined in chunk order they stay ascending
+			jobs->ParallelFor(static_cast<unsigned>(cullChunks.size()), 1, [&](unsigned begin, unsigned end) {
+				for (unsigned c = begin; c < end; ++c) {
+					cullChunks[c].clear();
+					culler.Cull(frustum, c * CULL_CHUNK, (c + 1) * CULL_CHUNK, cullChunks[c]);
+				}
+			});
+			for (const std::vector<unsigned>& chunk : cullChunks)
+				visibleInstances.insert(visibleInstances.end(), chunk.begin(), chunk.end());
+		}
+		else
+			culler.Cull(frustum, visibleInstances);
+		visibleInstances.erase(std::remove_if(visibleInstances.begin(), visibleInstances.end(),
+			[flags](unsigned i) { return (flags[i] & INSTANCE_HIDDEN) != 0; }), visibleInstances.end());
+	}
+	// Recomputes every instance's world box from its world matrix and rebuilds the culling data
+	void RefreshInstanceBounds() {
+		const GW::MATH::GMATRIXF* worlds = instances.GetWorlds();
+		const AssetHandle* assetIds = instances.GetAssets();
+		BoundingBox* bounds = instances.GetBounds();
+		const unsigned count = static_cast<unsigned>(instances.Size());
+		boundsScratch.resize(count * 6);
+		BoxArrays boxes;
+		for (int a = 0; a < 3; ++a) {
+			boxes.center[a] = boundsScratch.data() + count * a;
+			boxes.extents[a] = boundsScratch.data() + count * (a + 3);
+		}
+		for (unsigned i = 0; i < count; ++i) {
+			const BoundingBox& local = assets.Get(assetIds[i]).bounds;
+			for (int a = 0; a < 3; ++a) {
+				boxes.center[a][i] = local.center[a];
+				boxes.extents[a][i] = local.extents[a];
+			}
 		}
+		// in place, same results as TransformBounds one instance at a time
+		static_assert(sizeof(GW::MATH::GMATRIXF) == 16 * sizeof(float), "worlds are read as one float array");
+		GetBatchMath().TransformBounds(boxes, count ? worlds[0].data : nullptr, count, boxes);
+		for (unsigned i = 0; i < count; ++i) {
+			for (int a = 0; a < 3; ++a) {
+				bounds[i].center[a] = boxes.center[a][i];
+				bounds[i].extents[a] = boxes.extents[a][i];
+			}
+		}
+		RebuildCulling();
+	}
+	// Copies the store's boxes into the culler and builds the BVH over them
+	void RebuildCulling() {
+		culler.Clear();
+		const BoundingBox* bounds = instances.GetBounds();
+		for (unsigned i = 0; i < instances.Size(); ++i) {
+			culler.Add(bounds[i]);
+		}
+		hierarchy.Build(bounds, static_cast<unsigned>(instances.Size()));
+		// room for a chunk that is all visible, so culling on the jobs never allocates
+		cullChunks.resize((instances.Size() + CULL_CHUNK - 1) / CULL_CHUNK);
+		for (std::vector<unsigned>& chunk : cullChunks)
+			chunk.reserve(CULL_CHUNK);
+		boundsDirty = false;
+	}
+	// Run time edits, they take effect when the next frame is drawn
+	void MoveInstance(InstanceHandle handle, const GW::MATH::GMATRIXF& world) {
+		if (!instances.IsValid(handle))
+			return;
+		const unsigned i = instances.IndexOf(handle);
+		instances.SetWorld(i, world, TransformBounds(assets.Get(instances.GetAssets()[i]).bounds, world.data));
+		boundsDirty = true;
+	}
+	void SetInstanceHidden(InstanceHandle handle, bool hidden) {
+		if (!instances.IsValid(handle))
+			return;
+		const unsigned i = instances.IndexOf(handle);
+		const unsigned flags = instances.GetFlags()[i];
+		instances.SetFlags(i, hidden ? flags | INSTANCE_HIDDEN : flags & ~INSTANCE_HIDDEN);
+	}
+	// Places another instance of a .h2b, loading and uploading it if this level does not use it yet.
+	// INVALID_INSTANCE if it cannot be loaded, or has over 65536 vertices and the level was
+	// uploaded with 16 bit indices.
+	InstanceHandle AddInstance(const std::string& modelName, const char* h2bPath, const GW::MATH::GMATRIXF& world) {
+		AssetHandle asset = assets.Acquire(AssetCache::StripModelName(modelName), h2bPath);
+		if (asset == INVALID_ASSET)
+			return INVALID_INSTANCE;
+		// may grow or repack the level buffers
+		if (backend != nullptr && !assets.Get(asset).UploadToGPU(geometry)) {
+			assets.Release(asset);
+			return INVALID_INSTANCE;
+		}
+		return AddInstance(modelName, asset, world);
+	}
+	bool RemoveInstance(InstanceHandle handle) {
+		if (!instances.IsValid(handle))
+			return false;
+		assets.Release(instances.GetAssets()[instances.IndexOf(handle)]);
+		instances.Remove(handle);
+		layoutDirty = boundsDirty = true; // the last instance took the removed one's dense index
+		return true;
+	}
+	// Frustum culling walks the BVH by default, off tests every instance box (SIMD, linear)
+	void SetHierarchyCulling(bool enabled) {
+		useHierarchy = enabled;
+	}
+	// LoadLevel's .h2b imports, linear culling, LOD selection & recording long draw queues split
+	// their work over jobs, nullptr (the default) runs them on the calling thread. The system must
+	// outlive the level or be unset first.
+	void SetJobSystem(JobSystem* _jobs) {
+		jobs = _jobs;
+	}
+	// Closest instance whose world box the ray hits, INVALID_INSTANCE if none (picking)
+	InstanceHandle Raycast(const GW::MATH::GVECTORF& origin, const GW::MATH::GVECTORF& direction,
+		float maxDistance, float& distance) {
+		const float o[3] = { origin.x, origin.y, origin.z };
+		const float d[3] = { direction.x, direction.y, direction.z };
+		if (boundsDirty)
+			RebuildCulling(); // edits since the last frame, same as RenderLevel would
+		unsigned hit;
+		if (!hierarchy.Raycast(o, d, maxDistance, hit, distance))
+			return INVALID_INSTANCE;
+		return instances.HandleOf(hit);
+	}
+	// Every instance whose world box overlaps box, dense indices into GetInstances
+	void QueryBox(const BoundingBox& box, std::vector<unsigned>& found) {
+		if (boundsDirty)
+			RebuildCulling();
+		hierarchy.QueryAABB(box, found);
+	}
+	const BVH& GetHierarchy() const {
+		return hierarchy;
+	}
+	// Off by default. On, the next UploadLevelToGPU stores CompactVertex (12 or 16 bytes) instead of
+	// the 36 byte H2B::VERTEX and draws with VertexShaderCompact. A level uploaded without UVs
+	// keeps dropping them for assets added later.
+	void SetCompactVertices(bool enabled) {
+		compactVertices = enabled;
+	}
+	// LODs are on by default, off always draws the full models
+	void SetLodEnabled(bool enabled) {
+		lodEnabled = enabled;
+	}
+	// How big a LOD's error may look, as a fraction of the screen height. Higher switches sooner.
+	void SetLodThreshold(float fractionOfScreenHeight) {
+		lodThreshold = fractionOfScreenHeight;
+	}
+	// Visible instances drawn at each LOD by the last RenderLevel, MAX_LOD_COUNT entries
+	const unsigned* GetLodInstanceCounts() const {
+		return lodInstanceCounts;
+	}
+	// Culling is on by default, off draws everything like before
+	void SetCulling(bool enabled) {
+		cullingEnabled = enabled;
+	}
+	// The instances drawn by the last RenderLevel, dense indices into GetInstances
+	const std::vector<unsigned>& GetVisibleInstances() const {
+		return visibleInstances;
+	}
+	const FrustumCuller& GetCuller() const {
+		return culler;
+	}
+	// Sorts the store by asset, finds the runs and sizes the per frame buffers for them
+	void BuildInstanceGroups() {
+		instanceGroups.clear();
+		instances.SortByAsset();
+		materialTable.Upload(*backend); // no-op unless instances added since brought new materials
+		const AssetHandle* assetIds = instances.GetAssets();
+		const unsigned* materialLists = instances.GetMaterials();
+		for (unsigned i = 0; i < instances.Size(); ++i) {
+			if (instanceGroups.empty() || assetIds[i] != assetIds[instanceGroups.back().first] ||
+				materialLists[i] != materialLists[instanceGroups.back().first])
+				instanceGroups.push_back({ i, 0 });
+			++instanceGroups.back().count;
+		}
+		frame.Create(*backend, static_cast<unsigned>(instances.Size()));
+		size_t meshDraws = 0;
+		for (const InstanceGroup& group : instanceGroups) {
+			const ModelAsset& shared = assets.Get(assetIds[group.first]);
+			meshDraws += shared.meshes.size() * shared.GetLodCount();
+		}
+		queue.Reserve(meshDraws);
+		while (jobs != nullptr && commandLists.size() < jobs->GetThreadCount())
+			commandLists.push_back(backend->CreateCommandList());
+		queue.ReserveLists(static_cast<unsigned>(commandLists.size()));
+		culler.Reserve(instances.Size());
+		visibleInstances.reserve(instances.Size());
+		visibleLods.reserve(instances.Size());
+		visibleDepths.reserve(instances.Size());
+		RebuildCulling();
+		layoutDirty = false;
+	}
+	// Runs of one asset in the instance store, RenderLevel draws each mesh of each LOD a run uses once
+	size_t GetInstanceGroupCount() const {
+		return instanceGroups.size();
+	}
+	// Pipeline, buffer & material binds, draws and triangles issued by the last RenderLevel
+	const RenderQueueStats& GetRenderStats() const {
+		return queue.GetStats();
+	}
+	// Heap allocations made by the last RenderLevel, only counted with LEVELRENDERER_COUNT_ALLOCATIONS
+	unsigned long long GetLastRenderAllocations() const {
+		return lastRenderAllocations;
 	}
 	// used to wipe CPU & GPU level data between levels
 	void UnloadLevel() {
-		allObjectsInLevel.clear();
+		const AssetHandle* assetIds = instances.GetAssets();
+		for (unsigned e = 0; e < instances.Size(); ++e) {
+			assets.Release(assetIds[e]);
+		}
+		frame.Destroy();
+		geometry.Destroy(); // after the assets gave their ranges back
+		queue.Clear();
+		commandLists.clear();
+		instanceGroups.clear();
+		visibleInstances.clear();
+		visibleLods.clear();
+		visibleDepths.clear();
+		culler.Clear();
+		hierarchy.Clear();
+		instances.Clear();
+		materialTable.Clear();
+		layoutDirty = boundsDirty = false;
+		pack.Close();
+		hasLevelLight = hasLevelCamera = false;
+	}
+	// LIGHT/CAMERA transforms of the loaded level, false if the file had none
+	bool GetLevelLight(GW::MATH::GMATRIXF& light) const {
+		light = levelLight;
+		return hasLevelLight;
+	}
+	bool GetLevelCamera(GW::MATH::GMATRIXF& camera) const {
+		camera = levelCamera;
+		return hasLevelCamera;
+	}
+	// Distinct materials of the level, GetAddedCount is how many there were before deduplication
+	const MaterialTable& GetMaterialTable() const {
+		return materialTable;
+	}
+	// The level's vertex & index buffers and where each asset lives in them
+	const LevelGeometry& GetGeometry() const {
+		return geometry;
+	}
+	// Packs the geometry of the assets still in use to the front of the level buffers, worth it
+	// after many assets were removed. Adding assets repacks by itself when they no longer fit.
+	void CompactGeometry() {
+		if (backend != nullptr)
+			geometry.Defragment();
+	}
+	// Shared asset storage, its hit/miss counters show how many .h2b parses were avoided
+	const AssetCache& GetAssetCache() const {
+		return assets;
 	}
-	// *THIS APPROACH COMBINES DATA & LOGIC* 
-	// *WITH THIS APPROACH THE CURRENT RENDERER SHOULD BE JUST AN API MANAGER CLASS*
-	// *ALL ACTUAL GPU LOADING AND RENDERING SHOULD BE HANDLED BY THE MODEL CLASS* 
-	// For example: anything that is not a global API object should be encapsulated.
-
 };
 
+#endif
@@ -0,0 +1,242 @@
+//lodReport.cpp
+// Generates the LOD chain of every .h2b in a folder the way the asset cache does and measures how
+// far each level really is from the full model, then flies a scripted camera around a level and
+// counts the triangles it submits per frame with LODs off and on.
+//   LodReport <h2b folder> <GameLevel.txt> [frames, default 240]
+#define GATEWARE_ENABLE_CORE // All libraries need this
+#define GATEWARE_ENABLE_SYSTEM // GFile & GLog used by the level loader
+#define GATEWARE_ENABLE_MATH
+
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+#include "../gateware-main/gateware-main/Gateware.h"
+#include "load_object_oriented.h"
+#include "recordingBackend.h"
+
+struct Vec3
+{
+	double x, y, z;
+};
+static Vec3 operator-(const Vec3& a, const Vec3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+static Vec3 operator+(const Vec3& a, const Vec3& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+static Vec3 operator*(const Vec3& a, double s) { return { a.x * s, a.y * s, a.z * s }; }
+static double Dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+// Closest point on triangle abc to p (Ericson, Real-Time Collision Detection 5.1.5), returns the distance
+static double DistanceToTriangle(const Vec3& p, const Vec3& a, const Vec3& b, const Vec3& c)
+{
+	const Vec3 ab = b - a, ac = c - a, ap = p - a;
+	const double d1 = Dot(ab, ap), d2 = Dot(ac, ap);
+	Vec3 closest;
+	if (d1 <= 0 && d2 <= 0)
+		closest = a;
+	else
+	{
+		const Vec3 bp = p - b;
+		const double d3 = Dot(ab, bp), d4 = Dot(ac, bp);
+		const Vec3 cp = p - c;
+		const double d5 = Dot(ab, cp), d6 = Dot(ac, cp);
+		const double vc = d1 * d4 - d3 * d2, vb = d5 * d2 - d1 * d6, va = d3 * d6 - d5 * d4;
+		if (d3 >= 0 && d4 <= d3)
+			closest = b;
+		else if (d6 >= 0 && d5 <= d6)
+			closest = c;
+		else if (vc <= 0 && d1 >= 0 && d3 <= 0)
+			closest = a + ab * (d1 / (d1 - d3));
+		else if (vb <= 0 && d2 >= 0 && d6 <= 0)
+			closest = a + ac * (d2 / (d2 - d6));
+		else if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0)
+			closest = b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+		else
+		{
+			const double denominator = 1.0 / (va + vb + vc);
+			closest = a + ab * (vb * denominator) + ac * (vc * denominator);
+		}
+	}
+	const Vec3 d = p - closest;
+	return std::sqrt(Dot(d, d));
+}
+
+// The triangles of one level of an asset as positions
+static std::vector<Vec3> LodTriangles(const ModelAsset& asset, unsigned lod)
+{
+	std::vector<Vec3> corners;
+	for (unsigned m = 0; m < asset.meshes.size(); ++m)
+	{
+		const H2B::BATCH& draw = asset.GetMeshDraw(lod, m);
+		for (unsigned i = 0; i < draw.indexCount; ++i)
+		{
+			const H2B::VECTOR& p = asset.vertices[asset.indices[draw.indexOffset + i]].pos;
+			corners.push_back({ p.x, p.y, p.z });
+		}
+	}
+	return corners;
+}
+
+// Largest distance from any sample of one surface to the other, both ways. The samples are each
+// triangle's corners, edge midpoints and centre.
+static double MeasureLodError(const std::vector<Vec3>& full, const std::vector<Vec3>& lod)
+{
+	auto oneWay = [](const std::vector<Vec3>& from, const std::vector<Vec3>& to) {
+		double worst = 0;
+		for (size_t t = 0; t + 2 < from.size(); t += 3)
+		{
+			const Vec3& a = from[t];
+			const Vec3& b = from[t + 1];
+			const Vec3& c = from[t + 2];
+			const Vec3 samples[] = { a, b, c, (a + b) * 0.5, (b + c) * 0.5, (c + a) * 0.5, (a + b + c) * (1.0 / 3) };
+			for (const Vec3& s : samples)
+			{
+				double nearest = HUGE_VAL;
+				for (size_t u = 0; u + 2 < to.size() && nearest > worst; u += 3)
+					nearest = std::min(nearest, DistanceToTriangle(s, to[u], to[u + 1], to[u + 2]));
+				worst = std::max(worst, nearest);
+			}
+		}
+		return worst;
+	};
+	return std::max(oneWay(full, lod), oneWay(lod, full));
+}
+
+static void ReportModels(const char* h2bFolder)
+{
+	std::vector<std::filesystem::path> files;
+	for (const auto& entry : std::filesystem::directory_iterator(h2bFolder))
+		if (entry.path().extension() == ".h2b")
+			files.push_back(entry.path());
+	std::sort(files.begin(), files.end());
+
+	std::cout << "LOD chain per model, error is in object space and % of the bounding sphere radius" << std::endl;
+	std::cout << std::left << std::setw(24) << "model" << std::right << std::setw(6) << "lod" << std::setw(8) << "tris" <<
+		std::setw(12) << "est. error" << std::setw(12) << "measured" << std::setw(10) << "% radius" << std::endl;
+	std::cout << std::fixed;
+	for (const std::filesystem::path& file : files)
+	{
+		ModelAsset asset;
+		if (!asset.Load(file.string().c_str(), H2BLoader::STREAM, true, true))
+		{
+			std::cout << file.filename().string() << ": could not parse" << std::endl;
+			continue;
+		}
+		const std::vector<Vec3> full = LodTriangles(asset, 0);
+		for (unsigned l = 0; l < asset.GetLodCount(); ++l)
+		{
+			const std::vector<Vec3> lod = LodTriangles(asset, l);
+			const double measured = l == 0 ? 0.0 : MeasureLodError(full, lod);
+			std::cout << std::left << std::setw(24) << (l == 0 ? file.stem().string() : "") << std::right <<
+				std::setw(6) << l << std::setw(8) << lod.size() / 3 << std::setprecision(4) <<
+				std::setw(12) << asset.GetLodError(l) << std::setw(12) << measured << std::setprecision(2) <<
+				std::setw(9) << (asset.sphere.radius > 0 ? 100.0 * measured / asset.sphere.radius : 0.0) << "%" << std::endl;
+		}
+	}
+}
+
+struct PathStats
+{
+	unsigned long long triangles = 0;
+	unsigned minTriangles = ~0u;
+	unsigned maxTriangles = 0;
+	unsigned long long draws = 0;
+	unsigned long long lodInstances[MAX_LOD_COUNT] = {};
+};
+
+// Orbits the level's centre twice, dollying between half and twice its radius, looking at the centre
+static PathStats FlyCameraPath(Level_Objects& level, GW::MATH::GMatrix& proxy, unsigned frames)
+{
+	const InstanceStore& instances = level.GetInstances();
+	float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (unsigned i = 0; i < instances.Size(); ++i)
+	{
+		const BoundingBox& box = instances.GetBounds()[i];
+		for (int a = 0; a < 3; ++a)
+		{
+			lo[a] = std::min(lo[a], box.center[a] - box.extents[a]);
+			hi[a] = std::max(hi[a], box.center[a] + box.extents[a]);
+		}
+	}
+	const float center[3] = { (lo[0] + hi[0]) * 0.5f, (lo[1] + hi[1]) * 0.5f, (lo[2] + hi[2]) * 0.5f };
+	const float radius = 0.5f * std::sqrt((hi[0] - lo[0]) * (hi[0] - lo[0]) + (hi[1] - lo[1]) * (hi[1] - lo[1]) +
+		(hi[2] - lo[2]) * (hi[2] - lo[2]));
+
+	PathStats stats;
+	for (unsigned f = 0; f < frames; ++f)
+	{
+		const float t = f / static_cast<float>(frames);
+		const float angle = 4.0f * 3.14159265f * t;
+		const float distance = radius * (1.25f - 0.75f * std::cos(2.0f * 3.14159265f * t));
+		GW::MATH::GVECTORF eye = { center[0] + distance * std::sin(angle), center[1] + distance * 0.4f,
+			center[2] - distance * std::cos(angle), 0 };
+		GW::MATH::GVECTORF at = { center[0], center[1], center[2], 0 };
+		GW::MATH::GVECTORF up = { 0, 1, 0, 0 };
+		GW::MATH::GMATRIXF view, camera;
+		proxy.LookAtLHF(eye, at, up, view);
+		proxy.InverseF(view, camera);
+		level.RenderLevel(view, camera);
+
+		const RenderQueueStats& frame = level.GetRenderStats();
+		stats.triangles += frame.triangles;
+		stats.minTriangles = std::min(stats.minTriangles, frame.triangles);
+		stats.maxTriangles = std::max(stats.maxTriangles, frame.triangles);
+		stats.draws += frame.draws;
+		for (unsigned l = 0; l < MAX_LOD_COUNT; ++l)
+			stats.lodInstances[l] += level.GetLodInstanceCounts()[l];
+	}
+	return stats;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 3 && argc != 4)
+	{
+		std::cout << "usage: LodReport <h2b folder> <GameLevel.txt> [frames]" << std::endl;
+		return 1;
+	}
+	const unsigned frames = argc == 4 ? static_cast<unsigned>(std::stoul(argv[3])) : 240;
+	ReportModels(argv[1]);
+
+	GW::SYSTEM::GLog log;
+	log.Create("LodReportLog.txt");
+	Level_Objects level;
+	if (!level.LoadLevel(argv[2], argv[1], log))
+		return 1;
+	// same projection as RenderManager at 16:9
+	GW::MATH::GMatrix proxy;
+	proxy.Create();
+	GW::MATH::GMATRIXF view, projection;
+	GW::MATH::GVECTORF eye = { 0, 8, -18, 0 }, at = { 0, 0, 0, 0 }, up = { 0, 1, 0, 0 };
+	proxy.LookAtLHF(eye, at, up, view);
+	proxy.ProjectionDirectXLHF(G_DEGREE_TO_RADIAN_F(65), 16.0f / 9.0f, 0.1f, 100.0f, projection);
+	RecordingBackend backend;
+	level.UploadLevelToGPU(backend, view, projection);
+
+	std::cout << std::endl << "Camera path over " << argv[2] << ", " << frames << " frames, " <<
+		level.GetInstances().Size() << " instances" << std::endl;
+	std::cout << std::left << std::setw(12) << "" << std::right << std::setw(14) << "avg tris" << std::setw(10) << "min" <<
+		std::setw(10) << "max" << std::setw(12) << "avg draws";
+	for (unsigned l = 0; l < MAX_LOD_COUNT; ++l)
+		std::cout << std::setw(9) << ("lod " + std::to_string(l));
+	std::cout << std::endl;
+	double baseline = 0;
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		level.SetLodEnabled(pass == 1);
+		const PathStats stats = FlyCameraPath(level, proxy, frames);
+		const double average = stats.triangles / static_cast<double>(frames);
+		baseline = pass == 0 ? average : baseline;
+		unsigned long long instanceFrames = 0;
+		for (unsigned long long n : stats.lodInstances)
+			instanceFrames += n;
+		std::cout << std::left << std::setw(12) << (pass == 0 ? "LODs off" : "LODs on") << std::right <<
+			std::setprecision(1) << std::setw(14) << average << std::setw(10) << stats.minTriangles <<
+			std::setw(10) << stats.maxTriangles << std::setw(12) << stats.draws / static_cast<double>(frames);
+		for (unsigned long long n : stats.lodInstances)
+			std::cout << std::setw(8) << (instanceFrames ? 100.0 * n / instanceFrames : 0.0) << "%";
+		std::cout << std::endl;
+		if (pass == 1 && baseline > 0)
+			std::cout << "LODs submit " << std::setprecision(1) << 100.0 * (1.0 - average / baseline) <<
+				"% fewer triangles along the path" << std::endl;
+	}
+	level.UnloadLevel();
+	return 0;
+}
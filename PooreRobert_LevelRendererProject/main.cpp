@@ -12,6 +12,10 @@
 // TODO: Part 4A 
 #define GATEWARE_ENABLE_INPUT
 #define GATEWARE_ENABLE_AUDIO
+// Debug builds count heap allocations so the renderer can warn if a frame allocates
+#if _DEBUG
+#define LEVELRENDERER_COUNT_ALLOCATIONS
+#endif
 
 // With what we want & what we don't defined we can include the API
 #include "../gateware-main/gateware-main/Gateware.h"
@@ -55,29 +59,23 @@ int main()
 		if (+d3d11.Create(win, GW::GRAPHICS::DEPTH_BUFFER_SUPPORT))
 		{
 			RenderManager renderer(win, d3d11);
+			// the camera updates 60 times a second, frames are drawn as fast as the present mode allows
+			FrameSchedulerSettings frameSettings;
+			frameSettings.presentMode = PresentMode::VSYNC; // V toggles it
+			frameSettings.frameCap = 0; // e.g. 144 to limit frames with vsync off
+			SteadyFrameClock frameClock;
+			FrameScheduler scheduler(frameClock, frameSettings);
 			while (+win.ProcessWindowEvents())
 			{
-				IDXGISwapChain* swap;
-				ID3D11DeviceContext* con;
-				ID3D11RenderTargetView* view;
-				ID3D11DepthStencilView* depth;
-				if (+d3d11.GetImmediateContext((void**)&con) &&
-					+d3d11.GetRenderTargetView((void**)&view) &&
-					+d3d11.GetDepthStencilView((void**)&depth) &&
-					+d3d11.GetSwapchain((void**)&swap))
-				{
-					con->ClearRenderTargetView(view, clr);
-					con->ClearDepthStencilView(depth, D3D11_CLEAR_DEPTH, 1, 0);
-					renderer.UpdateCamera();
-					renderer.SwapLevel(lvlAudio);
-					renderer.Render();
-					swap->Present(1, 0);
-					// release incremented COM reference counts
-					swap->Release();
-					view->Release();
-					depth->Release();
-					con->Release();
-				}
+				renderer.SampleInput();
+				renderer.UpdatePresentMode(scheduler);
+				scheduler.Tick([&](double step) { renderer.UpdateCamera(step); },
+					[&](float alpha) {
+						renderer.GetBackend().BeginFrame(clr);
+						renderer.SwapLevel(lvlAudio);
+						renderer.Render(alpha);
+						renderer.GetBackend().Present(scheduler.GetSyncInterval());
+					});
 			}
 		}
 	}
@@ -0,0 +1,163 @@
+//materialCheck.cpp
+// Checks that every mesh draws with the material its .h2b declares, headless on the in memory
+// RecordingBackend. Each draw's bound DrawData buffer is read back for the table entry, and that
+// entry of the uploaded material table must be the mesh's own material byte for byte. The shipped
+// levels are swapped in through a LevelStreamer twice each, then an asset's instances are removed
+// and placed again: the material table and its mesh lists must not grow from either.
+//   MaterialCheck <h2b folder> <levels folder>
+#define GATEWARE_ENABLE_CORE // All libraries need this
+#define GATEWARE_ENABLE_SYSTEM // GFile & GLog used by the level loader
+#define GATEWARE_ENABLE_MATH
+
+#include <iostream>
+#include <filesystem>
+#include <map>
+#include <tuple>
+#include "../gateware-main/gateware-main/Gateware.h"
+#include "load_object_oriented.h"
+#include "levelStreamer.h"
+#include "recordingBackend.h"
+
+static unsigned failures = 0;
+
+static void Check(bool passed, const std::string& what)
+{
+	if (!passed)
+	{
+		std::cout << "MISMATCH: " << what << std::endl;
+		++failures;
+	}
+}
+
+// Draws every mesh of every instance at full detail and compares each draw's material with the
+// one its mesh declares, returns how many draws were checked
+static unsigned CheckDrawMaterials(Level_Objects& level, RecordingBackend& backend, Camera& camera, const std::string& label)
+{
+	level.SetCulling(false);
+	level.SetLodEnabled(false);
+	backend.ClearCommands();
+	level.RenderLevel(camera.Update());
+
+	// firstIndex, baseVertex & indexCount of a draw -> the material of the mesh it draws
+	typedef std::tuple<unsigned, int, unsigned> DrawKey;
+	std::map<DrawKey, H2B::ATTRIBUTES> declared;
+	const InstanceStore& instances = level.GetInstances();
+	for (unsigned i = 0; i < instances.Size(); ++i)
+	{
+		const ModelAsset& asset = level.GetAssetCache().Get(instances.GetAssets()[i]);
+		const GeometryRange& range = level.GetGeometry().Get(asset.geometry);
+		for (const AssetMesh& mesh : asset.meshes)
+			declared[DrawKey(range.firstIndex + mesh.drawInfo.indexOffset, static_cast<int>(range.baseVertex),
+				mesh.drawInfo.indexCount)] = mesh.materialIndex < asset.materials.size() ?
+					asset.materials[mesh.materialIndex] : H2B::ATTRIBUTES();
+	}
+
+	BufferHandle drawData = INVALID_BUFFER, table = INVALID_BUFFER;
+	unsigned draws = 0, wrong = 0;
+	for (const RecordedCommand& c : backend.GetCommands())
+	{
+		if (c.type == RecordedCommandType::BIND_CONSTANT_BUFFERS && c.args[0] == 1 && c.args[1] == 1)
+			drawData = c.args[2];
+		else if (c.type == RecordedCommandType::BIND_SHADER_RESOURCES && c.args[0] == 0 && c.args[1] == 1)
+			table = c.args[2];
+		else if (c.type == RecordedCommandType::DRAW_INDEXED_INSTANCED)
+		{
+			++draws;
+			auto found = declared.find(DrawKey(c.args[2], c.baseVertex, c.args[0]));
+			if (found == declared.end() || !backend.IsValid(drawData) || !backend.IsValid(table))
+			{
+				++wrong;
+				continue;
+			}
+			unsigned entry;
+			std::memcpy(&entry, backend.GetBuffer(drawData).contents.data(), sizeof(entry));
+			const std::vector<char>& materials = backend.GetBuffer(table).contents;
+			wrong += (entry + 1) * sizeof(H2B::ATTRIBUTES) > materials.size() ||
+				std::memcmp(materials.data() + entry * sizeof(H2B::ATTRIBUTES), &found->second, sizeof(H2B::ATTRIBUTES)) != 0;
+		}
+	}
+	Check(draws > 0 && wrong == 0, label + ": " + std::to_string(wrong) + " of " + std::to_string(draws) +
+		" draws used another material than their mesh declares");
+	return draws;
+}
+
+// Swaps the level in through the streamer and waits for it
+static bool SwapTo(LevelStreamer& levels, RenderBackend& backend, Camera& camera, const std::string& levelPath,
+	const std::string& h2bFolder)
+{
+	GW::SYSTEM::GLog log; // not created, the messages go nowhere
+	levels.Request(levelPath.c_str(), [levelPath, h2bFolder, log](Level_Objects& level) {
+		return level.LoadLevel(levelPath.c_str(), h2bFolder.c_str(), log); });
+	LevelStreamState state;
+	while ((state = levels.Update(backend, camera.Update().view, camera.GetProjection())) == LevelStreamState::LOADING)
+		std::this_thread::yield();
+	return state == LevelStreamState::SWAPPED;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		std::cout << "usage: MaterialCheck <h2b folder> <levels folder>" << std::endl;
+		return 1;
+	}
+	const std::string h2bFolder = argv[1];
+	const std::string levelPaths[2] = { std::string(argv[2]) + "/GameLevelOne.txt", std::string(argv[2]) + "/GameLevelTwo.txt" };
+	GW::MATH::GMatrix proxy;
+	proxy.Create();
+	GW::MATH::GMATRIXF projection;
+	proxy.ProjectionDirectXLHF(G_DEGREE_TO_RADIAN_F(65), 16.0f / 9.0f, 0.1f, 100.0f, projection);
+	Camera camera;
+	camera.LookAt({ 0, 8, -18, 0 }, { 0, 0, 0, 0 }, { 0, 1, 0, 0 });
+	camera.SetProjection(projection);
+
+	RecordingBackend backend;
+	LevelStreamer levels;
+	size_t materialCount[2] = {}, meshListSize[2] = {};
+	for (int swap = 0; swap < 4; ++swap)
+	{
+		const int l = swap % 2;
+		const std::string label = std::filesystem::path(levelPaths[l]).filename().string() + " load " + std::to_string(swap / 2 + 1);
+		if (!SwapTo(levels, backend, camera, levelPaths[l], h2bFolder))
+		{
+			std::cout << "could not load " << levelPaths[l] << std::endl;
+			return 1;
+		}
+		const MaterialTable& table = levels.GetLevel().GetMaterialTable();
+		const unsigned draws = CheckDrawMaterials(levels.GetLevel(), backend, camera, label);
+		if (swap < 2)
+		{
+			materialCount[l] = table.Size();
+			meshListSize[l] = table.GetMeshListSize();
+		}
+		Check(table.Size() == materialCount[l] && table.GetMeshListSize() == meshListSize[l],
+			label + ": the material table grew across level swaps");
+		std::cout << label << ": " << draws << " draws, " << table.Size() << " materials, " <<
+			table.GetMeshListSize() << " mesh list entries" << std::endl;
+	}
+
+	// every instance of the first asset goes, then comes back at the same place
+	Level_Objects& level = levels.GetLevel();
+	const InstanceStore& instances = level.GetInstances();
+	const AssetHandle removedAsset = instances.GetAssets()[0];
+	const std::string assetName = level.GetAssetCache().Get(removedAsset).name;
+	std::vector<std::pair<std::string, GW::MATH::GMATRIXF>> removed;
+	for (unsigned i = instances.Size(); i-- > 0;)
+	{
+		if (instances.GetAssets()[i] != removedAsset)
+			continue;
+		removed.push_back({ instances.GetName(i), instances.GetWorlds()[i] });
+		level.RemoveInstance(instances.HandleOf(i));
+	}
+	level.RenderLevel(camera.Update()); // a frame without it, its asset was freed by the last removal
+	for (const auto& instance : removed)
+		Check(level.AddInstance(instance.first, (h2bFolder + "/" + assetName + ".h2b").c_str(), instance.second) != INVALID_INSTANCE,
+			"could not place " + instance.first + " again");
+	const unsigned draws = CheckDrawMaterials(level, backend, camera, assetName + " removed & added");
+	const MaterialTable& table = level.GetMaterialTable();
+	Check(table.Size() == materialCount[1] && table.GetMeshListSize() == meshListSize[1],
+		"the material table grew when " + assetName + " was added again");
+	std::cout << assetName << " removed & added: " << draws << " draws, " << table.Size() << " materials, " <<
+		table.GetMeshListSize() << " mesh list entries" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
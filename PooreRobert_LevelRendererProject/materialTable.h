@@ -0,0 +1,131 @@
+//materialTable
+// Every distinct material of a level in one structured buffer (StructuredBuffer materials : t0).
+// Materials are deduplicated by their 80 bytes across all .h2b files, so two models exported
+// with the same settings share one entry. A draw only says which entry it uses: Direct3D 11
+// has no root constants, so each entry also gets a 16 byte constant buffer (DrawData : b1)
+// holding just its index, written once at upload and only bound afterwards.
+// Meshes reach their entry through a per mesh list, one run per asset, made from the mesh's
+// own materialIndex. Runs are deduplicated too, so an asset freed and added again (or another
+// asset with the same materials) gets its old run back instead of growing the table.
+#ifndef _MATERIALTABLE_H_
+#define _MATERIALTABLE_H_
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include "assetCache.h"
+
+class MaterialTable
+{
+	std::vector<H2B::ATTRIBUTES> materials;
+	std::unordered_map<std::string, unsigned> lookup; // raw attribute bytes -> entry
+	std::vector<unsigned> meshMaterials; // entry of each mesh, runs start at a material list
+	std::unordered_map<std::string, unsigned> listLookup; // raw entries of a run -> where it starts
+	std::vector<unsigned> listScratch;
+	unsigned addedCount = 0; // materials offered, before deduplication
+
+	unsigned Find(const H2B::ATTRIBUTES& material)
+	{
+		auto found = lookup.emplace(std::string(reinterpret_cast<const char*>(&material), sizeof(material)),
+			static_cast<unsigned>(materials.size()));
+		if (found.second)
+			materials.push_back(material);
+		return found.first->second;
+	}
+
+	RenderBackend* backend = nullptr;
+	BufferHandle tableBuffer = INVALID_BUFFER;
+	std::vector<BufferHandle> indexBuffers; // entry -> its DrawData constant buffer
+	unsigned uploadedCount = 0;
+
+public:
+	// Entry holding these attributes, added if no earlier material matches byte for byte
+	unsigned Add(const H2B::ATTRIBUTES& material)
+	{
+		++addedCount;
+		return Find(material);
+	}
+
+	// Adds the materials of one model, returns where its per mesh entries start. Each mesh gets
+	// the material its materialIndex names, an out of range index gets a blank material. A model
+	// whose entries already are a run gets that run.
+	unsigned AddMeshList(const ModelAsset& model)
+	{
+		listScratch.clear();
+		addedCount += static_cast<unsigned>(model.meshes.size());
+		for (const AssetMesh& mesh : model.meshes)
+		{
+			const unsigned m = mesh.materialIndex;
+			listScratch.push_back(m < model.materials.size() ? Find(model.materials[m]) : Find(H2B::ATTRIBUTES()));
+		}
+		auto found = listLookup.emplace(std::string(reinterpret_cast<const char*>(listScratch.data()),
+			listScratch.size() * sizeof(unsigned)), static_cast<unsigned>(meshMaterials.size()));
+		if (found.second)
+			meshMaterials.insert(meshMaterials.end(), listScratch.begin(), listScratch.end());
+		return found.first->second;
+	}
+
+	// Creates the GPU table, or recreates it if entries were added since the last upload
+	void Upload(RenderBackend& _backend)
+	{
+		if (backend == &_backend && uploadedCount == materials.size())
+			return;
+		if (backend != nullptr)
+		{
+			backend->DestroyBuffer(tableBuffer);
+			if (backend != &_backend) // the index buffers belong to the old backend too
+			{
+				for (BufferHandle b : indexBuffers)
+					backend->DestroyBuffer(b);
+				indexBuffers.clear();
+			}
+		}
+		backend = &_backend;
+		tableBuffer = INVALID_BUFFER;
+		if (!materials.empty())
+		{
+			BufferDesc tDesc = { BufferType::STRUCTURED, BufferUsage::STATIC,
+				static_cast<unsigned>(materials.size() * sizeof(H2B::ATTRIBUTES)), sizeof(H2B::ATTRIBUTES) };
+			tableBuffer = backend->CreateBuffer(tDesc, materials.data());
+		}
+		BufferDesc iDesc = { BufferType::CONSTANT, BufferUsage::STATIC, 16 };
+		for (unsigned i = static_cast<unsigned>(indexBuffers.size()); i < materials.size(); ++i)
+		{
+			const unsigned drawData[4] = { i, 0, 0, 0 };
+			indexBuffers.push_back(backend->CreateBuffer(iDesc, drawData));
+		}
+		uploadedCount = static_cast<unsigned>(materials.size());
+	}
+
+	// Frees the GPU table and forgets every material
+	void Clear()
+	{
+		if (backend != nullptr)
+		{
+			backend->DestroyBuffer(tableBuffer);
+			for (BufferHandle b : indexBuffers)
+				backend->DestroyBuffer(b);
+		}
+		backend = nullptr;
+		tableBuffer = INVALID_BUFFER;
+		indexBuffers.clear();
+		uploadedCount = 0;
+		materials.clear();
+		lookup.clear();
+		meshMaterials.clear();
+		listLookup.clear();
+		addedCount = 0;
+	}
+
+	// Entry drawn by mesh of the model whose list starts at list
+	unsigned GetMeshMaterial(unsigned list, unsigned mesh) const { return meshMaterials[list + mesh]; }
+	const H2B::ATTRIBUTES& Get(unsigned entry) const { return materials[entry]; }
+	BufferHandle GetTableBuffer() const { return tableBuffer; }
+	BufferHandle GetIndexBuffer(unsigned entry) const { return indexBuffers[entry]; }
+	size_t Size() const { return materials.size(); }
+	// Entries of all mesh runs, one per mesh of each distinct run
+	size_t GetMeshListSize() const { return meshMaterials.size(); }
+	// Materials offered by all models, Size() of them were unique
+	unsigned GetAddedCount() const { return addedCount; }
+};
+
+#endif
@@ -0,0 +1,167 @@
+//meshCheck.cpp
+// Checks the load time mesh optimizer (meshOptimizer.h) on geometry with known duplicates, which
+// the shipped models do not have: a quad split into two triangles of their own and a grid written
+// one vertex per face corner must weld to their shared corners, a vertex that only differs in its
+// normal must stay, and after OptimizeMesh every mesh still draws the same triangles. Then a copy
+// of a shipped .h2b with one index past its vertices must be rejected by AssetCache, while the
+// file it came from still loads.
+//   MeshCheck <h2b folder>
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <array>
+#include <vector>
+#include "assetCache.h"
+
+static unsigned failures = 0;
+
+static void Check(bool passed, const std::string& what)
+{
+	if (!passed)
+	{
+		std::cout << "MISMATCH: " << what << std::endl;
+		++failures;
+	}
+}
+
+static H2B::VERTEX Corner(float x, float z, float normalY = 1)
+{
+	H2B::VERTEX vertex = {};
+	vertex.pos = { x, 0, z };
+	vertex.uvw = { x, z, 0 };
+	vertex.nrm = { 0, normalY, 0 };
+	return vertex;
+}
+
+typedef std::array<float, 9> Triangle; // its corners' positions, starting at the smallest
+
+// The triangles of indices [first, first + count) by position, so they compare across welding
+// and reordering. Rotating a triangle keeps its winding.
+static std::vector<Triangle> Triangles(const std::vector<H2B::VERTEX>& vertices, const std::vector<unsigned>& indices,
+	unsigned first, unsigned count)
+{
+	std::vector<Triangle> triangles;
+	for (unsigned t = first; t + 3 <= first + count; t += 3)
+	{
+		std::array<std::array<float, 3>, 3> corners;
+		for (unsigned c = 0; c < 3; ++c)
+		{
+			const H2B::VECTOR& pos = vertices[indices[t + c]].pos;
+			corners[c] = { pos.x, pos.y, pos.z };
+		}
+		std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end()), corners.end());
+		Triangle triangle;
+		for (unsigned c = 0; c < 3; ++c)
+			std::copy(corners[c].begin(), corners[c].end(), triangle.begin() + c * 3);
+		triangles.push_back(triangle);
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+static void CheckWeld()
+{
+	// two triangles of a quad, the diagonal's two corners written twice
+	std::vector<H2B::VERTEX> vertices = { Corner(0, 0), Corner(1, 0), Corner(1, 1), Corner(0, 0), Corner(1, 1), Corner(0, 1) };
+	std::vector<unsigned> indices = { 0, 1, 2, 3, 4, 5 };
+	const std::vector<Triangle> before = Triangles(vertices, indices, 0, 6);
+	Check(WeldVertices(vertices, indices) == 2 && vertices.size() == 4, "a quad's two repeated corners were not welded");
+	Check(indices == std::vector<unsigned>({ 0, 1, 2, 0, 2, 3 }), "the quad's indices do not point at the first copy of each corner");
+	Check(Triangles(vertices, indices, 0, 6) == before, "welding changed the quad's triangles");
+
+	// the same position with another normal is a different vertex
+	vertices = { Corner(0, 0), Corner(1, 0), Corner(1, 1), Corner(0, 0, -1), Corner(1, 1), Corner(0, 1) };
+	indices = { 0, 1, 2, 3, 4, 5 };
+	Check(WeldVertices(vertices, indices) == 1 && vertices.size() == 5, "a vertex that differs only in its normal was welded");
+
+	// an 8 x 8 grid, one vertex per corner of each of its 128 triangles, as two meshes
+	const unsigned size = 8;
+	vertices.clear();
+	indices.clear();
+	for (unsigned z = 0; z < size; ++z)
+		for (unsigned x = 0; x < size; ++x)
+		{
+			const float x0 = static_cast<float>(x), z0 = static_cast<float>(z);
+			for (const H2B::VERTEX& corner : { Corner(x0, z0), Corner(x0 + 1, z0), Corner(x0 + 1, z0 + 1),
+				Corner(x0, z0), Corner(x0 + 1, z0 + 1), Corner(x0, z0 + 1) })
+			{
+				indices.push_back(static_cast<unsigned>(vertices.size()));
+				vertices.push_back(corner);
+			}
+		}
+	const unsigned half = static_cast<unsigned>(indices.size()) / 2;
+	const H2B::BATCH meshes[] = { { half, 0 }, { half, half } };
+	const std::vector<Triangle> first = Triangles(vertices, indices, 0, half);
+	const std::vector<Triangle> second = Triangles(vertices, indices, half, half);
+	const unsigned indexCount = static_cast<unsigned>(indices.size());
+	const unsigned missesBefore = SimulateVertexCache(indices.data(), indexCount, static_cast<unsigned>(vertices.size()), 16);
+	OptimizeMesh(vertices, indices, meshes, 2);
+	Check(vertices.size() == (size + 1) * (size + 1), "the grid welded to " + std::to_string(vertices.size()) +
+		" vertices, not its " + std::to_string((size + 1) * (size + 1)) + " corners");
+	Check(indices.size() == indexCount && IndicesInRange(indices.data(), indices.size(), vertices.size()),
+		"OptimizeMesh left indices past the welded vertices");
+	Check(Triangles(vertices, indices, 0, half) == first && Triangles(vertices, indices, half, half) == second,
+		"OptimizeMesh moved triangles between meshes or changed them");
+	Check(SimulateVertexCache(indices.data(), indexCount, static_cast<unsigned>(vertices.size()), 16) < missesBefore,
+		"the welded grid does not reuse vertices in the cache");
+}
+
+// A copy of source whose first index is its vertex count, one past the last vertex
+static bool WriteBadIndex(const std::filesystem::path& source, const std::filesystem::path& copy)
+{
+	std::filesystem::copy_file(source, copy, std::filesystem::copy_options::overwrite_existing);
+	std::fstream file(copy, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+	unsigned vertexCount = 0, indexCount = 0;
+	file.seekg(4);
+	file.read(reinterpret_cast<char*>(&vertexCount), 4);
+	file.read(reinterpret_cast<char*>(&indexCount), 4);
+	if (!file || indexCount == 0)
+		return false;
+	file.seekp(20 + 36 * static_cast<std::streamoff>(vertexCount));
+	file.write(reinterpret_cast<const char*>(&vertexCount), 4);
+	return static_cast<bool>(file);
+}
+
+static void CheckBadIndices(const std::string& h2bFolder)
+{
+	Check(!IndicesInRange(std::vector<unsigned>({ 0, 1, 3 }).data(), 3, 3), "IndicesInRange let an index past the vertices through");
+	std::vector<std::filesystem::path> files;
+	for (const auto& entry : std::filesystem::directory_iterator(h2bFolder))
+		if (entry.path().extension() == ".h2b")
+			files.push_back(entry.path());
+	std::sort(files.begin(), files.end());
+	Check(!files.empty(), "no .h2b found");
+	if (files.empty())
+		return;
+	const std::filesystem::path bad = std::filesystem::temp_directory_path() / "MeshCheckBadIndex.h2b";
+	Check(WriteBadIndex(files[0], bad), "could not write a copy of " + files[0].filename().string());
+	for (const H2BLoader loader : { H2BLoader::STREAM, H2BLoader::MAPPED })
+		for (const bool optimize : { false, true })
+		{
+			const std::string label = std::string(loader == H2BLoader::MAPPED ? "mapped" : "stream") +
+				(optimize ? ", optimized" : "");
+			AssetCache cache;
+			cache.SetLoader(loader);
+			cache.SetMeshOptimization(optimize);
+			Check(cache.Acquire("Bad", bad.string().c_str()) == INVALID_ASSET && cache.GetAssetCount() == 0,
+				label + ": a .h2b with an index past its vertices was loaded");
+			Check(cache.Acquire("Good", files[0].string().c_str()) != INVALID_ASSET, label + ": " +
+				files[0].filename().string() + " did not load");
+		}
+	std::filesystem::remove(bad);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 2)
+	{
+		std::cout << "usage: MeshCheck <h2b folder>" << std::endl;
+		return 1;
+	}
+	CheckWeld();
+	CheckBadIndices(argv[1]);
+	if (failures == 0)
+		std::cout << "known duplicates weld, every mesh keeps its triangles and bad indices are rejected" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,255 @@
+//meshOptimizer
+// Load time clean up of .h2b geometry for the GPU's vertex pipeline, run once per asset:
+//   WeldVertices: bit identical vertices (the exporter writes one per face corner) become one
+//   OptimizeVertexCache: reorders a mesh's triangles with Tom Forsyth's linear speed algorithm
+//     so a vertex is used again while it is still in the post transform cache
+//   OptimizeVertexFetch: renumbers the vertices in order of first use so fetching walks the
+//     vertex buffer forward, vertices no triangle uses are dropped
+// Triangles never move between meshes, every mesh keeps its indexOffset & indexCount.
+// SimulateVertexCache measures the result without a GPU: ACMR is vertices transformed per
+// triangle (0.5 is the best a regular grid can do, 3 means no reuse at all), ATVR is vertices
+// transformed per vertex (1 is perfect).
+#ifndef _MESHOPTIMIZER_H_
+#define _MESHOPTIMIZER_H_
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include "h2bParser.h"
+
+// True when every index names one of vertexCount vertices. Everything below indexes its tables
+// with them unchecked, AssetCache::Load rejects a .h2b that fails this before optimizing it.
+inline bool IndicesInRange(const unsigned* indices, size_t indexCount, size_t vertexCount)
+{
+	for (size_t i = 0; i < indexCount; ++i)
+		if (indices[i] >= vertexCount)
+			return false;
+	return true;
+}
+
+// Merges vertices whose 36 bytes are equal and points the indices at the survivor, returns how
+// many were removed
+inline unsigned WeldVertices(std::vector<H2B::VERTEX>& vertices, std::vector<unsigned>& indices)
+{
+	struct Hash
+	{
+		size_t operator()(const H2B::VERTEX& v) const
+		{
+			unsigned words[sizeof(H2B::VERTEX) / 4];
+			std::memcpy(words, &v, sizeof(words));
+			size_t hash = 2166136261u;
+			for (unsigned w : words)
+				hash = (hash ^ w) * 16777619u;
+			return hash;
+		}
+	};
+	struct Equal
+	{
+		bool operator()(const H2B::VERTEX& a, const H2B::VERTEX& b) const
+		{
+			return std::memcmp(&a, &b, sizeof(H2B::VERTEX)) == 0;
+		}
+	};
+	std::unordered_map<H2B::VERTEX, unsigned, Hash, Equal> firstOf;
+	firstOf.reserve(vertices.size());
+	std::vector<unsigned> remap(vertices.size());
+	unsigned unique = 0;
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		auto found = firstOf.emplace(vertices[i], unique);
+		if (found.second)
+			vertices[unique++] = vertices[i];
+		remap[i] = found.first->second;
+	}
+	const unsigned removed = static_cast<unsigned>(vertices.size()) - unique;
+	vertices.resize(unique);
+	for (unsigned& index : indices)
+		index = remap[index];
+	return removed;
+}
+
+// Reorders the triangles of one mesh (indexCount / 3 of them, indices below vertexCount).
+// Every vertex is scored by where it sits in a simulated 32 entry LRU cache and by how many
+// triangles still use it, the next triangle is the best scoring one among those touching the
+// cache. Linear in the triangle count.
+inline void OptimizeVertexCache(unsigned* indices, unsigned indexCount, unsigned vertexCount)
+{
+	static const int CACHE_SIZE = 32;
+	const unsigned triangleCount = indexCount / 3;
+	if (triangleCount < 2)
+		return;
+	auto vertexScore = [](int cachePosition, unsigned remaining) {
+		if (remaining == 0)
+			return -1.0f; // nothing left to draw with it
+		float score = 0;
+		if (cachePosition >= 0)
+			score = cachePosition < 3 ? 0.75f : // used by the last triangle, do not favour it over its neighbours
+				std::pow(1.0f - (cachePosition - 3) / float(CACHE_SIZE - 3), 1.5f);
+		return score + 2.0f / std::sqrt(static_cast<float>(remaining)); // finish off lonely vertices
+	};
+
+	// triangles of every vertex, the first remaining[v] of its run are the ones not drawn yet
+	std::vector<unsigned> remaining(vertexCount, 0);
+	for (unsigned i = 0; i < triangleCount * 3; ++i)
+		++remaining[indices[i]];
+	std::vector<unsigned> firstTriangle(vertexCount + 1, 0);
+	for (unsigned v = 0; v < vertexCount; ++v)
+		firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+	std::vector<unsigned> triangles(triangleCount * 3);
+	std::vector<unsigned> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+	for (unsigned i = 0; i < triangleCount * 3; ++i)
+		triangles[filled[indices[i]]++] = i / 3;
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> score(vertexCount);
+	for (unsigned v = 0; v < vertexCount; ++v)
+		score[v] = vertexScore(-1, remaining[v]);
+	std::vector<float> triangleScore(triangleCount);
+	for (unsigned t = 0; t < triangleCount; ++t)
+		triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+	std::vector<bool> drawn(triangleCount, false);
+
+	std::vector<unsigned> output(triangleCount * 3);
+	unsigned cache[CACHE_SIZE + 3], nextCache[CACHE_SIZE + 3];
+	unsigned cacheCount = 0;
+	unsigned best = 0;
+	for (unsigned t = 1; t < triangleCount; ++t)
+		best = triangleScore[t] > triangleScore[best] ? t : best;
+	unsigned deadEndCursor = 0; // restarts after the cache runs dry go to the first triangle left
+	for (unsigned emitted = 0; emitted < triangleCount; ++emitted)
+	{
+		if (best == ~0u)
+		{
+			while (drawn[deadEndCursor])
+				++deadEndCursor;
+			best = deadEndCursor;
+		}
+		const unsigned* corners = indices + best * 3;
+		std::memcpy(&output[emitted * 3], corners, sizeof(unsigned) * 3);
+		drawn[best] = true;
+
+		// take the triangle out of its vertices' remaining lists
+		for (int c = 0; c < 3; ++c)
+		{
+			const unsigned v = corners[c];
+			unsigned* list = &triangles[firstTriangle[v]];
+			for (unsigned k = 0; k < remaining[v]; ++k)
+				if (list[k] == best)
+				{
+					list[k] = list[--remaining[v]];
+					break;
+				}
+		}
+		// its corners go to the front, the rest shifts back and the last three may fall out
+		unsigned nextCount = 0;
+		for (int c = 0; c < 3; ++c)
+			if (c == 0 || (corners[c] != corners[0] && (c == 1 || corners[c] != corners[1]))) // degenerate triangles
+				nextCache[nextCount++] = corners[c];
+		for (unsigned k = 0; k < cacheCount; ++k)
+		{
+			const unsigned v = cache[k];
+			if (v != corners[0] && v != corners[1] && v != corners[2])
+				nextCache[nextCount++] = v;
+		}
+		// rescore everything that moved, the triangles they are in change by the difference
+		for (unsigned k = 0; k < nextCount; ++k)
+		{
+			const unsigned v = nextCache[k];
+			cachePosition[v] = k < CACHE_SIZE ? static_cast<int>(k) : -1;
+			const float newScore = vertexScore(cachePosition[v], remaining[v]);
+			const float delta = newScore - score[v];
+			score[v] = newScore;
+			const unsigned* list = &triangles[firstTriangle[v]];
+			for (unsigned r = 0; r < remaining[v]; ++r)
+				triangleScore[list[r]] += delta;
+		}
+		cacheCount = nextCount < CACHE_SIZE ? nextCount : CACHE_SIZE;
+		std::memcpy(cache, nextCache, cacheCount * sizeof(unsigned));
+
+		// the next triangle is the best one still touching the cache
+		best = ~0u;
+		float bestScore = -1.0f;
+		for (unsigned k = 0; k < cacheCount; ++k)
+		{
+			const unsigned v = cache[k];
+			const unsigned* list = &triangles[firstTriangle[v]];
+			for (unsigned r = 0; r < remaining[v]; ++r)
+				if (triangleScore[list[r]] > bestScore)
+				{
+					bestScore = triangleScore[list[r]];
+					best = list[r];
+				}
+		}
+	}
+	std::memcpy(indices, output.data(), output.size() * sizeof(unsigned));
+}
+
+// Renumbers the vertices in the order the indices first use them and drops unused ones,
+// returns the new vertex count
+inline unsigned OptimizeVertexFetch(std::vector<H2B::VERTEX>& vertices, std::vector<unsigned>& indices)
+{
+	std::vector<unsigned> remap(vertices.size(), ~0u);
+	std::vector<H2B::VERTEX> reordered;
+	reordered.reserve(vertices.size());
+	for (unsigned& index : indices)
+	{
+		if (remap[index] == ~0u)
+		{
+			remap[index] = static_cast<unsigned>(reordered.size());
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(reordered);
+	return static_cast<unsigned>(vertices.size());
+}
+
+// Vertices a FIFO post transform cache of cacheSize entries transforms to draw these triangles
+inline unsigned SimulateVertexCache(const unsigned* indices, unsigned indexCount, unsigned vertexCount,
+	unsigned cacheSize = 16)
+{
+	std::vector<unsigned> insertedAt(vertexCount, 0); // miss count right after it went in, 0 never
+	unsigned misses = 0;
+	for (unsigned i = 0; i < indexCount; ++i)
+	{
+		const unsigned v = indices[i];
+		if (insertedAt[v] == 0 || misses - insertedAt[v] >= cacheSize)
+			insertedAt[v] = ++misses;
+	}
+	return misses;
+}
+
+struct VertexCacheStats
+{
+	float acmr; // transformed vertices per triangle
+	float atvr; // transformed vertices per vertex
+};
+
+inline VertexCacheStats MeasureVertexCache(const unsigned* indices, unsigned indexCount, unsigned vertexCount,
+	unsigned cacheSize = 16)
+{
+	const unsigned misses = SimulateVertexCache(indices, indexCount, vertexCount, cacheSize);
+	VertexCacheStats stats = { 0, 0 };
+	if (indexCount >= 3)
+		stats.acmr = misses / float(indexCount / 3);
+	if (vertexCount > 0)
+		stats.atvr = misses / float(vertexCount);
+	return stats;
+}
+
+// Weld, per mesh triangle order, then vertex order. meshes are the index ranges drawn on their own,
+// the indices must pass IndicesInRange.
+inline void OptimizeMesh(std::vector<H2B::VERTEX>& vertices, std::vector<unsigned>& indices,
+	const H2B::BATCH* meshes, unsigned meshCount)
+{
+	WeldVertices(vertices, indices);
+	for (unsigned m = 0; m < meshCount; ++m)
+	{
+		if (meshes[m].indexOffset + meshes[m].indexCount <= indices.size())
+			OptimizeVertexCache(indices.data() + meshes[m].indexOffset, meshes[m].indexCount,
+				static_cast<unsigned>(vertices.size()));
+	}
+	OptimizeVertexFetch(vertices, indices);
+}
+
+#endif
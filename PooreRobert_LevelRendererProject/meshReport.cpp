@@ -0,0 +1,85 @@
+//meshReport.cpp
+// Runs the load time mesh optimizer (meshOptimizer.h) over every .h2b in a folder and reports
+// the post transform cache efficiency before and after, measured with the CPU cache simulator.
+//   MeshReport <h2b folder> [cache size, default 16]
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include "h2bParser.h"
+#include "meshOptimizer.h"
+
+int main(int argc, char** argv)
+{
+	if (argc != 2 && argc != 3)
+	{
+		std::cout << "usage: MeshReport <h2b folder> [cache size]" << std::endl;
+		return 1;
+	}
+	const unsigned cacheSize = argc == 3 ? static_cast<unsigned>(std::stoul(argv[2])) : 16;
+	std::vector<std::filesystem::path> files;
+	for (const auto& entry : std::filesystem::directory_iterator(argv[1]))
+		if (entry.path().extension() == ".h2b")
+			files.push_back(entry.path());
+	std::sort(files.begin(), files.end());
+
+	std::cout << "FIFO cache of " << cacheSize << " vertices" << std::endl;
+	std::cout << std::left << std::setw(24) << "model" << std::right << std::setw(8) << "tris" <<
+		std::setw(8) << "verts" << std::setw(8) << "welded" << std::setw(10) << "ACMR" << std::setw(10) << "-> ACMR" <<
+		std::setw(8) << "ATVR" << std::setw(10) << "-> ATVR" << std::setw(10) << "index B" << std::setw(10) << "-> B" << std::endl;
+	std::cout << std::fixed;
+	unsigned totalTriangles = 0, totalMissesBefore = 0, totalMissesAfter = 0;
+	size_t totalIndexBytes = 0, totalIndexBytesAfter = 0;
+	for (const std::filesystem::path& file : files)
+	{
+		H2B::Parser model;
+		if (!model.Parse(file.string().c_str()))
+		{
+			std::cout << file.filename().string() << ": could not parse" << std::endl;
+			continue;
+		}
+		if (!IndicesInRange(model.indices.data(), model.indices.size(), model.vertices.size()))
+		{
+			std::cout << file.filename().string() << ": indices out of range" << std::endl;
+			continue;
+		}
+		std::vector<H2B::VERTEX> vertices = model.vertices;
+		std::vector<unsigned> indices = model.indices;
+		std::vector<H2B::BATCH> meshes;
+		for (const H2B::MESH& mesh : model.meshes)
+			meshes.push_back(mesh.drawInfo);
+		const unsigned indexCount = static_cast<unsigned>(indices.size());
+		const unsigned triangles = indexCount / 3;
+		const unsigned missesBefore = SimulateVertexCache(indices.data(), indexCount,
+			static_cast<unsigned>(vertices.size()), cacheSize);
+
+		const size_t originalVertices = vertices.size();
+		OptimizeMesh(vertices, indices, meshes.data(), static_cast<unsigned>(meshes.size()));
+		const unsigned missesAfter = SimulateVertexCache(indices.data(), indexCount,
+			static_cast<unsigned>(vertices.size()), cacheSize);
+		const float perTriangle = triangles ? 1.0f / triangles : 0.0f;
+
+		// 16 bit when the asset's own vertices fit, like LevelGeometry
+		const size_t indexBytes = indexCount * sizeof(unsigned);
+		const size_t indexBytesAfter = indexCount * (vertices.size() <= 65536 ? sizeof(unsigned short) : sizeof(unsigned));
+		totalTriangles += triangles;
+		totalMissesBefore += missesBefore;
+		totalMissesAfter += missesAfter;
+		totalIndexBytes += indexBytes;
+		totalIndexBytesAfter += indexBytesAfter;
+		std::cout << std::left << std::setw(24) << file.stem().string() << std::right << std::setw(8) << triangles <<
+			std::setw(8) << originalVertices << std::setw(8) << originalVertices - vertices.size() <<
+			std::setprecision(3) << std::setw(10) << missesBefore * perTriangle << std::setw(10) << missesAfter * perTriangle <<
+			std::setw(8) << float(missesBefore) / originalVertices << std::setw(10) << float(missesAfter) / vertices.size() <<
+			std::setw(10) << indexBytes << std::setw(10) << indexBytesAfter << std::endl;
+	}
+	std::cout << std::left << std::setw(24) << "total" << std::right << std::setw(8) << totalTriangles <<
+		std::setw(8) << "" << std::setw(8) << "" << std::setprecision(3) <<
+		std::setw(10) << (totalTriangles ? float(totalMissesBefore) / totalTriangles : 0.0f) <<
+		std::setw(10) << (totalTriangles ? float(totalMissesAfter) / totalTriangles : 0.0f) <<
+		std::setw(8) << "" << std::setw(10) << "" <<
+		std::setw(10) << totalIndexBytes << std::setw(10) << totalIndexBytesAfter << std::endl;
+	return 0;
+}
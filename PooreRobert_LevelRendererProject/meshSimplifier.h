@@ -0,0 +1,455 @@
+//meshSimplifier
+// Builds the coarser levels of detail of a model at load or bake time with quadric error metrics
+// (Garland & Heckbert). Every vertex keeps the sum of the squared distances to the planes of the
+// triangles around it, collapsing an edge moves one vertex onto its neighbour and costs what the
+// neighbour's position scores in both sums. The cheapest collapse goes first until the model is
+// down to the target triangle count.
+//   - collapses are half edge (onto an existing vertex), so every level reuses the model's vertex
+//     buffer and only adds indices
+//   - the exporter writes one vertex per face corner, so corners are joined by position first and
+//     each output corner picks the original vertex whose normal fits its new triangle best
+//   - open edges and edges between two meshes (materials) get an extra plane standing on the edge
+//     and their vertices only slide along them, so outlines do not shrink or crack
+//   - collapses that flip a triangle or pinch the surface (link condition) are skipped
+// One run makes the whole chain, each level continues from the previous one. A level's error is
+// the root of the largest collapse cost so far, a distance in object space.
+#ifndef _MESHSIMPLIFIER_H_
+#define _MESHSIMPLIFIER_H_
+#include <vector>
+#include <queue>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <unordered_set>
+#include <unordered_map>
+#include "h2bParser.h"
+#include "meshOptimizer.h"
+
+// Levels per model including the full one, and the triangle ratio the coarser ones aim for
+const unsigned MAX_LOD_COUNT = 4;
+const float LOD_TRIANGLE_RATIOS[MAX_LOD_COUNT - 1] = { 0.5f, 0.25f, 0.125f };
+// Models smaller than this are cheap enough at any distance and get no LODs
+const unsigned LOD_MIN_TRIANGLES = 64;
+
+// One coarser level of a model: the same meshes over other index ranges
+struct MeshLod
+{
+	std::vector<H2B::BATCH> meshes; // same count & order as the full model's meshes
+	float error; // object space distance, see above
+	unsigned triangleCount;
+};
+
+class MeshSimplifier
+{
+	// Symmetric 4x4 matrix of a sum of planes (a, b, c, d), its 10 distinct terms
+	struct Quadric
+	{
+		double aa, ab, ac, ad, bb, bc, bd, cc, cd, dd;
+
+		void AddPlane(double a, double b, double c, double d, double weight)
+		{
+			aa += weight * a * a; ab += weight * a * b; ac += weight * a * c; ad += weight * a * d;
+			bb += weight * b * b; bc += weight * b * c; bd += weight * b * d;
+			cc += weight * c * c; cd += weight * c * d;
+			dd += weight * d * d;
+		}
+		void Add(const Quadric& q)
+		{
+			aa += q.aa; ab += q.ab; ac += q.ac; ad += q.ad;
+			bb += q.bb; bc += q.bc; bd += q.bd;
+			cc += q.cc; cd += q.cd;
+			dd += q.dd;
+		}
+		// Sum of squared distances from p to every plane
+		double Evaluate(const double p[3]) const
+		{
+			const double x = p[0], y = p[1], z = p[2];
+			return aa * x * x + bb * y * y + cc * z * z + 2 * (ab * x * y + ac * x * z + bc * y * z) +
+				2 * (ad * x + bd * y + cd * z) + dd;
+		}
+	};
+	struct Triangle
+	{
+		unsigned corners[3]; // joined vertices
+		unsigned mesh;
+		bool alive;
+	};
+	struct Collapse
+	{
+		double cost;
+		unsigned from, to;
+		unsigned version; // of from when this was computed
+		bool operator<(const Collapse& other) const { return cost > other.cost; } // cheapest on top
+	};
+
+	std::vector<double> positions; // xyz per joined vertex
+	std::vector<unsigned> joined; // original vertex -> joined vertex
+	std::vector<unsigned> firstOriginal; // joined vertex -> its run in originals
+	std::vector<unsigned> originals;
+	std::vector<Quadric> quadrics;
+	std::vector<unsigned> versions; // bumped whenever a vertex's neighbourhood changes
+	std::vector<bool> removed;
+	std::vector<bool> border; // on an open edge or between two meshes
+	std::vector<std::vector<unsigned>> vertexTriangles;
+	std::vector<Triangle> triangles;
+	std::unordered_set<unsigned long long> borderEdges;
+	std::priority_queue<Collapse> heap;
+	unsigned liveTriangles = 0;
+	double maxCost = 0;
+	// scratch
+	std::vector<unsigned> marks;
+	unsigned mark = 0;
+	std::vector<unsigned> affected, candidates, neighboursA, neighboursB;
+
+	static unsigned long long EdgeKey(unsigned a, unsigned b)
+	{
+		return a < b ? static_cast<unsigned long long>(a) << 32 | b : static_cast<unsigned long long>(b) << 32 | a;
+	}
+	bool IsBorderEdge(unsigned a, unsigned b) const
+	{
+		return borderEdges.count(EdgeKey(a, b)) != 0;
+	}
+	const double* Position(unsigned v) const
+	{
+		return &positions[v * 3];
+	}
+	static void Normal(const double* a, const double* b, const double* c, double n[3])
+	{
+		const double e0[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		const double e1[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+		n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+		n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+	}
+	// Distinct vertices sharing a live triangle with v
+	void Neighbours(unsigned v, std::vector<unsigned>& out)
+	{
+		out.clear();
+		for (unsigned t : vertexTriangles[v])
+		{
+			if (!triangles[t].alive)
+				continue;
+			for (unsigned w : triangles[t].corners)
+				if (w != v && std::find(out.begin(), out.end(), w) == out.end())
+					out.push_back(w);
+		}
+	}
+
+	// Moving from onto to keeps the surface a manifold and turns no remaining triangle over
+	bool IsValid(unsigned from, unsigned to)
+	{
+		if (border[from] && !IsBorderEdge(from, to))
+			return false; // would cut across the outline
+		// link condition: the shared neighbours are exactly the tips of the triangles on the edge
+		Neighbours(from, neighboursA);
+		Neighbours(to, neighboursB);
+		unsigned shared = 0, onEdge = 0;
+		for (unsigned w : neighboursA)
+			shared += std::find(neighboursB.begin(), neighboursB.end(), w) != neighboursB.end();
+		for (unsigned t : vertexTriangles[from])
+		{
+			const Triangle& tri = triangles[t];
+			if (tri.alive && (tri.corners[0] == to || tri.corners[1] == to || tri.corners[2] == to))
+				++onEdge;
+		}
+		if (onEdge == 0 || shared != onEdge)
+			return false;
+		for (unsigned t : vertexTriangles[from])
+		{
+			const Triangle& tri = triangles[t];
+			if (!tri.alive || tri.corners[0] == to || tri.corners[1] == to || tri.corners[2] == to)
+				continue;
+			const double* p[3];
+			for (int c = 0; c < 3; ++c)
+				p[c] = Position(tri.corners[c]);
+			double before[3], after[3];
+			Normal(p[0], p[1], p[2], before);
+			for (int c = 0; c < 3; ++c)
+				p[c] = tri.corners[c] == from ? Position(to) : p[c];
+			Normal(p[0], p[1], p[2], after);
+			const double lengthBefore = std::sqrt(before[0] * before[0] + before[1] * before[1] + before[2] * before[2]);
+			const double lengthAfter = std::sqrt(after[0] * after[0] + after[1] * after[1] + after[2] * after[2]);
+			const double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+			if (lengthBefore > 0 && dot <= 0.25 * lengthBefore * lengthAfter)
+				return false; // flipped, folded or squashed flat
+		}
+		return true;
+	}
+
+	// Queues the cheapest valid collapse of v, if it has one. Older entries of v go stale.
+	void Requeue(unsigned v)
+	{
+		++versions[v];
+		Neighbours(v, candidates);
+		Collapse best = { 0, v, ~0u, versions[v] };
+		for (unsigned to : candidates)
+		{
+			if (!IsValid(v, to))
+				continue;
+			Quadric q = quadrics[v];
+			q.Add(quadrics[to]);
+			const double cost = std::max(0.0, q.Evaluate(Position(to)));
+			if (best.to == ~0u || cost < best.cost)
+			{
+				best.cost = cost;
+				best.to = to;
+			}
+		}
+		if (best.to != ~0u)
+			heap.push(best);
+	}
+
+	void Apply(const Collapse& collapse)
+	{
+		const unsigned from = collapse.from, to = collapse.to;
+		// everything around from now, everything around to afterwards gets requeued
+		++mark;
+		affected.clear();
+		auto touch = [this](unsigned w) {
+			if (marks[w] != mark)
+			{
+				marks[w] = mark;
+				affected.push_back(w);
+			}
+		};
+		for (unsigned t : vertexTriangles[from])
+			if (triangles[t].alive)
+				for (unsigned w : triangles[t].corners)
+					touch(w);
+		if (border[from]) // the outline from was on continues from to
+			for (unsigned w : affected)
+				if (w != from && w != to && IsBorderEdge(from, w))
+					borderEdges.insert(EdgeKey(to, w));
+		for (unsigned t : vertexTriangles[from])
+		{
+			Triangle& tri = triangles[t];
+			if (!tri.alive)
+				continue;
+			if (tri.corners[0] == to || tri.corners[1] == to || tri.corners[2] == to)
+			{
+				tri.alive = false; // the collapsed edge's own triangles
+				--liveTriangles;
+				continue;
+			}
+			for (unsigned& c : tri.corners)
+				c = c == from ? to : c;
+			vertexTriangles[to].push_back(t);
+		}
+		vertexTriangles[from] = std::vector<unsigned>();
+		quadrics[to].Add(quadrics[from]);
+		removed[from] = true;
+		maxCost = std::max(maxCost, collapse.cost);
+
+		std::vector<unsigned>& around = vertexTriangles[to];
+		around.erase(std::remove_if(around.begin(), around.end(),
+			[this](unsigned t) { return !triangles[t].alive; }), around.end());
+		for (unsigned t : around)
+			for (unsigned w : triangles[t].corners)
+				touch(w);
+		for (unsigned w : affected)
+			if (!removed[w])
+				Requeue(w);
+	}
+
+public:
+	// Joins the corners, sums the quadrics and queues the first collapses. meshes are the
+	// model's index ranges, triangles never move between them.
+	void Build(const H2B::VERTEX* vertices, unsigned vertexCount, const unsigned* indices, unsigned indexCount,
+		const H2B::BATCH* meshes, unsigned meshCount)
+	{
+		// corners at bit identical positions become one vertex
+		originals.resize(vertexCount);
+		for (unsigned i = 0; i < vertexCount; ++i)
+			originals[i] = i;
+		std::sort(originals.begin(), originals.end(), [vertices](unsigned a, unsigned b) {
+			return std::memcmp(&vertices[a].pos, &vertices[b].pos, sizeof(H2B::VECTOR)) < 0;
+		});
+		joined.resize(vertexCount);
+		firstOriginal.clear();
+		positions.clear();
+		for (unsigned k = 0; k < vertexCount; ++k)
+		{
+			const unsigned i = originals[k];
+			if (k == 0 || std::memcmp(&vertices[i].pos, &vertices[originals[k - 1]].pos, sizeof(H2B::VECTOR)) != 0)
+			{
+				firstOriginal.push_back(k);
+				positions.insert(positions.end(), { vertices[i].pos.x, vertices[i].pos.y, vertices[i].pos.z });
+			}
+			joined[i] = static_cast<unsigned>(firstOriginal.size()) - 1;
+		}
+		const unsigned count = static_cast<unsigned>(firstOriginal.size());
+		firstOriginal.push_back(vertexCount);
+
+		quadrics.assign(count, Quadric());
+		versions.assign(count, 0);
+		removed.assign(count, false);
+		border.assign(count, false);
+		marks.assign(count, 0);
+		mark = 0;
+		vertexTriangles.assign(count, std::vector<unsigned>());
+		triangles.clear();
+		borderEdges.clear();
+		heap = std::priority_queue<Collapse>();
+		liveTriangles = 0;
+		maxCost = 0;
+
+		// every triangle's plane goes to its corners, triangles that joining made degenerate are dropped
+		struct EdgeUse
+		{
+			unsigned count;
+			unsigned mesh;
+			unsigned triangle; // the first one, for the border plane
+			bool seam;
+		};
+		std::unordered_map<unsigned long long, EdgeUse> edges;
+		for (unsigned m = 0; m < meshCount; ++m)
+		{
+			if (meshes[m].indexOffset + meshes[m].indexCount > indexCount)
+				continue;
+			for (unsigned i = 0; i + 2 < meshes[m].indexCount; i += 3)
+			{
+				const unsigned* corners = indices + meshes[m].indexOffset + i;
+				Triangle tri = { { joined[corners[0]], joined[corners[1]], joined[corners[2]] }, m, true };
+				if (tri.corners[0] == tri.corners[1] || tri.corners[1] == tri.corners[2] || tri.corners[0] == tri.corners[2])
+					continue;
+				const unsigned t = static_cast<unsigned>(triangles.size());
+				triangles.push_back(tri);
+				++liveTriangles;
+				double n[3];
+				Normal(Position(tri.corners[0]), Position(tri.corners[1]), Position(tri.corners[2]), n);
+				const double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				for (int c = 0; c < 3; ++c)
+				{
+					vertexTriangles[tri.corners[c]].push_back(t);
+					if (length > 0)
+					{
+						const double* p = Position(tri.corners[0]);
+						const double d = -(n[0] * p[0] + n[1] * p[1] + n[2] * p[2]) / length;
+						quadrics[tri.corners[c]].AddPlane(n[0] / length, n[1] / length, n[2] / length, d, 1.0);
+					}
+					auto use = edges.emplace(EdgeKey(tri.corners[c], tri.corners[(c + 1) % 3]), EdgeUse{ 0, m, t, false }).first;
+					++use->second.count;
+					use->second.seam = use->second.seam || use->second.mesh != m;
+				}
+			}
+		}
+		// open, non manifold and material edges hold a plane through the edge, upright on its triangle
+		for (const auto& edge : edges)
+		{
+			if (edge.second.count == 2 && !edge.second.seam)
+				continue;
+			const unsigned a = static_cast<unsigned>(edge.first >> 32), b = static_cast<unsigned>(edge.first);
+			borderEdges.insert(edge.first);
+			border[a] = border[b] = true;
+			const Triangle& tri = triangles[edge.second.triangle];
+			double n[3];
+			Normal(Position(tri.corners[0]), Position(tri.corners[1]), Position(tri.corners[2]), n);
+			const double* pa = Position(a);
+			const double* pb = Position(b);
+			const double e[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+			double side[3] = { e[1] * n[2] - e[2] * n[1], e[2] * n[0] - e[0] * n[2], e[0] * n[1] - e[1] * n[0] };
+			const double length = std::sqrt(side[0] * side[0] + side[1] * side[1] + side[2] * side[2]);
+			if (length == 0)
+				continue;
+			for (double& s : side)
+				s /= length;
+			const double d = -(side[0] * pa[0] + side[1] * pa[1] + side[2] * pa[2]);
+			quadrics[a].AddPlane(side[0], side[1], side[2], d, 1.0);
+			quadrics[b].AddPlane(side[0], side[1], side[2], d, 1.0);
+		}
+		for (unsigned v = 0; v < count; ++v)
+			if (!vertexTriangles[v].empty())
+				Requeue(v);
+	}
+
+	// Collapses until at most targetTriangles are left or no valid collapse remains, returns how many are left
+	unsigned Reduce(unsigned targetTriangles)
+	{
+		while (liveTriangles > targetTriangles && !heap.empty())
+		{
+			const Collapse collapse = heap.top();
+			heap.pop();
+			if (removed[collapse.from] || collapse.version != versions[collapse.from])
+				continue; // superseded
+			if (removed[collapse.to] || !IsValid(collapse.from, collapse.to))
+			{
+				Requeue(collapse.from);
+				continue;
+			}
+			Apply(collapse);
+		}
+		return liveTriangles;
+	}
+
+	unsigned GetTriangleCount() const { return liveTriangles; }
+	float GetError() const { return static_cast<float>(std::sqrt(maxCost)); }
+
+	// Appends the remaining triangles mesh by mesh to indices, each mesh cache optimized, and
+	// records where they went. vertices are the ones given to Build.
+	void Emit(const H2B::VERTEX* vertices, unsigned vertexCount, std::vector<unsigned>& indices, unsigned meshCount, MeshLod& lod)
+	{
+		lod.meshes.resize(meshCount);
+		lod.error = GetError();
+		lod.triangleCount = liveTriangles;
+		for (unsigned m = 0; m < meshCount; ++m)
+		{
+			const unsigned first = static_cast<unsigned>(indices.size());
+			for (const Triangle& tri : triangles)
+			{
+				if (!tri.alive || tri.mesh != m)
+					continue;
+				double n[3];
+				Normal(Position(tri.corners[0]), Position(tri.corners[1]), Position(tri.corners[2]), n);
+				for (unsigned j : tri.corners)
+				{
+					unsigned best = originals[firstOriginal[j]];
+					double bestDot = -HUGE_VAL;
+					for (unsigned k = firstOriginal[j]; k < firstOriginal[j + 1]; ++k)
+					{
+						const H2B::VECTOR& normal = vertices[originals[k]].nrm;
+						const double dot = normal.x * n[0] + normal.y * n[1] + normal.z * n[2];
+						if (dot > bestDot)
+						{
+							bestDot = dot;
+							best = originals[k];
+						}
+					}
+					indices.push_back(best);
+				}
+			}
+			lod.meshes[m].indexOffset = first;
+			lod.meshes[m].indexCount = static_cast<unsigned>(indices.size()) - first;
+			OptimizeVertexCache(indices.data() + first, lod.meshes[m].indexCount, vertexCount);
+		}
+	}
+};
+
+// Appends up to MAX_LOD_COUNT - 1 coarser levels of a model to its indices, one per
+// LOD_TRIANGLE_RATIOS entry of the full triangle count. A level saving under a fifth of the
+// previous one's triangles ends the chain, models that do not simplify well get fewer levels.
+inline std::vector<MeshLod> GenerateLods(const std::vector<H2B::VERTEX>& vertices, std::vector<unsigned>& indices,
+	const H2B::BATCH* meshes, unsigned meshCount)
+{
+	std::vector<MeshLod> lods;
+	unsigned triangleCount = 0;
+	for (unsigned m = 0; m < meshCount; ++m)
+		triangleCount += meshes[m].indexCount / 3;
+	if (triangleCount < LOD_MIN_TRIANGLES)
+		return lods;
+	MeshSimplifier simplifier;
+	simplifier.Build(vertices.data(), static_cast<unsigned>(vertices.size()), indices.data(),
+		static_cast<unsigned>(indices.size()), meshes, meshCount);
+	unsigned previous = triangleCount;
+	for (float ratio : LOD_TRIANGLE_RATIOS)
+	{
+		const unsigned left = simplifier.Reduce(static_cast<unsigned>(triangleCount * ratio));
+		if (left == 0 || left > previous * 0.8f)
+			break;
+		lods.emplace_back();
+		simplifier.Emit(vertices.data(), static_cast<unsigned>(vertices.size()), indices, meshCount, lods.back());
+		previous = left;
+	}
+	return lods;
+}
+
+#endif
@@ -0,0 +1,161 @@
+//parseBench.cpp
+// Parses the two shipped levels plus a generated level of 100k MESH records with LevelTextParser
+// over the mapped file and with the GFile::ReadLine + sscanf loop LoadLevel used before it. Both
+// must find the same models with bit identical matrices. Times are the best of five parses,
+// opening the file included. GameLevel.txt is left out on purpose: some of its records are
+// indented, which the old loop skipped and LevelTextParser reads.
+//   ParseBench <levels folder> [generated records, default 100000]
+#define GATEWARE_ENABLE_CORE // All libraries need this
+#define GATEWARE_ENABLE_SYSTEM // GFile & GLog used by the level loader
+#define GATEWARE_ENABLE_MATH
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cstdio>
+#include "../gateware-main/gateware-main/Gateware.h"
+#include "h2bMappedParser.h"
+#include "levelParser.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double Milliseconds(Clock::time_point from, Clock::time_point to)
+{
+	return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+struct ParsedModel
+{
+	std::string name;
+	float matrix[16];
+};
+
+// LevelTextParser's MESH records, false on a parse error
+static bool ParseMapped(const std::string& path, std::vector<ParsedModel>& models)
+{
+	models.clear();
+	H2B::MappedFile file;
+	if (!file.Open(path.c_str()))
+		return false;
+	LevelTextParser parser(file.Data(), file.Size());
+	LevelRecord record;
+	while (parser.Next(record))
+		if (record.type == LevelRecordType::MESH)
+		{
+			models.push_back({ std::string(record.name), {} });
+			std::memcpy(models.back().matrix, record.matrix, sizeof(record.matrix));
+		}
+	if (parser.HasError())
+		std::cout << path << ":" << parser.GetError().line << ":" << parser.GetError().column << ": " <<
+			parser.GetError().message << std::endl;
+	return !parser.HasError();
+}
+
+// The loop LoadLevel had before LevelTextParser, line by line through GFile with sscanf
+static bool ParseLines(const std::string& path, std::vector<ParsedModel>& models)
+{
+	models.clear();
+	GW::SYSTEM::GFile file;
+	file.Create();
+	if (-file.OpenTextRead(path.c_str()))
+		return false;
+	char linebuffer[1024];
+	while (+file.ReadLine(linebuffer, 1024, '\n'))
+	{
+		if (linebuffer[0] == '\0')
+			break;
+		if (std::strcmp(linebuffer, "MESH") == 0)
+		{
+			ParsedModel model;
+			file.ReadLine(linebuffer, 1024, '\n');
+			model.name = linebuffer;
+			for (int i = 0; i < 4; ++i)
+			{
+				file.ReadLine(linebuffer, 1024, '\n');
+				std::sscanf(linebuffer + 13, "%f, %f, %f, %f",
+					&model.matrix[0 + i * 4], &model.matrix[1 + i * 4], &model.matrix[2 + i * 4], &model.matrix[3 + i * 4]);
+			}
+			models.push_back(std::move(model));
+		}
+	}
+	file.CloseFile();
+	return true;
+}
+
+// Exporter layout: four decimals padded to the column, every tenth record printed with %g
+// instead so exponents and longer mantissas take the strtof fallback
+static void GenerateLevel(const std::string& path, unsigned records)
+{
+	std::ofstream level(path);
+	level << "# Game Level Exporter v1.3\n";
+	std::mt19937 random(records);
+	std::uniform_real_distribution<float> value(-500.0f, 500.0f);
+	char number[32];
+	for (unsigned r = 0; r < records; ++r)
+	{
+		level << "MESH\nModel_" << r % 500 << "." << std::setw(3) << std::setfill('0') << r / 500 % 1000 << std::setfill(' ') << "\n";
+		for (int row = 0; row < 4; ++row)
+		{
+			level << (row == 0 ? "<Matrix 4x4 (" : "            (");
+			for (int column = 0; column < 4; ++column)
+			{
+				const float v = value(random) / (r % 10 == 9 ? 1e5f : 1.0f);
+				std::snprintf(number, sizeof(number), r % 10 == 9 ? "%.7g" : "%7.4f", v);
+				level << (column > 0 ? ", " : "") << number;
+			}
+			level << (row == 3 ? ")>\n" : ")\n");
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 2 && argc != 3)
+	{
+		std::cout << "usage: ParseBench <levels folder> [generated records]" << std::endl;
+		return 1;
+	}
+	const unsigned generatedRecords = argc == 3 ? std::max(1u, static_cast<unsigned>(std::stoul(argv[2]))) : 100000;
+	const int passes = 5;
+	std::vector<std::string> levels = { std::string(argv[1]) + "/GameLevelOne.txt", std::string(argv[1]) + "/GameLevelTwo.txt" };
+	const std::string generated = (std::filesystem::temp_directory_path() / "ParseBenchLevel.txt").string();
+	GenerateLevel(generated, generatedRecords);
+	levels.push_back(generated);
+
+	std::cout << "best of " << passes << " parses" << std::endl;
+	std::cout << std::left << std::setw(22) << "level" << std::right << std::setw(9) << "models" << std::setw(12) <<
+		"parser ms" << std::setw(12) << "sscanf ms" << std::setw(10) << "speedup" << std::setw(7) << "same" << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+	bool allSame = true;
+	std::vector<ParsedModel> mapped, lines;
+	for (const std::string& path : levels)
+	{
+		double mappedMs = HUGE_VAL, linesMs = HUGE_VAL;
+		bool parsed = true;
+		for (int pass = 0; pass < passes; ++pass)
+		{
+			Clock::time_point start = Clock::now();
+			parsed &= ParseMapped(path, mapped);
+			mappedMs = std::min(mappedMs, Milliseconds(start, Clock::now()));
+
+			start = Clock::now();
+			parsed &= ParseLines(path, lines);
+			linesMs = std::min(linesMs, Milliseconds(start, Clock::now()));
+		}
+		bool same = parsed && !mapped.empty() && mapped.size() == lines.size();
+		for (size_t m = 0; same && m < mapped.size(); ++m)
+			same = mapped[m].name == lines[m].name && std::memcmp(mapped[m].matrix, lines[m].matrix, sizeof(mapped[m].matrix)) == 0;
+		allSame &= same;
+		std::cout << std::left << std::setw(22) << std::filesystem::path(path).filename().string() << std::right <<
+			std::setw(9) << mapped.size() << std::setw(12) << mappedMs << std::setw(12) << linesMs << std::setw(9) <<
+			linesMs / mappedMs << "x" << std::setw(7) << (same ? "yes" : "NO") << std::endl;
+	}
+	std::filesystem::remove(generated);
+	if (!allSame)
+		std::cout << "MISMATCH: LevelTextParser and ReadLine + sscanf read other models or matrices" << std::endl;
+	return allSame ? 0 : 1;
+}
@@ -0,0 +1,365 @@
+//recordingBackend
+// Null RenderBackend: does no GPU work, instead it keeps buffer contents in CPU memory
+// and records every command it is given. Lets the renderer run headless on Linux and
+// lets a caller inspect (or count) exactly what a frame would have sent to the GPU.
+// Command lists keep their commands in their own vector, executing one appends them to the
+// backend's stream, so what reaches the "GPU" is the same as if the backend had been called.
+#ifndef _RECORDINGBACKEND_H_
+#define _RECORDINGBACKEND_H_
+#include <vector>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include "renderBackend.h"
+
+enum class RecordedCommandType
+{
+	CREATE_BUFFER,
+	UPDATE_BUFFER,
+	UPDATE_BUFFER_RANGE,
+	COPY_BUFFER_RANGE,
+	DESTROY_BUFFER,
+	MAP_BUFFER,
+	UNMAP_BUFFER,
+	CREATE_PIPELINE,
+	BEGIN_FRAME,
+	PRESENT,
+	BIND_PIPELINE,
+	BIND_VERTEX_BUFFER,
+	BIND_VERTEX_BUFFERS,
+	BIND_INDEX_BUFFER,
+	BIND_CONSTANT_BUFFERS,
+	BIND_SHADER_RESOURCES,
+	DRAW_INDEXED,
+	DRAW_INDEXED_INSTANCED,
+	EXECUTE_COMMAND_LIST, // the list's commands follow, args[0] of them
+	COUNT
+};
+
+// Arguments are stored in the order the matching RenderBackend call takes them
+struct RecordedCommand
+{
+	RecordedCommandType type;
+	unsigned args[5];
+	int baseVertex;
+};
+
+// Turns binds & draws into RecordedCommands for Store, shared by the backend and its lists
+template <typename Base>
+class RecordedCommandEncoder : public Base
+{
+protected:
+	virtual void Store(const RecordedCommand& command) = 0;
+	void Encode(RecordedCommandType type, unsigned a = 0, unsigned b = 0, unsigned c = 0, unsigned d = 0,
+		unsigned e = 0, int baseVertex = 0)
+	{
+		Store({ type, { a, b, c, d, e }, baseVertex });
+	}
+
+public:
+	void BindPipeline(PipelineHandle pipeline) override
+	{
+		Encode(RecordedCommandType::BIND_PIPELINE, pipeline);
+	}
+
+	void BindVertexBuffer(BufferHandle buffer, unsigned stride, unsigned offset) override
+	{
+		Encode(RecordedCommandType::BIND_VERTEX_BUFFER, buffer, stride, offset);
+	}
+
+	// the stream only has room for two handles, enough for mesh + instances
+	void BindVertexBuffers(unsigned startSlot, const BufferHandle* handles, const unsigned* /*strides*/,
+		const unsigned* /*offsets*/, unsigned count) override
+	{
+		Encode(RecordedCommandType::BIND_VERTEX_BUFFERS, startSlot, count,
+			count > 0 ? handles[0] : INVALID_BUFFER, count > 1 ? handles[1] : INVALID_BUFFER);
+	}
+
+	void BindIndexBuffer(BufferHandle buffer, IndexFormat format, unsigned offset) override
+	{
+		Encode(RecordedCommandType::BIND_INDEX_BUFFER, buffer, static_cast<unsigned>(format), offset);
+	}
+
+	// and for SceneData + DrawData
+	void BindConstantBuffers(unsigned startSlot, const BufferHandle* handles, unsigned count) override
+	{
+		Encode(RecordedCommandType::BIND_CONSTANT_BUFFERS, startSlot, count,
+			count > 0 ? handles[0] : INVALID_BUFFER, count > 1 ? handles[1] : INVALID_BUFFER);
+	}
+
+	void BindShaderResources(unsigned startSlot, const BufferHandle* handles, unsigned count) override
+	{
+		Encode(RecordedCommandType::BIND_SHADER_RESOURCES, startSlot, count,
+			count > 0 ? handles[0] : INVALID_BUFFER, count > 1 ? handles[1] : INVALID_BUFFER);
+	}
+
+	void DrawIndexed(unsigned indexCount, unsigned firstIndex, int baseVertex) override
+	{
+		Encode(RecordedCommandType::DRAW_INDEXED, indexCount, firstIndex, 0, 0, 0, baseVertex);
+	}
+
+	void DrawIndexedInstanced(unsigned indexCount, unsigned instanceCount, unsigned firstIndex,
+		int baseVertex, unsigned firstInstance) override
+	{
+		Encode(RecordedCommandType::DRAW_INDEXED_INSTANCED, indexCount, instanceCount, firstIndex, firstInstance, 0, baseVertex);
+	}
+};
+
+// Commands stay here until RecordingBackend::ExecuteCommandList copies them into the stream
+class RecordingCommandList : public RecordedCommandEncoder<CommandList>
+{
+	friend class RecordingBackend;
+	std::vector<RecordedCommand> commands; // capacity is kept across Begin
+
+protected:
+	void Store(const RecordedCommand& command) override
+	{
+		commands.push_back(command);
+	}
+
+public:
+	void Begin() override
+	{
+		commands.clear();
+	}
+	void End() override {}
+	const std::vector<RecordedCommand>& GetCommands() const { return commands; }
+};
+
+class RecordingBackend : public RecordedCommandEncoder<RenderBackend>
+{
+public:
+	struct RecordedBuffer
+	{
+		BufferDesc desc;
+		std::vector<char> contents;
+		bool alive;
+	};
+	struct RecordedPipeline
+	{
+		std::string vertexShader; // "<path>:<entry>:<profile>"
+		std::string pixelShader;
+		std::vector<VertexElement> elements;
+	};
+
+private:
+	std::vector<RecordedBuffer> buffers; // handle - 1
+	std::vector<RecordedPipeline> pipelines; // handle - 1
+	std::vector<RecordedCommand> commands;
+	unsigned counts[static_cast<unsigned>(RecordedCommandType::COUNT)] = {};
+	bool recording = true;
+	// what a real device would have bound right now, to spot binds that change nothing
+	PipelineHandle boundPipeline = INVALID_PIPELINE;
+	BufferHandle boundVertexBuffers[2] = {};
+	BufferHandle boundIndexBuffer = INVALID_BUFFER;
+	BufferHandle boundConstantBuffers[2] = {};
+	BufferHandle boundShaderResource = INVALID_BUFFER; // slot 0
+	unsigned redundantBinds = 0;
+
+	// Sets bound to value, counting it as redundant if it already was
+	template <typename T>
+	void Bind(T& bound, T value)
+	{
+		if (bound == value)
+			++redundantBinds;
+		bound = value;
+	}
+
+	// Slots 0 & 1 of a multi slot bind, one redundant bind if every handle was already there
+	void BindSlots(BufferHandle bound[2], const RecordedCommand& command)
+	{
+		const unsigned startSlot = command.args[0], count = command.args[1];
+		if (startSlot + count > 2 || count == 0)
+			return;
+		bool same = true;
+		for (unsigned i = 0; i < count; ++i)
+		{
+			same = same && bound[startSlot + i] == command.args[2 + i];
+			bound[startSlot + i] = command.args[2 + i];
+		}
+		redundantBinds += same ? 1 : 0;
+	}
+	void ClearBindings()
+	{
+		boundPipeline = INVALID_PIPELINE;
+		boundVertexBuffers[0] = boundVertexBuffers[1] = INVALID_BUFFER;
+		boundIndexBuffer = INVALID_BUFFER;
+		boundConstantBuffers[0] = boundConstantBuffers[1] = INVALID_BUFFER;
+		boundShaderResource = INVALID_BUFFER;
+	}
+
+	// Every command, from the backend's own calls or an executed list, comes through here
+	void Store(const RecordedCommand& command) override
+	{
+		switch (command.type)
+		{
+		case RecordedCommandType::BIND_PIPELINE: Bind(boundPipeline, command.args[0]); break;
+		case RecordedCommandType::BIND_VERTEX_BUFFER: Bind(boundVertexBuffers[0], command.args[0]); break;
+		case RecordedCommandType::BIND_VERTEX_BUFFERS: BindSlots(boundVertexBuffers, command); break;
+		case RecordedCommandType::BIND_INDEX_BUFFER: Bind(boundIndexBuffer, command.args[0]); break;
+		case RecordedCommandType::BIND_CONSTANT_BUFFERS: BindSlots(boundConstantBuffers, command); break;
+		case RecordedCommandType::BIND_SHADER_RESOURCES:
+			if (command.args[0] == 0 && command.args[1] > 0)
+				Bind(boundShaderResource, command.args[2]);
+			break;
+		default: break;
+		}
+		++counts[static_cast<unsigned>(command.type)];
+		if (recording)
+			commands.push_back(command);
+	}
+	void Record(RecordedCommandType type, unsigned a = 0, unsigned b = 0, unsigned c = 0, unsigned d = 0, unsigned e = 0)
+	{
+		Encode(type, a, b, c, d, e);
+	}
+
+	static std::string ShaderName(const char* path, const char* entry, const char* profile)
+	{
+		return std::string(path) + ":" + entry + ":" + profile;
+	}
+
+public:
+	BufferHandle CreateBuffer(const BufferDesc& desc, const void* initialData) override
+	{
+		RecordedBuffer buffer = { desc, std::vector<char>(desc.sizeInBytes), true };
+		if (initialData != nullptr)
+			std::memcpy(buffer.contents.data(), initialData, desc.sizeInBytes);
+		buffers.push_back(std::move(buffer));
+		BufferHandle handle = static_cast<BufferHandle>(buffers.size());
+		Record(RecordedCommandType::CREATE_BUFFER, handle, static_cast<unsigned>(desc.type), desc.sizeInBytes);
+		return handle;
+	}
+
+	void UpdateBuffer(BufferHandle buffer, const void* data, unsigned sizeInBytes) override
+	{
+		if (IsValid(buffer))
+		{
+			std::vector<char>& contents = buffers[buffer - 1].contents;
+			std::memcpy(contents.data(), data, sizeInBytes < contents.size() ? sizeInBytes : contents.size());
+		}
+		Record(RecordedCommandType::UPDATE_BUFFER, buffer, sizeInBytes);
+	}
+
+	void UpdateBufferRange(BufferHandle buffer, unsigned offsetInBytes, const void* data, unsigned sizeInBytes) override
+	{
+		if (IsValid(buffer) && offsetInBytes + sizeInBytes <= buffers[buffer - 1].contents.size())
+			std::memcpy(buffers[buffer - 1].contents.data() + offsetInBytes, data, sizeInBytes);
+		Record(RecordedCommandType::UPDATE_BUFFER_RANGE, buffer, offsetInBytes, sizeInBytes);
+	}
+
+	void CopyBufferRange(BufferHandle destination, unsigned destinationOffset,
+		BufferHandle source, unsigned sourceOffset, unsigned sizeInBytes) override
+	{
+		if (IsValid(destination) && IsValid(source) &&
+			destinationOffset + sizeInBytes <= buffers[destination - 1].contents.size() &&
+			sourceOffset + sizeInBytes <= buffers[source - 1].contents.size())
+			std::memmove(buffers[destination - 1].contents.data() + destinationOffset,
+				buffers[source - 1].contents.data() + sourceOffset, sizeInBytes);
+		Record(RecordedCommandType::COPY_BUFFER_RANGE, destination, destinationOffset, source, sourceOffset, sizeInBytes);
+	}
+
+	void DestroyBuffer(BufferHandle buffer) override
+	{
+		if (IsValid(buffer))
+		{
+			buffers[buffer - 1].alive = false;
+			buffers[buffer - 1].contents.clear();
+			buffers[buffer - 1].contents.shrink_to_fit();
+		}
+		Record(RecordedCommandType::DESTROY_BUFFER, buffer);
+	}
+
+	// Maps straight onto the kept contents, so whatever the caller writes can be inspected
+	void* MapBuffer(BufferHandle buffer, MapMode mode) override
+	{
+		Record(RecordedCommandType::MAP_BUFFER, buffer, static_cast<unsigned>(mode));
+		return IsValid(buffer) ? buffers[buffer - 1].contents.data() : nullptr;
+	}
+
+	void UnmapBuffer(BufferHandle buffer) override
+	{
+		Record(RecordedCommandType::UNMAP_BUFFER, buffer);
+	}
+
+	PipelineHandle CreatePipeline(const PipelineDesc& desc) override
+	{
+		RecordedPipeline pipeline;
+		pipeline.vertexShader = ShaderName(desc.vertexShaderPath, desc.vertexEntryPoint, desc.vertexProfile);
+		pipeline.pixelShader = ShaderName(desc.pixelShaderPath, desc.pixelEntryPoint, desc.pixelProfile);
+		pipeline.elements.assign(desc.elements, desc.elements + desc.elementCount);
+		for (size_t i = 0; i < pipelines.size(); ++i) // same description, same handle
+		{
+			const RecordedPipeline& other = pipelines[i];
+			if (other.vertexShader == pipeline.vertexShader && other.pixelShader == pipeline.pixelShader &&
+				other.elements.size() == pipeline.elements.size() &&
+				std::equal(other.elements.begin(), other.elements.end(), pipeline.elements.begin(),
+					[](const VertexElement& a, const VertexElement& b) {
+						return std::strcmp(a.semanticName, b.semanticName) == 0 && a.semanticIndex == b.semanticIndex &&
+							a.format == b.format && a.inputSlot == b.inputSlot && a.perInstance == b.perInstance; }))
+				return static_cast<PipelineHandle>(i + 1);
+		}
+		pipelines.push_back(std::move(pipeline));
+		PipelineHandle handle = static_cast<PipelineHandle>(pipelines.size());
+		Record(RecordedCommandType::CREATE_PIPELINE, handle);
+		return handle;
+	}
+
+	void BeginFrame(const float /*clearColor*/[4]) override
+	{
+		Record(RecordedCommandType::BEGIN_FRAME);
+	}
+
+	void Present(unsigned syncInterval) override
+	{
+		Record(RecordedCommandType::PRESENT, syncInterval);
+	}
+
+	std::unique_ptr<CommandList> CreateCommandList() override
+	{
+		return std::unique_ptr<CommandList>(new RecordingCommandList());
+	}
+
+	// Like a D3D11 command list the binds start and end cleared, so none in a list are redundant
+	// to what was bound before it
+	void ExecuteCommandList(CommandList& list) override
+	{
+		const std::vector<RecordedCommand>& listCommands = static_cast<RecordingCommandList&>(list).commands;
+		Record(RecordedCommandType::EXECUTE_COMMAND_LIST, static_cast<unsigned>(listCommands.size()));
+		ClearBindings();
+		for (const RecordedCommand& command : listCommands)
+			Store(command);
+		ClearBindings();
+	}
+
+	// Inspection //////////////////////////////////////////////////
+	bool IsValid(BufferHandle buffer) const
+	{
+		return buffer != INVALID_BUFFER && buffer <= buffers.size() && buffers[buffer - 1].alive;
+	}
+	const RecordedBuffer& GetBuffer(BufferHandle buffer) const { return buffers[buffer - 1]; }
+	const RecordedPipeline& GetPipeline(PipelineHandle pipeline) const { return pipelines[pipeline - 1]; }
+	unsigned GetLiveBufferCount() const
+	{
+		unsigned live = 0;
+		for (const RecordedBuffer& b : buffers)
+			live += b.alive ? 1 : 0;
+		return live;
+	}
+	const std::vector<RecordedCommand>& GetCommands() const { return commands; }
+	unsigned GetCount(RecordedCommandType type) const { return counts[static_cast<unsigned>(type)]; }
+	// Pipeline, vertex/index/constant buffer & shader resource binds that set what was already bound
+	unsigned GetRedundantBindCount() const { return redundantBinds; }
+
+	// Recording can be switched off to only keep counts (for long benchmark runs)
+	void SetRecording(bool enabled) { recording = enabled; }
+	// Forgets recorded commands and counts, keeps buffers & pipelines. Command capacity is
+	// kept too so steady state frames do not allocate.
+	void ClearCommands()
+	{
+		commands.clear();
+		std::memset(counts, 0, sizeof(counts));
+		redundantBinds = 0;
+	}
+};
+
+#endif
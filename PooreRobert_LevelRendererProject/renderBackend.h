@@ -0,0 +1,131 @@
+//renderBackend
+// The small set of GPU operations the level renderer actually needs. Level_Objects and
+// its assets only talk to this interface, D3D11Backend implements it for the game and
+// RecordingBackend implements it with no GPU at all so loading and draw submission
+// can be built, tested and profiled on machines without Direct3D.
+// Binds & draws can also be recorded on other threads into CommandLists (deferred contexts
+// for D3D11, in memory commands for RecordingBackend) and executed in order on the render thread.
+#ifndef _RENDERBACKEND_H_
+#define _RENDERBACKEND_H_
+#include <memory>
+
+// Handles are small integers owned by the backend, 0 is never a valid handle
+typedef unsigned BufferHandle;
+typedef unsigned PipelineHandle;
+const BufferHandle INVALID_BUFFER = 0;
+const PipelineHandle INVALID_PIPELINE = 0;
+
+enum class BufferType { VERTEX, INDEX, CONSTANT, STRUCTURED };
+enum class BufferUsage
+{
+	STATIC, // written at creation or in parts with UpdateBufferRange/CopyBufferRange
+	DYNAMIC // rewritten by the CPU with UpdateBuffer or MapBuffer
+};
+enum class MapMode
+{
+	DISCARD, // the old contents are thrown away, the GPU keeps reading its own copy
+	NO_OVERWRITE // keeps the contents, the caller promises to only write parts the GPU is not using
+};
+enum class IndexFormat { UINT16, UINT32 };
+enum class VertexFormat
+{
+	FLOAT2, FLOAT3, FLOAT4,
+	UNORM16X4, // 0..65535 read as 0..1
+	SNORM16X2, // -32767..32767 read as -1..1
+	HALF2
+};
+
+struct BufferDesc
+{
+	BufferType type;
+	BufferUsage usage;
+	unsigned sizeInBytes;
+	unsigned structureStride = 0; // STRUCTURED only, bytes per element
+};
+
+// One vertex shader input, elements are packed in order within their slot
+struct VertexElement
+{
+	const char* semanticName;
+	unsigned semanticIndex;
+	VertexFormat format;
+	unsigned inputSlot;
+	bool perInstance;
+};
+
+// Shaders plus vertex layout, backends return the same handle for identical descriptions
+struct PipelineDesc
+{
+	const char* vertexShaderPath;
+	const char* vertexEntryPoint;
+	const char* vertexProfile;
+	const char* pixelShaderPath;
+	const char* pixelEntryPoint;
+	const char* pixelProfile;
+	const VertexElement* elements;
+	unsigned elementCount;
+};
+
+// State binding & draws, everything a CommandList can hold
+class CommandRecorder
+{
+public:
+	virtual ~CommandRecorder() {}
+
+	// State binding, constant buffers are bound to both the vertex and pixel stages
+	virtual void BindPipeline(PipelineHandle pipeline) = 0;
+	virtual void BindVertexBuffer(BufferHandle buffer, unsigned stride, unsigned offset) = 0;
+	// slot 0 is usually the mesh, slot 1 per instance data
+	virtual void BindVertexBuffers(unsigned startSlot, const BufferHandle* buffers, const unsigned* strides,
+		const unsigned* offsets, unsigned count) = 0;
+	virtual void BindIndexBuffer(BufferHandle buffer, IndexFormat format, unsigned offset) = 0;
+	virtual void BindConstantBuffers(unsigned startSlot, const BufferHandle* buffers, unsigned count) = 0;
+	// STRUCTURED buffers as shader resources (t registers), also bound to both stages
+	virtual void BindShaderResources(unsigned startSlot, const BufferHandle* buffers, unsigned count) = 0;
+
+	virtual void DrawIndexed(unsigned indexCount, unsigned firstIndex, int baseVertex) = 0;
+	// firstInstance offsets the per instance vertex buffers
+	virtual void DrawIndexedInstanced(unsigned indexCount, unsigned instanceCount, unsigned firstIndex,
+		int baseVertex, unsigned firstInstance) = 0;
+};
+
+// Binds & draws recorded on any thread (one at a time per list) between Begin and End, then
+// played on the render thread with RenderBackend::ExecuteCommandList. A list starts with nothing
+// bound but the frame's render target, so it binds everything it draws with itself. No buffers
+// or pipelines may be created or destroyed while lists record.
+class CommandList : public CommandRecorder
+{
+public:
+	// Drops whatever was recorded before
+	virtual void Begin() = 0;
+	virtual void End() = 0;
+};
+
+class RenderBackend : public CommandRecorder
+{
+public:
+	// Resource creation, initialData may be nullptr for DYNAMIC buffers
+	virtual BufferHandle CreateBuffer(const BufferDesc& desc, const void* initialData) = 0;
+	virtual void UpdateBuffer(BufferHandle buffer, const void* data, unsigned sizeInBytes) = 0;
+	virtual void DestroyBuffer(BufferHandle buffer) = 0;
+	// Partial writes & GPU side copies for STATIC buffers, offsets and sizes in bytes
+	virtual void UpdateBufferRange(BufferHandle buffer, unsigned offsetInBytes, const void* data, unsigned sizeInBytes) = 0;
+	virtual void CopyBufferRange(BufferHandle destination, unsigned destinationOffset,
+		BufferHandle source, unsigned sourceOffset, unsigned sizeInBytes) = 0;
+	// Direct CPU write access to a DYNAMIC buffer, nullptr on failure. Unmap before drawing with it.
+	virtual void* MapBuffer(BufferHandle buffer, MapMode mode) = 0;
+	virtual void UnmapBuffer(BufferHandle buffer) = 0;
+	virtual PipelineHandle CreatePipeline(const PipelineDesc& desc) = 0;
+
+	// Frame begin clears & binds the back buffer, Present flips it
+	virtual void BeginFrame(const float clearColor[4]) = 0;
+	virtual void Present(unsigned syncInterval) = 0;
+
+	// A list for recording on another thread, it must not outlive the backend
+	virtual std::unique_ptr<CommandList> CreateCommandList() = 0;
+	// Render thread only, plays a list recorded since BeginFrame. Afterwards nothing is bound
+	// (besides the render target), the same as at the start of a list.
+	virtual void ExecuteCommandList(CommandList& list) = 0;
+};
+
+#endif
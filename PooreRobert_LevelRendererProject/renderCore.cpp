@@ -0,0 +1,12 @@
+//renderCore.cpp
+// Translation unit for the platform neutral renderer core (LevelRendererCore in CMake).
+// Only Gateware's core, system and math libraries are enabled here, no Direct3D, so this
+// builds on Linux and is what headless tools and benchmarks link against.
+#define GATEWARE_ENABLE_CORE // All libraries need this
+#define GATEWARE_ENABLE_SYSTEM // GFile & GLog used by the level loader
+#define GATEWARE_ENABLE_MATH
+
+#include "../gateware-main/gateware-main/Gateware.h"
+#include "load_object_oriented.h"
+#include "levelStreamer.h"
+#include "recordingBackend.h"
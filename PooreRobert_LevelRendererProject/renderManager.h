@@ -1,7 +1,11 @@
 //RenderManager
 #include <d3dcompiler.h>	// required for compiling shaders on the fly, consider pre-compiling instead
 
+#include <filesystem>
 #include "load_object_oriented.h"
+#include "levelStreamer.h"
+#include "d3d11Backend.h"
+#include "frameScheduler.h"
 #pragma comment(lib, "d3dcompiler.lib") 
 
 
@@ -10,8 +14,6 @@
 // Creation, Rendering & Cleanup
 class RenderManager
 {
-	std::chrono::steady_clock::time_point lastUpdate; //Timer variables
-	float deltaTime;
 
 	GW::MATH::GMatrix proxyMat; // proxy handles
 	GW::SYSTEM::GWindow win;
@@ -20,18 +22,27 @@ class RenderManager
 	GW::INPUT::GInput input;  //Support for Keyboard Input or Controller (Controller not implimented)
 	GW::INPUT::GController controller;
 
-	GW::MATH::GMATRIXF world; //Declaration of World, View, and Projection Matrix
-	GW::MATH::GMATRIXF view;
+	GW::MATH::GMATRIXF view; //Declaration of View and Projection Matrix
 	GW::MATH::GMATRIXF pers;
 
 	GW::MATH::GMATRIXF currView; // Used in Specular Reflection
-
-	Level_Objects theLevel; //Level Objects
+	Camera camera; // state after the last fixed update
+	Camera previousCamera; // and the one before, frames are drawn between the two
+	Camera renderCamera; // owns the view, view & currView are copies of its last frame
+	float mouseX = 0.0f; // mouse movement since the last fixed update
+	float mouseY = 0.0f;
+	bool vsyncHeld = false;
+
+	D3D11Backend backend; // All GPU work goes through here, it also owns the shared shaders
+	JobSystem jobs; // one thread per core, this one included. Declared before levels so it outlives them
+	LevelStreamer levels; //Level Objects, the next level loads in the background
+	bool lvlOneHeld = false; // last frame's key states, level swaps trigger on press only
+	bool lvlTwoHeld = false;
 
 	GW::SYSTEM::GLog log; // handy for logging any messages/warning/errors
 
 public:
-	RenderManager(GW::SYSTEM::GWindow _win, GW::GRAPHICS::GDirectX11Surface _d3d)
+	RenderManager(GW::SYSTEM::GWindow _win, GW::GRAPHICS::GDirectX11Surface _d3d) : backend(_d3d)
 	{
 		win = _win;
 		d3d = _d3d;
@@ -41,7 +52,7 @@ public:
 		log.EnableConsoleLogging(true); // mirror output to the console
 		log.Log("Start Program.");
 
-		theLevel.LoadLevel("../Levels/GameLevelOne.txt", "../Models", log); //Loads Level in Object Oriented method
+		LoadLevel(levels.GetLevel(), "GameLevelOne", &jobs, log); //Loads Level in Object Oriented method
 
 		proxyMat.Create();		//Create Proxy and Initialize Matrices
 		CreateMatricies(_d3d);
@@ -49,45 +60,96 @@ public:
 		input.Create(_win); //Initialize int=puts
 		controller.Create();
 
-		theLevel.UploadLevelToGPU(_d3d, world, view, pers); //Send Initalized data to GPU
+		levels.GetLevel().UploadLevelToGPU(backend, view, pers); //Send Initalized data to GPU
+		LogShaderCache();
 	}
 
 	//constructor helper functions
+	// Prefers the .lvlpack built by PackLevels, falls back to the text level. Touches nothing but
+	// its arguments so it can run on the streaming thread. The level keeps using jobs once drawn.
+	static bool LoadLevel(Level_Objects& level, const char* levelName, JobSystem* jobs, GW::SYSTEM::GLog log)
+	{
+		level.SetJobSystem(jobs);
+		std::string path = std::string("../Levels/") + levelName;
+		if (std::filesystem::exists(path + ".lvlpack") && level.LoadLevelPack((path + ".lvlpack").c_str(), log))
+			return true;
+		return level.LoadLevel((path + ".txt").c_str(), "../Models", log);
+	}
+	void RequestLevel(const char* levelName)
+	{
+		std::string name = levelName;
+		GW::SYSTEM::GLog workerLog = log;
+		JobSystem* workerJobs = &jobs;
+		if (!levels.Request(levelName, [name, workerJobs, workerLog](Level_Objects& level) {
+			return LoadLevel(level, name.c_str(), workerJobs, workerLog); }))
+			log.LogCategorized("WARNING", ("Already loading " + levels.GetRequestedName() +
+				", ignoring request for " + name + ".").c_str());
+	}
+	void LogLoadTimings()
+	{
+		const LevelLoadTimings& t = levels.GetLastTimings();
+		std::string info = "Level Swap (ms) Load: " + std::to_string(t.loadMs) + " Wait: " + std::to_string(t.waitMs) +
+			" Upload: " + std::to_string(t.uploadMs) + " Unload: " + std::to_string(t.unloadMs) +
+			" Total: " + std::to_string(t.totalMs) + " Frames While Loading: " + std::to_string(t.framesWhileLoading);
+		log.LogCategorized("INFO", info.c_str());
+	}
+	void LogShaderCache()
+	{
+		const ShaderBytecodeCache& cache = backend.GetShaderLibrary().GetBytecodeCache();
+		std::string info = "Shaders Compiled: " + std::to_string(cache.GetCompileCount()) +
+			" Cache Hits: " + std::to_string(cache.GetCacheHitCount()) + " (Disk: " + std::to_string(cache.GetDiskHitCount()) + ")";
+		log.LogCategorized("INFO", info.c_str());
+	}
 
-	void Render()
+	RenderBackend& GetBackend()
 	{
+		return backend;
+	}
 
-		theLevel.RenderLevel(d3d, view, currView); //Renders the Inital Level on Construction
+	// alpha is how far this frame is from the last fixed update to the next, see FrameScheduler
+	void Render(float alpha)
+	{
+		renderCamera.Interpolate(previousCamera, camera, alpha);
+		const CameraFrame& frame = renderCamera.Update(); // no matrix inversion, see camera.h
+		view = frame.view;
+		currView = frame.world;
+
+		Level_Objects& theLevel = levels.GetLevel();
+		theLevel.RenderLevel(frame); //Renders the Inital Level on Construction
+#ifdef LEVELRENDERER_COUNT_ALLOCATIONS
+		if (theLevel.GetLastRenderAllocations() != 0) // drawing a loaded level should never allocate
+			log.LogCategorized("WARNING", ("RenderLevel allocated " +
+				std::to_string(theLevel.GetLastRenderAllocations()) + " times this frame.").c_str());
+#endif
 
 	}
-	void UpdateCamera()
-	{
-		proxyMat.InverseF(view, view); //Inverse the view matrix
 
-		float yChange = 0.0f; //Initialize Variables to contain the change over button presses and mouse movement
-		float zChange = 0.0f;
-		float xChange = 0.0f;
+	// Once per frame, the mouse moves between fixed updates add up until the next one uses them
+	void SampleInput()
+	{
 		float xDelta = 0.0f;
 		float yDelta = 0.0f;
-		float spaceC = 0.0f;					
+		if (input.GetMouseDelta(xDelta, yDelta) != GW::GReturn::REDUNDANT) //Prevent Camera drift by ignoring 
+		{																   //redundant movement
+			mouseX += xDelta;
+			mouseY += yDelta;
+		}
+	}
+
+	// One fixed update of step seconds
+	void UpdateCamera(double step)
+	{
+		CameraInput frameInput; //Collects this update's input for the camera
+		float spaceC = 0.0f;
 		float shiftC = 0.0f;
 		float wC = 0.0f;
 		float sC = 0.0f;
 		float aC = 0.0f;
 		float dC = 0.0f;
 
-		const float cSpeed = 3.0; //Camera Speed
-
-		GW::MATH::GMATRIXF zero;
-		proxyMat.IdentityF(zero);
-
-		unsigned int height = 0.0f; //Variables to contain the hight and width of the window and aspect ratio
-		unsigned int width = 0.0f; 
-		float aRatio = 0.0f;
-
-		win.GetClientHeight(height); // Collects Hight, Width, and Aspect Ratio
-		win.GetClientWidth(width);
-		d3d.GetAspectRatio(aRatio);
+		win.GetClientHeight(frameInput.height); // Collects Hight, Width, and Aspect Ratio
+		win.GetClientWidth(frameInput.width);
+		d3d.GetAspectRatio(frameInput.aspectRatio);
 
 		input.GetState(G_KEY_SPACE, spaceC);	//Collects Input from the Keyboard
 		input.GetState(G_KEY_LEFTSHIFT, shiftC);
@@ -96,99 +158,87 @@ public:
 		input.GetState(G_KEY_A, aC);
 		input.GetState(G_KEY_D, dC);
 
-		if (input.GetMouseDelta(xDelta, yDelta) == GW::GReturn::REDUNDANT) //Prevent Camera drift by ignoring 
-		{																   //redundant movement
-			xDelta = 0.0f;
-			yDelta = 0.0f;
-		}
-
-		auto now = std::chrono::steady_clock::now();  //Collects the change over time between ticks
-		deltaTime = std::chrono::duration_cast<std::chrono::microseconds>(now - lastUpdate).count() / 1000000.0f;
-		lastUpdate = now;
-
+		frameInput.mouseX = mouseX;
+		frameInput.mouseY = mouseY;
+		mouseX = mouseY = 0.0f;
+		frameInput.deltaTime = static_cast<float>(step);
+		frameInput.up = spaceC - shiftC;
+		frameInput.forward = wC - sC;
+		frameInput.right = dC - aC;
 
-		float totalPitch = 1.13446 * yDelta / height; //Variables to calculate mouse movement
-		float totalYaw = 1.13446 * aRatio * xDelta / width;
-		float perFrameSpeed = cSpeed * deltaTime;
-		yChange = spaceC - shiftC;
-		zChange = wC - sC;
-		xChange = dC - aC;
-
-
-		//PITCH/////
-		GW::MATH::GMATRIXF pitch;
-		proxyMat.RotationYawPitchRollF(0, totalPitch, 0, pitch);
-		if (xDelta != 0){
-			proxyMat.MultiplyMatrixF(view, pitch, view);
-		}
-		else{
-			proxyMat.MultiplyMatrixF(view, zero, view);
-		}
-
-		//YAW/////
-		GW::MATH::GMATRIXF yaw;
-		proxyMat.RotationYawPitchRollF(totalYaw, 0, 0, yaw);
-		if (yDelta != 0){
-			proxyMat.MultiplyMatrixF(yaw, view, view);
-		}
-		else{	
-			proxyMat.MultiplyMatrixF(zero, view, view);
-		}
-
-		//X and Z TRANSLATION
-		GW::MATH::GVECTORF zxMove = { xChange * perFrameSpeed,0,zChange * perFrameSpeed };
-		proxyMat.TranslateGlobalF(view, zxMove, view);
-
-		//Y TRANSLATION/////
-		GW::MATH::GVECTORF yMove = { 0,yChange * cSpeed * deltaTime ,0 };
-		proxyMat.TranslateGlobalF(view, yMove, view);
-
-		currView = view;
-
-		proxyMat.InverseF(view, view);
+		previousCamera = camera;
+		ApplyCameraInput(camera, frameInput);
+	}
 
+	// V toggles vsync, the frame pacing of the old mode is logged first
+	void UpdatePresentMode(FrameScheduler& scheduler)
+	{
+		float vsync = 0.0f;
+		input.GetState(G_KEY_V, vsync);
+		const bool pressed = vsync != 0 && !vsyncHeld;
+		vsyncHeld = vsync != 0;
+		if (!pressed)
+			return;
+		LogFramePacing(scheduler);
+		const bool wasVsync = scheduler.GetSettings().presentMode == PresentMode::VSYNC;
+		scheduler.SetPresentMode(wasVsync ? PresentMode::IMMEDIATE : PresentMode::VSYNC);
+		scheduler.ResetStats();
+		log.LogCategorized("INFO", wasVsync ? "Vsync off." : "Vsync on.");
+	}
+	void LogFramePacing(const FrameScheduler& scheduler)
+	{
+		const FramePacingStats stats = scheduler.GetStats();
+		std::string info = "Frame Pacing (ms, last " + std::to_string(stats.frames) + " frames) Avg: " +
+			std::to_string(stats.averageMs) + " Min: " + std::to_string(stats.minMs) + " Max: " + std::to_string(stats.maxMs) +
+			" 99%: " + std::to_string(stats.percentile99Ms) + " Jitter: " + std::to_string(stats.jitterMs) +
+			" Updates/Frame: " + std::to_string(stats.updatesPerFrame) + " Stalls: " + std::to_string(stats.stalls) +
+			" Dropped: " + std::to_string(stats.droppedMs);
+		log.LogCategorized("INFO", info.c_str());
 	}
 
-	void SwapLevel(GW::AUDIO::GAudio audio) //Unloads One level to load another
+	void SwapLevel(GW::AUDIO::GAudio audio) //Streams in one level to replace another
 	{
 		float lvlone;
 		float lvltwo;
 		input.GetState(G_KEY_1, lvlone);
 		input.GetState(G_KEY_2, lvltwo);
 
-		if (lvltwo != 0)
-		{
-			theLevel.UnloadLevel();
-			theLevel.LoadLevel("../Levels/GameLevelTwo.txt", "../Models", log);
-			theLevel.UploadLevelToGPU(d3d, world, view, pers);
-			lvltwo = 0;
-			audio.PlaySounds();
-		}
-		else if (lvlone != 0)
+		// only a press starts a load, holding the key does not queue one every frame
+		bool lvlTwoPressed = lvltwo != 0 && !lvlTwoHeld;
+		bool lvlOnePressed = lvlone != 0 && !lvlOneHeld;
+		lvlTwoHeld = lvltwo != 0;
+		lvlOneHeld = lvlone != 0;
+
+		if (lvlTwoPressed)
+			RequestLevel("GameLevelTwo");
+		else if (lvlOnePressed)
+			RequestLevel("GameLevelOne");
+
+		// the current level keeps drawing until the new one is ready, then they swap here
+		switch (levels.Update(backend, view, pers))
 		{
-			theLevel.UnloadLevel();
-			theLevel.LoadLevel("../Levels/GameLevelOne.txt", "../Models", log);
-			theLevel.UploadLevelToGPU(d3d, world, view, pers);
-			lvlone = 0;
+		case LevelStreamState::SWAPPED:
+			LogShaderCache();
+			LogLoadTimings();
 			audio.PlaySounds();
+			break;
+		case LevelStreamState::FAILED:
+			log.LogCategorized("ERROR", ("Could not load " + levels.GetRequestedName() +
+				", keeping the current level.").c_str());
+			break;
+		default:
+			break;
 		}
-		
-		lvlone = 0;
-		lvltwo = 0;
-
 	}
 
 	void CreateMatricies(GW::GRAPHICS::GDirectX11Surface _d3d)
 	{
-		//WORLD MATRIX//////////
-		world = GW::MATH::GIdentityMatrixF;
-
 		//VIEW MATRIX//////////
 		view = GW::MATH::GIdentityMatrixF;
 		GW::MATH::GVECTORF eye = { 0, 8, -18, 0 };
 		GW::MATH::GVECTORF at = { 0, 0, 0, 0 };
 		GW::MATH::GVECTORF up = { 0, 1, 0, 0 };
-		proxyMat.LookAtLHF(eye, at, up, view);
+		camera.LookAt(eye, at, up);
 
 		//PROJECTION MATRIX//////////
 		float ratio = 0.0f;
@@ -197,6 +247,13 @@ public:
 		float zFar = 0.1f;
 		float zNear = 100.0f;
 		proxyMat.ProjectionDirectXLHF(fov, ratio, zFar, zNear, pers);
+		camera.SetProjection(pers);
+		previousCamera = camera;
+
+		renderCamera = camera;
+		const CameraFrame& frame = renderCamera.Update();
+		view = frame.view;
+		currView = frame.world;
 		
 	
 	}
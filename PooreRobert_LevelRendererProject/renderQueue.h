@@ -0,0 +1,240 @@
+//renderQueue
+// Per frame list of draws, each one tagged with a 64 bit key that orders them by the state
+// they need. Sorting the keys puts draws sharing a pipeline, vertex/index buffers and material
+// next to each other, so Submit only binds what differs from the previous draw.
+// Key layout, most significant first:
+//   pass (4 bits) | pipeline (12) | asset (16) | material table index (16) | depth (16)
+// Depth is the top half of the float's bits, which orders positive floats correctly without
+// knowing the depth range. Opaque draws are therefore front to back within the same state.
+// SubmitParallel splits the sorted draws into runs, records each run into its own CommandList
+// on the job system and executes the lists in order, the GPU sees the same draws in the same order.
+#ifndef _RENDERQUEUE_H_
+#define _RENDERQUEUE_H_
+#include <vector>
+#include <cstring>
+#include "../gateware-main/gateware-main/Gateware.h"
+#include "renderBackend.h"
+#include "frameConstants.h"
+#include "jobSystem.h"
+
+enum class RenderPass : unsigned { OPAQUE = 0 };
+
+// Everything one DrawIndexedInstanced needs, handles only
+struct DrawPacket
+{
+	PipelineHandle pipeline;
+	BufferHandle vertexBuffer;
+	unsigned vertexStride;
+	BufferHandle indexBuffer;
+	IndexFormat indexFormat;
+	BufferHandle material; // constant buffer for slot 1, holds the material table index
+	unsigned indexCount;
+	unsigned firstIndex;
+	int baseVertex;
+	unsigned instanceCount;
+	unsigned firstInstance; // into the object buffer
+};
+
+// Binds and draws issued by the last Submit
+struct RenderQueueStats
+{
+	unsigned pipelineBinds;
+	unsigned vertexBufferBinds;
+	unsigned indexBufferBinds;
+	unsigned materialBinds;
+	unsigned draws;
+	unsigned triangles; // over all instances
+};
+
+class RenderQueue
+{
+	struct SortEntry
+	{
+		unsigned long long key;
+		unsigned packet;
+	};
+	std::vector<DrawPacket> packets;
+	std::vector<SortEntry> entries;
+	std::vector<SortEntry> scratch; // radix sort ping-pong buffer
+	RenderQueueStats stats = {};
+	std::vector<RenderQueueStats> listStats; // SubmitParallel's, one per list
+
+	// Draws [first, end) of the sorted entries into target, binding only what changes
+	void Record(CommandRecorder& target, size_t first, size_t end, BufferHandle sceneBuffer, BufferHandle objectBuffer,
+		BufferHandle materialTable, RenderQueueStats& counts) const
+	{
+		PipelineHandle pipeline = INVALID_PIPELINE;
+		BufferHandle vertexBuffer = INVALID_BUFFER;
+		BufferHandle indexBuffer = INVALID_BUFFER;
+		BufferHandle material = INVALID_BUFFER;
+		if (first < end)
+		{
+			target.BindConstantBuffers(0, &sceneBuffer, 1);
+			target.BindShaderResources(0, &materialTable, 1);
+		}
+		for (size_t i = first; i < end; ++i)
+		{
+			const DrawPacket& p = packets[entries[i].packet];
+			if (p.pipeline != pipeline)
+			{
+				target.BindPipeline(p.pipeline);
+				pipeline = p.pipeline;
+				++counts.pipelineBinds;
+			}
+			if (p.vertexBuffer != vertexBuffer)
+			{
+				const BufferHandle vBuffs[] = { p.vertexBuffer, objectBuffer };
+				const unsigned strides[] = { p.vertexStride, sizeof(ObjectData) };
+				const unsigned offsets[] = { 0, 0 };
+				target.BindVertexBuffers(0, vBuffs, strides, offsets, 2);
+				vertexBuffer = p.vertexBuffer;
+				++counts.vertexBufferBinds;
+			}
+			if (p.indexBuffer != indexBuffer)
+			{
+				target.BindIndexBuffer(p.indexBuffer, p.indexFormat, 0);
+				indexBuffer = p.indexBuffer;
+				++counts.indexBufferBinds;
+			}
+			if (p.material != material)
+			{
+				target.BindConstantBuffers(1, &p.material, 1);
+				material = p.material;
+				++counts.materialBinds;
+			}
+			target.DrawIndexedInstanced(p.indexCount, p.instanceCount, p.firstIndex, p.baseVertex, p.firstInstance);
+			++counts.draws;
+			counts.triangles += p.indexCount / 3 * p.instanceCount;
+		}
+	}
+
+public:
+	static unsigned long long MakeKey(RenderPass pass, PipelineHandle pipeline, unsigned asset,
+		BufferHandle material, float depth)
+	{
+		unsigned bits;
+		depth = depth > 0 ? depth : 0; // behind the eye sorts first, -0 too
+		std::memcpy(&bits, &depth, sizeof(bits));
+		return static_cast<unsigned long long>(static_cast<unsigned>(pass) & 0xF) << 60 |
+			static_cast<unsigned long long>(pipeline & 0xFFF) << 48 |
+			static_cast<unsigned long long>(asset & 0xFFFF) << 32 |
+			static_cast<unsigned long long>(material & 0xFFFF) << 16 |
+			static_cast<unsigned long long>(bits >> 16);
+	}
+
+	// Capacity is kept across Clear so a steady frame does not allocate
+	void Reserve(size_t count)
+	{
+		packets.reserve(count);
+		entries.reserve(count);
+		scratch.reserve(count);
+	}
+	// Room for the stats of this many command lists, call it where the lists are created so
+	// RecordLists does not allocate
+	void ReserveLists(unsigned listCount)
+	{
+		if (listStats.size() < listCount)
+			listStats.resize(listCount);
+	}
+	void Clear()
+	{
+		packets.clear();
+		entries.clear();
+	}
+	void Push(unsigned long long key, const DrawPacket& packet)
+	{
+		entries.push_back({ key, static_cast<unsigned>(packets.size()) });
+		packets.push_back(packet);
+	}
+
+	// LSD radix sort, 8 bits per pass. All histograms come from one read of the keys and a pass
+	// whose digit is the same in every key is skipped, so fields nobody uses cost nothing. Stable.
+	void Sort()
+	{
+		const size_t count = entries.size();
+		if (count < 2)
+			return;
+		unsigned histogram[8][256] = {};
+		for (const SortEntry& e : entries)
+			for (int d = 0; d < 8; ++d)
+				++histogram[d][(e.key >> (d * 8)) & 0xFF];
+		scratch.resize(count);
+		SortEntry* from = entries.data();
+		SortEntry* to = scratch.data();
+		for (int d = 0; d < 8; ++d)
+		{
+			unsigned* buckets = histogram[d];
+			if (buckets[(from[0].key >> (d * 8)) & 0xFF] == count)
+				continue;
+			unsigned offset = 0;
+			for (int b = 0; b < 256; ++b)
+			{
+				const unsigned n = buckets[b];
+				buckets[b] = offset;
+				offset += n;
+			}
+			for (size_t i = 0; i < count; ++i)
+				to[buckets[(from[i].key >> (d * 8)) & 0xFF]++] = from[i];
+			std::swap(from, to);
+		}
+		if (from != entries.data())
+			std::memcpy(entries.data(), from, count * sizeof(SortEntry));
+	}
+
+	// Draws in key order. Scene data, the object buffer (vertex slot 1) and the material table
+	// (t0) are bound once for the whole queue, everything else only when it differs from the
+	// previous draw.
+	void Submit(RenderBackend& backend, BufferHandle sceneBuffer, BufferHandle objectBuffer, BufferHandle materialTable)
+	{
+		stats = {};
+		Record(backend, 0, entries.size(), sceneBuffer, objectBuffer, materialTable, stats);
+	}
+
+	// Submit over listCount lists: each records an equal run of the draws on a job, then they are
+	// executed in order on this thread. Every list binds its own state from scratch, so a run
+	// costs a few more binds than one long Submit.
+	void SubmitParallel(RenderBackend& backend, JobSystem& jobs, const std::unique_ptr<CommandList>* lists, unsigned listCount,
+		BufferHandle sceneBuffer, BufferHandle objectBuffer, BufferHandle materialTable)
+	{
+		RecordLists(jobs, lists, listCount, sceneBuffer, objectBuffer, materialTable);
+		ExecuteLists(backend, lists, listCount);
+	}
+	// The two halves of SubmitParallel, recording returns once every list is done
+	void RecordLists(JobSystem& jobs, const std::unique_ptr<CommandList>* lists, unsigned listCount,
+		BufferHandle sceneBuffer, BufferHandle objectBuffer, BufferHandle materialTable)
+	{
+		ReserveLists(listCount); // no-op unless the caller did not
+		const size_t count = entries.size();
+		jobs.ParallelFor(listCount, 1, [&](unsigned begin, unsigned end) {
+			for (unsigned l = begin; l < end; ++l)
+			{
+				listStats[l] = {};
+				lists[l]->Begin();
+				Record(*lists[l], count * l / listCount, count * (l + 1) / listCount, sceneBuffer, objectBuffer,
+					materialTable, listStats[l]);
+				lists[l]->End();
+			}
+		});
+	}
+	void ExecuteLists(RenderBackend& backend, const std::unique_ptr<CommandList>* lists, unsigned listCount)
+	{
+		stats = {};
+		for (unsigned l = 0; l < listCount; ++l)
+		{
+			backend.ExecuteCommandList(*lists[l]);
+			stats.pipelineBinds += listStats[l].pipelineBinds;
+			stats.vertexBufferBinds += listStats[l].vertexBufferBinds;
+			stats.indexBufferBinds += listStats[l].indexBufferBinds;
+			stats.materialBinds += listStats[l].materialBinds;
+			stats.draws += listStats[l].draws;
+			stats.triangles += listStats[l].triangles;
+		}
+	}
+
+	size_t Size() const { return entries.size(); }
+	// Key of the i-th draw in submit order (after Sort)
+	unsigned long long GetKey(size_t i) const { return entries[i].key; }
+	const RenderQueueStats& GetStats() const { return stats; }
+};
+
+#endif
@@ -0,0 +1,135 @@
+//ringCheck.cpp
+// Checks the per frame object ring (FrameConstants) from what RenderLevel records on the in
+// memory RecordingBackend, for the shipped levels over frames that wrap the ring several times.
+// Every frame must map the ring exactly once and unmap it before the first draw, with NO_OVERWRITE
+// while the frame's objects fit after the previous frame's and DISCARD, starting over at the
+// front, when they do not. The scene data is one UpdateBuffer and the draws stay inside the
+// frame's part of the ring.
+//   RingCheck <h2b folder> <levels folder> [frames, default 24]
+#define GATEWARE_ENABLE_CORE // All libraries need this
+#define GATEWARE_ENABLE_SYSTEM // GFile & GLog used by the level loader
+#define GATEWARE_ENABLE_MATH
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "../gateware-main/gateware-main/Gateware.h"
+#include "load_object_oriented.h"
+#include "recordingBackend.h"
+
+static unsigned failures = 0;
+
+static void Check(bool passed, const std::string& what)
+{
+	if (!passed)
+	{
+		std::cout << "MISMATCH: " << what << std::endl;
+		++failures;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 3 && argc != 4)
+	{
+		std::cout << "usage: RingCheck <h2b folder> <levels folder> [frames]" << std::endl;
+		return 1;
+	}
+	const unsigned frames = argc == 4 ? std::max(4u, static_cast<unsigned>(std::stoul(argv[3]))) : 24;
+	GW::SYSTEM::GLog log; // not created, the messages go nowhere
+	GW::MATH::GMatrix proxy;
+	proxy.Create();
+	GW::MATH::GMATRIXF projection;
+	proxy.ProjectionDirectXLHF(G_DEGREE_TO_RADIAN_F(65), 16.0f / 9.0f, 0.1f, 100.0f, projection);
+
+	std::cout << std::left << std::setw(20) << "level" << std::setw(10) << "culling" << std::right << std::setw(8) <<
+		"frames" << std::setw(8) << "empty" << std::setw(10) << "capacity" << std::setw(10) << "discards" << std::setw(14) <<
+		"no overwrite" << std::endl;
+	for (const char* name : { "GameLevelOne.txt", "GameLevelTwo.txt" })
+	{
+		// culling off fills a third of the ring every frame, on the visible count changes as the camera turns
+		for (const bool culling : { false, true })
+		{
+			const std::string path = std::string(argv[2]) + "/" + name;
+			const std::string label = std::string(name) + (culling ? " culled" : "");
+			Level_Objects level;
+			if (!level.LoadLevel(path.c_str(), argv[1], log))
+			{
+				std::cout << "could not load " << path << std::endl;
+				return 1;
+			}
+			level.SetCulling(culling);
+			RecordingBackend backend;
+			Camera camera;
+			camera.LookAt({ 0, 8, -18, 0 }, { 0, 0, 0, 0 }, { 0, 1, 0, 0 });
+			camera.SetProjection(projection);
+			level.UploadLevelToGPU(backend, camera.Update().view, projection);
+
+			unsigned capacity = 0, head = 0, discards = 0, noOverwrites = 0, emptyFrames = 0, wrongFrames = 0;
+			BufferHandle ring = INVALID_BUFFER;
+			for (unsigned f = 0; f < frames; ++f)
+			{
+				camera.YawLocal(0.4f);
+				backend.ClearCommands();
+				level.RenderLevel(camera.Update());
+				unsigned visible = 0;
+				for (unsigned l = 0; l < MAX_LOD_COUNT; ++l)
+					visible += level.GetLodInstanceCounts()[l];
+
+				// the map, the unmap and the draws in the order they were recorded
+				const std::vector<RecordedCommand>& commands = backend.GetCommands();
+				size_t mapAt = commands.size(), unmapAt = commands.size(), firstDraw = commands.size();
+				unsigned firstInstance = ~0u, endInstance = 0;
+				for (size_t c = 0; c < commands.size(); ++c)
+				{
+					if (commands[c].type == RecordedCommandType::MAP_BUFFER && mapAt == commands.size())
+						mapAt = c;
+					else if (commands[c].type == RecordedCommandType::UNMAP_BUFFER && unmapAt == commands.size())
+						unmapAt = c;
+					else if (commands[c].type == RecordedCommandType::DRAW_INDEXED_INSTANCED)
+					{
+						firstDraw = std::min(firstDraw, c);
+						firstInstance = std::min(firstInstance, commands[c].args[3]);
+						endInstance = std::max(endInstance, commands[c].args[3] + commands[c].args[1]);
+					}
+				}
+				// nothing visible (the camera turns all the way round) maps nothing and draws nothing
+				const unsigned maps = visible > 0 ? 1 : 0;
+				bool right = backend.GetCount(RecordedCommandType::MAP_BUFFER) == maps &&
+					backend.GetCount(RecordedCommandType::UNMAP_BUFFER) == maps &&
+					backend.GetCount(RecordedCommandType::UPDATE_BUFFER) == 1 &&
+					(visible == 0 ? firstDraw == commands.size() : mapAt < unmapAt && unmapAt < firstDraw &&
+						commands[unmapAt].args[0] == commands[mapAt].args[0]);
+				if (right && visible > 0)
+				{
+					if (ring == INVALID_BUFFER)
+					{
+						ring = commands[mapAt].args[0];
+						capacity = backend.GetBuffer(ring).desc.sizeInBytes / sizeof(ObjectData);
+						head = capacity; // the first frame must discard
+					}
+					// what the ring should have done, then what it did
+					const bool discard = head + visible > capacity;
+					const unsigned frameStart = discard ? 0 : head;
+					head = frameStart + visible;
+					(discard ? discards : noOverwrites) += 1;
+					right = commands[mapAt].args[0] == ring &&
+						commands[mapAt].args[1] == static_cast<unsigned>(discard ? MapMode::DISCARD : MapMode::NO_OVERWRITE) &&
+						firstInstance == frameStart && endInstance == frameStart + visible;
+				}
+				emptyFrames += visible == 0;
+				wrongFrames += !right;
+			}
+			Check(wrongFrames == 0, label + ": " + std::to_string(wrongFrames) + " of " + std::to_string(frames) +
+				" frames did not map the object ring once, in the right mode, for their own objects");
+			Check(discards > 1 && noOverwrites > 0, label + ": the ring did not wrap around");
+			std::cout << std::left << std::setw(20) << name << std::setw(10) << (culling ? "on" : "off") << std::right <<
+				std::setw(8) << frames << std::setw(8) << emptyFrames << std::setw(10) << capacity << std::setw(10) << discards <<
+				std::setw(14) << noOverwrites << std::endl;
+			level.UnloadLevel();
+		}
+	}
+	if (failures == 0)
+		std::cout << "every frame mapped the object ring once" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
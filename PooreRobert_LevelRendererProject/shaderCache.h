@@ -0,0 +1,196 @@
+//shaderCache
+// Platform neutral half of the shader library: keys compiled shader bytecode by
+// (source hash, entry point, profile, flags), keeps it in memory for the life of the
+// process and persists it to a cache directory so later runs skip compilation entirely.
+// The actual compiler is supplied through ShaderCompiler (D3DCompile on Windows).
+#ifndef _SHADERCACHE_H_
+#define _SHADERCACHE_H_
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <unordered_map>
+#include <fstream>
+#include <filesystem>
+
+// FNV-1a, stable across runs and platforms which is what the on-disk cache needs
+inline unsigned long long HashShaderBytes(const void* data, size_t size,
+	unsigned long long hash = 14695981039346656037ull)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+struct ShaderKey
+{
+	unsigned long long sourceHash = 0;
+	std::string entryPoint;
+	std::string profile;
+	unsigned flags = 0;
+
+	unsigned long long Hash() const
+	{
+		unsigned long long hash = HashShaderBytes(&sourceHash, sizeof(sourceHash));
+		hash = HashShaderBytes(entryPoint.c_str(), entryPoint.size() + 1, hash);
+		hash = HashShaderBytes(profile.c_str(), profile.size() + 1, hash);
+		return HashShaderBytes(&flags, sizeof(flags), hash);
+	}
+	bool operator==(const ShaderKey& other) const
+	{
+		return sourceHash == other.sourceHash && flags == other.flags &&
+			entryPoint == other.entryPoint && profile == other.profile;
+	}
+	// "<hash>_<entry>_<profile>.cso"
+	std::string FileName() const
+	{
+		char hex[17];
+		std::snprintf(hex, sizeof(hex), "%016llx", Hash());
+		return std::string(hex) + "_" + entryPoint + "_" + profile + ".cso";
+	}
+};
+
+struct ShaderKeyHasher
+{
+	size_t operator()(const ShaderKey& key) const { return static_cast<size_t>(key.Hash()); }
+};
+
+// Turns HLSL source into bytecode, implemented with D3DCompile by the D3D11 renderer
+// and by a stub in headless builds
+class ShaderCompiler
+{
+public:
+	virtual ~ShaderCompiler() {}
+	virtual bool Compile(const std::string& source, const ShaderKey& key,
+		std::vector<char>& bytecode, std::string& errors) = 0;
+};
+
+class ShaderBytecodeCache
+{
+	// header written in front of each cached blob so stale or foreign files are ignored
+	struct FileHeader
+	{
+		char magic[4];
+		unsigned version;
+		unsigned long long keyHash;
+		unsigned long long size;
+	};
+	static const unsigned FILE_VERSION = 1;
+
+	ShaderCompiler* compiler;
+	std::string cacheDirectory; // empty disables persistence
+	std::unordered_map<ShaderKey, std::vector<char>, ShaderKeyHasher> bytecodes;
+	std::unordered_map<std::string, std::string> sources; // shader path -> contents
+
+	unsigned compiles = 0;
+	unsigned memoryHits = 0;
+	unsigned diskHits = 0;
+
+	bool ReadCached(const ShaderKey& key, std::vector<char>& bytecode) const
+	{
+		if (cacheDirectory.empty())
+			return false;
+		std::ifstream file(cacheDirectory + "/" + key.FileName(), std::ios_base::in | std::ios_base::binary);
+		if (!file.is_open())
+			return false;
+		FileHeader header;
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+			std::string(header.magic, 4) != "LRSC" || header.version != FILE_VERSION ||
+			header.keyHash != key.Hash() || header.size == 0)
+			return false;
+		bytecode.resize(static_cast<size_t>(header.size));
+		return static_cast<bool>(file.read(bytecode.data(), bytecode.size()));
+	}
+
+	void WriteCached(const ShaderKey& key, const std::vector<char>& bytecode) const
+	{
+		if (cacheDirectory.empty())
+			return;
+		std::error_code ignored; // a read-only install just means no persistence
+		std::filesystem::create_directories(cacheDirectory, ignored);
+		std::ofstream file(cacheDirectory + "/" + key.FileName(), std::ios_base::out | std::ios_base::binary);
+		if (!file.is_open())
+			return;
+		FileHeader header = { { 'L', 'R', 'S', 'C' }, FILE_VERSION, key.Hash(), bytecode.size() };
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(bytecode.data(), bytecode.size());
+	}
+
+public:
+	ShaderBytecodeCache(ShaderCompiler* _compiler, std::string _cacheDirectory)
+		: compiler(_compiler), cacheDirectory(std::move(_cacheDirectory)) {}
+
+	// Reads (and remembers) the source of a shader file, empty if it could not be read
+	const std::string& GetSource(const std::string& sourcePath)
+	{
+		auto found = sources.find(sourcePath);
+		if (found != sources.end())
+			return found->second;
+		std::string& source = sources[sourcePath];
+		std::ifstream file(sourcePath, std::ios_base::in | std::ios_base::binary);
+		if (file.is_open())
+			source.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		return source;
+	}
+
+	ShaderKey MakeKey(const std::string& source, const char* entryPoint, const char* profile, unsigned flags) const
+	{
+		ShaderKey key;
+		key.sourceHash = HashShaderBytes(source.data(), source.size());
+		key.entryPoint = entryPoint;
+		key.profile = profile;
+		key.flags = flags;
+		return key;
+	}
+
+	// Returns the bytecode for the key, from memory, then disk, then the compiler.
+	// nullptr means compilation failed and errors holds the compiler output.
+	const std::vector<char>* GetBytecode(const std::string& source, const ShaderKey& key, std::string& errors)
+	{
+		auto found = bytecodes.find(key);
+		if (found != bytecodes.end())
+		{
+			++memoryHits;
+			return &found->second;
+		}
+		std::vector<char> bytecode;
+		if (ReadCached(key, bytecode))
+		{
+			++diskHits;
+			return &(bytecodes[key] = std::move(bytecode));
+		}
+		if (compiler == nullptr || source.empty())
+			return nullptr;
+		++compiles;
+		if (!compiler->Compile(source, key, bytecode, errors))
+			return nullptr;
+		WriteCached(key, bytecode);
+		return &(bytecodes[key] = std::move(bytecode));
+	}
+
+	// Bytecode already held in memory, does not count as a hit
+	const std::vector<char>* Find(const ShaderKey& key) const
+	{
+		auto found = bytecodes.find(key);
+		return found != bytecodes.end() ? &found->second : nullptr;
+	}
+
+	// Forgets everything held in memory (the disk cache is left alone)
+	void Clear()
+	{
+		bytecodes.clear();
+		sources.clear();
+	}
+
+	unsigned GetCompileCount() const { return compiles; }
+	unsigned GetMemoryHitCount() const { return memoryHits; }
+	unsigned GetDiskHitCount() const { return diskHits; }
+	unsigned GetCacheHitCount() const { return memoryHits + diskHits; }
+	const std::string& GetCacheDirectory() const { return cacheDirectory; }
+};
+
+#endif
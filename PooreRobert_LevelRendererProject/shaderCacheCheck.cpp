@@ -0,0 +1,155 @@
+//shaderCacheCheck.cpp
+// Checks ShaderBytecodeCache with a stub ShaderCompiler that counts its calls, on copies of the
+// shipped shaders in a fresh cache directory. A second request in the same run is a memory hit,
+// a second run (a new cache on the same directory) loads from disk without compiling, and a
+// changed source, entry point, profile or flags compiles again. Failed compiles and damaged
+// cache files are never served.
+//   ShaderCacheCheck <shaders folder>
+#include <iostream>
+#include <filesystem>
+#include <fstream>
+#include "shaderCache.h"
+
+static unsigned failures = 0;
+
+static void Check(bool passed, const std::string& what)
+{
+	if (!passed)
+	{
+		std::cout << "MISMATCH: " << what << std::endl;
+		++failures;
+	}
+}
+
+// Bytecode is the key spelled out plus the source hash, sources containing "#error" fail
+class CountingCompiler : public ShaderCompiler
+{
+public:
+	unsigned calls = 0;
+
+	bool Compile(const std::string& source, const ShaderKey& key, std::vector<char>& bytecode, std::string& errors) override
+	{
+		++calls;
+		if (source.find("#error") != std::string::npos)
+		{
+			errors = "stub: #error in source";
+			return false;
+		}
+		const std::string text = key.FileName() + ":" + std::to_string(HashShaderBytes(source.data(), source.size()));
+		bytecode.assign(text.begin(), text.end());
+		return true;
+	}
+};
+
+static std::string Expected(const std::string& source, const ShaderKey& key)
+{
+	return key.FileName() + ":" + std::to_string(HashShaderBytes(source.data(), source.size()));
+}
+
+static bool Is(const std::vector<char>* bytecode, const std::string& expected)
+{
+	return bytecode != nullptr && std::string(bytecode->begin(), bytecode->end()) == expected;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 2)
+	{
+		std::cout << "usage: ShaderCacheCheck <shaders folder>" << std::endl;
+		return 1;
+	}
+	const std::filesystem::path work = std::filesystem::temp_directory_path() / "ShaderCacheCheck";
+	std::filesystem::remove_all(work);
+	std::filesystem::create_directories(work / "Shaders");
+	const std::string cacheDirectory = (work / "Cache").string();
+	const std::string vertexPath = (work / "Shaders" / "VertexShader.hlsl").string();
+	const std::string pixelPath = (work / "Shaders" / "PixelShader.hlsl").string();
+	std::filesystem::copy_file(std::string(argv[1]) + "/VertexShader.hlsl", vertexPath);
+	std::filesystem::copy_file(std::string(argv[1]) + "/PixelShader.hlsl", pixelPath);
+
+	CountingCompiler compiler;
+	std::string errors;
+	ShaderKey vertexKey, pixelKey;
+	std::string vertexSource, pixelSource;
+	{
+		// first run: both compile once, asking again is a memory hit
+		ShaderBytecodeCache cache(&compiler, cacheDirectory);
+		vertexSource = cache.GetSource(vertexPath);
+		pixelSource = cache.GetSource(pixelPath);
+		Check(!vertexSource.empty() && !pixelSource.empty(), "the shader sources could not be read");
+		vertexKey = cache.MakeKey(vertexSource, "main", "vs_4_0", 0);
+		pixelKey = cache.MakeKey(pixelSource, "main", "ps_4_0", 0);
+		Check(Is(cache.GetBytecode(vertexSource, vertexKey, errors), Expected(vertexSource, vertexKey)) &&
+			Is(cache.GetBytecode(pixelSource, pixelKey, errors), Expected(pixelSource, pixelKey)),
+			"first run bytecode is not what the compiler made");
+		Check(compiler.calls == 2 && cache.GetCompileCount() == 2 && cache.GetCacheHitCount() == 0, "first run did not compile both once");
+		Check(Is(cache.GetBytecode(vertexSource, vertexKey, errors), Expected(vertexSource, vertexKey)) &&
+			compiler.calls == 2 && cache.GetMemoryHitCount() == 1, "a second request in the same run compiled again");
+		Check(std::filesystem::exists(cacheDirectory + "/" + vertexKey.FileName()) &&
+			std::filesystem::exists(cacheDirectory + "/" + pixelKey.FileName()), "compiled bytecode was not written to the cache directory");
+
+		// memory forgotten, the disk still has it
+		cache.Clear();
+		Check(Is(cache.GetBytecode(vertexSource, vertexKey, errors), Expected(vertexSource, vertexKey)) &&
+			compiler.calls == 2 && cache.GetDiskHitCount() == 1, "after Clear the bytecode was not read back from disk");
+	}
+	{
+		// second run: everything comes from disk
+		ShaderBytecodeCache cache(&compiler, cacheDirectory);
+		Check(Is(cache.GetBytecode(cache.GetSource(vertexPath), vertexKey, errors), Expected(vertexSource, vertexKey)) &&
+			Is(cache.GetBytecode(cache.GetSource(pixelPath), pixelKey, errors), Expected(pixelSource, pixelKey)),
+			"second run bytecode differs from the first");
+		Check(compiler.calls == 2 && cache.GetCompileCount() == 0 && cache.GetDiskHitCount() == 2, "second run compiled instead of loading the cache");
+
+		// a different entry point, profile or flags is another shader
+		const unsigned before = compiler.calls;
+		const ShaderKey compact = cache.MakeKey(vertexSource, "mainCompact", "vs_4_0", 0);
+		const ShaderKey newer = cache.MakeKey(vertexSource, "main", "vs_5_0", 0);
+		const ShaderKey debug = cache.MakeKey(vertexSource, "main", "vs_4_0", 1);
+		Check(cache.GetBytecode(vertexSource, compact, errors) && cache.GetBytecode(vertexSource, newer, errors) &&
+			cache.GetBytecode(vertexSource, debug, errors) && compiler.calls == before + 3,
+			"another entry point, profile or flags did not compile");
+	}
+	{
+		// the vertex shader is edited between runs: it compiles again, the pixel shader does not
+		std::ofstream(vertexPath, std::ios_base::app) << "\n// edited\n";
+		ShaderBytecodeCache cache(&compiler, cacheDirectory);
+		const std::string& edited = cache.GetSource(vertexPath);
+		const ShaderKey editedKey = cache.MakeKey(edited, "main", "vs_4_0", 0);
+		const unsigned before = compiler.calls;
+		Check(!(editedKey == vertexKey), "an edited source has the same key");
+		Check(Is(cache.GetBytecode(edited, editedKey, errors), Expected(edited, editedKey)) && compiler.calls == before + 1,
+			"an edited source was not compiled again");
+		Check(cache.GetBytecode(cache.GetSource(pixelPath), pixelKey, errors) && compiler.calls == before + 1,
+			"an unchanged source was compiled again after another one changed");
+	}
+	{
+		// a failed compile returns the errors, is not cached and is tried again next time
+		ShaderBytecodeCache cache(&compiler, cacheDirectory);
+		const std::string broken = vertexSource + "\n#error broken\n";
+		const ShaderKey brokenKey = cache.MakeKey(broken, "main", "vs_4_0", 0);
+		const unsigned before = compiler.calls;
+		errors.clear();
+		Check(cache.GetBytecode(broken, brokenKey, errors) == nullptr && !errors.empty(), "a failed compile returned bytecode");
+		Check(cache.GetBytecode(broken, brokenKey, errors) == nullptr && compiler.calls == before + 2 &&
+			!std::filesystem::exists(cacheDirectory + "/" + brokenKey.FileName()), "a failed compile was cached");
+
+		// a damaged cache file is compiled over, not served
+		std::ofstream(cacheDirectory + "/" + pixelKey.FileName(), std::ios_base::binary | std::ios_base::trunc) << "LRSC";
+		Check(Is(cache.GetBytecode(pixelSource, pixelKey, errors), Expected(pixelSource, pixelKey)) && compiler.calls == before + 3,
+			"a damaged cache file was not compiled over");
+	}
+	{
+		// no cache directory, nothing persists
+		ShaderBytecodeCache cache(&compiler, "");
+		const unsigned before = compiler.calls;
+		cache.GetBytecode(pixelSource, pixelKey, errors);
+		ShaderBytecodeCache again(&compiler, "");
+		again.GetBytecode(pixelSource, pixelKey, errors);
+		Check(compiler.calls == before + 2, "a cache without a directory persisted bytecode");
+	}
+	std::filesystem::remove_all(work);
+	if (failures == 0)
+		std::cout << "shader cache checks passed, " << compiler.calls << " stub compiles" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
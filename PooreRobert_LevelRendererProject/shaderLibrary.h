@@ -0,0 +1,160 @@
+//shaderLibrary
+// Direct3D 11 half of the shader library. Every Model used to read and D3DCompile both
+// shaders itself, this hands out one shared shader object per unique ShaderKey instead
+// and lets ShaderBytecodeCache skip compilation whenever it has seen the source before.
+#ifndef _SHADERLIBRARY_H_
+#define _SHADERLIBRARY_H_
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <d3dcompiler.h>
+#include "shaderCache.h"
+
+void PrintLabeledDebugString(const char* label, const char* toPrint);
+
+class D3DShaderCompiler : public ShaderCompiler
+{
+public:
+	bool Compile(const std::string& source, const ShaderKey& key,
+		std::vector<char>& bytecode, std::string& errors) override
+	{
+		Microsoft::WRL::ComPtr<ID3DBlob> blob, compileErrors;
+		HRESULT compilationResult =
+			D3DCompile(source.c_str(), source.length(),
+				nullptr, nullptr, nullptr, key.entryPoint.c_str(), key.profile.c_str(), key.flags, 0,
+				blob.GetAddressOf(), compileErrors.GetAddressOf());
+		if (FAILED(compilationResult))
+		{
+			if (compileErrors)
+				errors.assign(static_cast<const char*>(compileErrors->GetBufferPointer()), compileErrors->GetBufferSize());
+			return false;
+		}
+		const char* data = static_cast<const char*>(blob->GetBufferPointer());
+		bytecode.assign(data, data + blob->GetBufferSize());
+		return true;
+	}
+};
+
+class ShaderLibrary
+{
+	D3DShaderCompiler compiler;
+	ShaderBytecodeCache bytecodes;
+
+	std::unordered_map<ShaderKey, Microsoft::WRL::ComPtr<ID3D11VertexShader>, ShaderKeyHasher> vertexShaders;
+	std::unordered_map<ShaderKey, Microsoft::WRL::ComPtr<ID3D11PixelShader>, ShaderKeyHasher> pixelShaders;
+	// A layout with the vertex shader & elements it was made for, a lookup whose hash matches
+	// compares them in full so two colliding element lists never share a layout
+	struct InputLayout
+	{
+		ShaderKey vsKey;
+		std::vector<std::string> semantics;
+		std::vector<UINT> fields; // LayoutFields of every element
+		Microsoft::WRL::ComPtr<ID3D11InputLayout> layout;
+
+		bool Matches(const ShaderKey& key, const D3D11_INPUT_ELEMENT_DESC* elements, UINT count) const
+		{
+			if (!(vsKey == key) || semantics.size() != count)
+				return false;
+			for (UINT i = 0; i < count; ++i)
+			{
+				const std::array<UINT, 6> element = LayoutFields(elements[i]);
+				if (semantics[i] != elements[i].SemanticName || !std::equal(element.begin(), element.end(), fields.begin() + i * 6))
+					return false;
+			}
+			return true;
+		}
+	};
+	std::unordered_multimap<unsigned long long, InputLayout> inputLayouts; // by LayoutHash
+
+	const std::vector<char>* GetBytecode(const char* sourcePath, const char* entryPoint, const char* profile,
+		UINT compilerFlags, ShaderKey& key)
+	{
+		const std::string& source = bytecodes.GetSource(sourcePath);
+		key = bytecodes.MakeKey(source, entryPoint, profile, compilerFlags);
+		std::string errors;
+		const std::vector<char>* bytecode = bytecodes.GetBytecode(source, key, errors);
+		if (bytecode == nullptr)
+		{
+			PrintLabeledDebugString((std::string(sourcePath) + " Errors:\n").c_str(),
+				errors.empty() ? "File not found or empty\n" : errors.c_str());
+			abort();
+		}
+		return bytecode;
+	}
+
+	// Everything of an element but its semantic name
+	static std::array<UINT, 6> LayoutFields(const D3D11_INPUT_ELEMENT_DESC& element)
+	{
+		return { element.SemanticIndex, static_cast<UINT>(element.Format), element.InputSlot,
+			element.AlignedByteOffset, static_cast<UINT>(element.InputSlotClass), element.InstanceDataStepRate };
+	}
+	// input layouts only depend on the vertex shader signature and the element descriptions
+	static unsigned long long LayoutHash(const ShaderKey& vsKey, const D3D11_INPUT_ELEMENT_DESC* elements, UINT count)
+	{
+		unsigned long long hash = vsKey.Hash();
+		for (UINT i = 0; i < count; ++i)
+		{
+			hash = HashShaderBytes(elements[i].SemanticName, std::strlen(elements[i].SemanticName) + 1, hash);
+			const std::array<UINT, 6> fields = LayoutFields(elements[i]);
+			hash = HashShaderBytes(fields.data(), sizeof(UINT) * fields.size(), hash);
+		}
+		return hash;
+	}
+
+public:
+	explicit ShaderLibrary(std::string cacheDirectory = "../ShaderCache")
+		: bytecodes(&compiler, std::move(cacheDirectory)) {}
+
+	void LoadVertexShader(ID3D11Device* creator, const char* sourcePath, const char* entryPoint, const char* profile,
+		UINT compilerFlags, Microsoft::WRL::ComPtr<ID3D11VertexShader>& shader, ShaderKey& key)
+	{
+		const std::vector<char>* bytecode = GetBytecode(sourcePath, entryPoint, profile, compilerFlags, key);
+		Microsoft::WRL::ComPtr<ID3D11VertexShader>& shared = vertexShaders[key];
+		if (!shared)
+			creator->CreateVertexShader(bytecode->data(), bytecode->size(), nullptr, shared.GetAddressOf());
+		shader = shared;
+	}
+
+	void LoadPixelShader(ID3D11Device* creator, const char* sourcePath, const char* entryPoint, const char* profile,
+		UINT compilerFlags, Microsoft::WRL::ComPtr<ID3D11PixelShader>& shader)
+	{
+		ShaderKey key;
+		const std::vector<char>* bytecode = GetBytecode(sourcePath, entryPoint, profile, compilerFlags, key);
+		Microsoft::WRL::ComPtr<ID3D11PixelShader>& shared = pixelShaders[key];
+		if (!shared)
+			creator->CreatePixelShader(bytecode->data(), bytecode->size(), nullptr, shared.GetAddressOf());
+		shader = shared;
+	}
+
+	// vsKey comes from LoadVertexShader, the layout is validated against that shader's bytecode
+	void LoadInputLayout(ID3D11Device* creator, const ShaderKey& vsKey, const D3D11_INPUT_ELEMENT_DESC* elements,
+		UINT count, Microsoft::WRL::ComPtr<ID3D11InputLayout>& layout)
+	{
+		const unsigned long long hash = LayoutHash(vsKey, elements, count);
+		const auto found = inputLayouts.equal_range(hash);
+		for (auto candidate = found.first; candidate != found.second; ++candidate)
+			if (candidate->second.Matches(vsKey, elements, count))
+			{
+				layout = candidate->second.layout;
+				return;
+			}
+		InputLayout created;
+		created.vsKey = vsKey;
+		for (UINT i = 0; i < count; ++i)
+		{
+			created.semantics.push_back(elements[i].SemanticName);
+			const std::array<UINT, 6> fields = LayoutFields(elements[i]);
+			created.fields.insert(created.fields.end(), fields.begin(), fields.end());
+		}
+		const std::vector<char>* bytecode = bytecodes.Find(vsKey);
+		if (bytecode != nullptr)
+			creator->CreateInputLayout(elements, count, bytecode->data(), bytecode->size(), created.layout.GetAddressOf());
+		layout = created.layout;
+		if (created.layout)
+			inputLayouts.emplace(hash, std::move(created));
+	}
+
+	const ShaderBytecodeCache& GetBytecodeCache() const { return bytecodes; }
+};
+
+#endif
@@ -0,0 +1,144 @@
+//sortBench.cpp
+// Checks RenderQueue::Sort's LSD radix sort against std::stable_sort on the same 64 bit keys:
+// random keys, keys shaped like MakeKey's, all equal keys (every pass skipped) and keys that
+// differ in one byte (an odd number of passes, the result is copied back) or two. The order is
+// read back from the draws Submit records on the RecordingBackend, each packet's firstInstance
+// is its push index, so equal keys must keep their push order. Then times both at 100k draws.
+//   SortBench [draws, default 100000]
+#define GATEWARE_ENABLE_CORE // All libraries need this
+#define GATEWARE_ENABLE_SYSTEM // GFile & GLog used by the level loader
+#define GATEWARE_ENABLE_MATH
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "../gateware-main/gateware-main/Gateware.h"
+#include "renderQueue.h"
+#include "recordingBackend.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double Milliseconds(Clock::time_point from, Clock::time_point to)
+{
+	return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+static unsigned failures = 0;
+
+static void Check(bool passed, const std::string& what)
+{
+	if (!passed)
+	{
+		std::cout << "MISMATCH: " << what << std::endl;
+		++failures;
+	}
+}
+
+typedef std::pair<unsigned long long, unsigned> KeyAndPush;
+
+static void Fill(RenderQueue& queue, const std::vector<unsigned long long>& keys)
+{
+	queue.Clear();
+	DrawPacket packet = {};
+	packet.indexCount = 3;
+	packet.instanceCount = 1;
+	for (unsigned i = 0; i < keys.size(); ++i)
+	{
+		packet.firstInstance = i;
+		queue.Push(keys[i], packet);
+	}
+}
+
+// Radix sorted queue against std::stable_sort of (key, push index) by key
+static void CheckOrder(RenderQueue& queue, RecordingBackend& backend, const std::vector<unsigned long long>& keys, const std::string& label)
+{
+	Fill(queue, keys);
+	queue.Sort();
+	std::vector<KeyAndPush> expected(keys.size());
+	for (unsigned i = 0; i < keys.size(); ++i)
+		expected[i] = { keys[i], i };
+	std::stable_sort(expected.begin(), expected.end(),
+		[](const KeyAndPush& a, const KeyAndPush& b) { return a.first < b.first; });
+
+	backend.ClearCommands();
+	queue.Submit(backend, INVALID_BUFFER, INVALID_BUFFER, INVALID_BUFFER);
+	std::vector<KeyAndPush> sorted;
+	sorted.reserve(keys.size());
+	for (const RecordedCommand& c : backend.GetCommands())
+		if (c.type == RecordedCommandType::DRAW_INDEXED_INSTANCED)
+			sorted.push_back({ queue.GetKey(sorted.size()), c.args[3] });
+	Check(queue.Size() == keys.size() && sorted == expected, label + ": the radix sort differs from std::stable_sort");
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 2)
+	{
+		std::cout << "usage: SortBench [draws]" << std::endl;
+		return 1;
+	}
+	const unsigned count = argc == 2 ? std::max(2u, static_cast<unsigned>(std::stoul(argv[1]))) : 100000;
+	const int passes = 5;
+	std::mt19937_64 random(14);
+	RenderQueue queue;
+	queue.Reserve(count);
+	RecordingBackend backend;
+
+	std::vector<unsigned long long> randomKeys(count), levelKeys(count), keys(count);
+	for (unsigned long long& key : randomKeys)
+		key = random();
+	// a few pipelines, assets & materials and a spread of depths, many keys equal
+	for (unsigned long long& key : levelKeys)
+		key = RenderQueue::MakeKey(RenderPass::OPAQUE, random() % 3, random() % 40, random() % 120,
+			std::uniform_real_distribution<float>(0.1f, 100.0f)(random) * (random() % 4 == 0 ? 0 : 1));
+
+	for (unsigned small : { 0u, 1u, 2u, 3u })
+		CheckOrder(queue, backend, std::vector<unsigned long long>(randomKeys.begin(), randomKeys.begin() + small),
+			std::to_string(small) + " keys");
+	CheckOrder(queue, backend, randomKeys, "random keys");
+	CheckOrder(queue, backend, levelKeys, "MakeKey keys");
+	CheckOrder(queue, backend, std::vector<unsigned long long>(count, 0x0123456789ABCDEFull), "all equal keys");
+	for (int byte = 0; byte < 8; ++byte)
+	{
+		for (unsigned i = 0; i < count; ++i)
+			keys[i] = (0x0123456789ABCDEFull & ~(0xFFull << byte * 8)) | (random() & 0xFF) << byte * 8;
+		CheckOrder(queue, backend, keys, "keys differing in byte " + std::to_string(byte));
+		for (unsigned i = 0; i < count; ++i)
+			keys[i] = (keys[i] & ~(0xFFull << (byte + 3) % 8 * 8)) | (random() % 4) << (byte + 3) % 8 * 8;
+		CheckOrder(queue, backend, keys, "keys differing in bytes " + std::to_string(byte) + " & " + std::to_string((byte + 3) % 8));
+	}
+
+	// radix against std::stable_sort of the same entries, queue filled again before each pass
+	std::cout << count << " draws, best of " << passes << " passes" << std::endl;
+	std::cout << std::left << std::setw(16) << "keys" << std::right << std::setw(11) << "radix ms" << std::setw(15) <<
+		"stable_sort ms" << std::setw(10) << "speedup" << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+	std::vector<KeyAndPush> entries(count);
+	for (int set = 0; set < 3; ++set)
+	{
+		const std::vector<unsigned long long>& timed = set == 0 ? randomKeys : set == 1 ? levelKeys : keys;
+		double radixMs = HUGE_VAL, stableMs = HUGE_VAL;
+		for (int pass = 0; pass < passes; ++pass)
+		{
+			Fill(queue, timed);
+			Clock::time_point start = Clock::now();
+			queue.Sort();
+			radixMs = std::min(radixMs, Milliseconds(start, Clock::now()));
+
+			for (unsigned i = 0; i < count; ++i)
+				entries[i] = { timed[i], i };
+			start = Clock::now();
+			std::stable_sort(entries.begin(), entries.end(),
+				[](const KeyAndPush& a, const KeyAndPush& b) { return a.first < b.first; });
+			stableMs = std::min(stableMs, Milliseconds(start, Clock::now()));
+		}
+		std::cout << std::left << std::setw(16) << (set == 0 ? "random" : set == 1 ? "MakeKey" : "two bytes") <<
+			std::right << std::setw(11) << radixMs << std::setw(15) << stableMs << std::setw(9) << stableMs / radixMs << "x" << std::endl;
+	}
+	if (failures == 0)
+		std::cout << "RenderQueue::Sort matches std::stable_sort" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,239 @@
+//storeBench.cpp
+// Checks InstanceStore's handles (Add, Remove swapping the last instance in, slot reuse with a
+// new generation, SortByAsset) against a std::map of what should be alive, and times the two
+// passes RenderLevel makes over every instance, culling the world boxes and copying the world
+// matrices, on 100k instances in the store and in a std::list of Model like nodes as the level
+// kept them before the store.
+//   StoreBench [instances, default 100000]
+#define GATEWARE_ENABLE_CORE // All libraries need this
+#define GATEWARE_ENABLE_SYSTEM // GFile & GLog used by the level loader
+#define GATEWARE_ENABLE_MATH
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <list>
+#include <map>
+#include <vector>
+#include "../gateware-main/gateware-main/Gateware.h"
+#include "instanceStore.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double Milliseconds(Clock::time_point from, Clock::time_point to)
+{
+	return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+static unsigned failures = 0;
+
+static void Check(bool passed, const std::string& what)
+{
+	if (!passed)
+	{
+		std::cout << "MISMATCH: " << what << std::endl;
+		++failures;
+	}
+}
+
+// What a placed model was before the store, one heap node each with everything inline
+struct ListModel
+{
+	std::string name;
+	AssetHandle asset = INVALID_ASSET;
+	GW::MATH::GMATRIXF world;
+	unsigned pipeline = 0;
+	BoundingBox bounds;
+	unsigned flags = INSTANCE_NONE;
+	unsigned order = 0; // only used to shuffle the list
+};
+
+static GW::MATH::GMATRIXF Translation(float x, float y, float z)
+{
+	GW::MATH::GMATRIXF world = GW::MATH::GIdentityMatrixF;
+	world.row4 = { x, y, z, 1 };
+	return world;
+}
+
+// Every live handle must lead to the instance the reference says it is
+static bool Matches(const InstanceStore& store, const std::map<InstanceHandle, std::string>& alive)
+{
+	if (store.Size() != alive.size())
+		return false;
+	for (const auto& instance : alive)
+		if (!store.IsValid(instance.first) || store.GetName(store.IndexOf(instance.first)) != instance.second ||
+			store.HandleOf(store.IndexOf(instance.first)) != instance.first)
+			return false;
+	return true;
+}
+
+static void CheckHandles()
+{
+	InstanceStore store;
+	const BoundingBox box = { { 0, 0, 0 }, { 1, 1, 1 } };
+	const InstanceHandle a = store.Add("a", 0, 0, Translation(0, 0, 0), box);
+	const InstanceHandle b = store.Add("b", 1, 0, Translation(1, 0, 0), box);
+	const InstanceHandle c = store.Add("c", 0, 0, Translation(2, 0, 0), box);
+	Check(store.Size() == 3 && store.IndexOf(a) == 0 && store.IndexOf(b) == 1 && store.IndexOf(c) == 2,
+		"added instances are not in order");
+
+	// the last instance fills the hole and keeps its handle
+	Check(store.Remove(b), "Remove of a live handle failed");
+	Check(!store.IsValid(b), "a removed instance's handle is still valid");
+	Check(!store.Remove(b), "a removed instance was removed twice");
+	Check(store.Size() == 2 && store.IndexOf(c) == 1 && store.GetName(1) == "c" && store.GetWorlds()[1].row4.x == 2,
+		"the last instance was not moved into the removed one's place");
+
+	// the freed slot is reused with the next generation, the old handle stays stale
+	const InstanceHandle d = store.Add("d", 1, 0, Translation(3, 0, 0), box);
+	Check(d != b && (d & 0xffffff) == (b & 0xffffff), "the freed slot was not reused under a new handle");
+	Check(!store.IsValid(b) && store.IsValid(d) && store.GetName(store.IndexOf(d)) == "d",
+		"a stale handle reached the instance that reused its slot");
+	Check(!store.IsValid(INVALID_INSTANCE) && !store.IsValid(0xffffff), "an unknown handle is valid");
+
+	// grouping by asset moves instances, not handles
+	store.SortByAsset();
+	Check(store.GetAssets()[0] == 0 && store.GetAssets()[1] == 0 && store.GetAssets()[2] == 1,
+		"SortByAsset did not group by asset");
+	Check(store.GetName(store.IndexOf(a)) == "a" && store.GetName(store.IndexOf(c)) == "c" &&
+		store.GetName(store.IndexOf(d)) == "d" && store.GetWorlds()[store.IndexOf(d)].row4.x == 3,
+		"a handle points at another instance after SortByAsset");
+
+	// random adds, removes & sorts against a map of what should be alive
+	std::mt19937 random(13);
+	std::map<InstanceHandle, std::string> alive = { { a, "a" }, { c, "c" }, { d, "d" } };
+	std::vector<InstanceHandle> handles = { a, c, d };
+	unsigned mismatches = 0, staleAccepted = 0;
+	for (unsigned step = 0; step < 20000; ++step)
+	{
+		const unsigned action = random() % 8;
+		if (action < 4 || handles.empty())
+		{
+			const std::string name = "i" + std::to_string(step);
+			const InstanceHandle handle = store.Add(name, random() % 16, 0, Translation(static_cast<float>(step), 0, 0), box);
+			alive[handle] = name;
+			handles.push_back(handle);
+		}
+		else if (action < 7)
+		{
+			const unsigned pick = random() % handles.size();
+			const InstanceHandle handle = handles[pick];
+			handles[pick] = handles.back();
+			handles.pop_back();
+			alive.erase(handle);
+			mismatches += !store.Remove(handle);
+			staleAccepted += store.IsValid(handle) || store.Remove(handle);
+		}
+		else
+			store.SortByAsset();
+		if (step % 1000 == 999)
+			mismatches += !Matches(store, alive);
+	}
+	Check(mismatches == 0 && Matches(store, alive), "handles went to other instances than the reference map after random edits");
+	Check(staleAccepted == 0, std::to_string(staleAccepted) + " removed handles were still accepted");
+	store.Clear();
+	Check(store.Empty() && !store.IsValid(a), "Clear left instances behind");
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 2)
+	{
+		std::cout << "usage: StoreBench [instances]" << std::endl;
+		return 1;
+	}
+	const unsigned count = argc == 2 ? std::max(1u, static_cast<unsigned>(std::stoul(argv[1]))) : 100000;
+	const int passes = 5;
+	CheckHandles();
+
+	// the same instances both ways, the list nodes shuffled like a level edited for a while
+	std::mt19937 random(count);
+	std::uniform_real_distribution<float> position(-200.0f, 200.0f), size(0.1f, 4.0f);
+	InstanceStore store;
+	store.Reserve(count);
+	std::list<ListModel> models;
+	for (unsigned i = 0; i < count; ++i)
+	{
+		ListModel model;
+		model.name = "Model_" + std::to_string(i);
+		model.asset = i % 64;
+		model.world = Translation(position(random), position(random) * 0.1f, position(random));
+		model.bounds = { { model.world.row4.x, model.world.row4.y, model.world.row4.z }, { size(random), size(random), size(random) } };
+		model.order = static_cast<unsigned>(random());
+		store.Add(model.name, model.asset, 0, model.world, model.bounds);
+		models.push_back(std::move(model));
+	}
+	models.sort([](const ListModel& a, const ListModel& b) { return a.order < b.order; });
+	store.SortByAsset();
+
+	const float view[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	const float n = 0.1f, f = 300.0f;
+	const float projection[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, f / (f - n), 1, 0, 0, -n * f / (f - n), 0 };
+	float viewProj[16];
+	MultiplyMatrix4(view, projection, viewProj);
+	const Frustum frustum = ExtractFrustum(viewProj);
+
+	// the two orders differ, the results are compared as sorted world x positions
+	std::vector<GW::MATH::GMATRIXF> copied(count);
+	std::vector<float> storeX, listX;
+	storeX.reserve(count);
+	listX.reserve(count);
+	double storeCull = HUGE_VAL, listCull = HUGE_VAL, storeCopy = HUGE_VAL, listCopy = HUGE_VAL;
+	bool sameVisible = true, sameCopy = true;
+	for (int pass = 0; pass < passes; ++pass)
+	{
+		Clock::time_point start = Clock::now();
+		storeX.clear();
+		const BoundingBox* bounds = store.GetBounds();
+		for (unsigned i = 0; i < store.Size(); ++i)
+			if (IsBoxVisible(frustum, bounds[i]))
+				storeX.push_back(bounds[i].center[0]);
+		storeCull = std::min(storeCull, Milliseconds(start, Clock::now()));
+
+		start = Clock::now();
+		listX.clear();
+		for (const ListModel& model : models)
+			if (IsBoxVisible(frustum, model.bounds))
+				listX.push_back(model.bounds.center[0]);
+		listCull = std::min(listCull, Milliseconds(start, Clock::now()));
+		std::sort(storeX.begin(), storeX.end());
+		std::sort(listX.begin(), listX.end());
+		sameVisible &= storeX == listX;
+
+		start = Clock::now();
+		std::copy(store.GetWorlds(), store.GetWorlds() + store.Size(), copied.begin());
+		storeCopy = std::min(storeCopy, Milliseconds(start, Clock::now()));
+		storeX.clear();
+		for (const GW::MATH::GMATRIXF& world : copied)
+			storeX.push_back(world.row4.x);
+
+		start = Clock::now();
+		GW::MATH::GMATRIXF* out = copied.data();
+		for (const ListModel& model : models)
+			*out++ = model.world;
+		listCopy = std::min(listCopy, Milliseconds(start, Clock::now()));
+		listX.clear();
+		for (const GW::MATH::GMATRIXF& world : copied)
+			listX.push_back(world.row4.x);
+		std::sort(storeX.begin(), storeX.end());
+		std::sort(listX.begin(), listX.end());
+		sameCopy &= storeX == listX;
+	}
+	Check(sameVisible, "the store and the list culled to other instances");
+	Check(sameCopy, "the store and the list copied other world matrices");
+
+	std::cout << count << " instances, best of " << passes << " passes, " << sizeof(ListModel) <<
+		" byte list nodes (+ list links)" << std::endl;
+	std::cout << std::left << std::setw(20) << "pass" << std::right << std::setw(12) << "list ms" << std::setw(12) <<
+		"store ms" << std::setw(10) << "speedup" << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << std::left << std::setw(20) << "cull world boxes" << std::right << std::setw(12) << listCull <<
+		std::setw(12) << storeCull << std::setw(9) << listCull / storeCull << "x" << std::endl;
+	std::cout << std::left << std::setw(20) << "copy world matrices" << std::right << std::setw(12) << listCopy <<
+		std::setw(12) << storeCopy << std::setw(9) << listCopy / storeCopy << "x" << std::endl;
+	if (failures == 0)
+		std::cout << "InstanceStore handle checks passed" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+//streamerCheck.cpp
+// Checks LevelStreamer's swap on the in memory RecordingBackend. GameLevelOne is streamed in and
+// drawn, then GameLevelTwo is requested with a load that waits for a go from this thread, and
+// Update + RenderLevel run every frame while the worker is held and while it loads. Until the
+// frame Update returns SWAPPED every frame must draw level one exactly as before the request
+// and no GPU buffer may be created or freed. The swap frame and every frame after it must draw
+// what level two draws when it is loaded on its own.
+//   StreamerCheck <h2b folder> <levels folder>
+#define GATEWARE_ENABLE_CORE // All libraries need this
+#define GATEWARE_ENABLE_SYSTEM // GFile & GLog used by the level loader
+#define GATEWARE_ENABLE_MATH
+
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <tuple>
+#include "../gateware-main/gateware-main/Gateware.h"
+#include "load_object_oriented.h"
+#include "levelStreamer.h"
+#include "recordingBackend.h"
+
+static unsigned failures = 0;
+
+static void Check(bool passed, const std::string& what)
+{
+	if (!passed)
+	{
+		std::cout << "MISMATCH: " << what << std::endl;
+		++failures;
+	}
+}
+
+// indexCount, instanceCount, firstIndex & baseVertex of every draw of a frame, the first
+// instance is left out since it moves with the per frame ring
+typedef std::vector<std::tuple<unsigned, unsigned, unsigned, int>> FrameDraws;
+
+static FrameDraws DrawsOf(const RecordingBackend& backend)
+{
+	FrameDraws draws;
+	for (const RecordedCommand& c : backend.GetCommands())
+		if (c.type == RecordedCommandType::DRAW_INDEXED_INSTANCED)
+			draws.push_back(std::make_tuple(c.args[0], c.args[1], c.args[2], c.baseVertex));
+	return draws;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		std::cout << "usage: StreamerCheck <h2b folder> <levels folder>" << std::endl;
+		return 1;
+	}
+	const std::string h2bFolder = argv[1];
+	const std::string levelOne = std::string(argv[2]) + "/GameLevelOne.txt", levelTwo = std::string(argv[2]) + "/GameLevelTwo.txt";
+	const std::chrono::seconds timeout(30);
+	const unsigned heldFrames = 10;
+	GW::SYSTEM::GLog log; // not created, the messages go nowhere
+	GW::MATH::GMatrix proxy;
+	proxy.Create();
+	GW::MATH::GMATRIXF projection;
+	proxy.ProjectionDirectXLHF(G_DEGREE_TO_RADIAN_F(65), 16.0f / 9.0f, 0.1f, 100.0f, projection);
+	Camera camera;
+	camera.LookAt({ 0, 8, -18, 0 }, { 0, 0, 0, 0 }, { 0, 1, 0, 0 });
+	camera.SetProjection(projection);
+
+	// what level two draws from this camera when nothing else is going on
+	FrameDraws expectedTwo;
+	{
+		RecordingBackend backend;
+		Level_Objects level;
+		if (!level.LoadLevel(levelTwo.c_str(), h2bFolder.c_str(), log))
+		{
+			std::cout << "could not load " << levelTwo << std::endl;
+			return 1;
+		}
+		level.UploadLevelToGPU(backend, camera.Update().view, projection);
+		backend.ClearCommands();
+		level.RenderLevel(camera.Update());
+		expectedTwo = DrawsOf(backend);
+		level.UnloadLevel();
+	}
+
+	RecordingBackend backend;
+	LevelStreamer levels;
+	levels.Request(levelOne.c_str(), [&](Level_Objects& level) { return level.LoadLevel(levelOne.c_str(), h2bFolder.c_str(), log); });
+	const auto start = std::chrono::steady_clock::now();
+	while (levels.Update(backend, camera.Update().view, projection) == LevelStreamState::LOADING &&
+		std::chrono::steady_clock::now() - start < timeout)
+		std::this_thread::yield();
+	if (levels.IsLoading() || levels.GetLevel().GetInstances().Empty())
+	{
+		std::cout << "could not stream in " << levelOne << std::endl;
+		return 1;
+	}
+	backend.ClearCommands();
+	levels.GetLevel().RenderLevel(camera.Update());
+	const FrameDraws expectedOne = DrawsOf(backend);
+	Check(!expectedOne.empty() && expectedOne != expectedTwo, "the two levels draw the same from the test camera");
+
+	// the worker is held until heldFrames frames went by, then loads while the frames go on
+	std::atomic<bool> go{ false };
+	std::atomic<bool> loadTimedOut{ false };
+	levels.Request(levelTwo.c_str(), [&](Level_Objects& level) {
+		const auto waitStart = std::chrono::steady_clock::now();
+		while (!go.load())
+		{
+			if (std::chrono::steady_clock::now() - waitStart > timeout)
+			{
+				loadTimedOut = true;
+				return false;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return level.LoadLevel(levelTwo.c_str(), h2bFolder.c_str(), log);
+	});
+	const Level_Objects* oldLevel = &levels.GetLevel();
+	unsigned frames = 0, wrongFrames = 0, gpuChanges = 0;
+	LevelStreamState state = LevelStreamState::LOADING;
+	const auto requested = std::chrono::steady_clock::now();
+	while (state == LevelStreamState::LOADING && std::chrono::steady_clock::now() - requested < timeout)
+	{
+		if (frames == heldFrames)
+			go = true;
+		backend.ClearCommands();
+		state = levels.Update(backend, camera.Update().view, projection);
+		levels.GetLevel().RenderLevel(camera.Update());
+		if (state != LevelStreamState::LOADING)
+			break;
+		++frames;
+		wrongFrames += DrawsOf(backend) != expectedOne || &levels.GetLevel() != oldLevel;
+		gpuChanges += backend.GetCount(RecordedCommandType::CREATE_BUFFER) + backend.GetCount(RecordedCommandType::DESTROY_BUFFER);
+	}
+	go = true;
+	Check(state == LevelStreamState::SWAPPED && !loadTimedOut, "level two was not swapped in");
+	Check(frames >= heldFrames && levels.GetLastTimings().framesWhileLoading == frames,
+		"Update did not report LOADING for every frame before the swap");
+	Check(wrongFrames == 0, std::to_string(wrongFrames) + " of " + std::to_string(frames) +
+		" frames while loading did not draw level one as before the request");
+	Check(gpuChanges == 0, "GPU buffers were created or freed before the swap frame");
+
+	// the swap frame uploads level two, frees level one and draws level two, so do the ones after it
+	Check(DrawsOf(backend) == expectedTwo, "the swap frame did not draw level two");
+	Check(backend.GetCount(RecordedCommandType::CREATE_BUFFER) > 0 && backend.GetCount(RecordedCommandType::DESTROY_BUFFER) > 0,
+		"the swap frame did not upload level two and free level one");
+	for (int frame = 0; frame < 3; ++frame)
+	{
+		backend.ClearCommands();
+		Check(levels.Update(backend, camera.Update().view, projection) == LevelStreamState::IDLE, "Update is not idle after the swap");
+		levels.GetLevel().RenderLevel(camera.Update());
+		Check(DrawsOf(backend) == expectedTwo, "a frame after the swap did not draw level two");
+	}
+	levels.GetLevel().UnloadLevel();
+	Check(backend.GetLiveBufferCount() == 0, "buffers left after both levels were unloaded");
+	if (failures == 0)
+		std::cout << "level one drew for " << frames << " frames while level two loaded, then level two from the swap frame on" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
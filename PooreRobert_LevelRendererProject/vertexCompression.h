@@ -0,0 +1,254 @@
+//vertexCompression
+// Smaller vertices for the level buffers. H2B::VERTEX is 36 bytes of floats and most of that is
+// wasted: a position only needs as much precision as its model is big, a normal is a direction
+// and none of the shipped models has UVs (every UVW in Models/ is zero).
+// The compact format stores
+//   position: UNORM16 per axis inside the asset's box, the shader scales it back with a per
+//             asset VertexDecode that travels with each instance
+//   normal:   octahedral mapping of the unit sphere onto a square, two SNORM16
+//   uv:       two halfs (w is dropped), left out of the whole level when no asset has any
+// which is 16 bytes per vertex, 12 without UVs.
+#ifndef _VERTEXCOMPRESSION_H_
+#define _VERTEXCOMPRESSION_H_
+#include <cmath>
+#include <cstring>
+#include <cstddef>
+#include "h2bParser.h"
+
+enum class VertexEncoding
+{
+	FULL, // H2B::VERTEX as exported
+	COMPACT, // CompactVertex
+	COMPACT_NO_UV // CompactVertex up to its uv
+};
+
+// Matches the compact input layouts in Level_Objects::CreateVertexInputLayout
+struct CompactVertex
+{
+	unsigned short position[4]; // UNORM16 in the asset's box, w is padding
+	short normal[2]; // octahedral, SNORM16
+	unsigned short uv[2]; // halfs
+};
+
+// Object space position = offset + stored position * scale. Offset 0 & scale 1 for FULL.
+struct VertexDecode
+{
+	float offset[4];
+	float scale[4];
+};
+
+inline unsigned VertexStride(VertexEncoding encoding)
+{
+	switch (encoding)
+	{
+	case VertexEncoding::COMPACT: return sizeof(CompactVertex);
+	case VertexEncoding::COMPACT_NO_UV: return offsetof(CompactVertex, uv);
+	default: return sizeof(H2B::VERTEX);
+	}
+}
+
+// True if any vertex has a non zero u or v, w is never used
+inline bool HasUVs(const H2B::VERTEX* vertices, unsigned count)
+{
+	for (unsigned i = 0; i < count; ++i)
+		if (vertices[i].uvw.x != 0 || vertices[i].uvw.y != 0)
+			return true;
+	return false;
+}
+
+// The box the positions get quantized in, identity for FULL
+inline VertexDecode ComputeVertexDecode(const H2B::VERTEX* vertices, unsigned count, VertexEncoding encoding)
+{
+	VertexDecode decode = { { 0, 0, 0, 0 }, { 1, 1, 1, 0 } };
+	if (encoding == VertexEncoding::FULL || count == 0)
+		return decode;
+	float low[3] = { vertices[0].pos.x, vertices[0].pos.y, vertices[0].pos.z };
+	float high[3] = { low[0], low[1], low[2] };
+	for (unsigned i = 1; i < count; ++i)
+	{
+		const float p[3] = { vertices[i].pos.x, vertices[i].pos.y, vertices[i].pos.z };
+		for (int a = 0; a < 3; ++a)
+		{
+			low[a] = p[a] < low[a] ? p[a] : low[a];
+			high[a] = p[a] > high[a] ? p[a] : high[a];
+		}
+	}
+	for (int a = 0; a < 3; ++a)
+	{
+		decode.offset[a] = low[a];
+		decode.scale[a] = high[a] - low[a];
+	}
+	return decode;
+}
+
+// IEEE half, rounded to nearest even. Too big becomes infinity, too small zero or a denormal.
+inline unsigned short FloatToHalf(float value)
+{
+	unsigned bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	const unsigned short sign = static_cast<unsigned short>(bits >> 16 & 0x8000);
+	bits &= 0x7FFFFFFF;
+	if (bits >= 0x7F800000) // infinity, NaN stays NaN
+		return sign | 0x7C00 | (bits > 0x7F800000 ? 0x200 : 0);
+	if (bits >= 0x477FF000) // rounds past 65504
+		return sign | 0x7C00;
+	if (bits >= 0x38800000) // normal, rebias the exponent and round off 13 mantissa bits
+	{
+		bits -= 112u << 23;
+		return sign | static_cast<unsigned short>((bits + 0xFFF + (bits >> 13 & 1)) >> 13);
+	}
+	if (bits < 0x33000000) // under half the smallest denormal
+		return sign;
+	const unsigned mantissa = (bits & 0x7FFFFF) | 0x800000;
+	const unsigned shift = 126 - (bits >> 23);
+	unsigned half = mantissa >> shift;
+	const unsigned rest = mantissa & ((1u << shift) - 1);
+	const unsigned middle = 1u << (shift - 1);
+	if (rest > middle || (rest == middle && (half & 1)))
+		++half;
+	return sign | static_cast<unsigned short>(half);
+}
+
+inline float HalfToFloat(unsigned short half)
+{
+	const unsigned sign = static_cast<unsigned>(half & 0x8000) << 16;
+	const unsigned exponent = half >> 10 & 0x1F;
+	const unsigned mantissa = half & 0x3FF;
+	unsigned bits;
+	if (exponent == 0x1F)
+		bits = sign | 0x7F800000 | mantissa << 13;
+	else if (exponent != 0)
+		bits = sign | (exponent + 112) << 23 | mantissa << 13;
+	else if (mantissa == 0)
+		bits = sign;
+	else
+	{
+		float value = std::ldexp(static_cast<float>(mantissa), -24);
+		std::memcpy(&bits, &value, sizeof(bits));
+		bits |= sign;
+	}
+	float value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+// What the input assembler turns an SNORM16 into
+inline float SnormToFloat(short value)
+{
+	const float f = value / 32767.0f;
+	return f < -1.0f ? -1.0f : f;
+}
+
+// Same as DecodeOctahedral in VertexShaderCompact.hlsl
+inline void DecodeOctahedral(const short encoded[2], float normal[3])
+{
+	float x = SnormToFloat(encoded[0]), y = SnormToFloat(encoded[1]);
+	const float z = 1.0f - std::fabs(x) - std::fabs(y);
+	if (z < 0)
+	{
+		const float fx = (1.0f - std::fabs(y)) * (x >= 0 ? 1.0f : -1.0f);
+		const float fy = (1.0f - std::fabs(x)) * (y >= 0 ? 1.0f : -1.0f);
+		x = fx;
+		y = fy;
+	}
+	const float length = std::sqrt(x * x + y * y + z * z);
+	normal[0] = x / length;
+	normal[1] = y / length;
+	normal[2] = z / length;
+}
+
+// Projects onto the octahedron, folds the lower half over and then tries all four ways of
+// rounding to SNORM16, keeping the one that decodes closest to the input. A zero vector
+// encodes as +z.
+inline void EncodeOctahedral(float x, float y, float z, short encoded[2])
+{
+	const float sum = std::fabs(x) + std::fabs(y) + std::fabs(z);
+	if (sum == 0)
+	{
+		encoded[0] = encoded[1] = 0;
+		return;
+	}
+	float u = x / sum, v = y / sum;
+	if (z < 0)
+	{
+		const float fu = (1.0f - std::fabs(v)) * (u >= 0 ? 1.0f : -1.0f);
+		const float fv = (1.0f - std::fabs(u)) * (v >= 0 ? 1.0f : -1.0f);
+		u = fu;
+		v = fv;
+	}
+	const float su = std::floor(u * 32767.0f), sv = std::floor(v * 32767.0f);
+	float best = -HUGE_VALF;
+	for (int c = 0; c < 4; ++c)
+	{
+		const float cu = su + (c & 1), cv = sv + (c >> 1);
+		const short candidate[2] = {
+			static_cast<short>(cu < -32767.0f ? -32767.0f : cu > 32767.0f ? 32767.0f : cu),
+			static_cast<short>(cv < -32767.0f ? -32767.0f : cv > 32767.0f ? 32767.0f : cv) };
+		float n[3];
+		DecodeOctahedral(candidate, n);
+		const float cosine = n[0] * x + n[1] * y + n[2] * z; // same length for every candidate
+		if (cosine > best)
+		{
+			best = cosine;
+			encoded[0] = candidate[0];
+			encoded[1] = candidate[1];
+		}
+	}
+}
+
+inline unsigned short QuantizeUnorm16(float value, float offset, float scale)
+{
+	if (scale <= 0)
+		return 0;
+	const float q = std::floor((value - offset) / scale * 65535.0f + 0.5f);
+	return static_cast<unsigned short>(q < 0 ? 0 : q > 65535.0f ? 65535.0f : q);
+}
+
+// Writes count vertices of the given encoding to output, VertexStride(encoding) bytes apart
+inline void EncodeVertices(const H2B::VERTEX* vertices, unsigned count, VertexEncoding encoding,
+	const VertexDecode& decode, void* output)
+{
+	if (encoding == VertexEncoding::FULL)
+	{
+		std::memcpy(output, vertices, count * sizeof(H2B::VERTEX));
+		return;
+	}
+	const unsigned stride = VertexStride(encoding);
+	unsigned char* out = static_cast<unsigned char*>(output);
+	for (unsigned i = 0; i < count; ++i, out += stride)
+	{
+		const H2B::VERTEX& v = vertices[i];
+		CompactVertex c;
+		c.position[0] = QuantizeUnorm16(v.pos.x, decode.offset[0], decode.scale[0]);
+		c.position[1] = QuantizeUnorm16(v.pos.y, decode.offset[1], decode.scale[1]);
+		c.position[2] = QuantizeUnorm16(v.pos.z, decode.offset[2], decode.scale[2]);
+		c.position[3] = 0;
+		EncodeOctahedral(v.nrm.x, v.nrm.y, v.nrm.z, c.normal);
+		c.uv[0] = FloatToHalf(v.uvw.x);
+		c.uv[1] = FloatToHalf(v.uvw.y);
+		std::memcpy(out, &c, stride);
+	}
+}
+
+// What the vertex shader sees for one encoded vertex, object space. Used to measure the error.
+inline H2B::VERTEX DecodeVertex(const void* input, VertexEncoding encoding, const VertexDecode& decode)
+{
+	H2B::VERTEX v;
+	if (encoding == VertexEncoding::FULL)
+	{
+		std::memcpy(&v, input, sizeof(v));
+		return v;
+	}
+	CompactVertex c = {};
+	std::memcpy(&c, input, VertexStride(encoding));
+	v.pos.x = decode.offset[0] + c.position[0] / 65535.0f * decode.scale[0];
+	v.pos.y = decode.offset[1] + c.position[1] / 65535.0f * decode.scale[1];
+	v.pos.z = decode.offset[2] + c.position[2] / 65535.0f * decode.scale[2];
+	float n[3];
+	DecodeOctahedral(c.normal, n);
+	v.nrm = { n[0], n[1], n[2] };
+	v.uvw = { HalfToFloat(c.uv[0]), HalfToFloat(c.uv[1]), 0 };
+	return v;
+}
+
+#endif
@@ -0,0 +1,107 @@
+//vertexReport.cpp
+// Encodes every .h2b in a folder the way a level with compact vertices would and reports how
+// many vertex bytes that saves and how far the decoded vertices are from the originals.
+//   VertexReport <h2b folder>
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+#include <algorithm>
+#include <vector>
+#include <cmath>
+#include "h2bParser.h"
+#include "vertexCompression.h"
+
+struct EncodingError
+{
+	float position = 0; // object space units
+	float positionOfSize = 0; // position error / longest side of the asset's box
+	float normalDegrees = 0;
+	float uv = 0;
+};
+
+static EncodingError MeasureError(const H2B::VERTEX* vertices, unsigned count, VertexEncoding encoding,
+	const VertexDecode& decode, const std::vector<unsigned char>& encoded)
+{
+	EncodingError error;
+	const unsigned stride = VertexStride(encoding);
+	for (unsigned i = 0; i < count; ++i)
+	{
+		const H2B::VERTEX& a = vertices[i];
+		const H2B::VERTEX b = DecodeVertex(encoded.data() + static_cast<size_t>(i) * stride, encoding, decode);
+		const float dp = std::max({ std::fabs(a.pos.x - b.pos.x), std::fabs(a.pos.y - b.pos.y), std::fabs(a.pos.z - b.pos.z) });
+		error.position = std::max(error.position, dp);
+		// angle between the normals from sine & cosine in double, acos of a float is too coarse near 0
+		const double cx = double(a.nrm.y) * b.nrm.z - double(a.nrm.z) * b.nrm.y;
+		const double cy = double(a.nrm.z) * b.nrm.x - double(a.nrm.x) * b.nrm.z;
+		const double cz = double(a.nrm.x) * b.nrm.y - double(a.nrm.y) * b.nrm.x;
+		const double dot = double(a.nrm.x) * b.nrm.x + double(a.nrm.y) * b.nrm.y + double(a.nrm.z) * b.nrm.z;
+		const float angle = static_cast<float>(std::atan2(std::sqrt(cx * cx + cy * cy + cz * cz), dot) * 57.29577951308232);
+		error.normalDegrees = std::max(error.normalDegrees, angle);
+		if (encoding == VertexEncoding::COMPACT)
+			error.uv = std::max({ error.uv, std::fabs(a.uvw.x - b.uvw.x), std::fabs(a.uvw.y - b.uvw.y) });
+	}
+	const float size = std::max({ decode.scale[0], decode.scale[1], decode.scale[2] });
+	error.positionOfSize = size > 0 ? error.position / size : 0;
+	return error;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 2)
+	{
+		std::cout << "usage: VertexReport <h2b folder>" << std::endl;
+		return 1;
+	}
+	std::vector<std::filesystem::path> files;
+	for (const auto& entry : std::filesystem::directory_iterator(argv[1]))
+		if (entry.path().extension() == ".h2b")
+			files.push_back(entry.path());
+	std::sort(files.begin(), files.end());
+
+	std::cout << std::left << std::setw(24) << "model" << std::right << std::setw(8) << "verts" <<
+		std::setw(10) << "full B" << std::setw(10) << "compact B" << std::setw(8) << "saved" <<
+		std::setw(13) << "max pos err" << std::setw(12) << "of size" << std::setw(11) << "max nrm" <<
+		std::setw(11) << "max uv err" << std::endl;
+	std::cout << std::fixed;
+	size_t totalFull = 0, totalCompact = 0;
+	EncodingError worst;
+	for (const std::filesystem::path& file : files)
+	{
+		H2B::Parser model;
+		if (!model.Parse(file.string().c_str()))
+		{
+			std::cout << file.filename().string() << ": could not parse" << std::endl;
+			continue;
+		}
+		const H2B::VERTEX* vertices = model.vertices.data();
+		const unsigned count = static_cast<unsigned>(model.vertices.size());
+		// a level of only this model, UVs are kept when it has any
+		const VertexEncoding encoding = HasUVs(vertices, count) ? VertexEncoding::COMPACT : VertexEncoding::COMPACT_NO_UV;
+		const VertexDecode decode = ComputeVertexDecode(vertices, count, encoding);
+		std::vector<unsigned char> encoded(static_cast<size_t>(count) * VertexStride(encoding));
+		EncodeVertices(vertices, count, encoding, decode, encoded.data());
+		const EncodingError error = MeasureError(vertices, count, encoding, decode, encoded);
+
+		const size_t fullBytes = static_cast<size_t>(count) * sizeof(H2B::VERTEX);
+		totalFull += fullBytes;
+		totalCompact += encoded.size();
+		worst.position = std::max(worst.position, error.position);
+		worst.positionOfSize = std::max(worst.positionOfSize, error.positionOfSize);
+		worst.normalDegrees = std::max(worst.normalDegrees, error.normalDegrees);
+		worst.uv = std::max(worst.uv, error.uv);
+		std::cout << std::left << std::setw(24) << file.stem().string() << std::right << std::setw(8) << count <<
+			std::setw(10) << fullBytes << std::setw(10) << encoded.size() <<
+			std::setw(7) << std::setprecision(1) << 100.0 * (fullBytes - encoded.size()) / (fullBytes ? fullBytes : 1) << "%" <<
+			std::setw(13) << std::setprecision(7) << error.position << std::setw(12) << std::setprecision(7) << error.positionOfSize <<
+			std::setw(10) << std::setprecision(4) << error.normalDegrees << "d" <<
+			std::setw(11) << std::setprecision(5) << (encoding == VertexEncoding::COMPACT ? error.uv : 0.0f) <<
+			(encoding == VertexEncoding::COMPACT ? "" : "  (no UVs, 12 B/vertex)") << std::endl;
+	}
+	std::cout << std::left << std::setw(24) << "total" << std::right << std::setw(8) << "" <<
+		std::setw(10) << totalFull << std::setw(10) << totalCompact <<
+		std::setw(7) << std::setprecision(1) << 100.0 * (totalFull - totalCompact) / (totalFull ? totalFull : 1) << "%" <<
+		std::setw(13) << std::setprecision(7) << worst.position << std::setw(12) << std::setprecision(7) << worst.positionOfSize <<
+		std::setw(10) << std::setprecision(4) << worst.normalDegrees << "d" <<
+		std::setw(11) << std::setprecision(5) << worst.uv << std::endl;
+	return 0;
+}